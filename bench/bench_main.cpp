@@ -0,0 +1,209 @@
+// Desktop benchmarks of the engine, kept out of the shipped builds; see
+// the Makefile next to this file. Run without arguments for the modes.
+
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/dsp/miniacid_engine.h"
+#include "src/dsp/sample_convert.h"
+#include "src/dsp/sample_rate_probe.h"
+#include "src/audio/desktop_audio_recorder.h"
+#include "src/audio/song_bouncer.h"
+#include "platform_sdl/scene_storage_sdl.h"
+#include "parallel_voice_renderer.h"
+#include "voice_benchmark.h"
+
+namespace {
+
+// Renders the current scene with stem capture off and in each layout and
+// reports the cost of a block, including the int16 conversion of the stems.
+void benchStems(MiniAcid& engine, int blocks) {
+  std::vector<float> out(AUDIO_BUFFER_SAMPLES);
+  std::vector<float> stems(AUDIO_BUFFER_SAMPLES * kMaxStems);
+  std::vector<int16_t> pcm(AUDIO_BUFFER_SAMPLES * kMaxStems);
+  const double deadlineNs = 1e9 * AUDIO_BUFFER_SAMPLES / engine.sampleRate();
+  static const char* const kNames[] = {"off", "grouped", "lanes"};
+  double baseNs = 0.0;
+  for (int mode = 0; mode < 3; ++mode) {
+    const bool capture = mode > 0;
+    engine.setStemLayout(mode == 2 ? StemLayout::PerLane : StemLayout::Grouped);
+    const size_t values = AUDIO_BUFFER_SAMPLES * static_cast<size_t>(stemCount(engine.stemLayout()));
+    engine.start();
+    auto start = std::chrono::steady_clock::now();
+    for (int b = 0; b < blocks; ++b) {
+      engine.renderFloat(out.data(), AUDIO_BUFFER_SAMPLES, capture ? stems.data() : nullptr);
+      if (capture) convertFloatToInt16(stems.data(), pcm.data(), values, 1.0f);
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start).count() / blocks;
+    if (mode == 0) baseNs = ns;
+    printf("stems %-7s: %.1f us per block (%.2f%% of deadline, %+.1f%% over off)\n",
+           kNames[mode], ns / 1000.0, 100.0 * ns / deadlineNs, 100.0 * (ns - baseNs) / baseNs);
+  }
+  engine.stop();
+}
+
+std::vector<uint8_t> readWholeFile(const std::string& path) {
+  std::vector<uint8_t> bytes;
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) return bytes;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+  fclose(file);
+  return bytes;
+}
+
+// Exports the song with a SongBouncer writing to a file named after
+// 'name'. With 'live' set the engine keeps playing on this thread, paced
+// like the audio callback, and the blocks that ran late are counted.
+bool exportSong(MiniAcid& engine, const char* name, bool live, std::string& filename) {
+  DesktopAudioRecorder recorder;
+  recorder.setTrackNames({name});
+  SongBouncer bouncer;
+  bouncer.setRecorder(&recorder);
+  auto snapshot = std::make_unique<SongRenderSnapshot>();
+  engine.captureSongRender(*snapshot);
+  std::unique_ptr<MiniAcid> clone = MiniAcid::cloneForSongRender(*snapshot);
+  if (engine.loadSongRenderBanks(*clone) != 0 || !bouncer.start(std::move(clone))) {
+    fprintf(stderr, "Cannot start the export\n");
+    return false;
+  }
+  const auto period = std::chrono::nanoseconds(
+      static_cast<int64_t>(1e9 * AUDIO_BUFFER_SAMPLES / engine.sampleRate()));
+  int16_t pcm[AUDIO_BUFFER_SAMPLES];
+  int blocks = 0;
+  int late = 0;
+  auto next = std::chrono::steady_clock::now();
+  while (bouncer.isRendering()) {
+    if (!live) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    auto start = std::chrono::steady_clock::now();
+    engine.generateAudioBuffer(pcm, AUDIO_BUFFER_SAMPLES);
+    if (std::chrono::steady_clock::now() - start > period) ++late;
+    ++blocks;
+    next += period;
+    std::this_thread::sleep_until(next);
+  }
+  bouncer.update();
+  filename = bouncer.filename();
+  printf("%s: %.1f s of song in %.2f s (%.0fx realtime)", name, bouncer.songSeconds(),
+         bouncer.renderSeconds(), bouncer.songSeconds() / bouncer.renderSeconds());
+  if (live) printf(", live engine meanwhile: %d blocks, %d late", blocks, late);
+  printf("\n");
+  return bouncer.state() == SongBouncer::State::Done;
+}
+
+// Exports a song of 'rows' positions while the engine keeps playing, then
+// again with nothing else running, and checks the files match. Every other
+// row plays from a different bank so the exports page banks in as they go.
+bool benchBounce(MiniAcid& engine, int rows) {
+  if (rows < 1) rows = 1;
+  if (rows > Song::kMaxPositions) rows = Song::kMaxPositions;
+  for (int pos = 0; pos < rows; ++pos) {
+    int pattern = pos % 2 ? (pos * 9) % kSongPatternCount : 0;
+    engine.setSongPattern(pos, SongTrack::SynthA, pattern);
+    engine.setSongPattern(pos, SongTrack::SynthB, pattern);
+    engine.setSongPattern(pos, SongTrack::Drums, pattern);
+  }
+  engine.start();
+  std::string liveFile;
+  std::string quietFile;
+  bool ok = exportSong(engine, "song", true, liveFile);
+  engine.stop();
+  ok = exportSong(engine, "reference", false, quietFile) && ok;
+  std::vector<uint8_t> a = readWholeFile(liveFile);
+  std::vector<uint8_t> b = readWholeFile(quietFile);
+  remove(liveFile.c_str());
+  remove(quietFile.c_str());
+  bool same = !a.empty() && a == b;
+  printf("%zu bytes, %s\n", a.size(), same ? "identical to the reference" : "DIFFERENT from the reference");
+  return ok && same;
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: miniacid-bench <mode> [arg]\n"
+          "  bench303              303 voices that fit in half a block\n"
+          "  benchvoices [voices]  parallel voice rendering per thread count\n"
+          "  benchsplit            engine render on one thread and split\n"
+          "  proberate             load of each engine rate\n"
+          "  benchbounce [rows]    song export while playing, checked against a quiet export\n"
+          "  benchstems [blocks]   cost of the stem layouts\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  const std::string mode = argv[1];
+
+  if (mode == "bench303") {
+    VoiceBenchmarkResult bench = benchmark303Voices(SAMPLE_RATE, AUDIO_BUFFER_SAMPLES, 400, 0.5f);
+    for (int v = 1; v <= TB303VoiceBank::kMaxVoices; ++v) {
+      printf("%d voices: worst block %.1f%% of deadline\n", v, bench.worstLoad[v] * 100.0f);
+    }
+    printf("max 303 voices within 50%% budget: %d\n", bench.maxVoices);
+    return 0;
+  }
+
+  if (mode == "benchvoices") {
+    int voices = argc > 2 ? atoi(argv[2]) : 64;
+    int threads = WorkStealingPool::hardwareThreads();
+    ParallelBenchmarkResult bench =
+        benchmarkParallelVoices(SAMPLE_RATE, AUDIO_BUFFER_SAMPLES, 400, voices, threads);
+    double deadlineUs = 1e6 * AUDIO_BUFFER_SAMPLES / SAMPLE_RATE;
+    for (int t = 1; t <= bench.maxThreads; ++t) {
+      printf("%d voices, %d threads: %.0f us per block (%.1f%% of deadline), %.2fx\n", voices, t,
+             bench.blockUs[t], bench.blockUs[t] * 100.0 / deadlineUs,
+             bench.blockUs[1] / bench.blockUs[t]);
+    }
+    return 0;
+  }
+
+  if (mode == "proberate") {
+    SampleRateProbeResult probe = probeEngineSampleRate(AUDIO_BUFFER_SAMPLES, 400, 0.25f);
+    for (int r = 0; r < kEngineSampleRateCount; ++r) {
+      if (probe.load[r] <= 0.0f) continue;
+      printf("%d Hz: average %.1f%% of deadline\n", kEngineSampleRates[r], probe.load[r] * 100.0f);
+    }
+    printf("picked %d Hz within 25%% budget\n", probe.sampleRate);
+    return 0;
+  }
+
+  // The remaining modes play the scene saved by the desktop build.
+  SceneStorageSdl storage;
+  MiniAcid engine(SAMPLE_RATE, &storage);
+  engine.init();
+
+  if (mode == "benchsplit") {
+    RenderBenchmarkResult bench = benchmarkEngineRender(engine, AUDIO_BUFFER_SAMPLES, 2000);
+    printf("one thread: average %.1f%%, worst %.1f%% of deadline\n",
+           bench.averageLoad * 100.0f, bench.worstLoad * 100.0f);
+    if (bench.split) {
+      printf("split:      average %.1f%%, worst %.1f%% of deadline\n",
+             bench.splitAverageLoad * 100.0f, bench.splitWorstLoad * 100.0f);
+    }
+    return 0;
+  }
+
+  if (mode == "benchbounce") return benchBounce(engine, argc > 2 ? atoi(argv[2]) : 64) ? 0 : 1;
+
+  if (mode == "benchstems") {
+    benchStems(engine, argc > 2 ? atoi(argv[2]) : 4000);
+    return 0;
+  }
+
+  usage();
+  return 1;
+}
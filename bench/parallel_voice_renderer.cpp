@@ -0,0 +1,155 @@
+#include "parallel_voice_renderer.h"
+
+#include <chrono>
+
+namespace {
+constexpr size_t kMasterSlice = 64;
+} // namespace
+
+ParallelVoiceRenderer::ParallelVoiceRenderer(float sampleRate, int voiceCount, int threads)
+  : voiceCount_(voiceCount < 1 ? 1 : voiceCount),
+    pool_(threads) {
+  for (int first = 0; first < voiceCount_; first += TB303VoiceBank::kMaxVoices) {
+    int voices = voiceCount_ - first;
+    if (voices > TB303VoiceBank::kMaxVoices) voices = TB303VoiceBank::kMaxVoices;
+    banks_.emplace_back(new TB303VoiceBank(sampleRate, voices));
+  }
+  channels_.reserve(voiceCount_);
+  for (int v = 0; v < voiceCount_; ++v) channels_.emplace_back(sampleRate);
+  voiceOut_.assign(static_cast<size_t>(voiceCount_) * kMaxBlock, 0.0f);
+  scratch_.resize(pool_.threadCount());
+  for (auto& frames : scratch_) frames.assign(TB303VoiceBank::kMaxVoices * kMaxBlock, 0.0f);
+}
+
+void ParallelVoiceRenderer::startNote(int voice, float freqHz, bool accent, bool slide) {
+  if (voice < 0 || voice >= voiceCount_) return;
+  banks_[voice / TB303VoiceBank::kMaxVoices]->startNote(voice % TB303VoiceBank::kMaxVoices, freqHz,
+                                                         accent, slide);
+}
+
+void ParallelVoiceRenderer::release(int voice) {
+  if (voice < 0 || voice >= voiceCount_) return;
+  banks_[voice / TB303VoiceBank::kMaxVoices]->release(voice % TB303VoiceBank::kMaxVoices);
+}
+
+void ParallelVoiceRenderer::setParameter(int voice, TB303ParamId id, float value) {
+  if (voice < 0 || voice >= voiceCount_) return;
+  banks_[voice / TB303VoiceBank::kMaxVoices]->setParameter(voice % TB303VoiceBank::kMaxVoices, id,
+                                                            value);
+}
+
+Synth303Channel& ParallelVoiceRenderer::channel(int voice) {
+  if (voice < 0) voice = 0;
+  if (voice >= voiceCount_) voice = voiceCount_ - 1;
+  return channels_[voice];
+}
+
+void ParallelVoiceRenderer::voiceTask(void* renderer, int group, int worker) {
+  auto* self = static_cast<ParallelVoiceRenderer*>(renderer);
+  TB303VoiceBank& bank = *self->banks_[group];
+  const int voices = bank.voiceCount();
+  const size_t frames = self->blockFrames_;
+  // The bank writes whole frames; render them into this thread's scratch
+  // and split them into the per-voice blocks in one pass afterwards.
+  float* scratch = self->scratch_[worker].data();
+  for (size_t i = 0; i < frames; ++i) bank.process(scratch + i * TB303VoiceBank::kMaxVoices);
+  for (int v = 0; v < voices; ++v) {
+    float* out = &self->voiceOut_[(group * TB303VoiceBank::kMaxVoices + v) * kMaxBlock];
+    for (size_t i = 0; i < frames; ++i) out[i] = scratch[i * TB303VoiceBank::kMaxVoices + v];
+  }
+}
+
+void ParallelVoiceRenderer::sendTask(void* renderer, int voice, int worker) {
+  (void)worker;
+  auto* self = static_cast<ParallelVoiceRenderer*>(renderer);
+  Synth303Channel& channel = self->channels_[voice];
+  float* block = &self->voiceOut_[static_cast<size_t>(voice) * kMaxBlock];
+  for (size_t i = 0; i < self->blockFrames_; ++i) {
+    block[i] = channel.delay.process(channel.distortion.process(block[i] * 0.5f));
+  }
+}
+
+void ParallelVoiceRenderer::masterTask(void* renderer, int slice, int worker) {
+  (void)worker;
+  auto* self = static_cast<ParallelVoiceRenderer*>(renderer);
+  size_t begin = static_cast<size_t>(slice) * kMasterSlice;
+  size_t end = begin + kMasterSlice;
+  if (end > self->blockFrames_) end = self->blockFrames_;
+  float* out = self->blockOut_;
+  for (size_t i = begin; i < end; ++i) out[i] = 0.0f;
+  for (int v = 0; v < self->voiceCount_; ++v) {
+    const float* block = &self->voiceOut_[static_cast<size_t>(v) * kMaxBlock];
+    for (size_t i = begin; i < end; ++i) out[i] += block[i];
+  }
+}
+
+void ParallelVoiceRenderer::renderBlock(float* out, size_t frames) {
+  blockOut_ = out;
+  blockFrames_ = frames;
+  const int groups = static_cast<int>(banks_.size());
+  const int slices = static_cast<int>((frames + kMasterSlice - 1) / kMasterSlice);
+  if (pool_.threadCount() == 1 || frames * static_cast<size_t>(voiceCount_) < kMinParallelWork) {
+    for (int g = 0; g < groups; ++g) voiceTask(this, g, 0);
+    for (int v = 0; v < voiceCount_; ++v) sendTask(this, v, 0);
+    for (int s = 0; s < slices; ++s) masterTask(this, s, 0);
+    return;
+  }
+  pool_.run(groups, &ParallelVoiceRenderer::voiceTask, this);
+  pool_.run(voiceCount_, &ParallelVoiceRenderer::sendTask, this);
+  pool_.run(slices, &ParallelVoiceRenderer::masterTask, this);
+}
+
+void ParallelVoiceRenderer::render(float* out, size_t frames) {
+  if (!out) return;
+  while (frames > 0) {
+    size_t block = frames < kMaxBlock ? frames : kMaxBlock;
+    renderBlock(out, block);
+    out += block;
+    frames -= block;
+  }
+}
+
+ParallelBenchmarkResult benchmarkParallelVoices(float sampleRate, size_t blockSamples, int blocks,
+                                                int voices, int maxThreads) {
+  ParallelBenchmarkResult result;
+  if (sampleRate <= 0.0f || blockSamples == 0 || blocks <= 0 || voices <= 0) return result;
+  if (maxThreads > ParallelBenchmarkResult::kMaxThreads) maxThreads = ParallelBenchmarkResult::kMaxThreads;
+  const size_t noteSamples = static_cast<size_t>(sampleRate * 60.0f / 140.0f / 4.0f);
+  static const float kNotes[] = {55.0f, 110.0f, 65.4f, 130.8f, 73.4f, 98.0f};
+
+  std::vector<float> out(blockSamples);
+  volatile float sink = 0.0f;
+  for (int threads = 1; threads <= maxThreads; ++threads) {
+    ParallelVoiceRenderer renderer(sampleRate, voices, threads);
+    for (int v = 0; v < voices; ++v) {
+      Synth303Channel& channel = renderer.channel(v);
+      channel.distortion.setEnabled(true);
+      channel.delay.setBeats(0.5f);
+      channel.delay.setBpm(140.0f);
+      channel.delay.setEnabled(true);
+      renderer.setParameter(v, TB303ParamId::Oscillator, 2.0f);
+    }
+    size_t sampleIndex = 0;
+    size_t nextNote = 0;
+    double totalUs = 0.0;
+    for (int b = 0; b < blocks; ++b, sampleIndex += blockSamples) {
+      // Notes change on block boundaries, close enough for a load figure.
+      while (nextNote <= sampleIndex) {
+        size_t step = nextNote / noteSamples;
+        for (int v = 0; v < voices; ++v) {
+          float freq = kNotes[(step + v) % (sizeof(kNotes) / sizeof(kNotes[0]))];
+          renderer.startNote(v, freq, step % 4 == 0, step % 3 == 1);
+        }
+        nextNote += noteSamples;
+      }
+      auto start = std::chrono::steady_clock::now();
+      renderer.render(out.data(), blockSamples);
+      totalUs += std::chrono::duration<double, std::micro>(
+                     std::chrono::steady_clock::now() - start).count();
+      sink = sink + out[0];
+    }
+    result.blockUs[threads] = totalUs / blocks;
+    result.maxThreads = threads;
+  }
+  return result;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+#include "src/dsp/miniacid_engine.h"
+#include "work_stealing_pool.h"
+
+// Renders large sets of 303 voices (dense generative patches, offline
+// renders) on a WorkStealingPool. Each block runs as three stages:
+//   voices - one task per TB303VoiceBank of up to kMaxVoices voices,
+//   sends  - one task per voice for its distortion and delay,
+//   master - one task per slice of the block summing every voice.
+// Blocks with too little work to pay for scheduling run serially.
+class ParallelVoiceRenderer {
+public:
+  static constexpr size_t kMaxBlock = 256;
+  // Below this many voice-samples per block the stages run on the caller.
+  static constexpr size_t kMinParallelWork = 4 * kMaxBlock;
+
+  ParallelVoiceRenderer(float sampleRate, int voiceCount, int threads);
+
+  int voiceCount() const { return voiceCount_; }
+  int threadCount() const { return pool_.threadCount(); }
+
+  void startNote(int voice, float freqHz, bool accent, bool slide);
+  void release(int voice);
+  void setParameter(int voice, TB303ParamId id, float value);
+  Synth303Channel& channel(int voice);
+
+  // Renders 'frames' samples of the mix (voices scaled by 0.5 like the
+  // engine) into 'out'.
+  void render(float* out, size_t frames);
+
+private:
+  static void voiceTask(void* renderer, int group, int worker);
+  static void sendTask(void* renderer, int voice, int worker);
+  static void masterTask(void* renderer, int slice, int worker);
+  void renderBlock(float* out, size_t frames);
+
+  int voiceCount_;
+  WorkStealingPool pool_;
+  std::vector<std::unique_ptr<TB303VoiceBank>> banks_;
+  std::vector<Synth303Channel> channels_;
+  // One block per voice, written by the voice stage and the sends.
+  std::vector<float> voiceOut_;
+  // Per-thread frame buffers the voice banks render into.
+  std::vector<std::vector<float>> scratch_;
+
+  // State of the block being rendered.
+  float* blockOut_ = nullptr;
+  size_t blockFrames_ = 0;
+};
+
+struct ParallelBenchmarkResult {
+  static constexpr int kMaxThreads = 32;
+  // Highest thread count measured.
+  int maxThreads = 0;
+  // Average block time in microseconds for each thread count. Index 0 is unused.
+  double blockUs[kMaxThreads + 1] = {};
+};
+
+// Renders 'blocks' blocks of 'voices' busy supersaw lines through
+// ParallelVoiceRenderer with 1..maxThreads threads, to show how it scales.
+ParallelBenchmarkResult benchmarkParallelVoices(float sampleRate, size_t blockSamples, int blocks,
+                                                int voices, int maxThreads);
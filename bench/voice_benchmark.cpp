@@ -0,0 +1,98 @@
+#include "voice_benchmark.h"
+
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "src/dsp/miniacid_engine.h"
+
+VoiceBenchmarkResult benchmark303Voices(float sampleRate, size_t blockSamples, int blocks,
+                                        float budget) {
+  VoiceBenchmarkResult result;
+  if (sampleRate <= 0.0f || blockSamples == 0 || blocks <= 0) return result;
+  const double deadlineUs = 1e6 * static_cast<double>(blockSamples) / sampleRate;
+  // A sixteenth at 140 bpm.
+  const size_t noteSamples = static_cast<size_t>(sampleRate * 60.0f / 140.0f / 4.0f);
+  static const float kNotes[] = {55.0f, 110.0f, 65.4f, 130.8f, 73.4f, 98.0f};
+
+  TB303VoiceBank bank(sampleRate, TB303VoiceBank::kMaxVoices);
+  std::vector<Synth303Channel> channels;
+  channels.reserve(TB303VoiceBank::kMaxVoices);
+  for (int v = 0; v < TB303VoiceBank::kMaxVoices; ++v) {
+    channels.emplace_back(sampleRate);
+    channels[v].distortion.setEnabled(true);
+    channels[v].delay.setBeats(0.5f);
+    channels[v].delay.setBpm(140.0f);
+    channels[v].delay.setEnabled(true);
+    bank.setParameter(v, TB303ParamId::Oscillator, 2.0f);
+  }
+
+  float out[TB303VoiceBank::kMaxVoices];
+  volatile float sink = 0.0f;
+  for (int voices = 1; voices <= TB303VoiceBank::kMaxVoices; ++voices) {
+    bank.setVoiceCount(voices);
+    size_t sampleIndex = 0;
+    double worstUs = 0.0;
+    for (int b = 0; b < blocks; ++b) {
+      auto start = std::chrono::steady_clock::now();
+      float mix = 0.0f;
+      for (size_t i = 0; i < blockSamples; ++i, ++sampleIndex) {
+        if (sampleIndex % noteSamples == 0) {
+          size_t step = sampleIndex / noteSamples;
+          for (int v = 0; v < voices; ++v) {
+            float freq = kNotes[(step + v) % (sizeof(kNotes) / sizeof(kNotes[0]))];
+            bank.startNote(v, freq, step % 4 == 0, step % 3 == 1);
+          }
+        }
+        bank.process(out);
+        for (int v = 0; v < voices; ++v) {
+          mix += channels[v].delay.process(channels[v].distortion.process(out[v] * 0.5f));
+        }
+      }
+      sink = sink + mix;
+      double us = std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start).count();
+      if (us > worstUs) worstUs = us;
+    }
+    result.worstLoad[voices] = static_cast<float>(worstUs / deadlineUs);
+    if (result.worstLoad[voices] <= budget && result.maxVoices == voices - 1) {
+      result.maxVoices = voices;
+    }
+  }
+  return result;
+}
+
+namespace {
+void timeEngineBlocks(MiniAcid& engine, size_t blockSamples, int blocks, float& average,
+                      float& worst) {
+  const double deadlineUs = 1e6 * static_cast<double>(blockSamples) / engine.sampleRate();
+  std::vector<int16_t> buffer(blockSamples);
+  double totalUs = 0.0;
+  double worstUs = 0.0;
+  for (int b = 0; b < blocks; ++b) {
+    auto start = std::chrono::steady_clock::now();
+    engine.generateAudioBuffer(buffer.data(), blockSamples);
+    double us = std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - start).count();
+    totalUs += us;
+    if (us > worstUs) worstUs = us;
+  }
+  average = static_cast<float>(totalUs / blocks / deadlineUs);
+  worst = static_cast<float>(worstUs / deadlineUs);
+}
+} // namespace
+
+RenderBenchmarkResult benchmarkEngineRender(MiniAcid& engine, size_t blockSamples, int blocks) {
+  RenderBenchmarkResult result;
+  if (blockSamples == 0 || blocks <= 0) return result;
+  engine.setParallelRender(false);
+  if (!engine.isPlaying()) engine.start();
+  timeEngineBlocks(engine, blockSamples, blocks, result.averageLoad, result.worstLoad);
+  result.split = engine.setParallelRender(true);
+  if (result.split) {
+    timeEngineBlocks(engine, blockSamples, blocks, result.splitAverageLoad,
+                     result.splitWorstLoad);
+  }
+  engine.setParallelRender(false);
+  return result;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/dsp/miniacid_engine.h"
+#include "src/dsp/mini_tb303.h"
+
+struct VoiceBenchmarkResult {
+  // Slowest block for each voice count, as a fraction of the block's
+  // playback time (1.0 is a missed deadline). Index 0 is unused.
+  float worstLoad[TB303VoiceBank::kMaxVoices + 1] = {};
+  // Largest voice count whose slowest block stayed within the budget.
+  int maxVoices = 0;
+};
+
+// Renders 'blocks' blocks of busy supersaw lines through distortion and
+// delay with 1..kMaxVoices 303 voices. 'budget' is the share of each block
+// the 303 section may take, leaving the rest to drums and the UI.
+VoiceBenchmarkResult benchmark303Voices(float sampleRate, size_t blockSamples, int blocks,
+                                        float budget);
+
+struct RenderBenchmarkResult {
+  // Average and slowest block as a fraction of the block's playback time,
+  // rendered on the audio thread alone and split across two threads.
+  float averageLoad = 0.0f;
+  float worstLoad = 0.0f;
+  float splitAverageLoad = 0.0f;
+  float splitWorstLoad = 0.0f;
+  // False when the build has no threads; the split figures are then unset.
+  bool split = false;
+};
+
+// Starts 'engine' and renders 'blocks' blocks of whatever it has loaded,
+// first with the whole block on the calling thread, then with
+// MiniAcid::setParallelRender(). The engine is left playing with parallel
+// rendering off.
+RenderBenchmarkResult benchmarkEngineRender(MiniAcid& engine, size_t blockSamples, int blocks);
@@ -0,0 +1,140 @@
+#include "work_stealing_pool.h"
+
+namespace {
+// Rounds of yielding before an idle helper parks. A block arriving within
+// this window is picked up without any locking.
+constexpr int kSpinRounds = 2000;
+
+uint64_t packRange(uint32_t begin, uint32_t end) {
+  return static_cast<uint64_t>(begin) | (static_cast<uint64_t>(end) << 32);
+}
+
+uint32_t rangeBegin(uint64_t bounds) { return static_cast<uint32_t>(bounds); }
+uint32_t rangeEnd(uint64_t bounds) { return static_cast<uint32_t>(bounds >> 32); }
+} // namespace
+
+WorkStealingPool::WorkStealingPool(int threads)
+  : threadCount_(threads < 1 ? 1 : threads) {
+#ifndef MINIACID_WORK_STEALING_POOL
+  threadCount_ = 1;
+#endif
+  ranges_.reset(new Range[threadCount_]);
+#ifdef MINIACID_WORK_STEALING_POOL
+  threads_.reserve(threadCount_ - 1);
+  for (int w = 1; w < threadCount_; ++w) {
+    threads_.emplace_back(&WorkStealingPool::threadLoop, this, w);
+  }
+#endif
+}
+
+WorkStealingPool::~WorkStealingPool() {
+#ifdef MINIACID_WORK_STEALING_POOL
+  {
+    std::lock_guard<std::mutex> lock(parkMutex_);
+    stopRequested_ = true;
+  }
+  park_.notify_all();
+  for (auto& thread : threads_) thread.join();
+#endif
+}
+
+int WorkStealingPool::hardwareThreads() {
+#ifdef MINIACID_WORK_STEALING_POOL
+  int threads = static_cast<int>(std::thread::hardware_concurrency());
+  return threads < 1 ? 1 : threads;
+#else
+  return 1;
+#endif
+}
+
+bool WorkStealingPool::popOwn(int worker, int& task) {
+  std::atomic<uint64_t>& bounds = ranges_[worker].bounds;
+  uint64_t current = bounds.load(std::memory_order_acquire);
+  while (rangeBegin(current) < rangeEnd(current)) {
+    uint64_t next = packRange(rangeBegin(current) + 1, rangeEnd(current));
+    if (bounds.compare_exchange_weak(current, next, std::memory_order_acq_rel)) {
+      task = static_cast<int>(rangeBegin(current));
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WorkStealingPool::steal(int victim, int& task) {
+  std::atomic<uint64_t>& bounds = ranges_[victim].bounds;
+  uint64_t current = bounds.load(std::memory_order_acquire);
+  while (rangeBegin(current) < rangeEnd(current)) {
+    uint64_t next = packRange(rangeBegin(current), rangeEnd(current) - 1);
+    if (bounds.compare_exchange_weak(current, next, std::memory_order_acq_rel)) {
+      task = static_cast<int>(rangeEnd(current) - 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WorkStealingPool::runOne(int worker) {
+  int task = -1;
+  bool found = popOwn(worker, task);
+  for (int i = 1; !found && i < threadCount_; ++i) {
+    found = steal((worker + i) % threadCount_, task);
+  }
+  if (!found) return false;
+  // task_ and context_ were written before the ranges were published.
+  task_(context_, task, worker);
+  pending_.fetch_sub(1, std::memory_order_acq_rel);
+  return true;
+}
+
+void WorkStealingPool::run(int count, Task task, void* context) {
+  if (count <= 0 || !task) return;
+  if (threadCount_ == 1 || count == 1) {
+    for (int t = 0; t < count; ++t) task(context, t, 0);
+    return;
+  }
+
+  task_ = task;
+  context_ = context;
+  pending_.store(count, std::memory_order_relaxed);
+  for (int w = 0; w < threadCount_; ++w) {
+    uint32_t begin = static_cast<uint32_t>(static_cast<int64_t>(count) * w / threadCount_);
+    uint32_t end = static_cast<uint32_t>(static_cast<int64_t>(count) * (w + 1) / threadCount_);
+    ranges_[w].bounds.store(packRange(begin, end), std::memory_order_release);
+  }
+#ifdef MINIACID_WORK_STEALING_POOL
+  epoch_.fetch_add(1);
+  if (parked_.load() > 0) {
+    { std::lock_guard<std::mutex> lock(parkMutex_); }
+    park_.notify_all();
+  }
+#endif
+
+  while (runOne(0)) {}
+  while (pending_.load(std::memory_order_acquire) > 0) {
+#ifdef MINIACID_WORK_STEALING_POOL
+    std::this_thread::yield();
+#endif
+  }
+}
+
+#ifdef MINIACID_WORK_STEALING_POOL
+void WorkStealingPool::threadLoop(int worker) {
+  uint32_t seen = 0;
+  while (true) {
+    int spins = 0;
+    while (epoch_.load() == seen && !stopRequested_.load()) {
+      if (++spins < kSpinRounds) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(parkMutex_);
+      ++parked_;
+      park_.wait(lock, [this, seen]() { return epoch_.load() != seen || stopRequested_.load(); });
+      --parked_;
+    }
+    if (stopRequested_.load()) break;
+    seen = epoch_.load();
+    while (runOne(worker)) {}
+  }
+}
+#endif
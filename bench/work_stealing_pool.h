@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define MINIACID_WORK_STEALING_POOL 1
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// A small thread pool for splitting a block into independent tasks. run()
+// deals the tasks out as one contiguous range per thread; a thread that
+// finishes its range steals the last task of another's. Ranges are single
+// atomics, so handing out and stealing work never takes a lock. Idle
+// threads spin briefly between runs and only park on a condition variable
+// once no work has shown up for a while, so back-to-back blocks never
+// touch the mutex. Builds without thread support run everything inline.
+class WorkStealingPool {
+public:
+  // 'worker' is the index of the thread running the task, 0 being the
+  // caller of run(); use it to pick per-thread scratch memory.
+  using Task = void (*)(void* context, int task, int worker);
+
+  // 'threads' counts the calling thread, so 1 means no helper threads.
+  explicit WorkStealingPool(int threads);
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  int threadCount() const { return threadCount_; }
+  // Threads the machine can run at once (1 without thread support).
+  static int hardwareThreads();
+
+  // Runs tasks 0..count-1 and returns once all of them have finished. The
+  // calling thread works as thread 0. Not reentrant.
+  void run(int count, Task task, void* context);
+
+private:
+  // Remaining tasks of one thread: begin in the low half, end in the high.
+  struct alignas(64) Range {
+    std::atomic<uint64_t> bounds{0};
+  };
+
+  bool runOne(int worker);
+  bool popOwn(int worker, int& task);
+  bool steal(int victim, int& task);
+
+  int threadCount_;
+  std::unique_ptr<Range[]> ranges_;
+  Task task_ = nullptr;
+  void* context_ = nullptr;
+  std::atomic<int> pending_{0};
+
+#ifdef MINIACID_WORK_STEALING_POOL
+  void threadLoop(int worker);
+
+  std::vector<std::thread> threads_;
+  std::atomic<uint32_t> epoch_{0};
+  std::atomic<int> parked_{0};
+  std::atomic<bool> stopRequested_{false};
+  std::mutex parkMutex_;
+  std::condition_variable park_;
+#endif
+};
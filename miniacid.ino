@@ -4,6 +4,7 @@
 #include <SD.h>
 #include <SPI.h>
 #include "src/dsp/miniacid_engine.h"
+#include "src/dsp/sample_rate_probe.h"
 #include "cardputer_display.h"
 #include <cstdarg>
 #include <cstdio>
@@ -45,7 +46,7 @@ void audioTask(void *param) {
     }
 
     M5Cardputer.Speaker.playRaw(g_audioBuffer, AUDIO_BUFFER_SAMPLES,
-                                SAMPLE_RATE, false);
+                                static_cast<uint32_t>(g_miniAcid.sampleRate()), false);
   }
 }
 
@@ -68,6 +69,15 @@ void setup() {
   M5Cardputer.Speaker.setVolume(200); // 0-255
 
   g_miniAcid.init();
+  // Highest rate the 303s and drums can render in well under half a block,
+  // so the UI and heavy patterns keep their headroom.
+  {
+    SampleRateProbeResult probe = probeEngineSampleRate(AUDIO_BUFFER_SAMPLES, 40, 0.4f);
+    g_miniAcid.setSampleRate(static_cast<float>(probe.sampleRate));
+    Serial.printf("engine rate %d Hz\n", probe.sampleRate);
+  }
+  // Drums render on core 0 while the audio task renders the 303s on core 1.
+  g_miniAcid.setParallelRender(true);
   g_miniDisplay = new MiniAcidDisplay(g_display, g_miniAcid);
   
   // Set audio guard to protect audio task from concurrent access
@@ -79,7 +89,11 @@ void setup() {
   
   // Initialize audio recorder (done after other initialization to avoid boot issues)
   g_audioRecorder = new CardputerAudioRecorder();
+  // 4:1 ADPCM keeps the SD bus free for scene saves during long sessions.
+  g_audioRecorder->setFormat(RecordingFormat::ImaAdpcm);
   g_miniDisplay->setAudioRecorder(g_audioRecorder);
+  // No export recorder: the second engine a song export renders with does
+  // not fit in RAM next to the live one.
 
   xTaskCreatePinnedToCore(audioTask, "AudioTask",
                           4096, // stack
@@ -0,0 +1,46 @@
+// miniacid-decode <recording> <out.wav>: turns any recording the desktop
+// build writes (PCM or IMA-ADPCM WAV, lossless .mar) back into plain
+// 16-bit WAV.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "../src/audio/recording_codec.h"
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <recording> <out.wav>\n", argv[0]);
+    return 2;
+  }
+  FILE* in = fopen(argv[1], "rb");
+  std::vector<uint8_t> bytes;
+  if (in) {
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+      bytes.insert(bytes.end(), buffer, buffer + n);
+    }
+    fclose(in);
+  }
+  std::vector<int16_t> samples;
+  int rate = 0;
+  if (!decodeRecording(bytes.data(), bytes.size(), samples, rate)) {
+    fprintf(stderr, "Cannot decode %s\n", argv[1]);
+    return 1;
+  }
+  uint8_t header[64];
+  size_t headerSize = writeRecordingHeader(RecordingFormat::Pcm16, rate, 1,
+                                           static_cast<uint32_t>(samples.size()),
+                                           static_cast<uint32_t>(samples.size() * 2), header);
+  FILE* out = fopen(argv[2], "wb");
+  if (!out) {
+    fprintf(stderr, "Cannot write %s\n", argv[2]);
+    return 1;
+  }
+  fwrite(header, 1, headerSize, out);
+  fwrite(samples.data(), sizeof(int16_t), samples.size(), out);
+  fclose(out);
+  printf("%zu samples at %d Hz\n", samples.size(), rate);
+  return 0;
+}
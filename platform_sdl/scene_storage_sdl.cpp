@@ -1,12 +1,21 @@
 #include "scene_storage_sdl.h"
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iterator>
 #include <sstream>
+#include <cstdio>
 #include <cstring>
 #ifndef __EMSCRIPTEN__
 #include <filesystem>
 #endif
+#if !defined(__EMSCRIPTEN__) && !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "scenes.h"
 
@@ -106,7 +115,11 @@ std::string SceneStorageSdl::normalizeSceneName(const std::string& name) const {
 }
 
 std::string SceneStorageSdl::sceneFilePath() const {
-  std::string path = normalizeSceneName(currentSceneName_);
+  return sceneFilePathFor(currentSceneName_);
+}
+
+std::string SceneStorageSdl::sceneFilePathFor(const std::string& name) const {
+  std::string path = normalizeSceneName(name);
   path += kSceneExtension;
   return path;
 }
@@ -149,9 +162,75 @@ std::string SceneStorageSdl::sceneKeyForStorage(const std::string& name) const {
   return std::string(kKeyPrefix) + name;
 }
 
+std::string SceneStorageSdl::bankKeyForStorage(const std::string& name, int bankIndex) const {
+  return "miniacid:bank:" + normalizeSceneName(name) + ":" + std::to_string(bankIndex);
+}
+
+bool SceneStorageSdl::readBank(const std::string& sceneName, int bankIndex, SceneBank& out) {
+  if (bankIndex < 0 || bankIndex >= kBankCount) return false;
+  uint8_t segment[SceneBankSegment::kBytes];
+  std::lock_guard<std::mutex> lock(bankMutex_);
+#ifdef __EMSCRIPTEN__
+  // localStorage only holds strings, so each bank is its own hex encoded key.
+  std::string key = bankKeyForStorage(sceneName, bankIndex);
+  char hex[SceneBankSegment::kBytes * 2 + 1];
+  int length = wasm_read_scene(key.c_str(), hex, sizeof(hex));
+  if (length != static_cast<int>(SceneBankSegment::kBytes * 2)) return false;
+  for (size_t i = 0; i < SceneBankSegment::kBytes; ++i) {
+    unsigned value = 0;
+    if (std::sscanf(hex + i * 2, "%2x", &value) != 1) return false;
+    segment[i] = static_cast<uint8_t>(value);
+  }
+#else
+  std::ifstream file(normalizeSceneName(sceneName) + kBankExtension, std::ios::in | std::ios::binary);
+  if (!file.is_open()) return false;
+  file.seekg(static_cast<std::streamoff>(bankIndex * SceneBankSegment::kBytes));
+  file.read(reinterpret_cast<char*>(segment), sizeof(segment));
+  if (file.gcount() != static_cast<std::streamsize>(sizeof(segment))) return false;
+#endif
+  return SceneBankSegment::decode(segment, out);
+}
+
+bool SceneStorageSdl::writeBank(const std::string& sceneName, int bankIndex, const SceneBank& bank) {
+  if (bankIndex < 0 || bankIndex >= kBankCount) return false;
+  uint8_t segment[SceneBankSegment::kBytes];
+  SceneBankSegment::encode(bank, segment);
+  std::lock_guard<std::mutex> lock(bankMutex_);
+#ifdef __EMSCRIPTEN__
+  std::string hex;
+  hex.reserve(sizeof(segment) * 2);
+  static const char kDigits[] = "0123456789abcdef";
+  for (uint8_t value : segment) {
+    hex.push_back(kDigits[value >> 4]);
+    hex.push_back(kDigits[value & 0x0F]);
+  }
+  return wasm_write_scene(bankKeyForStorage(sceneName, bankIndex).c_str(), hex.c_str()) > 0;
+#else
+  // Segments sit at fixed offsets, so a bank is rewritten in place. Gaps
+  // left by banks never written read back as zeros and decode as empty.
+  std::string path = normalizeSceneName(sceneName) + kBankExtension;
+  std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+  if (!file.is_open()) {
+    std::ofstream create(path, std::ios::out | std::ios::binary);
+    if (!create.is_open()) return false;
+    create.close();
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open()) return false;
+  }
+  file.seekp(static_cast<std::streamoff>(bankIndex * SceneBankSegment::kBytes));
+  file.write(reinterpret_cast<const char*>(segment), sizeof(segment));
+  file.flush();
+  return file.good();
+#endif
+}
+
 bool SceneStorageSdl::readScene(std::string& out) {
+  return readSceneData(currentSceneName_, out);
+}
+
+bool SceneStorageSdl::readSceneData(const std::string& sceneName, std::string& out) const {
 #ifdef __EMSCRIPTEN__
-  std::string key = sceneKeyForStorage(currentSceneName_);
+  std::string key = sceneKeyForStorage(sceneName);
   int length = wasm_read_scene(key.c_str(), nullptr, 0);
   if (length <= 0) return false;
   std::string buffer;
@@ -162,7 +241,7 @@ bool SceneStorageSdl::readScene(std::string& out) {
   out = buffer;
   return true;
 #else
-  std::ifstream file(sceneFilePath(), std::ios::in);
+  std::ifstream file(sceneFilePathFor(sceneName), std::ios::in);
   if (!file.is_open()) return false;
 
   out.assign((std::istreambuf_iterator<char>(file)),
@@ -178,41 +257,62 @@ bool SceneStorageSdl::writeScene(const SceneManager& manager) {
   return writeScene(out);
 }
 
+bool SceneStorageSdl::writeScene(const SceneManager& manager, const std::string& sceneName) {
+  std::string out;
+  if (!manager.writeSceneJson(out)) return false;
+  return writeSceneData(normalizeSceneName(sceneName), out);
+}
+
 bool SceneStorageSdl::readScene(SceneManager& manager) {
+  return readScene(manager, currentSceneName_);
+}
+
+bool SceneStorageSdl::readScene(SceneManager& manager, const std::string& sceneName) {
   std::string serialized;
-  if (!readScene(serialized)) return false;
+  if (!readSceneData(normalizeSceneName(sceneName), serialized)) return false;
   return manager.loadScene(serialized);
 }
 
 bool SceneStorageSdl::writeScene(const std::string& data) {
   persistCurrentSceneName();
-#ifdef __EMSCRIPTEN__
-  std::string key = sceneKeyForStorage(currentSceneName_);
-  return wasm_write_scene(key.c_str(), data.c_str()) > 0;
-#else
-  std::ofstream file(sceneFilePath(), std::ios::out | std::ios::trunc);
-  if (!file.is_open()) return false;
-  file << data;
-  return file.good();
-#endif
+  return writeSceneData(currentSceneName_, data);
 }
 
-std::vector<std::string> SceneStorageSdl::findSceneNamesOnDisk() const {
+bool SceneStorageSdl::writeSceneData(const std::string& sceneName, const std::string& data) const {
 #ifdef __EMSCRIPTEN__
-  return {};
+  std::string key = sceneKeyForStorage(sceneName);
+  if (wasm_write_scene(key.c_str(), data.c_str()) <= 0) return false;
+  updateIndexEntry(sceneName, data, false);
+  return true;
 #else
-  std::vector<std::string> names;
-  namespace fs = std::filesystem;
-  std::error_code ec;
-  for (const auto& entry : fs::directory_iterator(fs::current_path(), ec)) {
-    if (ec) break;
-    if (!entry.is_regular_file()) continue;
-    const fs::path& path = entry.path();
-    if (path.extension() == kSceneExtension) {
-      names.push_back(path.stem().string());
+  bool indexWasStale = false;
+  {
+    std::lock_guard<std::mutex> lock(indexMutex_);
+    indexWasStale = indexIsStaleLocked();
+  }
+  // Write next to the target and rename over it so a crash mid-write never
+  // leaves a truncated scene behind.
+  std::string path = sceneFilePathFor(sceneName);
+  std::string tempPath = path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) return false;
+    file << data;
+    file.flush();
+    if (!file.good()) {
+      file.close();
+      std::remove(tempPath.c_str());
+      return false;
     }
   }
-  return names;
+  std::error_code ec;
+  std::filesystem::rename(tempPath, path, ec);
+  if (ec) {
+    std::remove(tempPath.c_str());
+    return false;
+  }
+  updateIndexEntry(sceneName, data, indexWasStale);
+  return true;
 #endif
 }
 
@@ -238,13 +338,238 @@ std::vector<std::string> SceneStorageSdl::findSceneNamesLocalStorage() const {
 }
 
 std::vector<std::string> SceneStorageSdl::getAvailableSceneNames() const {
+  std::vector<std::string> names;
+  {
+    std::lock_guard<std::mutex> lock(indexMutex_);
+    std::vector<SceneInfo> infos;
+    if (ensureIndexLocked()) readIndexRangeLocked(0, indexCount_, infos);
+    names.reserve(infos.size());
+    for (const auto& info : infos) names.push_back(info.name);
+  }
+  if (names.empty()) names.push_back(currentSceneName_);
+  return names;
+}
+
+size_t SceneStorageSdl::sceneCount() const {
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  if (!ensureIndexLocked()) return 0;
+  return indexCount_;
+}
+
+size_t SceneStorageSdl::readSceneInfos(size_t offset, size_t count, std::vector<SceneInfo>& out) const {
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  if (!ensureIndexLocked()) return 0;
+  return readIndexRangeLocked(offset, count, out);
+}
+
+int SceneStorageSdl::findScene(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  if (!ensureIndexLocked()) return -1;
+  std::vector<SceneInfo> probe;
+  return SceneIndex::find(indexCount_, normalizeSceneName(name),
+                          [this, &probe](size_t position, std::string& probeName) {
+    probe.clear();
+    if (readIndexRangeLocked(position, 1, probe) != 1) return false;
+    probeName = probe[0].name;
+    return true;
+  });
+}
+
+bool SceneStorageSdl::rebuildSceneIndex() {
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  return rebuildIndexLocked();
+}
+
+bool SceneStorageSdl::ensureIndexLocked() const {
 #ifdef __EMSCRIPTEN__
-  std::vector<std::string> names = findSceneNamesLocalStorage();
+  if (indexValid_) return true;
+  return rebuildIndexLocked();
 #else
-  std::vector<std::string> names = findSceneNamesOnDisk();
+  if (indexValid_ && !indexIsStaleLocked()) return true;
+  if (!indexValid_ && !indexIsStaleLocked()) {
+    std::ifstream file(kSceneIndexFile, std::ios::in | std::ios::binary);
+    char header[SceneIndex::kRecordSize];
+    uint32_t count = 0;
+    if (file.read(header, sizeof(header)) && SceneIndex::parseHeader(header, count)) {
+      std::error_code ec;
+      uintmax_t size = std::filesystem::file_size(kSceneIndexFile, ec);
+      if (!ec && size == SceneIndex::fileSizeFor(count)) {
+        indexCount_ = count;
+        indexValid_ = true;
+        return true;
+      }
+    }
+  }
+  return rebuildIndexLocked();
 #endif
-  if (names.empty()) names.push_back(currentSceneName_);
-  return names;
+}
+
+bool SceneStorageSdl::indexIsStaleLocked() const {
+#ifdef __EMSCRIPTEN__
+  return !indexValid_;
+#else
+  // Anything created, removed or renamed next to the scenes bumps the
+  // directory time past the index; the index itself is rewritten in place
+  // so updating it does not.
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::file_time_type indexTime = fs::last_write_time(kSceneIndexFile, ec);
+  if (ec) return true;
+  fs::file_time_type dirTime = fs::last_write_time(fs::current_path(), ec);
+  if (ec) return false;
+  return dirTime > indexTime;
+#endif
+}
+
+bool SceneStorageSdl::readIndexLocked(std::vector<SceneInfo>& out) const {
+#ifdef __EMSCRIPTEN__
+  out = memoryIndex_;
+  return indexValid_;
+#else
+  std::ifstream file(kSceneIndexFile, std::ios::in | std::ios::binary);
+  char header[SceneIndex::kRecordSize];
+  uint32_t count = 0;
+  if (!file.read(header, sizeof(header)) || !SceneIndex::parseHeader(header, count)) return false;
+  char record[SceneIndex::kRecordSize];
+  SceneInfo info;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!file.read(record, sizeof(record))) return false;
+    if (SceneIndex::parseRecord(record, info)) out.push_back(info);
+  }
+  return true;
+#endif
+}
+
+size_t SceneStorageSdl::readIndexRangeLocked(size_t offset, size_t count,
+                                             std::vector<SceneInfo>& out) const {
+  if (offset >= indexCount_) return 0;
+  if (count > indexCount_ - offset) count = indexCount_ - offset;
+#ifdef __EMSCRIPTEN__
+  out.insert(out.end(), memoryIndex_.begin() + offset, memoryIndex_.begin() + offset + count);
+  return count;
+#else
+  std::ifstream file(kSceneIndexFile, std::ios::in | std::ios::binary);
+  if (!file.is_open()) return 0;
+  file.seekg(static_cast<std::streamoff>(SceneIndex::recordOffset(offset)));
+  char record[SceneIndex::kRecordSize];
+  size_t added = 0;
+  SceneInfo info;
+  for (size_t i = 0; i < count; ++i) {
+    if (!file.read(record, sizeof(record))) break;
+    if (!SceneIndex::parseRecord(record, info)) break;
+    out.push_back(info);
+    ++added;
+  }
+  return added;
+#endif
+}
+
+bool SceneStorageSdl::writeIndexLocked(const std::vector<SceneInfo>& infos) const {
+#ifdef __EMSCRIPTEN__
+  memoryIndex_ = infos;
+  indexCount_ = memoryIndex_.size();
+  indexValid_ = true;
+  return true;
+#else
+  std::vector<char> buffer(SceneIndex::fileSizeFor(infos.size()));
+  size_t count = 0;
+  for (const auto& info : infos) {
+    if (SceneIndex::formatRecord(info, buffer.data() + SceneIndex::recordOffset(count))) ++count;
+  }
+  SceneIndex::formatHeader(static_cast<uint32_t>(count), buffer.data());
+  std::ofstream file(kSceneIndexFile, std::ios::out | std::ios::binary | std::ios::trunc);
+  indexValid_ = false;
+  if (!file.is_open()) return false;
+  file.write(buffer.data(), static_cast<std::streamsize>(SceneIndex::fileSizeFor(count)));
+  file.close();
+  if (!file) return false;
+  indexCount_ = count;
+  indexValid_ = true;
+  return true;
+#endif
+}
+
+bool SceneStorageSdl::rebuildIndexLocked() const {
+  std::vector<SceneInfo> previous;
+  readIndexLocked(previous);
+  std::vector<SceneInfo> infos;
+#ifdef __EMSCRIPTEN__
+  for (const auto& name : findSceneNamesLocalStorage()) {
+    SceneInfo info;
+    info.name = name;
+    std::string data;
+    if (readSceneData(name, data)) {
+      SceneInfoScanner scanner;
+      scanner.scan(data);
+      info.sizeBytes = static_cast<uint32_t>(data.size());
+      info.bpm = scanner.bpm();
+      info.drumEngine = scanner.drumEngine();
+    }
+    infos.push_back(info);
+  }
+#else
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  for (const auto& entry : fs::directory_iterator(fs::current_path(), ec)) {
+    if (ec) break;
+    if (!entry.is_regular_file()) continue;
+    const fs::path& path = entry.path();
+    if (path.extension() != kSceneExtension) continue;
+    SceneInfo info;
+    info.name = path.stem().string();
+    std::error_code statEc;
+    info.sizeBytes = static_cast<uint32_t>(entry.file_size(statEc));
+    auto stamp = entry.last_write_time(statEc).time_since_epoch();
+    info.modified = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(stamp).count());
+    // Unchanged files keep their previous summary; only new or modified
+    // scenes are scanned.
+    auto it = std::lower_bound(previous.begin(), previous.end(), info.name,
+                               [](const SceneInfo& a, const std::string& name) { return a.name < name; });
+    if (it != previous.end() && it->name == info.name && it->sizeBytes == info.sizeBytes &&
+        it->modified == info.modified) {
+      infos.push_back(*it);
+      continue;
+    }
+    std::string data;
+    if (readSceneData(info.name, data)) {
+      SceneInfoScanner scanner;
+      scanner.scan(data);
+      info.bpm = scanner.bpm();
+      info.drumEngine = scanner.drumEngine();
+    }
+    infos.push_back(info);
+  }
+#endif
+  SceneIndex::sortByName(infos);
+  return writeIndexLocked(infos);
+}
+
+void SceneStorageSdl::updateIndexEntry(const std::string& sceneName, const std::string& data,
+                                       bool rebuild) const {
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  std::vector<SceneInfo> infos;
+  if (rebuild || !readIndexLocked(infos)) {
+    rebuildIndexLocked();
+    return;
+  }
+  SceneInfo info;
+  info.name = normalizeSceneName(sceneName);
+  info.sizeBytes = static_cast<uint32_t>(data.size());
+#ifndef __EMSCRIPTEN__
+  std::error_code ec;
+  auto stamp = std::filesystem::last_write_time(sceneFilePathFor(sceneName), ec).time_since_epoch();
+  if (!ec) {
+    info.modified = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(stamp).count());
+  }
+#endif
+  SceneInfoScanner scanner;
+  scanner.scan(data);
+  info.bpm = scanner.bpm();
+  info.drumEngine = scanner.drumEngine();
+  SceneIndex::upsert(infos, info);
+  writeIndexLocked(infos);
 }
 
 std::string SceneStorageSdl::getCurrentSceneName() const {
@@ -255,3 +580,87 @@ bool SceneStorageSdl::setCurrentSceneName(const std::string& name) {
   currentSceneName_ = normalizeSceneName(name);
   return persistCurrentSceneName();
 }
+
+#if !defined(__EMSCRIPTEN__) && !defined(_WIN32)
+namespace {
+// One read-only mapping per lane file; the pages are only read in as the
+// samples play.
+class MappedDrumSampleKit : public DrumSampleKit {
+public:
+  ~MappedDrumSampleKit() override {
+    for (int l = 0; l < kDrumLanes; ++l) {
+      if (maps[l]) munmap(maps[l], sizes[l]);
+    }
+  }
+
+  void* maps[kDrumLanes] = {};
+  size_t sizes[kDrumLanes] = {};
+};
+
+bool mapFile(const std::string& path, void*& map, size_t& size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat info;
+  bool ok = fstat(fd, &info) == 0 && info.st_size > 0;
+  if (ok) {
+    size = static_cast<size_t>(info.st_size);
+    map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ok = map != MAP_FAILED;
+    if (!ok) map = nullptr;
+  }
+  close(fd);
+  return ok;
+}
+} // namespace
+#endif
+
+std::vector<std::string> SceneStorageSdl::drumSampleKitNames() const {
+  std::vector<std::string> names;
+#ifndef __EMSCRIPTEN__
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  for (const auto& entry : fs::directory_iterator(kDrumSampleDirectory, ec)) {
+    if (ec) break;
+    if (!entry.is_directory()) continue;
+    std::string name = entry.path().filename().string();
+    if (isDrumSampleKitName(name)) names.push_back(name);
+  }
+  std::sort(names.begin(), names.end());
+#endif
+  return names;
+}
+
+std::shared_ptr<const DrumSampleKit> SceneStorageSdl::loadDrumSampleKit(const std::string& kitName) {
+#ifdef __EMSCRIPTEN__
+  (void)kitName;
+  return nullptr;
+#else
+  if (!isDrumSampleKitName(kitName)) return nullptr;
+  std::string folder = std::string(kDrumSampleDirectory) + "/" + kitName + "/";
+#ifdef _WIN32
+  size_t sizes[kDrumLanes] = {};
+  for (int l = 0; l < kDrumLanes; ++l) {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(folder + drumSampleFileName(l), ec);
+    if (!ec) sizes[l] = static_cast<size_t>(size);
+  }
+  return loadDrumSampleKitArena(kitName, sizes, [&](int lane, uint8_t* dst, size_t size) {
+    std::ifstream file(folder + drumSampleFileName(lane), std::ios::binary);
+    return file.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(size)) &&
+           static_cast<size_t>(file.gcount()) == size;
+  });
+#else
+  auto kit = std::make_shared<MappedDrumSampleKit>();
+  kit->name = kitName;
+  bool any = false;
+  for (int l = 0; l < kDrumLanes; ++l) {
+    if (!mapFile(folder + drumSampleFileName(l), kit->maps[l], kit->sizes[l])) continue;
+    if (parseWavSample(static_cast<const uint8_t*>(kit->maps[l]), kit->sizes[l], kit->lanes[l])) {
+      any = true;
+    }
+  }
+  if (!any) return nullptr;
+  return kit;
+#endif
+#endif
+}
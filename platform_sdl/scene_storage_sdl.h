@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "../scene_storage.h"
@@ -10,24 +12,58 @@ public:
   bool readScene(std::string& out) override;
   bool writeScene(const std::string& data) override;
   bool writeScene(const SceneManager& manager) override;
+  bool writeScene(const SceneManager& manager, const std::string& sceneName) override;
   bool readScene(SceneManager& manager) override;
+  bool readScene(SceneManager& manager, const std::string& sceneName) override;
   void initializeStorage() override;
   std::vector<std::string> getAvailableSceneNames() const override;
+  size_t sceneCount() const override;
+  size_t readSceneInfos(size_t offset, size_t count, std::vector<SceneInfo>& out) const override;
+  int findScene(const std::string& name) const override;
+  bool rebuildSceneIndex() override;
   std::string getCurrentSceneName() const override;
   bool setCurrentSceneName(const std::string& name) override;
+  bool readBank(const std::string& sceneName, int bankIndex, SceneBank& out) override;
+  bool writeBank(const std::string& sceneName, int bankIndex, const SceneBank& bank) override;
+  std::vector<std::string> drumSampleKitNames() const override;
+  std::shared_ptr<const DrumSampleKit> loadDrumSampleKit(const std::string& kitName) override;
 
 private:
   static constexpr const char* kDefaultSceneName = "miniacid_scene";
   static constexpr const char* kSceneNameFile = "miniacid_scene_name.txt";
   static constexpr const char* kSceneExtension = ".json";
+  static constexpr const char* kSceneIndexFile = "miniacid_scene_index.txt";
+  static constexpr const char* kBankExtension = ".banks";
 
   std::string normalizeSceneName(const std::string& name) const;
   std::string sceneFilePath() const;
+  std::string sceneFilePathFor(const std::string& name) const;
+  bool writeSceneData(const std::string& sceneName, const std::string& data) const;
+  bool readSceneData(const std::string& sceneName, std::string& out) const;
   void loadStoredSceneName();
   bool persistCurrentSceneName() const;
-  std::vector<std::string> findSceneNamesOnDisk() const;
   std::vector<std::string> findSceneNamesLocalStorage() const;
   std::string sceneKeyForStorage(const std::string& name) const;
+  std::string bankKeyForStorage(const std::string& name, int bankIndex) const;
+
+  bool ensureIndexLocked() const;
+  bool indexIsStaleLocked() const;
+  bool rebuildIndexLocked() const;
+  bool readIndexLocked(std::vector<SceneInfo>& out) const;
+  size_t readIndexRangeLocked(size_t offset, size_t count, std::vector<SceneInfo>& out) const;
+  bool writeIndexLocked(const std::vector<SceneInfo>& infos) const;
+  void updateIndexEntry(const std::string& sceneName, const std::string& data, bool rebuild) const;
 
   std::string currentSceneName_;
+
+  // Guards the index; scenes are written from the background scene writer.
+  mutable std::mutex indexMutex_;
+  mutable bool indexValid_ = false;
+  mutable size_t indexCount_ = 0;
+  // Serializes bank segment reads and in-place rewrites.
+  mutable std::mutex bankMutex_;
+#ifdef __EMSCRIPTEN__
+  // localStorage is already an in-memory key list, so the index lives here.
+  mutable std::vector<SceneInfo> memoryIndex_;
+#endif
 };
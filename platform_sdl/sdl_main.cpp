@@ -1,7 +1,10 @@
 #include <cmath>
 #include <functional>
+#include <mutex>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string>
+#include <vector>
 
 #include <SDL.h>
 #ifdef __EMSCRIPTEN__
@@ -12,7 +15,10 @@
 #include "../cardputer_display.h"
 #include "../src/ui/miniacid_display.h"
 #include "../src/dsp/miniacid_engine.h"
+#include "../src/dsp/resampler.h"
+#include "../src/dsp/sample_rate_probe.h"
 #include "scene_storage_sdl.h"
+#include "../src/audio/pcm_stream_output.h"
 #ifndef __EMSCRIPTEN__
 #include "../src/audio/desktop_audio_recorder.h"
 #else
@@ -24,13 +30,85 @@ struct AudioContext {
   SceneStorageSdl storage;
   MiniAcid synth;
   SDL_AudioDeviceID device;
+  // Converts the engine rate to the device rate when they differ.
+  PolyphaseResampler resampler;
+  std::vector<float> engineBlock;
 #ifndef __EMSCRIPTEN__
   DesktopAudioRecorder recorder;
+  // With --stems, runs alongside 'recorder' (see StemSessionRecorder).
+  DesktopAudioRecorder stemRecorder;
+  // Interleaved stem frames of one engine block; empty without --stems.
+  std::vector<float> stemBlock;
+  // Song exports from the project page (see SongBouncer).
+  DesktopAudioRecorder exportRecorder;
 #else
   WasmAudioRecorder recorder;
+  WasmAudioRecorder exportRecorder;
+#endif
+#ifdef MINIACID_PCM_STREAM
+  // With --stream, replaces the SDL device (which stays 0); 'streamLock'
+  // then takes the place of the device lock.
+  PcmStreamOutput stream;
+  std::mutex streamLock;
 #endif
 };
 
+// Keeps the engine still for the UI, whichever output drives it.
+static void lockAudio(AudioContext& audio) {
+#ifdef MINIACID_PCM_STREAM
+  if (audio.device == 0) {
+    audio.streamLock.lock();
+    return;
+  }
+#endif
+  SDL_LockAudioDevice(audio.device);
+}
+
+static void unlockAudio(AudioContext& audio) {
+#ifdef MINIACID_PCM_STREAM
+  if (audio.device == 0) {
+    audio.streamLock.unlock();
+    return;
+  }
+#endif
+  SDL_UnlockAudioDevice(audio.device);
+}
+
+#ifndef __EMSCRIPTEN__
+// The recorder the UI drives when stems are on. The stem file starts just
+// before the mix and stops just after it; the callback only feeds stems
+// while the mix records, so every file holds the same blocks.
+class StemSessionRecorder : public IAudioRecorder {
+ public:
+  explicit StemSessionRecorder(AudioContext& audio) : audio_(audio) {}
+
+  bool start(int sampleRate, int channels) override {
+    if (!audio_.stemRecorder.start(sampleRate, stemCount(audio_.synth.stemLayout()))) {
+      return false;
+    }
+    if (!audio_.recorder.start(sampleRate, channels)) {
+      audio_.stemRecorder.stop();
+      return false;
+    }
+    return true;
+  }
+  void stop() override {
+    audio_.recorder.stop();
+    audio_.stemRecorder.stop();
+  }
+  bool isRecording() const override { return audio_.recorder.isRecording(); }
+  void writeSamples(const int16_t* samples, size_t sampleCount) override {
+    audio_.recorder.writeSamples(samples, sampleCount);
+  }
+  const std::string& filename() const override { return audio_.recorder.filename(); }
+  bool setFormat(RecordingFormat format) override { return audio_.recorder.setFormat(format); }
+  RecordingFormat format() const override { return audio_.recorder.format(); }
+
+ private:
+  AudioContext& audio_;
+};
+#endif
+
 struct AppState {
   AppState() : audio(SAMPLE_RATE) {}
   AudioContext audio;
@@ -43,14 +121,155 @@ struct AppState {
   unsigned long lastUIUpdate = 0;
 };
 
+static void recordSamples(AudioContext *ctx, const float *samples, size_t frames) {
+  if (!ctx->recorder.isRecording()) return;
+  int16_t pcm[AUDIO_BUFFER_SAMPLES];
+  for (size_t done = 0; done < frames;) {
+    size_t count = frames - done;
+    if (count > AUDIO_BUFFER_SAMPLES) count = AUDIO_BUFFER_SAMPLES;
+    convertFloatToInt16(samples + done, pcm, count, 1.0f);
+    ctx->recorder.writeSamples(pcm, count);
+    done += count;
+  }
+}
+
+#ifndef __EMSCRIPTEN__
+static void recordStems(AudioContext *ctx, const float *stems, size_t frames) {
+  const size_t channels = static_cast<size_t>(stemCount(ctx->synth.stemLayout()));
+  int16_t pcm[AUDIO_BUFFER_SAMPLES * kMaxStems];
+  for (size_t done = 0; done < frames;) {
+    size_t count = frames - done;
+    if (count > AUDIO_BUFFER_SAMPLES) count = AUDIO_BUFFER_SAMPLES;
+    convertFloatToInt16(stems + done * channels, pcm, count * channels, 1.0f);
+    ctx->stemRecorder.writeSamples(pcm, count * channels);
+    done += count;
+  }
+}
+
+// --stems=grouped|lanes records the pre-master buses next to the mix: one
+// interleaved WAV, or with --stem-files one mono file per stem in the
+// --record format.
+static bool stemLayoutArg(int argc, char **argv, StemLayout& layout, bool& split) {
+  bool stems = false;
+  split = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--stems=grouped" || arg == "--stems") {
+      layout = StemLayout::Grouped;
+      stems = true;
+    } else if (arg == "--stems=lanes") {
+      layout = StemLayout::PerLane;
+      stems = true;
+    } else if (arg == "--stem-files") {
+      split = true;
+    }
+  }
+  return stems;
+}
+#endif
+
+// Renders one engine block and hands it to the recorders.
+static void renderBlock(AudioContext *ctx, float *out, size_t frames) {
+#ifndef __EMSCRIPTEN__
+  if (!ctx->stemBlock.empty() && ctx->stemRecorder.isRecording() &&
+      ctx->recorder.isRecording()) {
+    float *stems = ctx->stemBlock.data();
+    ctx->synth.renderFloat(out, frames, stems);
+    recordSamples(ctx, out, frames);
+    recordStems(ctx, stems, frames);
+    return;
+  }
+#endif
+  ctx->synth.renderFloat(out, frames);
+  recordSamples(ctx, out, frames);
+}
+
+// --record=pcm|adpcm|lossless picks the recording format; plain WAV by default.
+static RecordingFormat recordingFormatArg(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--record=adpcm") return RecordingFormat::ImaAdpcm;
+    if (arg == "--record=lossless") return RecordingFormat::RiceLossless;
+  }
+  return RecordingFormat::Pcm16;
+}
+
+static ResamplerQuality resamplerQualityArg(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--resample=low") return ResamplerQuality::Low;
+    if (arg == "--resample=medium") return ResamplerQuality::Medium;
+  }
+  return ResamplerQuality::High;
+}
+
+// --rate=<Hz> forces one of kEngineSampleRates; 0 lets the startup probe pick.
+static int sampleRateArg(int argc, char **argv) {
+  const std::string prefix = "--rate=";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, prefix.size(), prefix) != 0) continue;
+    int rate = atoi(arg.c_str() + prefix.size());
+    for (int r = 0; r < kEngineSampleRateCount; ++r) {
+      if (kEngineSampleRates[r] == rate) return rate;
+    }
+    fprintf(stderr, "Unsupported rate %d, probing instead\n", rate);
+  }
+  return 0;
+}
+
+#ifdef MINIACID_PCM_STREAM
+// --stream=<target> sends the engine output as raw PCM instead of playing
+// it (see PcmStreamOutput for the targets); empty without it.
+static std::string streamTargetArg(int argc, char **argv) {
+  const std::string prefix = "--stream=";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, prefix.size(), prefix) == 0) return arg.substr(prefix.size());
+  }
+  return std::string();
+}
+
+// --stream-format=s16|f32, --stream-pace=clock|free and
+// --stream-ahead=<frames>; 16-bit, wall clock, the default ahead otherwise.
+static void streamOptionsArg(int argc, char **argv, PcmStreamFormat& format,
+                             PcmStreamPacing& pacing, size_t& aheadFrames) {
+  const std::string aheadPrefix = "--stream-ahead=";
+  format = PcmStreamFormat::S16;
+  pacing = PcmStreamPacing::WallClock;
+  aheadFrames = PcmStreamOutput::kDefaultAheadFrames;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--stream-format=f32") format = PcmStreamFormat::F32;
+    if (arg == "--stream-pace=free") pacing = PcmStreamPacing::FreeRun;
+    if (arg.compare(0, aheadPrefix.size(), aheadPrefix) == 0) {
+      long frames = atol(arg.c_str() + aheadPrefix.size());
+      if (frames >= 0) aheadFrames = static_cast<size_t>(frames);
+    }
+  }
+}
+#endif
+
 static void audioCallback(void *userdata, Uint8 *stream, int len) {
   AudioContext *ctx = static_cast<AudioContext *>(userdata);
-  int16_t *out = reinterpret_cast<int16_t *>(stream);
-  size_t frames = static_cast<size_t>(len) / sizeof(int16_t);
+  float *out = reinterpret_cast<float *>(stream);
+  size_t frames = static_cast<size_t>(len) / sizeof(float);
 
-  // Fill the output buffer using the synth
-  ctx->synth.generateAudioBuffer(out, frames);
-  ctx->recorder.writeSamples(out, frames);
+  // The device takes the engine's float output as is; only the recorder
+  // needs int16. Recordings stay at the engine rate.
+  for (size_t done = 0; done < frames;) {
+    size_t count = frames - done;
+    if (count > AUDIO_BUFFER_SAMPLES) count = AUDIO_BUFFER_SAMPLES;
+    if (ctx->resampler.passthrough()) {
+      renderBlock(ctx, out + done, count);
+    } else {
+      size_t need = ctx->resampler.inputNeeded(count);
+      float* engine = ctx->engineBlock.data();
+      renderBlock(ctx, engine, need);
+      ctx->resampler.process(engine, out + done, count);
+    }
+    done += count;
+  }
 }
 
 static void handleEvents(AppState& s) {
@@ -172,13 +391,13 @@ static void handleEvents(AppState& s) {
         if (s.ui) s.ui->dismissSplash();
         if (s.ui) s.ui->update();
       } else if (sc == SDL_SCANCODE_SPACE) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         if (s.audio.synth.isPlaying()) {
           s.audio.synth.stop();
         } else {
           s.audio.synth.start();
         }
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_LEFTBRACKET) {
         if (s.ui) s.ui->previousPage();
         if (s.ui) s.ui->update();
@@ -186,75 +405,75 @@ static void handleEvents(AppState& s) {
         if (s.ui) s.ui->nextPage();
         if (s.ui) s.ui->update();
       } else if (sc == SDL_SCANCODE_I) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.randomize303Pattern(0);
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_O) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.randomize303Pattern(1);
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_P) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.randomizeDrumPattern();
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_1) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMute303(0);
         bool muted = s.audio.synth.is303Muted(0);
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_2) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMute303(1);
         bool muted = s.audio.synth.is303Muted(1);
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_3) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMuteKick();
         bool muted = s.audio.synth.isKickMuted();
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_4) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMuteSnare();
         bool muted = s.audio.synth.isSnareMuted();
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_5) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMuteHat();
         bool muted = s.audio.synth.isHatMuted();
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_6) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMuteOpenHat();
         bool muted = s.audio.synth.isOpenHatMuted();
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_7) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMuteMidTom();
         bool muted = s.audio.synth.isMidTomMuted();
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_8) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMuteHighTom();
         bool muted = s.audio.synth.isHighTomMuted();
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_9) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMuteRim();
         bool muted = s.audio.synth.isRimMuted();
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_0) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.toggleMuteClap();
         bool muted = s.audio.synth.isClapMuted();
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_K) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.setBpm(s.audio.synth.bpm() - 5.0f);
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       } else if (sc == SDL_SCANCODE_L) {
-        SDL_LockAudioDevice(s.audio.device);
+        lockAudio(s.audio);
         s.audio.synth.setBpm(s.audio.synth.bpm() + 5.0f);
-        SDL_UnlockAudioDevice(s.audio.device);
+        unlockAudio(s.audio);
       }
     }
   }
@@ -271,12 +490,34 @@ static void updateUI(AppState& s) {
 static void cleanup(AppState& s) {
   if (s.cleaned_up) return;
   if (s.audio.recorder.isRecording()) {
-    SDL_LockAudioDevice(s.audio.device);
+    lockAudio(s.audio);
     s.audio.recorder.stop();
-    SDL_UnlockAudioDevice(s.audio.device);
+    unlockAudio(s.audio);
     printf("WAV Recording stopped: %s\n", s.audio.recorder.filename().c_str());
+#ifndef __EMSCRIPTEN__
+    if (s.audio.recorder.droppedSamples() > 0) {
+      printf("Recording dropped %u samples\n", s.audio.recorder.droppedSamples());
+    }
+#endif
+  }
+#ifndef __EMSCRIPTEN__
+  if (s.audio.stemRecorder.isRecording()) {
+    lockAudio(s.audio);
+    s.audio.stemRecorder.stop();
+    unlockAudio(s.audio);
+    printf("Stem recording stopped: %s\n", s.audio.stemRecorder.filename().c_str());
   }
-  SDL_CloseAudioDevice(s.audio.device);
+#endif
+#ifdef MINIACID_PCM_STREAM
+  if (s.audio.stream.isRunning()) {
+    s.audio.stream.stop();
+    fprintf(stderr, "Stream stopped: %llu frames rendered, %llu dropped, %llu bytes written\n",
+            static_cast<unsigned long long>(s.audio.stream.renderedFrames()),
+            static_cast<unsigned long long>(s.audio.stream.droppedFrames()),
+            static_cast<unsigned long long>(s.audio.stream.writtenBytes()));
+  }
+#endif
+  if (s.audio.device != 0) SDL_CloseAudioDevice(s.audio.device);
   delete s.ui;
   s.ui = nullptr;
   delete s.sdl;
@@ -292,6 +533,14 @@ static void mainLoopTick(void* userdata) {
   AppState* s = static_cast<AppState*>(userdata);
   handleEvents(*s);
   updateUI(*s);
+#ifdef MINIACID_PCM_STREAM
+  // Stdout or a file that stops taking data ends the session, like a
+  // pipeline would.
+  if (s->audio.stream.isRunning() && !s->audio.stream.healthy()) {
+    fprintf(stderr, "Stream output closed\n");
+    s->running = false;
+  }
+#endif
   if (!s->running) {
 #ifdef __EMSCRIPTEN__
     emscripten_cancel_main_loop();
@@ -311,6 +560,20 @@ int main(int argc, char **argv) {
 
   AppState state;
 
+#ifdef MINIACID_PCM_STREAM
+  // Opened first: streaming to stdout moves everything printed from here
+  // on to stderr.
+  const std::string streamTarget = streamTargetArg(argc, argv);
+  if (!streamTarget.empty() && !state.audio.stream.open(streamTarget)) {
+    fprintf(stderr, "Cannot stream to %s\n", streamTarget.c_str());
+    SDL_Quit();
+    return 1;
+  }
+  const bool streaming = !streamTarget.empty();
+#else
+  const bool streaming = false;
+#endif
+
   int winw = 240;
   int winh = 135;
 
@@ -330,32 +593,111 @@ int main(int argc, char **argv) {
 
   state.gfx->begin();
   state.audio.synth.init();
+  state.audio.synth.setParallelRender(true);
+  int engineRate = sampleRateArg(argc, argv);
+  if (engineRate == 0) {
+    engineRate = probeEngineSampleRate(AUDIO_BUFFER_SAMPLES, 100, 0.25f).sampleRate;
+  }
+  state.audio.synth.setSampleRate(static_cast<float>(engineRate));
 
   SDL_AudioSpec desired{};
-  desired.freq = SAMPLE_RATE;
-  desired.format = AUDIO_S16SYS;
+  desired.freq = engineRate;
+  desired.format = AUDIO_F32SYS;
   desired.channels = 1;
   desired.samples = AUDIO_BUFFER_SAMPLES;
   desired.callback = audioCallback;
   desired.userdata = &state.audio;
 
-  SDL_AudioSpec obtained{};
-  state.audio.device = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, 0);
-  if (state.audio.device == 0) {
+  // Take the device's native rate instead of SDL's own conversion; the
+  // engine keeps rendering at engineRate and the callback resamples. A
+  // stream goes out at the engine rate and needs no device.
+  SDL_AudioSpec obtained = desired;
+  if (!streaming) {
+    state.audio.device = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained,
+                                             SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+  }
+  if (!streaming && state.audio.device == 0) {
     fprintf(stderr, "Failed to open audio: %s\n", SDL_GetError());
     SDL_Quit();
     return 1;
   }
+  state.audio.resampler.configure(static_cast<uint32_t>(engineRate),
+                                  static_cast<uint32_t>(obtained.freq),
+                                  resamplerQualityArg(argc, argv));
+  state.audio.engineBlock.assign(state.audio.resampler.maxInputNeeded(AUDIO_BUFFER_SAMPLES), 0.0f);
+  if (!state.audio.resampler.passthrough()) {
+    printf("Resampling %d Hz to %d Hz\n", engineRate, obtained.freq);
+  } else {
+    printf("Engine rate %d Hz\n", engineRate);
+  }
+  const RecordingFormat recordingFormat = recordingFormatArg(argc, argv);
+#ifndef __EMSCRIPTEN__
+  StemSessionRecorder stemSession(state.audio);
+  StemLayout stemLayout = StemLayout::Grouped;
+  bool stemFiles = false;
+  bool stems = stemLayoutArg(argc, argv, stemLayout, stemFiles);
+  if (stems) {
+    state.audio.synth.setStemLayout(stemLayout);
+    const int count = stemCount(stemLayout);
+    // Blocks are at most AUDIO_BUFFER_SAMPLES, or what the resampler asks for.
+    size_t frames = state.audio.engineBlock.size();
+    if (frames < AUDIO_BUFFER_SAMPLES) frames = AUDIO_BUFFER_SAMPLES;
+    state.audio.stemBlock.assign(frames * count, 0.0f);
+    std::vector<std::string> names;
+    if (stemFiles) {
+      for (int i = 0; i < count; ++i) names.push_back(stemName(stemLayout, i));
+      state.audio.stemRecorder.setFormat(recordingFormat);
+    } else {
+      names.push_back("stems");
+    }
+    state.audio.stemRecorder.setTrackNames(names);
+    printf("Recording %d stems%s\n", count, stemFiles ? " to separate files" : "");
+  }
+#endif
 
-  SDL_PauseAudioDevice(state.audio.device, 0); // start playback
+#ifdef MINIACID_PCM_STREAM
+  if (streaming) {
+    PcmStreamFormat streamFormat;
+    PcmStreamPacing streamPacing;
+    size_t streamAhead;
+    streamOptionsArg(argc, argv, streamFormat, streamPacing, streamAhead);
+    state.audio.stream.setAheadFrames(streamAhead);
+    AudioContext* ctx = &state.audio;
+    bool started = state.audio.stream.start(engineRate, streamFormat, streamPacing,
+                                            [ctx](float* out, size_t frames) {
+                                              std::lock_guard<std::mutex> lock(ctx->streamLock);
+                                              renderBlock(ctx, out, frames);
+                                            });
+    if (!started) {
+      fprintf(stderr, "Cannot start the stream\n");
+      cleanup(state);
+      return 1;
+    }
+    fprintf(stderr, "Streaming %s mono at %d Hz to %s\n",
+            streamFormat == PcmStreamFormat::S16 ? "s16le" : "f32le", engineRate,
+            streamTarget.c_str());
+  }
+#endif
+  if (!streaming) SDL_PauseAudioDevice(state.audio.device, 0); // start playback
 
   state.ui = new MiniAcidDisplay(*state.gfx, state.audio.synth);
   state.ui->setAudioGuard([&](const std::function<void()>& fn) {
-    SDL_LockAudioDevice(state.audio.device);
+    lockAudio(state.audio);
     fn();
-    SDL_UnlockAudioDevice(state.audio.device);
+    unlockAudio(state.audio);
   });
+  state.audio.recorder.setFormat(recordingFormat);
+#ifndef __EMSCRIPTEN__
+  if (stems) {
+    state.ui->setAudioRecorder(&stemSession);
+  } else {
+    state.ui->setAudioRecorder(&state.audio.recorder);
+  }
+#else
   state.ui->setAudioRecorder(&state.audio.recorder);
+#endif
+  state.audio.exportRecorder.setTrackNames({"song"});
+  state.ui->setExportRecorder(&state.audio.exportRecorder);
 
 #ifdef __EMSCRIPTEN__
   emscripten_set_main_loop_arg(mainLoopTick, &state, 0, 1);
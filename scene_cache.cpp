@@ -0,0 +1,246 @@
+#include "scene_cache.h"
+
+#include "scene_storage.h"
+
+#if defined(ESP_PLATFORM) && defined(MINIACID_SCENE_PREFETCH)
+#include <esp_pthread.h>
+#endif
+
+#ifdef MINIACID_SCENE_PREFETCH
+#define SCENE_CACHE_LOCK() std::lock_guard<std::mutex> lock(mutex_)
+#else
+#define SCENE_CACHE_LOCK() do {} while (0)
+#endif
+
+SceneCache::SceneCache(SceneStorage* storage, size_t budgetBytes) : storage_(storage) {
+  stats_.budgetBytes = budgetBytes;
+}
+
+SceneCache::~SceneCache() {
+#ifdef MINIACID_SCENE_PREFETCH
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopRequested_ = true;
+    prefetchQueue_.clear();
+    loadTarget_ = nullptr;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) thread_.join();
+#endif
+}
+
+size_t SceneCache::entryBytes(const std::string& sceneName, const SceneManager& manager) {
+  return sizeof(Entry) + sizeof(SceneManager) + sceneName.capacity() +
+         manager.getDrumEngineName().capacity() + manager.song().allocatedBytes();
+}
+
+std::list<SceneCache::Entry>::iterator SceneCache::findLocked(const std::string& sceneName) {
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->name == sceneName) return it;
+  }
+  return entries_.end();
+}
+
+void SceneCache::evictLocked() {
+  while (!entries_.empty() && stats_.bytesUsed > stats_.budgetBytes) {
+    Entry& victim = entries_.back();
+    stats_.bytesUsed -= victim.bytes;
+    entries_.pop_back();
+    ++stats_.evictions;
+  }
+  stats_.entries = entries_.size();
+}
+
+void SceneCache::storeLocked(const std::string& sceneName, const SceneManager& manager) {
+  std::shared_ptr<SceneManager> copy = std::make_shared<SceneManager>(manager);
+  // Clean banks are re-read on load, which also picks up banks paged out
+  // (and written back) after this copy was made.
+  copy->releaseCleanBanks();
+  storeEntryLocked(sceneName, std::move(copy), false);
+}
+
+void SceneCache::storeEntryLocked(const std::string& sceneName,
+                                  std::shared_ptr<const SceneManager> scene, bool banksSaved) {
+  auto it = findLocked(sceneName);
+  if (it == entries_.end()) {
+    entries_.push_front(Entry());
+    it = entries_.begin();
+    it->name = sceneName;
+  } else {
+    stats_.bytesUsed -= it->bytes;
+    entries_.splice(entries_.begin(), entries_, it);
+  }
+  it->bytes = entryBytes(sceneName, *scene);
+  it->scene = std::move(scene);
+  it->banksSaved = banksSaved;
+  stats_.bytesUsed += it->bytes;
+  evictLocked();
+}
+
+void SceneCache::copyEntry(const Entry& entry, SceneManager& out) {
+  out = *entry.scene;
+  if (entry.banksSaved) {
+    // Every bank of a saved snapshot is in the writer or on storage, and may
+    // have been paged out with newer edits since; treat them all as clean.
+    out.markBanksSaved(entry.name);
+    out.releaseCleanBanks();
+  }
+}
+
+void SceneCache::setBudget(size_t budgetBytes) {
+  SCENE_CACHE_LOCK();
+  stats_.budgetBytes = budgetBytes;
+  evictLocked();
+}
+
+bool SceneCache::fetch(const std::string& sceneName, SceneManager& out) {
+  SCENE_CACHE_LOCK();
+  auto it = findLocked(sceneName);
+  if (it == entries_.end()) {
+    ++stats_.misses;
+    return false;
+  }
+  ++stats_.hits;
+  entries_.splice(entries_.begin(), entries_, it);
+  copyEntry(*it, out);
+  return true;
+}
+
+void SceneCache::store(const std::string& sceneName, const SceneManager& manager) {
+  SCENE_CACHE_LOCK();
+  ++generation_;
+  storeLocked(sceneName, manager);
+}
+
+void SceneCache::storeSaved(const std::string& sceneName,
+                            std::shared_ptr<const SceneManager> snapshot) {
+  if (!snapshot) return;
+  SCENE_CACHE_LOCK();
+  ++generation_;
+  storeEntryLocked(sceneName, std::move(snapshot), true);
+}
+
+void SceneCache::invalidate(const std::string& sceneName) {
+  SCENE_CACHE_LOCK();
+  ++generation_;
+  auto it = findLocked(sceneName);
+  if (it == entries_.end()) return;
+  stats_.bytesUsed -= it->bytes;
+  entries_.erase(it);
+  stats_.entries = entries_.size();
+}
+
+SceneCache::Stats SceneCache::stats() const {
+  SCENE_CACHE_LOCK();
+  return stats_;
+}
+
+#ifdef MINIACID_SCENE_PREFETCH
+
+void SceneCache::prefetch(const std::vector<std::string>& sceneNames) {
+  if (!storage_) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    prefetchQueue_.clear();
+    for (const auto& name : sceneNames) {
+      if (findLocked(name) == entries_.end()) prefetchQueue_.push_back(name);
+    }
+    if (prefetchQueue_.empty()) return;
+    startThreadLocked();
+  }
+  wake_.notify_one();
+}
+
+void SceneCache::loadAsync(const std::string& sceneName, SceneManager* target,
+                           std::function<void(bool)> done) {
+  if (!target) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loadName_ = sceneName;
+    loadTarget_ = target;
+    loadDone_ = std::move(done);
+    startThreadLocked();
+  }
+  wake_.notify_one();
+}
+
+void SceneCache::startThreadLocked() {
+  if (thread_.joinable()) return;
+#if defined(ESP_PLATFORM)
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = 8192;
+  cfg.prio = 1;
+  cfg.pin_to_core = 0;
+  cfg.thread_name = "scenePrefetch";
+  esp_pthread_set_cfg(&cfg);
+#endif
+  thread_ = std::thread(&SceneCache::threadLoop, this);
+}
+
+void SceneCache::threadLoop() {
+  // Parse into a private buffer so a slow read never holds the cache lock.
+  std::unique_ptr<SceneManager> scratch = std::make_unique<SceneManager>();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this]() {
+      return loadTarget_ || !prefetchQueue_.empty() || stopRequested_;
+    });
+    if (stopRequested_) break;
+
+    if (loadTarget_) {
+      std::string name = loadName_;
+      SceneManager* target = loadTarget_;
+      std::function<void(bool)> done = std::move(loadDone_);
+      loadTarget_ = nullptr;
+      bool ok = true;
+      auto it = findLocked(name);
+      if (it != entries_.end()) {
+        ++stats_.hits;
+        entries_.splice(entries_.begin(), entries_, it);
+        copyEntry(*it, *target);
+      } else {
+        ++stats_.misses;
+        uint32_t startGeneration = generation_;
+        lock.unlock();
+        ok = storage_->readScene(*target, name);
+        lock.lock();
+        if (ok && generation_ == startGeneration) storeLocked(name, *target);
+      }
+      lock.unlock();
+      if (done) done(ok);
+      lock.lock();
+      continue;
+    }
+
+    std::string name = prefetchQueue_.front();
+    prefetchQueue_.erase(prefetchQueue_.begin());
+    if (findLocked(name) != entries_.end()) continue;
+    uint32_t startGeneration = generation_;
+
+    lock.unlock();
+    bool ok = storage_->readScene(*scratch, name);
+    lock.lock();
+
+    if (!ok || generation_ != startGeneration) continue;
+    if (findLocked(name) != entries_.end()) continue;
+    storeLocked(name, *scratch);
+    ++stats_.prefetched;
+  }
+}
+
+#else
+
+void SceneCache::prefetch(const std::vector<std::string>&) {}
+
+void SceneCache::loadAsync(const std::string& sceneName, SceneManager* target,
+                           std::function<void(bool)> done) {
+  if (!target) return;
+  bool ok = fetch(sceneName, *target);
+  if (!ok && storage_) {
+    ok = storage_->readScene(*target, sceneName);
+    if (ok) store(sceneName, *target);
+  }
+  if (done) done(ok);
+}
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define MINIACID_SCENE_PREFETCH 1
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#include "scenes.h"
+
+class SceneStorage;
+
+// LRU cache of parsed scenes, bounded by a byte budget. Entries hold the
+// scene as it is on storage (saves write through via store()), so a cache
+// hit is equivalent to re-reading the file. Pattern banks are not cached;
+// they are paged in from the bank store after a fetch. prefetch() parses scenes on a
+// background thread; builds without thread support only cache scenes that
+// were loaded or saved.
+class SceneCache {
+public:
+#if defined(ARDUINO)
+  static constexpr size_t kDefaultBudgetBytes = 64 * 1024;
+#else
+  static constexpr size_t kDefaultBudgetBytes = 4 * 1024 * 1024;
+#endif
+
+  struct Stats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t prefetched = 0;
+    uint32_t evictions = 0;
+    size_t entries = 0;
+    size_t bytesUsed = 0;
+    size_t budgetBytes = 0;
+  };
+
+  explicit SceneCache(SceneStorage* storage, size_t budgetBytes = kDefaultBudgetBytes);
+  ~SceneCache();
+
+  SceneCache(const SceneCache&) = delete;
+  SceneCache& operator=(const SceneCache&) = delete;
+
+  void setBudget(size_t budgetBytes);
+  // Copies the cached scene into 'out'. Returns false on a miss.
+  bool fetch(const std::string& sceneName, SceneManager& out);
+  // Inserts or refreshes 'sceneName'. Call after every load from storage.
+  void store(const std::string& sceneName, const SceneManager& manager);
+  // Same for a save: keeps the snapshot handed to the scene writer instead of
+  // copying it. Its banks are written along with it, so copies taken from the
+  // cache page them in again rather than trusting the snapshot.
+  void storeSaved(const std::string& sceneName, std::shared_ptr<const SceneManager> snapshot);
+  void invalidate(const std::string& sceneName);
+  // Replaces the prefetch queue; scenes already cached are skipped.
+  void prefetch(const std::vector<std::string>& sceneNames);
+  // Fills 'target' with 'sceneName' (cache first, then storage) on the
+  // prefetch thread and calls done(ok) there. Runs ahead of prefetches; a
+  // newer request replaces one that has not started yet. 'target' must stay
+  // untouched by the caller until done() runs.
+  void loadAsync(const std::string& sceneName, SceneManager* target,
+                 std::function<void(bool)> done);
+  Stats stats() const;
+
+private:
+  struct Entry {
+    std::string name;
+    // Never changed once stored; saves share it with the scene writer.
+    std::shared_ptr<const SceneManager> scene;
+    bool banksSaved = false;
+    size_t bytes = 0;
+  };
+
+  std::list<Entry>::iterator findLocked(const std::string& sceneName);
+  void storeLocked(const std::string& sceneName, const SceneManager& manager);
+  void storeEntryLocked(const std::string& sceneName, std::shared_ptr<const SceneManager> scene,
+                        bool banksSaved);
+  static void copyEntry(const Entry& entry, SceneManager& out);
+  void evictLocked();
+  static size_t entryBytes(const std::string& sceneName, const SceneManager& manager);
+
+  SceneStorage* storage_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  Stats stats_;
+  // Bumped by store()/invalidate() so an in-flight prefetch never replaces
+  // a newer copy with what it read from storage.
+  uint32_t generation_ = 0;
+
+#ifdef MINIACID_SCENE_PREFETCH
+  void startThreadLocked();
+  void threadLoop();
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread thread_;
+  std::vector<std::string> prefetchQueue_;
+  std::string loadName_;
+  SceneManager* loadTarget_ = nullptr;
+  std::function<void(bool)> loadDone_;
+  bool stopRequested_ = false;
+#endif
+};
@@ -0,0 +1,151 @@
+#include "scene_index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+constexpr const char* kHeaderMagic = "MINIACID-SCENE-INDEX 1";
+
+void padRecord(char* out, int written) {
+  size_t used = written < 0 ? 0 : static_cast<size_t>(written);
+  if (used > SceneIndex::kRecordSize - 1) used = SceneIndex::kRecordSize - 1;
+  std::memset(out + used, ' ', SceneIndex::kRecordSize - 1 - used);
+  out[SceneIndex::kRecordSize - 1] = '\n';
+}
+
+std::string trimRight(const char* data, size_t len) {
+  while (len > 0 && data[len - 1] == ' ') --len;
+  return std::string(data, len);
+}
+} // namespace
+
+void SceneIndex::formatHeader(uint32_t count, char* out) {
+  char buffer[kRecordSize + 1];
+  int written = std::snprintf(buffer, sizeof(buffer), "%s %10u", kHeaderMagic,
+                              static_cast<unsigned>(count));
+  std::memcpy(out, buffer, kRecordSize);
+  padRecord(out, written);
+}
+
+bool SceneIndex::parseHeader(const char* in, uint32_t& count) {
+  size_t magicLen = std::strlen(kHeaderMagic);
+  if (std::strncmp(in, kHeaderMagic, magicLen) != 0) return false;
+  if (in[kRecordSize - 1] != '\n') return false;
+  char buffer[kRecordSize];
+  std::memcpy(buffer, in + magicLen, kRecordSize - magicLen - 1);
+  buffer[kRecordSize - magicLen - 1] = '\0';
+  char* end = nullptr;
+  unsigned long value = std::strtoul(buffer, &end, 10);
+  if (end == buffer) return false;
+  count = static_cast<uint32_t>(value);
+  return true;
+}
+
+bool SceneIndex::formatRecord(const SceneInfo& info, char* out) {
+  if (info.name.empty() || info.name.size() > kNameWidth) return false;
+  char buffer[kRecordSize + 1];
+  int written = std::snprintf(buffer, sizeof(buffer), "%-48.48s %10u %10u %6.2f %-8.8s",
+                              info.name.c_str(), static_cast<unsigned>(info.sizeBytes),
+                              static_cast<unsigned>(info.modified),
+                              static_cast<double>(info.bpm), info.drumEngine.c_str());
+  std::memcpy(out, buffer, kRecordSize);
+  padRecord(out, written);
+  return true;
+}
+
+bool SceneIndex::parseRecord(const char* in, SceneInfo& out) {
+  if (in[kRecordSize - 1] != '\n') return false;
+  out.name = trimRight(in, kNameWidth);
+  if (out.name.empty()) return false;
+  char buffer[kRecordSize];
+  std::memcpy(buffer, in + kNameWidth, kRecordSize - kNameWidth - 1);
+  buffer[kRecordSize - kNameWidth - 1] = '\0';
+  char* cursor = buffer;
+  char* end = nullptr;
+  out.sizeBytes = static_cast<uint32_t>(std::strtoul(cursor, &end, 10));
+  if (end == cursor) return false;
+  cursor = end;
+  out.modified = static_cast<uint32_t>(std::strtoul(cursor, &end, 10));
+  if (end == cursor) return false;
+  cursor = end;
+  out.bpm = std::strtof(cursor, &end);
+  if (end == cursor) return false;
+  cursor = end;
+  while (*cursor == ' ') ++cursor;
+  out.drumEngine = trimRight(cursor, std::strlen(cursor));
+  return true;
+}
+
+void SceneIndex::upsert(std::vector<SceneInfo>& sorted, const SceneInfo& info) {
+  auto it = std::lower_bound(sorted.begin(), sorted.end(), info,
+                             [](const SceneInfo& a, const SceneInfo& b) { return a.name < b.name; });
+  if (it != sorted.end() && it->name == info.name) {
+    *it = info;
+  } else {
+    sorted.insert(it, info);
+  }
+}
+
+void SceneIndex::sortByName(std::vector<SceneInfo>& infos) {
+  std::sort(infos.begin(), infos.end(),
+            [](const SceneInfo& a, const SceneInfo& b) { return a.name < b.name; });
+  infos.erase(std::unique(infos.begin(), infos.end(),
+                          [](const SceneInfo& a, const SceneInfo& b) { return a.name == b.name; }),
+              infos.end());
+}
+
+void SceneInfoScanner::finishNumber() {
+  if (key_ == "bpm" && !number_.empty()) {
+    bpm_ = std::strtof(number_.c_str(), nullptr);
+  }
+  number_.clear();
+  key_.clear();
+}
+
+void SceneInfoScanner::feed(int c) {
+  if (inString_) {
+    if (escaped_) {
+      escaped_ = false;
+      token_.push_back(static_cast<char>(c));
+    } else if (c == '\\') {
+      escaped_ = true;
+    } else if (c == '"') {
+      inString_ = false;
+      if (key_ == "drumEngine") {
+        drumEngine_ = token_;
+        key_.clear();
+      } else {
+        lastString_ = token_;
+      }
+    } else if (token_.size() < 32) {
+      token_.push_back(static_cast<char>(c));
+    }
+    return;
+  }
+  switch (c) {
+    case '"':
+      inString_ = true;
+      token_.clear();
+      break;
+    case ':':
+      key_ = lastString_;
+      number_.clear();
+      break;
+    case ',':
+    case '}':
+    case ']':
+    case '{':
+    case '[':
+      finishNumber();
+      break;
+    default:
+      if (key_ == "bpm" && number_.size() < 16) number_.push_back(static_cast<char>(c));
+      break;
+  }
+}
+
+void SceneInfoScanner::scan(const std::string& json) {
+  for (char c : json) feed(static_cast<unsigned char>(c));
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Summary of one scene file as kept in the scene index.
+struct SceneInfo {
+  std::string name;
+  uint32_t sizeBytes = 0;
+  uint32_t modified = 0;
+  float bpm = 0.0f;
+  std::string drumEngine;
+};
+
+// On-storage layout of the scene index: a header record followed by one
+// fixed-size text record per scene, sorted by name. Fixed-size records let
+// storage seek straight to any page instead of parsing the whole file.
+class SceneIndex {
+public:
+  static constexpr size_t kRecordSize = 88;
+  static constexpr size_t kNameWidth = 48;
+  static constexpr size_t kEngineWidth = 8;
+
+  static size_t recordOffset(size_t position) { return (position + 1) * kRecordSize; }
+  static size_t fileSizeFor(size_t count) { return (count + 1) * kRecordSize; }
+
+  static void formatHeader(uint32_t count, char* out);
+  static bool parseHeader(const char* in, uint32_t& count);
+  // Returns false when the name does not fit a record.
+  static bool formatRecord(const SceneInfo& info, char* out);
+  static bool parseRecord(const char* in, SceneInfo& out);
+
+  // Inserts or replaces 'info', keeping 'sorted' ordered by name.
+  static void upsert(std::vector<SceneInfo>& sorted, const SceneInfo& info);
+  static void sortByName(std::vector<SceneInfo>& infos);
+
+  // Binary search over 'count' records; readName(i, name) loads the name of
+  // record i. Returns the position of 'name' or -1.
+  template <typename ReadName>
+  static int find(size_t count, const std::string& name, ReadName readName) {
+    size_t lo = 0;
+    size_t hi = count;
+    std::string probe;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (!readName(mid, probe)) return -1;
+      if (probe < name) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    if (lo < count && readName(lo, probe) && probe == name) return static_cast<int>(lo);
+    return -1;
+  }
+};
+
+// Pulls bpm and drum engine out of scene JSON one character at a time, so
+// rebuilding the index does not have to parse whole scenes.
+class SceneInfoScanner {
+public:
+  void feed(int c);
+  template <typename Stream>
+  void scanStream(Stream& stream) {
+    while (stream.available()) {
+      int c = stream.read();
+      if (c < 0) break;
+      feed(c);
+    }
+  }
+  void scan(const std::string& json);
+
+  float bpm() const { return bpm_; }
+  const std::string& drumEngine() const { return drumEngine_; }
+
+private:
+  void finishNumber();
+
+  std::string token_;
+  std::string lastString_;
+  std::string key_;
+  std::string number_;
+  bool inString_ = false;
+  bool escaped_ = false;
+  float bpm_ = 0.0f;
+  std::string drumEngine_;
+};
@@ -5,10 +5,17 @@
 #include <string>
 #include <vector>
 
-class SceneManager;
+#include "scene_index.h"
+#include "scenes.h"
+#include "src/dsp/sample_drum_voice.h"
 
-// Abstract interface for loading and saving scene JSON blobs.
-class SceneStorage {
+// Abstract interface for loading and saving scene JSON blobs, plus the
+// pattern banks of each scene (SceneBankStore), which are kept as fixed-size
+// segments so a single bank can be read or rewritten on its own.
+// readBank()/writeBank() are called from the UI and background threads.
+// Sample drum kits (DrumSampleStore) are loaded from the same storage, also
+// from the background scene loader.
+class SceneStorage : public SceneBankStore, public DrumSampleStore {
 public:
   virtual ~SceneStorage() = default;
   virtual void initializeStorage() = 0;
@@ -20,10 +27,26 @@ public:
   // it should also always write to a general, to persist the name of the current scene being opened.
   virtual bool writeScene(const std::string& data) = 0;
   virtual bool readScene(SceneManager& manager) = 0;
+  // Reads the scene 'sceneName' without touching the current scene name.
+  // Must be safe to call from a background thread alongside the other calls.
+  virtual bool readScene(SceneManager& manager, const std::string& sceneName) = 0;
   virtual bool writeScene(const SceneManager& manager) = 0;
+  // Writes 'manager' as the scene 'sceneName' without touching the current scene name.
+  // The previous file must stay intact until the new one is complete, since this
+  // is called from the background scene writer.
+  virtual bool writeScene(const SceneManager& manager, const std::string& sceneName) = 0;
 
   // return the scenes currently found on the storage
   virtual std::vector<std::string> getAvailableSceneNames() const = 0;
+
+  // Scene index, sorted by name. Saves keep it current; it is rebuilt from
+  // the scene files when missing, damaged or (where detectable) stale.
+  virtual size_t sceneCount() const = 0;
+  // Appends up to 'count' entries starting at 'offset'; returns how many were added.
+  virtual size_t readSceneInfos(size_t offset, size_t count, std::vector<SceneInfo>& out) const = 0;
+  // Returns the index position of 'name', or -1.
+  virtual int findScene(const std::string& name) const = 0;
+  virtual bool rebuildSceneIndex() = 0;
   // return the name of the current scene
   virtual std::string getCurrentSceneName() const = 0;
   // set the name of the current scene.
@@ -1,5 +1,6 @@
 #include "scene_storage_cardputer.h"
 
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 #include <M5Cardputer.h>
@@ -57,6 +58,60 @@ std::string SceneStorageCardputer::currentScenePath() const {
   return scenePathFor(currentSceneName_);
 }
 
+std::string SceneStorageCardputer::bankPathFor(const std::string& name) const {
+  std::string path = "/";
+  path += normalizeSceneName(name);
+  path += kBankExtension;
+  return path;
+}
+
+bool SceneStorageCardputer::readBank(const std::string& sceneName, int bankIndex, SceneBank& out) {
+  if (!isInitialized_ || bankIndex < 0 || bankIndex >= kBankCount) return false;
+  uint8_t segment[SceneBankSegment::kBytes];
+  std::lock_guard<std::mutex> lock(bankMutex_);
+  std::string path = bankPathFor(sceneName);
+  File file = SD.open(path.c_str(), FILE_READ);
+  if (!file) return false;
+  bool ok = file.seek(static_cast<uint32_t>(bankIndex * SceneBankSegment::kBytes)) &&
+            file.read(segment, sizeof(segment)) == sizeof(segment);
+  file.close();
+  return ok && SceneBankSegment::decode(segment, out);
+}
+
+bool SceneStorageCardputer::writeBank(const std::string& sceneName, int bankIndex, const SceneBank& bank) {
+  if (!isInitialized_ || bankIndex < 0 || bankIndex >= kBankCount) return false;
+  uint8_t segment[SceneBankSegment::kBytes];
+  SceneBankSegment::encode(bank, segment);
+  std::lock_guard<std::mutex> lock(bankMutex_);
+  // Rewrite the segment in place; "r+" keeps the other banks of the file.
+  std::string path = bankPathFor(sceneName);
+  if (!SD.exists(path.c_str())) {
+    File create = SD.open(path.c_str(), FILE_WRITE);
+    if (!create) return false;
+    create.close();
+  }
+  File file = SD.open(path.c_str(), "r+");
+  if (!file) return false;
+  // Seeking past the end is not allowed, so pad up to the segment first.
+  size_t offset = static_cast<size_t>(bankIndex) * SceneBankSegment::kBytes;
+  bool ok = true;
+  if (file.size() < offset) {
+    ok = file.seek(file.size());
+    static const uint8_t kZeros[64] = {};
+    size_t missing = offset - file.size();
+    while (ok && missing > 0) {
+      size_t chunk = missing < sizeof(kZeros) ? missing : sizeof(kZeros);
+      ok = file.write(kZeros, chunk) == chunk;
+      missing -= chunk;
+    }
+  }
+  ok = ok && file.seek(static_cast<uint32_t>(offset)) &&
+       file.write(segment, sizeof(segment)) == sizeof(segment);
+  file.close();
+  if (!ok) Serial.printf("Bank write failed: %s[%d]\n", path.c_str(), bankIndex);
+  return ok;
+}
+
 void SceneStorageCardputer::loadStoredSceneName() {
   if (!isInitialized_) return;
   File file = SD.open(kSceneNamePath, FILE_READ);
@@ -106,6 +161,7 @@ bool SceneStorageCardputer::readScene(std::string& out) {
     return false;
   }
   std::string path = currentScenePath();
+  recoverInterruptedWrite(path);
   Serial.printf("Reading scene from SD card (%s)...\n", path.c_str());
   File file = SD.open(path.c_str(), FILE_READ);
   if (!file) return false;
@@ -149,9 +205,19 @@ bool SceneStorageCardputer::writeScene(const std::string& data) {
   Serial.printf("Writing to file: %s\n", path.c_str());
   size_t written = file.write(reinterpret_cast<const uint8_t*>(data.data()), data.size());
   Serial.printf("Written %zu bytes to file.\n", written);
+  SceneInfo info;
+  info.name = currentSceneName_;
+  info.sizeBytes = static_cast<uint32_t>(written);
+  info.modified = static_cast<uint32_t>(file.getLastWrite());
   file.close();
   Serial.println("File write complete.");
-  return written == data.size();
+  if (written != data.size()) return false;
+  SceneInfoScanner scanner;
+  scanner.scan(data);
+  info.bpm = scanner.bpm();
+  info.drumEngine = scanner.drumEngine();
+  updateIndexEntry(info);
+  return true;
 }
 
 bool SceneStorageCardputer::readScene(SceneManager& manager) {
@@ -159,7 +225,13 @@ bool SceneStorageCardputer::readScene(SceneManager& manager) {
     Serial.println("Storage not initialized. Please call initializeStorage() first.");
     return false;
   }
-  std::string path = currentScenePath();
+  return readScene(manager, currentSceneName_);
+}
+
+bool SceneStorageCardputer::readScene(SceneManager& manager, const std::string& sceneName) {
+  if (!isInitialized_) return false;
+  std::string path = scenePathFor(sceneName);
+  recoverInterruptedWrite(path);
   Serial.printf("Reading scene (streaming) from SD card (%s)...\n", path.c_str());
   File file = SD.open(path.c_str(), FILE_READ);
   if (!file) return false;
@@ -184,27 +256,156 @@ bool SceneStorageCardputer::writeScene(const SceneManager& manager) {
     Serial.println("Storage not initialized. Please call initializeStorage() first.");
     return false;
   }
-  Serial.println("Writing scene (streaming) to SD card...");
   persistCurrentSceneName();
-  std::string path = currentScenePath();
-  bool removed = SD.remove(path.c_str());
-  Serial.printf("Removed old scene file: %s\n", removed ? "yes" : "no");
-  File file = SD.open(path.c_str(), FILE_WRITE);
+  return writeScene(manager, currentSceneName_);
+}
+
+bool SceneStorageCardputer::writeScene(const SceneManager& manager, const std::string& sceneName) {
+  if (!isInitialized_) return false;
+  // FAT has no atomic replace: stream into a temp file first and only drop
+  // the old scene once the new one is complete. readScene() picks up the
+  // temp file if we were interrupted between remove and rename.
+  std::string path = scenePathFor(sceneName);
+  std::string tempPath = path + kTempSuffix;
+  SD.remove(tempPath.c_str());
+  File file = SD.open(tempPath.c_str(), FILE_WRITE);
   if (!file) return false;
 
   bool ok = manager.writeSceneJson(file);
+  SceneInfo info;
+  info.name = normalizeSceneName(sceneName);
+  info.sizeBytes = static_cast<uint32_t>(file.size());
+  info.modified = static_cast<uint32_t>(file.getLastWrite());
+  info.bpm = manager.getBpm();
+  info.drumEngine = manager.getDrumEngineName();
   file.close();
-  Serial.printf("Streaming write %s\n to %s\n", ok ? "succeeded" : "failed", path.c_str());
+  if (ok) {
+    SD.remove(path.c_str());
+    ok = SD.rename(tempPath.c_str(), path.c_str());
+  } else {
+    SD.remove(tempPath.c_str());
+  }
+  Serial.printf("Streaming write %s to %s\n", ok ? "succeeded" : "failed", path.c_str());
+  if (ok) updateIndexEntry(info);
   return ok;
 }
 
+void SceneStorageCardputer::recoverInterruptedWrite(const std::string& path) const {
+  if (SD.exists(path.c_str())) return;
+  std::string tempPath = path + kTempSuffix;
+  if (!SD.exists(tempPath.c_str())) return;
+  Serial.printf("Recovering interrupted scene write: %s\n", path.c_str());
+  SD.rename(tempPath.c_str(), path.c_str());
+}
+
 std::vector<std::string> SceneStorageCardputer::getAvailableSceneNames() const {
   std::vector<std::string> names;
   if (!isInitialized_) return names;
 
-  File root = SD.open("/");
-  if (!root) return names;
+  std::vector<SceneInfo> infos;
+  readSceneInfos(0, sceneCount(), infos);
+  names.reserve(infos.size());
+  for (const auto& info : infos) names.push_back(info.name);
+  if (names.empty()) names.push_back(currentSceneName_);
+  return names;
+}
+
+size_t SceneStorageCardputer::sceneCount() const {
+  if (!isInitialized_) return 0;
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  if (!ensureIndexLocked()) return 0;
+  return indexCount_;
+}
+
+size_t SceneStorageCardputer::readSceneInfos(size_t offset, size_t count,
+                                             std::vector<SceneInfo>& out) const {
+  if (!isInitialized_) return 0;
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  if (!ensureIndexLocked() || offset >= indexCount_) return 0;
+  if (count > indexCount_ - offset) count = indexCount_ - offset;
+  File file = SD.open(kSceneIndexPath, FILE_READ);
+  if (!file) return 0;
+  file.seek(SceneIndex::recordOffset(offset));
+  char record[SceneIndex::kRecordSize];
+  SceneInfo info;
+  size_t added = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (file.read(reinterpret_cast<uint8_t*>(record), sizeof(record)) != sizeof(record)) break;
+    if (!SceneIndex::parseRecord(record, info)) break;
+    out.push_back(info);
+    ++added;
+  }
+  file.close();
+  return added;
+}
+
+int SceneStorageCardputer::findScene(const std::string& name) const {
+  if (!isInitialized_) return -1;
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  if (!ensureIndexLocked()) return -1;
+  File file = SD.open(kSceneIndexPath, FILE_READ);
+  if (!file) return -1;
+  char record[SceneIndex::kRecordSize];
+  SceneInfo info;
+  int position = SceneIndex::find(indexCount_, normalizeSceneName(name),
+                                  [&](size_t probe, std::string& probeName) {
+    if (!file.seek(SceneIndex::recordOffset(probe))) return false;
+    if (file.read(reinterpret_cast<uint8_t*>(record), sizeof(record)) != sizeof(record)) return false;
+    if (!SceneIndex::parseRecord(record, info)) return false;
+    probeName = info.name;
+    return true;
+  });
+  file.close();
+  return position;
+}
 
+bool SceneStorageCardputer::rebuildSceneIndex() {
+  if (!isInitialized_) return false;
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  return rebuildIndexLocked();
+}
+
+bool SceneStorageCardputer::ensureIndexLocked() const {
+  if (indexValid_) return true;
+  File file = SD.open(kSceneIndexPath, FILE_READ);
+  if (file) {
+    char header[SceneIndex::kRecordSize];
+    uint32_t count = 0;
+    bool ok = file.read(reinterpret_cast<uint8_t*>(header), sizeof(header)) == sizeof(header) &&
+              SceneIndex::parseHeader(header, count) &&
+              file.size() == SceneIndex::fileSizeFor(count);
+    file.close();
+    if (ok) {
+      indexCount_ = count;
+      indexValid_ = true;
+      return true;
+    }
+  }
+  return rebuildIndexLocked();
+}
+
+bool SceneStorageCardputer::rebuildIndexLocked() const {
+  Serial.println("Rebuilding scene index...");
+  // Keep summaries of files whose size and stamp did not change.
+  std::vector<SceneInfo> previous;
+  File oldIndex = SD.open(kSceneIndexPath, FILE_READ);
+  if (oldIndex) {
+    char record[SceneIndex::kRecordSize];
+    uint32_t count = 0;
+    if (oldIndex.read(reinterpret_cast<uint8_t*>(record), sizeof(record)) == sizeof(record) &&
+        SceneIndex::parseHeader(record, count)) {
+      SceneInfo info;
+      for (uint32_t i = 0; i < count; ++i) {
+        if (oldIndex.read(reinterpret_cast<uint8_t*>(record), sizeof(record)) != sizeof(record)) break;
+        if (SceneIndex::parseRecord(record, info)) previous.push_back(info);
+      }
+    }
+    oldIndex.close();
+  }
+
+  std::vector<SceneInfo> infos;
+  File root = SD.open("/");
+  if (!root) return false;
   while (true) {
     File entry = root.openNextFile();
     if (!entry) break;
@@ -212,15 +413,115 @@ std::vector<std::string> SceneStorageCardputer::getAvailableSceneNames() const {
       std::string fileName = entry.name();
       if (!fileName.empty() && fileName.front() == '/') fileName.erase(0, 1);
       if (endsWith(fileName, kSceneExtension)) {
-        fileName.resize(fileName.size() - std::strlen(kSceneExtension));
-        names.push_back(fileName);
+        SceneInfo info;
+        info.name = fileName.substr(0, fileName.size() - std::strlen(kSceneExtension));
+        info.sizeBytes = static_cast<uint32_t>(entry.size());
+        info.modified = static_cast<uint32_t>(entry.getLastWrite());
+        auto it = std::lower_bound(previous.begin(), previous.end(), info.name,
+                                   [](const SceneInfo& a, const std::string& n) { return a.name < n; });
+        if (it != previous.end() && it->name == info.name &&
+            it->sizeBytes == info.sizeBytes && it->modified == info.modified) {
+          infos.push_back(*it);
+        } else {
+          SceneInfoScanner scanner;
+          scanner.scanStream(entry);
+          info.bpm = scanner.bpm();
+          info.drumEngine = scanner.drumEngine();
+          infos.push_back(info);
+        }
       }
     }
     entry.close();
   }
   root.close();
-  if (names.empty()) names.push_back(currentSceneName_);
-  return names;
+  SceneIndex::sortByName(infos);
+
+  indexValid_ = false;
+  File out = SD.open(kSceneIndexPath, FILE_WRITE);
+  if (!out) return false;
+  char record[SceneIndex::kRecordSize];
+  size_t count = 0;
+  SceneIndex::formatHeader(0, record);
+  out.write(reinterpret_cast<const uint8_t*>(record), sizeof(record));
+  for (const auto& info : infos) {
+    if (!SceneIndex::formatRecord(info, record)) continue;
+    out.write(reinterpret_cast<const uint8_t*>(record), sizeof(record));
+    ++count;
+  }
+  SceneIndex::formatHeader(static_cast<uint32_t>(count), record);
+  out.seek(0);
+  bool ok = out.write(reinterpret_cast<const uint8_t*>(record), sizeof(record)) == sizeof(record);
+  out.close();
+  if (!ok) return false;
+  indexCount_ = count;
+  indexValid_ = true;
+  Serial.printf("Scene index holds %u scenes\n", static_cast<unsigned>(count));
+  return true;
+}
+
+bool SceneStorageCardputer::upsertIndexLocked(const SceneInfo& info) const {
+  // Merge the new record into a copy of the index one record at a time so
+  // large libraries never have to be held in RAM.
+  File in = SD.open(kSceneIndexPath, FILE_READ);
+  if (!in) return false;
+  std::string tempPath = std::string(kSceneIndexPath) + kTempSuffix;
+  SD.remove(tempPath.c_str());
+  File out = SD.open(tempPath.c_str(), FILE_WRITE);
+  if (!out) {
+    in.close();
+    return false;
+  }
+
+  char record[SceneIndex::kRecordSize];
+  char fresh[SceneIndex::kRecordSize];
+  SceneIndex::formatRecord(info, fresh);
+  size_t count = 0;
+  bool inserted = false;
+  bool ok = in.read(reinterpret_cast<uint8_t*>(record), sizeof(record)) == sizeof(record);
+  out.write(reinterpret_cast<const uint8_t*>(record), sizeof(record));
+  SceneInfo existing;
+  while (ok && in.read(reinterpret_cast<uint8_t*>(record), sizeof(record)) == sizeof(record)) {
+    if (!SceneIndex::parseRecord(record, existing)) {
+      ok = false;
+      break;
+    }
+    if (!inserted && existing.name >= info.name) {
+      out.write(reinterpret_cast<const uint8_t*>(fresh), sizeof(fresh));
+      ++count;
+      inserted = true;
+      if (existing.name == info.name) continue;
+    }
+    out.write(reinterpret_cast<const uint8_t*>(record), sizeof(record));
+    ++count;
+  }
+  if (ok && !inserted) {
+    out.write(reinterpret_cast<const uint8_t*>(fresh), sizeof(fresh));
+    ++count;
+  }
+  in.close();
+  SceneIndex::formatHeader(static_cast<uint32_t>(count), record);
+  out.seek(0);
+  ok = ok && out.write(reinterpret_cast<const uint8_t*>(record), sizeof(record)) == sizeof(record);
+  out.close();
+  if (!ok) {
+    SD.remove(tempPath.c_str());
+    return false;
+  }
+  SD.remove(kSceneIndexPath);
+  if (!SD.rename(tempPath.c_str(), kSceneIndexPath)) return false;
+  indexCount_ = count;
+  indexValid_ = true;
+  return true;
+}
+
+void SceneStorageCardputer::updateIndexEntry(const SceneInfo& info) const {
+  std::lock_guard<std::mutex> lock(indexMutex_);
+  if (info.name.size() > SceneIndex::kNameWidth) return;
+  if (!ensureIndexLocked()) return;
+  if (!upsertIndexLocked(info)) {
+    indexValid_ = false;
+    rebuildIndexLocked();
+  }
 }
 
 std::string SceneStorageCardputer::getCurrentSceneName() const {
@@ -232,3 +533,49 @@ bool SceneStorageCardputer::setCurrentSceneName(const std::string& name) {
   if (!isInitialized_) return false;
   return persistCurrentSceneName();
 }
+
+std::vector<std::string> SceneStorageCardputer::drumSampleKitNames() const {
+  std::vector<std::string> names;
+  if (!isInitialized_) return names;
+  std::string path = "/";
+  path += kDrumSampleDirectory;
+  File root = SD.open(path.c_str());
+  if (!root) return names;
+  while (true) {
+    File entry = root.openNextFile();
+    if (!entry) break;
+    if (!entry.isDirectory()) continue;
+    std::string name = entry.name();
+    size_t slash = name.find_last_of('/');
+    if (slash != std::string::npos) name.erase(0, slash + 1);
+    if (isDrumSampleKitName(name)) names.push_back(name);
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+// The whole kit is read into one arena: the SD card is far too slow to
+// stream one-shots from the audio thread.
+std::shared_ptr<const DrumSampleKit> SceneStorageCardputer::loadDrumSampleKit(const std::string& kitName) {
+  if (!isInitialized_ || !isDrumSampleKitName(kitName)) return nullptr;
+  std::string folder = "/";
+  folder += kDrumSampleDirectory;
+  folder += "/" + kitName + "/";
+  size_t sizes[kDrumLanes] = {};
+  for (int l = 0; l < kDrumLanes; ++l) {
+    std::string path = folder + drumSampleFileName(l);
+    if (!SD.exists(path.c_str())) continue;
+    File file = SD.open(path.c_str(), FILE_READ);
+    if (!file) continue;
+    sizes[l] = file.size();
+    file.close();
+  }
+  return loadDrumSampleKitArena(kitName, sizes, [&](int lane, uint8_t* dst, size_t size) {
+    std::string path = folder + drumSampleFileName(lane);
+    File file = SD.open(path.c_str(), FILE_READ);
+    if (!file) return false;
+    bool ok = file.read(dst, size) == size;
+    file.close();
+    return ok;
+  });
+}
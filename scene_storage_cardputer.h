@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "scene_storage.h"
@@ -10,24 +12,53 @@ public:
   bool readScene(std::string& out) override;
   bool writeScene(const std::string& data) override;
   bool readScene(SceneManager& manager) override;
+  bool readScene(SceneManager& manager, const std::string& sceneName) override;
   bool writeScene(const SceneManager& manager) override;
+  bool writeScene(const SceneManager& manager, const std::string& sceneName) override;
   void initializeStorage() override;
   std::vector<std::string> getAvailableSceneNames() const override;
+  size_t sceneCount() const override;
+  size_t readSceneInfos(size_t offset, size_t count, std::vector<SceneInfo>& out) const override;
+  int findScene(const std::string& name) const override;
+  bool rebuildSceneIndex() override;
   std::string getCurrentSceneName() const override;
   bool setCurrentSceneName(const std::string& name) override;
+  bool readBank(const std::string& sceneName, int bankIndex, SceneBank& out) override;
+  bool writeBank(const std::string& sceneName, int bankIndex, const SceneBank& bank) override;
+  std::vector<std::string> drumSampleKitNames() const override;
+  std::shared_ptr<const DrumSampleKit> loadDrumSampleKit(const std::string& kitName) override;
 
 private:
   static constexpr const char* kDefaultSceneName = "miniacid_scene";
   static constexpr const char* kSceneNamePath = "/miniacid_scene_name.txt";
   static constexpr const char* kSceneExtension = ".json";
+  static constexpr const char* kTempSuffix = ".tmp";
+  static constexpr const char* kSceneIndexPath = "/miniacid_scene_index.txt";
+  static constexpr const char* kBankExtension = ".banks";
 
   std::string scenePathFor(const std::string& name) const;
   std::string currentScenePath() const;
+  std::string bankPathFor(const std::string& name) const;
+  void recoverInterruptedWrite(const std::string& path) const;
   std::string normalizeSceneName(const std::string& name) const;
   void loadStoredSceneName();
   bool persistCurrentSceneName() const;
 
+  bool ensureIndexLocked() const;
+  bool rebuildIndexLocked() const;
+  bool upsertIndexLocked(const SceneInfo& info) const;
+  void updateIndexEntry(const SceneInfo& info) const;
+
   bool isInitialized_;
   std::string currentSceneName_;
 
+  // Guards the index file; scenes are written from the background scene writer.
+  // There is no reliable directory timestamp on FAT, so the index is only
+  // rebuilt when missing/damaged or on request (rebuildSceneIndex()).
+  mutable std::mutex indexMutex_;
+  mutable bool indexValid_ = false;
+  mutable size_t indexCount_ = 0;
+  // Serializes bank segment reads and in-place rewrites.
+  mutable std::mutex bankMutex_;
+
 };
@@ -0,0 +1,222 @@
+#include "scene_writer.h"
+
+#include "scene_storage.h"
+
+#if defined(ESP_PLATFORM) && defined(MINIACID_ASYNC_SCENE_WRITER)
+#include <esp_pthread.h>
+#endif
+
+AsyncSceneWriter::AsyncSceneWriter(SceneStorage* storage) : storage_(storage) {}
+
+AsyncSceneWriter::~AsyncSceneWriter() {
+#ifdef MINIACID_ASYNC_SCENE_WRITER
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return queue_.empty() && !isWriting_; });
+    stopRequested_ = true;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) thread_.join();
+#endif
+}
+
+bool AsyncSceneWriter::writeSnapshot(const SceneManager& snapshot, const std::string& sceneName) {
+  // Banks first: the scene file is what makes a new scene show up.
+  if (!snapshot.writeBanks(*storage_, sceneName)) return false;
+  return storage_->writeScene(snapshot, sceneName);
+}
+
+bool AsyncSceneWriter::writeJob(const Job& job) {
+  if (job.bank) return storage_->writeBank(job.sceneName, job.bankIndex, *job.bank);
+  return writeSnapshot(*job.snapshot, job.sceneName);
+}
+
+#ifdef MINIACID_ASYNC_SCENE_WRITER
+
+AsyncSceneWriter::Job& AsyncSceneWriter::queueJobLocked(const std::string& sceneName, int bankIndex) {
+  for (size_t i = 0; i < queue_.size(); ++i) {
+    if (queue_[i].sceneName != sceneName || queue_[i].bankIndex != bankIndex) continue;
+    // A save-as still has to copy the banks of its source scene; keep it.
+    if (queue_[i].snapshot && queue_[i].snapshot->bankSceneName() != sceneName) continue;
+    if (bankIndex < 0) ++status_.coalescedWrites;
+    Job job = std::move(queue_[i]);
+    queue_.erase(queue_.begin() + static_cast<std::ptrdiff_t>(i));
+    queue_.push_back(std::move(job));
+    return queue_.back();
+  }
+  queue_.push_back(Job());
+  Job& job = queue_.back();
+  job.sceneName = sceneName;
+  job.bankIndex = bankIndex;
+  return job;
+}
+
+bool AsyncSceneWriter::enqueue(std::shared_ptr<const SceneManager> snapshot,
+                               const std::string& sceneName) {
+  if (!storage_ || !snapshot) return false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Job& job = queueJobLocked(sceneName, -1);
+    job.snapshot = std::move(snapshot);
+    status_.state = State::Pending;
+    status_.sceneName = sceneName;
+    startThreadLocked();
+  }
+  wake_.notify_one();
+  return true;
+}
+
+bool AsyncSceneWriter::writeBank(const std::string& sceneName, int bankIndex, const SceneBank& bank) {
+  if (!storage_) return false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Job& job = queueJobLocked(sceneName, bankIndex);
+    if (!job.bank) job.bank = std::make_unique<SceneBank>();
+    *job.bank = bank;
+    startThreadLocked();
+  }
+  wake_.notify_one();
+  return true;
+}
+
+int AsyncSceneWriter::findQueuedBankLocked(std::string& sceneName, int bankIndex, SceneBank& out) const {
+  int redirected = 0;
+  auto check = [&](const Job& job) -> bool {
+    if (job.sceneName != sceneName) return false;
+    if (job.bank) {
+      if (job.bankIndex != bankIndex) return false;
+      out = *job.bank;
+      return true;
+    }
+    const SceneBank* resident = job.snapshot->residentBank(bankIndex);
+    if (resident) {
+      out = *resident;
+      return true;
+    }
+    if (job.snapshot->bankSceneName() != sceneName) {
+      sceneName = job.snapshot->bankSceneName();
+      redirected = -1;
+    }
+    return false;
+  };
+  for (auto it = queue_.rbegin(); it != queue_.rend(); ++it) {
+    if (check(*it)) return 1;
+  }
+  if (isWriting_ && check(writing_)) return 1;
+  return redirected;
+}
+
+bool AsyncSceneWriter::readBank(const std::string& sceneName, int bankIndex, SceneBank& out) {
+  if (!storage_) return false;
+  std::string name = sceneName;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (findQueuedBankLocked(name, bankIndex, out) > 0) return true;
+  }
+  if (name.empty()) return false;
+  return storage_->readBank(name, bankIndex, out);
+}
+
+void AsyncSceneWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this]() { return queue_.empty() && !isWriting_; });
+}
+
+std::vector<std::string> AsyncSceneWriter::pendingSceneNames() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::string> names;
+  if (isWriting_ && !writing_.bank) names.push_back(writing_.sceneName);
+  for (const auto& queued : queue_) {
+    if (!queued.bank) names.push_back(queued.sceneName);
+  }
+  return names;
+}
+
+AsyncSceneWriter::Status AsyncSceneWriter::status() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return status_;
+}
+
+void AsyncSceneWriter::startThreadLocked() {
+  if (thread_.joinable()) return;
+#if defined(ESP_PLATFORM)
+  // Keep file IO off the audio core and give the JSON writer enough stack.
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = 6144;
+  cfg.prio = 1;
+  cfg.pin_to_core = 0;
+  cfg.thread_name = "sceneWriter";
+  esp_pthread_set_cfg(&cfg);
+#endif
+  thread_ = std::thread(&AsyncSceneWriter::threadLoop, this);
+}
+
+void AsyncSceneWriter::threadLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this]() { return !queue_.empty() || stopRequested_; });
+    if (queue_.empty()) break;
+
+    writing_ = std::move(queue_.front());
+    queue_.erase(queue_.begin());
+    isWriting_ = true;
+    if (!writing_.bank) {
+      status_.state = State::Writing;
+      status_.sceneName = writing_.sceneName;
+    }
+
+    // writing_ is only replaced by this thread, so it can be read unlocked.
+    lock.unlock();
+    bool ok = writeJob(writing_);
+    lock.lock();
+
+    isWriting_ = false;
+    writing_.snapshot.reset();
+    if (!writing_.bank || !ok) finishWrite(writing_.sceneName, ok);
+    writing_.bank.reset();
+    if (queue_.empty()) idle_.notify_all();
+  }
+}
+
+#else
+
+bool AsyncSceneWriter::enqueue(std::shared_ptr<const SceneManager> snapshot,
+                               const std::string& sceneName) {
+  if (!storage_ || !snapshot) return false;
+  status_.state = State::Writing;
+  status_.sceneName = sceneName;
+  finishWrite(sceneName, writeSnapshot(*snapshot, sceneName));
+  return true;
+}
+
+void AsyncSceneWriter::flush() {}
+
+std::vector<std::string> AsyncSceneWriter::pendingSceneNames() const { return {}; }
+
+bool AsyncSceneWriter::writeBank(const std::string& sceneName, int bankIndex, const SceneBank& bank) {
+  if (!storage_) return false;
+  bool ok = storage_->writeBank(sceneName, bankIndex, bank);
+  if (!ok) finishWrite(sceneName, false);
+  return ok;
+}
+
+bool AsyncSceneWriter::readBank(const std::string& sceneName, int bankIndex, SceneBank& out) {
+  return storage_ && storage_->readBank(sceneName, bankIndex, out);
+}
+
+AsyncSceneWriter::Status AsyncSceneWriter::status() const { return status_; }
+
+#endif
+
+void AsyncSceneWriter::finishWrite(const std::string& sceneName, bool ok) {
+  if (ok) {
+    ++status_.completedWrites;
+  } else {
+    ++status_.failedWrites;
+  }
+#ifdef MINIACID_ASYNC_SCENE_WRITER
+  if (!queue_.empty()) return;
+#endif
+  status_.state = ok ? State::Saved : State::Failed;
+  status_.sceneName = sceneName;
+}
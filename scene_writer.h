@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define MINIACID_ASYNC_SCENE_WRITER 1
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#include "scenes.h"
+
+class SceneStorage;
+
+// Writes scene snapshots to storage on a background thread so saving never
+// blocks the UI or holds the audio lock while the file is written.
+// enqueue() takes a snapshot the caller copied once and may share (the scene
+// cache keeps the same one); if an older snapshot of the same scene is still
+// waiting to be written it is replaced (only the latest state matters).
+// Builds without thread support write synchronously from enqueue().
+//
+// It is also the bank store of the live scene: banks paged out by the
+// SceneManager go through the same queue, so they can never overtake (or be
+// overwritten by) an older snapshot, and readBank() sees queued data first.
+class AsyncSceneWriter : public SceneBankStore {
+public:
+  enum class State : uint8_t {
+    Idle = 0,
+    Pending,
+    Writing,
+    Saved,
+    Failed
+  };
+
+  struct Status {
+    State state = State::Idle;
+    std::string sceneName;
+    uint32_t completedWrites = 0;
+    uint32_t failedWrites = 0;
+    uint32_t coalescedWrites = 0;
+  };
+
+  explicit AsyncSceneWriter(SceneStorage* storage);
+  ~AsyncSceneWriter() override;
+
+  AsyncSceneWriter(const AsyncSceneWriter&) = delete;
+  AsyncSceneWriter& operator=(const AsyncSceneWriter&) = delete;
+
+  // Schedules 'snapshot' to be written as 'sceneName'. It must not change
+  // afterwards. Returns false only when there is no storage to write to.
+  bool enqueue(std::shared_ptr<const SceneManager> snapshot, const std::string& sceneName);
+  // Blocks until every queued snapshot has reached storage.
+  void flush();
+  // Names of scenes queued or being written, i.e. not yet visible on storage.
+  std::vector<std::string> pendingSceneNames() const;
+  Status status() const;
+
+  bool readBank(const std::string& sceneName, int bankIndex, SceneBank& out) override;
+  bool writeBank(const std::string& sceneName, int bankIndex, const SceneBank& bank) override;
+
+private:
+  // Either a scene snapshot or a single bank (bankIndex >= 0).
+  struct Job {
+    std::string sceneName;
+    std::shared_ptr<const SceneManager> snapshot;
+    int bankIndex = -1;
+    std::unique_ptr<SceneBank> bank;
+  };
+
+  bool writeSnapshot(const SceneManager& snapshot, const std::string& sceneName);
+  bool writeJob(const Job& job);
+  void finishWrite(const std::string& sceneName, bool ok);
+  // Moves the queued job matching (sceneName, bankIndex) to the back, or
+  // appends a new one. Jobs keep their order so older data never lands last.
+  Job& queueJobLocked(const std::string& sceneName, int bankIndex);
+  // Looks for the newest queued copy of a bank. Returns 1 when found, 0 when
+  // storage has it, -1 when it is redirected to 'sceneName' (a snapshot saved
+  // under a new name whose bank still lives in the scene it came from).
+  int findQueuedBankLocked(std::string& sceneName, int bankIndex, SceneBank& out) const;
+
+  SceneStorage* storage_;
+  std::vector<Job> queue_;
+  Job writing_;
+  bool isWriting_ = false;
+  Status status_;
+
+#ifdef MINIACID_ASYNC_SCENE_WRITER
+  void startThreadLocked();
+  void threadLoop();
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::thread thread_;
+  bool stopRequested_ = false;
+#endif
+};
@@ -1,7 +1,97 @@
 #include "ArduinoJson-v7.4.2.h"
 #include "scenes.h"
 
+#include <atomic>
 #include <memory>
+#include <new>
+
+void Song::setLength(int length) {
+  if (length < 1) length = 1;
+  if (length > kMaxPositions) length = kMaxPositions;
+  if (length < length_) {
+    int firstFree = (length + kChunkRows - 1) / kChunkRows;
+    for (int row = length; row < firstFree * kChunkRows; ++row) {
+      for (int t = 0; t < kTrackCount; ++t) setPattern(row, t, -1);
+    }
+    for (int c = firstFree; c < kChunks; ++c) chunks_[c].reset();
+  }
+  length_ = length;
+}
+
+Song::Chunk* Song::writableChunk(int index) {
+  std::shared_ptr<Chunk>& chunk = chunks_[index];
+  if (!chunk) {
+    chunk = std::make_shared<Chunk>();
+    std::memset(chunk->patterns, -1, sizeof(chunk->patterns));
+  } else if (chunk.use_count() > 1) {
+    chunk = std::make_shared<Chunk>(*chunk);
+  }
+  return chunk.get();
+}
+
+void Song::setPattern(int row, int track, int pattern) {
+  if (row < 0 || row >= kMaxPositions || track < 0 || track >= kTrackCount) return;
+  if (pattern < 0) {
+    if (!chunks_[row / kChunkRows]) return;
+    pattern = -1;
+  }
+  if (this->pattern(row, track) == pattern) return;
+  writableChunk(row / kChunkRows)->patterns[row % kChunkRows][track] = static_cast<int8_t>(pattern);
+}
+
+void Song::clear() {
+  for (int c = 0; c < kChunks; ++c) chunks_[c].reset();
+  length_ = 1;
+}
+
+void Song::copyRange(const Song& src, int srcRow, int dstRow, int rows,
+                     int srcTrack, int dstTrack, int tracks) {
+  if (rows <= 0 || tracks <= 0) return;
+  bool wholeChunks = srcTrack == 0 && dstTrack == 0 && tracks == kTrackCount &&
+                     srcRow % kChunkRows == 0 && dstRow % kChunkRows == 0;
+  // Walk backwards when copying down within the same song.
+  bool backwards = &src == this && dstRow > srcRow;
+  int r = backwards ? rows - 1 : 0;
+  int step = backwards ? -1 : 1;
+  for (; r >= 0 && r < rows; r += step) {
+    int from = srcRow + r;
+    int to = dstRow + r;
+    if (to < 0 || to >= kMaxPositions) continue;
+    if (wholeChunks && to % kChunkRows == 0 && r + kChunkRows <= rows && !backwards &&
+        to + kChunkRows <= kMaxPositions && from >= 0 && from + kChunkRows <= kMaxPositions) {
+      chunks_[to / kChunkRows] = src.chunks_[from / kChunkRows];
+      r += kChunkRows - 1;
+      continue;
+    }
+    for (int t = 0; t < tracks; ++t) {
+      setPattern(to, dstTrack + t, src.pattern(from, srcTrack + t));
+    }
+  }
+}
+
+int Song::lastUsedRow(int end) const {
+  if (end > kMaxPositions) end = kMaxPositions;
+  for (int c = (end - 1) / kChunkRows; c >= 0; --c) {
+    const Chunk* chunk = chunks_[c].get();
+    if (!chunk) continue;
+    int last = c * kChunkRows + kChunkRows - 1;
+    if (last >= end) last = end - 1;
+    for (int row = last; row >= c * kChunkRows; --row) {
+      for (int t = 0; t < kTrackCount; ++t) {
+        if (chunk->patterns[row % kChunkRows][t] >= 0) return row;
+      }
+    }
+  }
+  return -1;
+}
+
+size_t Song::allocatedBytes() const {
+  size_t bytes = 0;
+  for (int c = 0; c < kChunks; ++c) {
+    if (chunks_[c]) bytes += sizeof(Chunk);
+  }
+  return bytes;
+}
 
 namespace {
 int clampIndex(int value, int maxExclusive) {
@@ -11,10 +101,14 @@ int clampIndex(int value, int maxExclusive) {
 }
 
 void clearDrumPattern(DrumPattern& pattern) {
-  for (int i = 0; i < DrumPattern::kSteps; ++i) {
-    pattern.steps[i].hit = false;
-    pattern.steps[i].accent = false;
-  }
+  pattern.hits = 0;
+  pattern.accents = 0;
+}
+
+int8_t clampStepNote(int note) {
+  if (note < -1) return -1;
+  if (note > 127) return 127;
+  return static_cast<int8_t>(note);
 }
 
 void clearSynthPattern(SynthPattern& pattern) {
@@ -26,77 +120,54 @@ void clearSynthPattern(SynthPattern& pattern) {
 }
 
 void clearSong(Song& song) {
-  song.length = 1;
-  for (int i = 0; i < Song::kMaxPositions; ++i) {
-    for (int t = 0; t < SongPosition::kTrackCount; ++t) {
-      song.positions[i].patterns[t] = -1;
-    }
-  }
+  song.clear();
 }
 
 void clearSceneData(Scene& scene) {
-  for (int b = 0; b < kBankCount; ++b) {
-    for (int p = 0; p < Bank<DrumPatternSet>::kPatterns; ++p) {
-      for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
-        clearDrumPattern(scene.drumBanks[b].patterns[p].voices[v]);
-      }
-    }
-    for (int p = 0; p < Bank<SynthPattern>::kPatterns; ++p) {
-      clearSynthPattern(scene.synthABanks[b].patterns[p]);
-      clearSynthPattern(scene.synthBBanks[b].patterns[p]);
-    }
+  for (int i = 0; i < kResidentBankCount; ++i) {
+    scene.banks[i].bank.store(-1, std::memory_order_release);
+    scene.banks[i].dirty = false;
+    scene.banks[i].lastUse = 0;
   }
   clearSong(scene.song);
 }
 
-void serializeDrumPattern(const DrumPattern& pattern, ArduinoJson::JsonObject obj) {
-  ArduinoJson::JsonArray hit = obj["hit"].to<ArduinoJson::JsonArray>();
-  ArduinoJson::JsonArray accent = obj["accent"].to<ArduinoJson::JsonArray>();
-  for (int i = 0; i < DrumPattern::kSteps; ++i) {
-    hit.add(pattern.steps[i].hit);
-    accent.add(pattern.steps[i].accent);
-  }
+SynthPattern makeEmptySynthPattern() {
+  SynthPattern pattern;
+  clearSynthPattern(pattern);
+  return pattern;
 }
 
-void serializeDrumBank(const Bank<DrumPatternSet>& bank, ArduinoJson::JsonArray patterns) {
-  for (int p = 0; p < Bank<DrumPatternSet>::kPatterns; ++p) {
-    ArduinoJson::JsonArray voices = patterns.add<ArduinoJson::JsonArray>();
-    for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
-      ArduinoJson::JsonObject voice = voices.add<ArduinoJson::JsonObject>();
-      serializeDrumPattern(bank.patterns[p].voices[v], voice);
-    }
-  }
-}
+// Stand-ins for banks that are not resident yet.
+const DrumPatternSet kEmptyDrumPatternSet{};
+const SynthPattern kEmptySynthPattern = makeEmptySynthPattern();
 
-void serializeDrumBanks(const Bank<DrumPatternSet>* banks, ArduinoJson::JsonArray banksArr) {
-  for (int b = 0; b < kBankCount; ++b) {
-    ArduinoJson::JsonArray patterns = banksArr.add<ArduinoJson::JsonArray>();
-    serializeDrumBank(banks[b], patterns);
+// Slot for a bank stored inline in an older scene file. These are marked
+// dirty so the next save moves them into bank segments.
+SceneBank* claimLoadedBank(Scene& scene, int bankIndex) {
+  SceneBankSlot* freeSlot = nullptr;
+  for (int i = 0; i < kResidentBankCount; ++i) {
+    int8_t bank = scene.banks[i].bank.load(std::memory_order_acquire);
+    if (bank == bankIndex) return &scene.banks[i].data;
+    if (!freeSlot && bank < 0) freeSlot = &scene.banks[i];
   }
+  if (!freeSlot) return nullptr;
+  clearSceneBank(freeSlot->data);
+  freeSlot->dirty = true;
+  freeSlot->bank.store(static_cast<int8_t>(bankIndex), std::memory_order_release);
+  return &freeSlot->data;
 }
 
-void serializeSynthPattern(const SynthPattern& pattern, ArduinoJson::JsonArray steps) {
-  for (int i = 0; i < SynthPattern::kSteps; ++i) {
-    ArduinoJson::JsonObject step = steps.add<ArduinoJson::JsonObject>();
-    step["note"] = pattern.steps[i].note;
-    step["slide"] = pattern.steps[i].slide;
-    step["accent"] = pattern.steps[i].accent;
-  }
+void writeU16(uint8_t* out, uint16_t value) {
+  out[0] = static_cast<uint8_t>(value & 0xFF);
+  out[1] = static_cast<uint8_t>(value >> 8);
 }
 
-void serializeSynthBank(const Bank<SynthPattern>& bank, ArduinoJson::JsonArray patterns) {
-  for (int p = 0; p < Bank<SynthPattern>::kPatterns; ++p) {
-    ArduinoJson::JsonArray steps = patterns.add<ArduinoJson::JsonArray>();
-    serializeSynthPattern(bank.patterns[p], steps);
-  }
+uint16_t readU16(const uint8_t* in) {
+  return static_cast<uint16_t>(in[0] | (in[1] << 8));
 }
 
-void serializeSynthBanks(const Bank<SynthPattern>* banks, ArduinoJson::JsonArray banksArr) {
-  for (int b = 0; b < kBankCount; ++b) {
-    ArduinoJson::JsonArray patterns = banksArr.add<ArduinoJson::JsonArray>();
-    serializeSynthBank(banks[b], patterns);
-  }
-}
+constexpr uint8_t kBankSegmentMagic[4] = {'M', 'A', 'B', '1'};
 
 bool deserializeBoolArray(ArduinoJson::JsonArrayConst arr, bool* dst, int expectedSize) {
   if (static_cast<int>(arr.size()) != expectedSize) return false;
@@ -119,8 +190,8 @@ bool deserializeDrumPattern(ArduinoJson::JsonVariantConst value, DrumPattern& pa
   if (!deserializeBoolArray(hit, hits, DrumPattern::kSteps)) return false;
   if (!deserializeBoolArray(accent, accents, DrumPattern::kSteps)) return false;
   for (int i = 0; i < DrumPattern::kSteps; ++i) {
-    pattern.steps[i].hit = hits[i];
-    pattern.steps[i].accent = accents[i];
+    pattern.setHit(i, hits[i]);
+    pattern.setAccent(i, accents[i]);
   }
   return true;
 }
@@ -147,16 +218,18 @@ bool deserializeDrumBank(ArduinoJson::JsonVariantConst value, Bank<DrumPatternSe
   return true;
 }
 
-bool deserializeDrumBanks(ArduinoJson::JsonVariantConst value, Bank<DrumPatternSet>* banks) {
+bool deserializeDrumBanks(ArduinoJson::JsonVariantConst value, Scene& scene) {
   ArduinoJson::JsonArrayConst banksArr = value.as<ArduinoJson::JsonArrayConst>();
   if (banksArr.isNull()) return false;
   if (static_cast<int>(banksArr.size()) == Bank<DrumPatternSet>::kPatterns) {
-    return deserializeDrumBank(value, banks[0]);
+    SceneBank* bank = claimLoadedBank(scene, 0);
+    return bank && deserializeDrumBank(value, bank->drums);
   }
-  if (static_cast<int>(banksArr.size()) != kBankCount) return false;
+  if (static_cast<int>(banksArr.size()) > kBankCount) return false;
   int b = 0;
   for (ArduinoJson::JsonVariantConst bankVal : banksArr) {
-    if (!deserializeDrumBank(bankVal, banks[b])) return false;
+    SceneBank* bank = claimLoadedBank(scene, b);
+    if (!bank || !deserializeDrumBank(bankVal, bank->drums)) return false;
     ++b;
   }
   return true;
@@ -173,7 +246,7 @@ bool deserializeSynthPattern(ArduinoJson::JsonVariantConst value, SynthPattern&
     auto slide = obj["slide"];
     auto accent = obj["accent"];
     if (!note.is<int>() || !slide.is<bool>() || !accent.is<bool>()) return false;
-    pattern.steps[i].note = note.as<int>();
+    pattern.steps[i].note = clampStepNote(note.as<int>());
     pattern.steps[i].slide = slide.as<bool>();
     pattern.steps[i].accent = accent.as<bool>();
     ++i;
@@ -192,16 +265,18 @@ bool deserializeSynthBank(ArduinoJson::JsonVariantConst value, Bank<SynthPattern
   return true;
 }
 
-bool deserializeSynthBanks(ArduinoJson::JsonVariantConst value, Bank<SynthPattern>* banks) {
+bool deserializeSynthBanks(ArduinoJson::JsonVariantConst value, Scene& scene, bool synthB) {
   ArduinoJson::JsonArrayConst banksArr = value.as<ArduinoJson::JsonArrayConst>();
   if (banksArr.isNull()) return false;
   if (static_cast<int>(banksArr.size()) == Bank<SynthPattern>::kPatterns) {
-    return deserializeSynthBank(value, banks[0]);
+    SceneBank* bank = claimLoadedBank(scene, 0);
+    return bank && deserializeSynthBank(value, synthB ? bank->synthB : bank->synthA);
   }
-  if (static_cast<int>(banksArr.size()) != kBankCount) return false;
+  if (static_cast<int>(banksArr.size()) > kBankCount) return false;
   int b = 0;
   for (ArduinoJson::JsonVariantConst bankVal : banksArr) {
-    if (!deserializeSynthBank(bankVal, banks[b])) return false;
+    SceneBank* bank = claimLoadedBank(scene, b);
+    if (!bank || !deserializeSynthBank(bankVal, synthB ? bank->synthB : bank->synthA)) return false;
     ++b;
   }
   return true;
@@ -282,6 +357,8 @@ SceneJsonObserver::Path SceneJsonObserver::deduceArrayPath(const Context& parent
     return Path::SynthDelay;
   case Path::Song:
     return Path::SongPosition;
+  case Path::SongTracks:
+    return Path::SongTrackRuns;
   default:
     return Path::Unknown;
   }
@@ -384,6 +461,7 @@ void SceneJsonObserver::onArrayStart() {
         else if (lastKey_ == "synthBBank") path = Path::SynthBBank;
       } else if (parent.path == Path::Song) {
         if (lastKey_ == "positions") path = Path::SongPositions;
+        else if (lastKey_ == "tracks") path = Path::SongTracks;
         else if (lastKey_ == "synthDistortion") path = Path::SynthDistortion;
         else if (lastKey_ == "synthDelay") path = Path::SynthDelay;
       } else if (parent.path == Path::DrumVoice) {
@@ -420,8 +498,7 @@ void SceneJsonObserver::handlePrimitiveNumber(double value, bool isInteger) {
     if (lastKey_ == "length") {
       int len = static_cast<int>(value);
       if (len < 1) len = 1;
-      if (len > Song::kMaxPositions) len = Song::kMaxPositions;
-      song_.length = len;
+      song_.setLength(len);
       hasSong_ = true;
     }
     return;
@@ -436,13 +513,29 @@ void SceneJsonObserver::handlePrimitiveNumber(double value, bool isInteger) {
     if (lastKey_ == "a") trackIdx = 0;
     else if (lastKey_ == "b") trackIdx = 1;
     else if (lastKey_ == "drums") trackIdx = 2;
-    if (trackIdx >= 0 && trackIdx < SongPosition::kTrackCount) {
-      song_.positions[posIdx].patterns[trackIdx] = clampSongPatternIndex(static_cast<int>(value));
-      if (posIdx + 1 > song_.length) song_.length = posIdx + 1;
+    if (trackIdx >= 0 && trackIdx < Song::kTrackCount) {
+      if (posIdx + 1 > song_.length()) song_.setLength(posIdx + 1);
+      song_.setPattern(posIdx, trackIdx, clampSongPatternIndex(static_cast<int>(value)));
       hasSong_ = true;
     }
     return;
   }
+  if (path == Path::SongTrackRuns) {
+    int trackIdx = currentIndexFor(Path::SongTracks);
+    int idx = stack_[stackSize_ - 1].index;
+    if (trackIdx < 0 || trackIdx >= Song::kTrackCount) return;
+    if (idx % 2 == 0) {
+      if (idx == 0) runRow_ = 0;
+      runPattern_ = clampSongPatternIndex(static_cast<int>(value));
+      return;
+    }
+    int end = runRow_ + static_cast<int>(value);
+    if (end > Song::kMaxPositions) end = Song::kMaxPositions;
+    if (runPattern_ >= 0 && end > song_.length()) song_.setLength(end);
+    for (; runRow_ < end; ++runRow_) song_.setPattern(runRow_, trackIdx, runPattern_);
+    hasSong_ = true;
+    return;
+  }
   if (path == Path::DrumHitArray || path == Path::DrumAccentArray ||
       path == Path::MuteDrums || path == Path::MuteSynth || path == Path::SynthDistortion ||
       path == Path::SynthDelay) {
@@ -471,10 +564,15 @@ void SceneJsonObserver::handlePrimitiveNumber(double value, bool isInteger) {
       error_ = true;
       return;
     }
-    SynthPattern& pattern = useBankB ? target_.synthBBanks[bankIdx].patterns[patternIdx]
-                                     : target_.synthABanks[bankIdx].patterns[patternIdx];
+    SceneBank* bank = claimLoadedBank(target_, bankIdx);
+    if (!bank) {
+      error_ = true;
+      return;
+    }
+    SynthPattern& pattern = useBankB ? bank->synthB.patterns[patternIdx]
+                                     : bank->synthA.patterns[patternIdx];
     if (lastKey_ == "note") {
-      pattern.steps[stepIdx].note = static_cast<int>(value);
+      pattern.steps[stepIdx].note = clampStepNote(static_cast<int>(value));
     } else if (lastKey_ == "slide") {
       pattern.steps[stepIdx].slide = value != 0;
     } else if (lastKey_ == "accent") {
@@ -507,6 +605,10 @@ void SceneJsonObserver::handlePrimitiveNumber(double value, bool isInteger) {
       bpm_ = static_cast<float>(value);
       return;
     }
+    if (lastKey_ == "swing") {
+      swing_ = static_cast<float>(value);
+      return;
+    }
     if (lastKey_ == "songPosition") {
       songPosition_ = static_cast<int>(value);
       return;
@@ -552,11 +654,16 @@ void SceneJsonObserver::handlePrimitiveBool(bool value) {
       error_ = true;
       return;
     }
-    DrumStep& step = target_.drumBanks[bankIdx].patterns[patternIdx].voices[voiceIdx].steps[stepIdx];
+    SceneBank* bank = claimLoadedBank(target_, bankIdx);
+    if (!bank) {
+      error_ = true;
+      return;
+    }
+    DrumPattern& pattern = bank->drums.patterns[patternIdx].voices[voiceIdx];
     if (path == Path::DrumHitArray) {
-      step.hit = value;
+      pattern.setHit(stepIdx, value);
     } else {
-      step.accent = value;
+      pattern.setAccent(stepIdx, value);
     }
     return;
   }
@@ -611,8 +718,13 @@ void SceneJsonObserver::handlePrimitiveBool(bool value) {
       error_ = true;
       return;
     }
-    SynthPattern& pattern = useBankB ? target_.synthBBanks[bankIdx].patterns[patternIdx]
-                                     : target_.synthABanks[bankIdx].patterns[patternIdx];
+    SceneBank* bank = claimLoadedBank(target_, bankIdx);
+    if (!bank) {
+      error_ = true;
+      return;
+    }
+    SynthPattern& pattern = useBankB ? bank->synthB.patterns[patternIdx]
+                                     : bank->synthA.patterns[patternIdx];
     if (lastKey_ == "slide") {
       pattern.steps[stepIdx].slide = value;
     } else if (lastKey_ == "accent") {
@@ -699,6 +811,8 @@ const SynthParameters& SceneJsonObserver::synthParameters(int synthIdx) const {
 
 float SceneJsonObserver::bpm() const { return bpm_; }
 
+float SceneJsonObserver::swing() const { return swing_; }
+
 const Song& SceneJsonObserver::song() const { return song_; }
 
 bool SceneJsonObserver::hasSong() const { return hasSong_; }
@@ -731,30 +845,22 @@ void SceneManager::loadDefaultScene() {
   synthDelay_[1] = false;
   synthParameters_[0] = SynthParameters();
   synthParameters_[1] = SynthParameters();
-  drumEngineName_ = "808";
+  drumEngineName_ = kDefaultDrumEngineName;
   setBpm(100.0f);
+  setSwing(0.0f);
   songMode_ = false;
   songPosition_ = 0;
   loopMode_ = false;
   loopStartRow_ = 0;
   loopEndRow_ = 0;
-  clearSongData(scene_.song);
-  scene_.song.length = 1;
-  scene_.song.positions[0].patterns[0] = 0;
-  scene_.song.positions[0].patterns[1] = 0;
-  scene_.song.positions[0].patterns[2] = 0;
-
-  for (int b = 0; b < kBankCount; ++b) {
-    for (int i = 0; i < Bank<DrumPatternSet>::kPatterns; ++i) {
-      for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
-        clearDrumPattern(scene_.drumBanks[b].patterns[i].voices[v]);
-      }
-    }
-    for (int i = 0; i < Bank<SynthPattern>::kPatterns; ++i) {
-      clearSynthPattern(scene_.synthABanks[b].patterns[i]);
-      clearSynthPattern(scene_.synthBBanks[b].patterns[i]);
-    }
-  }
+  // A new scene starts out empty; only bank A is filled in below.
+  clearSceneData(scene_);
+  bankSceneName_.clear();
+  scene_.song.setLength(1);
+  scene_.song.setPattern(0, 0, 0);
+  scene_.song.setPattern(0, 1, 0);
+  scene_.song.setPattern(0, 2, 0);
+  SceneBank& bank = *claimLoadedBank(scene_, 0);
 
   int8_t notes[SynthPattern::kSteps] = {48, 48, 55, 55, 50, 50, 55, 55,
                                         48, 48, 55, 55, 50, 55, 50, -1};
@@ -801,13 +907,13 @@ void SceneManager::loadDefaultScene() {
                                     false, false, false, false, true,  false, false, false};
 
   for (int i = 0; i < SynthPattern::kSteps; ++i) {
-    scene_.synthABanks[0].patterns[0].steps[i].note = notes[i];
-    scene_.synthABanks[0].patterns[0].steps[i].accent = accent[i];
-    scene_.synthABanks[0].patterns[0].steps[i].slide = slide[i];
+    bank.synthA.patterns[0].steps[i].note = notes[i];
+    bank.synthA.patterns[0].steps[i].accent = accent[i];
+    bank.synthA.patterns[0].steps[i].slide = slide[i];
 
-    scene_.synthBBanks[0].patterns[0].steps[i].note = notes2[i];
-    scene_.synthBBanks[0].patterns[0].steps[i].accent = accent2[i];
-    scene_.synthBBanks[0].patterns[0].steps[i].slide = slide2[i];
+    bank.synthB.patterns[0].steps[i].note = notes2[i];
+    bank.synthB.patterns[0].steps[i].accent = accent2[i];
+    bank.synthB.patterns[0].steps[i].slide = slide2[i];
   }
 
   for (int i = 0; i < DrumPattern::kSteps; ++i) {
@@ -815,29 +921,29 @@ void SceneManager::loadDefaultScene() {
     if (openHat[i]) {
       hatVal = false;
     }
-    scene_.drumBanks[0].patterns[0].voices[0].steps[i].hit = kick[i];
-    scene_.drumBanks[0].patterns[0].voices[0].steps[i].accent = kick[i];
+    bank.drums.patterns[0].voices[0].setHit(i, kick[i]);
+    bank.drums.patterns[0].voices[0].setAccent(i, kick[i]);
 
-    scene_.drumBanks[0].patterns[0].voices[1].steps[i].hit = snare[i];
-    scene_.drumBanks[0].patterns[0].voices[1].steps[i].accent = snare[i];
+    bank.drums.patterns[0].voices[1].setHit(i, snare[i]);
+    bank.drums.patterns[0].voices[1].setAccent(i, snare[i]);
 
-    scene_.drumBanks[0].patterns[0].voices[2].steps[i].hit = hatVal;
-    scene_.drumBanks[0].patterns[0].voices[2].steps[i].accent = hatVal;
+    bank.drums.patterns[0].voices[2].setHit(i, hatVal);
+    bank.drums.patterns[0].voices[2].setAccent(i, hatVal);
 
-    scene_.drumBanks[0].patterns[0].voices[3].steps[i].hit = openHat[i];
-    scene_.drumBanks[0].patterns[0].voices[3].steps[i].accent = openHat[i];
+    bank.drums.patterns[0].voices[3].setHit(i, openHat[i]);
+    bank.drums.patterns[0].voices[3].setAccent(i, openHat[i]);
 
-    scene_.drumBanks[0].patterns[0].voices[4].steps[i].hit = midTom[i];
-    scene_.drumBanks[0].patterns[0].voices[4].steps[i].accent = midTom[i];
+    bank.drums.patterns[0].voices[4].setHit(i, midTom[i]);
+    bank.drums.patterns[0].voices[4].setAccent(i, midTom[i]);
 
-    scene_.drumBanks[0].patterns[0].voices[5].steps[i].hit = highTom[i];
-    scene_.drumBanks[0].patterns[0].voices[5].steps[i].accent = highTom[i];
+    bank.drums.patterns[0].voices[5].setHit(i, highTom[i]);
+    bank.drums.patterns[0].voices[5].setAccent(i, highTom[i]);
 
-    scene_.drumBanks[0].patterns[0].voices[6].steps[i].hit = rim[i];
-    scene_.drumBanks[0].patterns[0].voices[6].steps[i].accent = rim[i];
+    bank.drums.patterns[0].voices[6].setHit(i, rim[i]);
+    bank.drums.patterns[0].voices[6].setAccent(i, rim[i]);
 
-    scene_.drumBanks[0].patterns[0].voices[7].steps[i].hit = clap[i];
-    scene_.drumBanks[0].patterns[0].voices[7].steps[i].accent = clap[i];
+    bank.drums.patterns[0].voices[7].setHit(i, clap[i]);
+    bank.drums.patterns[0].voices[7].setAccent(i, clap[i]);
   }
 }
 
@@ -846,65 +952,299 @@ Scene& SceneManager::currentScene() { return scene_; }
 const Scene& SceneManager::currentScene() const { return scene_; }
 
 const DrumPatternSet& SceneManager::getCurrentDrumPattern() const {
-  int bank = clampBankIndex(drumBankIndex_);
-  return scene_.drumBanks[bank].patterns[clampPatternIndex(drumPatternIndex_)];
+  return getDrumPatternSet(drumPatternIndex_);
 }
 
-DrumPatternSet& SceneManager::editCurrentDrumPattern() {
-  int bank = clampBankIndex(drumBankIndex_);
-  return scene_.drumBanks[bank].patterns[clampPatternIndex(drumPatternIndex_)];
+DrumPatternSet* SceneManager::editCurrentDrumPattern() {
+  return editDrumPatternSet(drumPatternIndex_);
 }
 
 const SynthPattern& SceneManager::getCurrentSynthPattern(int synthIndex) const {
   int idx = clampSynthIndex(synthIndex);
-  int patternIndex = clampPatternIndex(synthPatternIndex_[idx]);
-  int bank = clampBankIndex(synthBankIndex_[idx]);
-  if (idx == 0) {
-    return scene_.synthABanks[bank].patterns[patternIndex];
-  }
-  return scene_.synthBBanks[bank].patterns[patternIndex];
+  return getSynthPattern(idx, synthPatternIndex_[idx]);
 }
 
-SynthPattern& SceneManager::editCurrentSynthPattern(int synthIndex) {
+SynthPattern* SceneManager::editCurrentSynthPattern(int synthIndex) {
   int idx = clampSynthIndex(synthIndex);
-  int patternIndex = clampPatternIndex(synthPatternIndex_[idx]);
-  int bank = clampBankIndex(synthBankIndex_[idx]);
-  if (idx == 0) {
-    return scene_.synthABanks[bank].patterns[patternIndex];
-  }
-  return scene_.synthBBanks[bank].patterns[patternIndex];
+  return editSynthPattern(idx, synthPatternIndex_[idx]);
 }
 
 const SynthPattern& SceneManager::getSynthPattern(int synthIndex, int patternIndex) const {
   int idx = clampSynthIndex(synthIndex);
   int pat = clampPatternIndex(patternIndex);
-  int bank = clampBankIndex(synthBankIndex_[idx]);
+  const SceneBank* bank = residentBank(clampBankIndex(synthBankIndex_[idx]));
+  if (!bank) return kEmptySynthPattern;
   if (idx == 0) {
-    return scene_.synthABanks[bank].patterns[pat];
+    return bank->synthA.patterns[pat];
   }
-  return scene_.synthBBanks[bank].patterns[pat];
+  return bank->synthB.patterns[pat];
 }
 
-SynthPattern& SceneManager::editSynthPattern(int synthIndex, int patternIndex) {
+SynthPattern* SceneManager::editSynthPattern(int synthIndex, int patternIndex) {
   int idx = clampSynthIndex(synthIndex);
   int pat = clampPatternIndex(patternIndex);
-  int bank = clampBankIndex(synthBankIndex_[idx]);
+  SceneBank* bank = editBank(clampBankIndex(synthBankIndex_[idx]));
+  if (!bank) return nullptr;
   if (idx == 0) {
-    return scene_.synthABanks[bank].patterns[pat];
+    return &bank->synthA.patterns[pat];
   }
-  return scene_.synthBBanks[bank].patterns[pat];
+  return &bank->synthB.patterns[pat];
 }
 
 const DrumPatternSet& SceneManager::getDrumPatternSet(int patternIndex) const {
   int pat = clampPatternIndex(patternIndex);
-  int bank = clampBankIndex(drumBankIndex_);
-  return scene_.drumBanks[bank].patterns[pat];
+  const SceneBank* bank = residentBank(clampBankIndex(drumBankIndex_));
+  if (!bank) return kEmptyDrumPatternSet;
+  return bank->drums.patterns[pat];
 }
 
-DrumPatternSet& SceneManager::editDrumPatternSet(int patternIndex) {
+DrumPatternSet* SceneManager::editDrumPatternSet(int patternIndex) {
   int pat = clampPatternIndex(patternIndex);
-  int bank = clampBankIndex(drumBankIndex_);
-  return scene_.drumBanks[bank].patterns[pat];
+  SceneBank* bank = editBank(clampBankIndex(drumBankIndex_));
+  if (!bank) return nullptr;
+  return &bank->drums.patterns[pat];
+}
+
+const SceneBank* SceneManager::residentBank(int bankIndex) const {
+  for (int i = 0; i < kResidentBankCount; ++i) {
+    if (scene_.banks[i].bank.load(std::memory_order_acquire) == bankIndex) {
+      return &scene_.banks[i].data;
+    }
+  }
+  return nullptr;
+}
+
+SceneBank* SceneManager::editBank(int bankIndex) {
+  // Edits only come from the UI, so paging in here is fine.
+  if (!ensureBankResident(bankIndex)) return nullptr;
+  for (int i = 0; i < kResidentBankCount; ++i) {
+    if (scene_.banks[i].bank.load(std::memory_order_acquire) == bankIndex) {
+      scene_.banks[i].dirty = true;
+      return &scene_.banks[i].data;
+    }
+  }
+  return nullptr;
+}
+
+void SceneManager::setBankStore(SceneBankStore* store, const std::string& sceneName) {
+  bankStore_ = store;
+  bankSceneName_ = sceneName;
+}
+
+void SceneManager::setBankReaders(const SceneBankReaders* readers) { bankReaders_ = readers; }
+
+const std::string& SceneManager::bankSceneName() const { return bankSceneName_; }
+
+bool SceneManager::isBankResident(int bankIndex) const { return residentBank(bankIndex) != nullptr; }
+
+uint32_t SceneManager::currentBanksMask() const {
+  return (1u << clampBankIndex(drumBankIndex_)) | (1u << clampBankIndex(synthBankIndex_[0])) |
+         (1u << clampBankIndex(synthBankIndex_[1]));
+}
+
+uint32_t SceneManager::residentBanksMask() const {
+  uint32_t mask = 0;
+  for (int i = 0; i < kResidentBankCount; ++i) {
+    int bank = scene_.banks[i].bank.load(std::memory_order_acquire);
+    if (bank >= 0) mask |= 1u << bank;
+  }
+  return mask;
+}
+
+void SceneManager::releaseCleanBanks() {
+  for (int i = 0; i < kResidentBankCount; ++i) {
+    if (!scene_.banks[i].dirty) scene_.banks[i].bank.store(-1, std::memory_order_release);
+  }
+}
+
+int SceneManager::freeBankSlot() {
+  int freeSlot = -1;
+  for (int i = 0; i < kResidentBankCount; ++i) {
+    SceneBankSlot& slot = scene_.banks[i];
+    if (slot.bank.load(std::memory_order_acquire) >= 0) continue;
+    if (slot.retiring) {
+      if (bankReaders_ && !bankReaders_->readsDone(slot.retireTicket)) continue;
+      slot.retiring = false;
+    }
+    if (freeSlot < 0) freeSlot = i;
+  }
+  return freeSlot;
+}
+
+bool SceneManager::retireBankSlot(uint32_t keepMask) {
+  bool canWriteBack = bankStore_ && !bankSceneName_.empty();
+  int victim = -1;
+  for (int i = 0; i < kResidentBankCount; ++i) {
+    const SceneBankSlot& slot = scene_.banks[i];
+    int bank = slot.bank.load(std::memory_order_acquire);
+    if (bank < 0) continue;
+    if (keepMask & (1u << bank)) continue;
+    if (slot.dirty && !canWriteBack) continue;
+    if (victim < 0 || slot.lastUse < scene_.banks[victim].lastUse) victim = i;
+  }
+  if (victim < 0) return false;
+
+  SceneBankSlot& slot = scene_.banks[victim];
+  int evicted = slot.bank.load(std::memory_order_acquire);
+  if (slot.dirty) {
+    if (!bankStore_->writeBank(bankSceneName_, evicted, slot.data)) return false;
+    slot.dirty = false;
+  }
+  slot.bank.store(-1, std::memory_order_seq_cst);
+  if (bankReaders_) {
+    slot.retiring = true;
+    slot.retireTicket = bankReaders_->readTicket();
+  }
+  return true;
+}
+
+bool SceneManager::ensureBankResident(int bankIndex, uint32_t keepMask) {
+  if (bankIndex < 0 || bankIndex >= kBankCount) return false;
+  for (int i = 0; i < kResidentBankCount; ++i) {
+    if (scene_.banks[i].bank.load(std::memory_order_acquire) == bankIndex) {
+      scene_.banks[i].lastUse = ++bankClock_;
+      return true;
+    }
+  }
+
+  keepMask |= currentBanksMask();
+  if (bankReaders_) keepMask |= bankReaders_->pinnedBanks();
+  int slotIndex = freeBankSlot();
+  if (slotIndex < 0) {
+    // The slot is reused once readers are done with it, possibly right away.
+    if (!retireBankSlot(keepMask)) return false;
+    slotIndex = freeBankSlot();
+    if (slotIndex < 0) return false;
+  }
+
+  SceneBankSlot& slot = scene_.banks[slotIndex];
+  if (!bankStore_ || bankSceneName_.empty() ||
+      !bankStore_->readBank(bankSceneName_, bankIndex, slot.data)) {
+    clearSceneBank(slot.data);
+  }
+  slot.dirty = false;
+  slot.lastUse = ++bankClock_;
+  slot.bank.store(static_cast<int8_t>(bankIndex), std::memory_order_release);
+
+  // Start freeing the next slot now, so the next bank does not have to wait.
+  if (bankReaders_ && freeBankSlot() < 0) {
+    bool retiring = false;
+    for (int i = 0; i < kResidentBankCount; ++i) retiring = retiring || scene_.banks[i].retiring;
+    if (!retiring) retireBankSlot(keepMask | (1u << bankIndex));
+  }
+  return true;
+}
+
+bool SceneManager::writeBanks(SceneBankStore& store, const std::string& sceneName) const {
+  bool sameScene = bankSceneName_ == sceneName;
+  std::unique_ptr<SceneBank> copy;
+  for (int b = 0; b < kBankCount; ++b) {
+    const SceneBankSlot* slot = nullptr;
+    for (int i = 0; i < kResidentBankCount; ++i) {
+      if (scene_.banks[i].bank.load(std::memory_order_acquire) == b) slot = &scene_.banks[i];
+    }
+    if (slot) {
+      if (sameScene && !slot->dirty) continue;
+      if (!store.writeBank(sceneName, b, slot->data)) return false;
+      continue;
+    }
+    if (sameScene) continue;
+    // Saved under a new name: carry over the banks that were never paged in.
+    if (!copy) copy = std::make_unique<SceneBank>();
+    if (bankSceneName_.empty() || !store.readBank(bankSceneName_, b, *copy)) {
+      clearSceneBank(*copy);
+    }
+    if (!store.writeBank(sceneName, b, *copy)) return false;
+  }
+  return true;
+}
+
+void SceneManager::markBanksSaved(const std::string& sceneName) {
+  bankSceneName_ = sceneName;
+  for (int i = 0; i < kResidentBankCount; ++i) scene_.banks[i].dirty = false;
+}
+
+void clearSceneBank(SceneBank& bank) {
+  for (int p = 0; p < Bank<DrumPatternSet>::kPatterns; ++p) {
+    for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
+      clearDrumPattern(bank.drums.patterns[p].voices[v]);
+    }
+  }
+  for (int p = 0; p < Bank<SynthPattern>::kPatterns; ++p) {
+    clearSynthPattern(bank.synthA.patterns[p]);
+    clearSynthPattern(bank.synthB.patterns[p]);
+  }
+}
+
+bool MemoryBankStore::readBank(const std::string&, int bankIndex, SceneBank& out) {
+  if (!hasBank(bankIndex)) return false;
+  out = *banks_[bankIndex];
+  return true;
+}
+
+bool MemoryBankStore::writeBank(const std::string&, int bankIndex, const SceneBank& bank) {
+  if (bankIndex < 0 || bankIndex >= kBankCount) return false;
+  if (!banks_[bankIndex]) banks_[bankIndex].reset(new (std::nothrow) SceneBank());
+  if (!banks_[bankIndex]) return false;
+  *banks_[bankIndex] = bank;
+  return true;
+}
+
+bool MemoryBankStore::hasBank(int bankIndex) const {
+  return bankIndex >= 0 && bankIndex < kBankCount && banks_[bankIndex];
+}
+
+void SceneBankSegment::encode(const SceneBank& bank, uint8_t* out) {
+  std::memcpy(out, kBankSegmentMagic, sizeof(kBankSegmentMagic));
+  uint8_t* cursor = out + sizeof(kBankSegmentMagic);
+  for (int p = 0; p < Bank<DrumPatternSet>::kPatterns; ++p) {
+    for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
+      const DrumPattern& pattern = bank.drums.patterns[p].voices[v];
+      writeU16(cursor, pattern.hits);
+      writeU16(cursor + 2, pattern.accents);
+      cursor += 4;
+    }
+  }
+  const Bank<SynthPattern>* synths[2] = {&bank.synthA, &bank.synthB};
+  for (const Bank<SynthPattern>* synth : synths) {
+    for (int p = 0; p < Bank<SynthPattern>::kPatterns; ++p) {
+      for (int i = 0; i < SynthPattern::kSteps; ++i) {
+        const SynthStep& step = synth->patterns[p].steps[i];
+        cursor[0] = static_cast<uint8_t>(clampStepNote(step.note));
+        cursor[1] = static_cast<uint8_t>((step.slide ? 1 : 0) | (step.accent ? 2 : 0));
+        cursor += 2;
+      }
+    }
+  }
+}
+
+bool SceneBankSegment::decode(const uint8_t* in, SceneBank& bank) {
+  if (std::memcmp(in, kBankSegmentMagic, sizeof(kBankSegmentMagic)) != 0) {
+    clearSceneBank(bank);
+    return false;
+  }
+  const uint8_t* cursor = in + sizeof(kBankSegmentMagic);
+  for (int p = 0; p < Bank<DrumPatternSet>::kPatterns; ++p) {
+    for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
+      DrumPattern& pattern = bank.drums.patterns[p].voices[v];
+      pattern.hits = readU16(cursor);
+      pattern.accents = readU16(cursor + 2);
+      cursor += 4;
+    }
+  }
+  Bank<SynthPattern>* synths[2] = {&bank.synthA, &bank.synthB};
+  for (Bank<SynthPattern>* synth : synths) {
+    for (int p = 0; p < Bank<SynthPattern>::kPatterns; ++p) {
+      for (int i = 0; i < SynthPattern::kSteps; ++i) {
+        SynthStep& step = synth->patterns[p].steps[i];
+        step.note = static_cast<int8_t>(cursor[0]);
+        step.slide = (cursor[1] & 1) != 0;
+        step.accent = (cursor[1] & 2) != 0;
+        cursor += 2;
+      }
+    }
+  }
+  return true;
 }
 
 void SceneManager::setCurrentDrumPatternIndex(int idx) {
@@ -985,6 +1325,14 @@ void SceneManager::setBpm(float bpm) {
 
 float SceneManager::getBpm() const { return bpm_; }
 
+void SceneManager::setSwing(float swing) {
+  if (swing < 0.0f) swing = 0.0f;
+  if (swing > 1.0f) swing = 1.0f;
+  swing_ = swing;
+}
+
+float SceneManager::getSwing() const { return swing_; }
+
 const Song& SceneManager::song() const { return scene_.song; }
 
 Song& SceneManager::editSong() { return scene_.song; }
@@ -994,38 +1342,51 @@ void SceneManager::setSongPattern(int position, SongTrack track, int patternInde
   if (pos < 0) pos = 0;
   if (pos >= Song::kMaxPositions) pos = Song::kMaxPositions - 1;
   int trackIdx = songTrackToIndex(track);
-  if (trackIdx < 0 || trackIdx >= SongPosition::kTrackCount) return;
+  if (trackIdx < 0 || trackIdx >= Song::kTrackCount) return;
   int pat = clampSongPatternIndex(patternIndex);
-  if (pos >= scene_.song.length) setSongLength(pos + 1);
-  scene_.song.positions[pos].patterns[trackIdx] = static_cast<int8_t>(pat);
+  if (pos >= scene_.song.length()) setSongLength(pos + 1);
+  scene_.song.setPattern(pos, trackIdx, pat);
 }
 
 void SceneManager::clearSongPattern(int position, SongTrack track) {
   int pos = clampSongPosition(position);
   int trackIdx = songTrackToIndex(track);
-  if (trackIdx < 0 || trackIdx >= SongPosition::kTrackCount) return;
-  scene_.song.positions[pos].patterns[trackIdx] = -1;
+  if (trackIdx < 0 || trackIdx >= Song::kTrackCount) return;
+  scene_.song.setPattern(pos, trackIdx, -1);
   trimSongLength();
 }
 
 int SceneManager::songPattern(int position, SongTrack track) const {
   if (position < 0 || position >= Song::kMaxPositions) return -1;
   int trackIdx = songTrackToIndex(track);
-  if (trackIdx < 0 || trackIdx >= SongPosition::kTrackCount) return -1;
-  if (position >= scene_.song.length) return -1;
-  return clampSongPatternIndex(scene_.song.positions[position].patterns[trackIdx]);
+  if (trackIdx < 0 || trackIdx >= Song::kTrackCount) return -1;
+  return clampSongPatternIndex(scene_.song.pattern(position, trackIdx));
+}
+
+void SceneManager::copySongRange(const Song& src, int srcRow, int dstRow, int rows,
+                                 int srcTrack, int dstTrack, int tracks) {
+  if (dstTrack < 0 || dstTrack >= Song::kTrackCount) return;
+  if (dstTrack + tracks > Song::kTrackCount) tracks = Song::kTrackCount - dstTrack;
+  if (dstRow + rows > Song::kMaxPositions) rows = Song::kMaxPositions - dstRow;
+  if (rows <= 0 || tracks <= 0 || dstRow < 0) return;
+  if (&src != &scene_.song) {
+    // Grow first so the rows being written are inside the song.
+    int end = dstRow + rows;
+    if (end > scene_.song.length()) scene_.song.setLength(end);
+  }
+  scene_.song.copyRange(src, srcRow, dstRow, rows, srcTrack, dstTrack, tracks);
+  trimSongLength();
 }
 
 void SceneManager::setSongLength(int length) {
-  int clamped = clampSongLength(length);
-  scene_.song.length = clamped;
-  if (songPosition_ >= scene_.song.length) songPosition_ = scene_.song.length - 1;
+  scene_.song.setLength(clampSongLength(length));
+  if (songPosition_ >= scene_.song.length()) songPosition_ = scene_.song.length() - 1;
   if (songPosition_ < 0) songPosition_ = 0;
   clampLoopRange();
 }
 
 int SceneManager::songLength() const {
-  int len = scene_.song.length;
+  int len = scene_.song.length();
   if (len < 1) len = 1;
   if (len > Song::kMaxPositions) len = Song::kMaxPositions;
   return len;
@@ -1079,45 +1440,47 @@ int SceneManager::getCurrentBankIndex(int instrumentId) const {
 }
 
 void SceneManager::setDrumStep(int voiceIdx, int step, bool hit, bool accent) {
-  DrumPatternSet& patternSet = editCurrentDrumPattern();
+  DrumPatternSet* patternSet = editCurrentDrumPattern();
+  if (!patternSet) return;
   int clampedVoice = clampIndex(voiceIdx, DrumPatternSet::kVoices);
   int clampedStep = clampIndex(step, DrumPattern::kSteps);
-  patternSet.voices[clampedVoice].steps[clampedStep].hit = hit;
-  patternSet.voices[clampedVoice].steps[clampedStep].accent = accent;
+  patternSet->voices[clampedVoice].setHit(clampedStep, hit);
+  patternSet->voices[clampedVoice].setAccent(clampedStep, accent);
 }
 
 void SceneManager::setSynthStep(int synthIdx, int step, int note, bool slide, bool accent) {
-  SynthPattern& pattern = editCurrentSynthPattern(synthIdx);
+  SynthPattern* pattern = editCurrentSynthPattern(synthIdx);
+  if (!pattern) return;
   int clampedStep = clampIndex(step, SynthPattern::kSteps);
-  pattern.steps[clampedStep].note = note;
-  pattern.steps[clampedStep].slide = slide;
-  pattern.steps[clampedStep].accent = accent;
+  pattern->steps[clampedStep].note = clampStepNote(note);
+  pattern->steps[clampedStep].slide = slide;
+  pattern->steps[clampedStep].accent = accent;
 }
 
 void SceneManager::buildSceneDocument(ArduinoJson::JsonDocument& doc) const {
   doc.clear();
   ArduinoJson::JsonObject root = doc.to<ArduinoJson::JsonObject>();
 
-  ArduinoJson::JsonArray drumBanks = root["drumBanks"].to<ArduinoJson::JsonArray>();
-  serializeDrumBanks(scene_.drumBanks, drumBanks);
-  ArduinoJson::JsonArray synthABanks = root["synthABanks"].to<ArduinoJson::JsonArray>();
-  serializeSynthBanks(scene_.synthABanks, synthABanks);
-  ArduinoJson::JsonArray synthBBanks = root["synthBBanks"].to<ArduinoJson::JsonArray>();
-  serializeSynthBanks(scene_.synthBBanks, synthBBanks);
   ArduinoJson::JsonObject songObj = root["song"].to<ArduinoJson::JsonObject>();
   int songLen = songLength();
   songObj["length"] = songLen;
-  ArduinoJson::JsonArray songPositions = songObj["positions"].to<ArduinoJson::JsonArray>();
-  for (int i = 0; i < songLen; ++i) {
-    ArduinoJson::JsonObject pos = songPositions.add<ArduinoJson::JsonObject>();
-    pos["a"] = scene_.song.positions[i].patterns[0];
-    pos["b"] = scene_.song.positions[i].patterns[1];
-    pos["drums"] = scene_.song.positions[i].patterns[2];
+  ArduinoJson::JsonArray songTracks = songObj["tracks"].to<ArduinoJson::JsonArray>();
+  for (int t = 0; t < Song::kTrackCount; ++t) {
+    ArduinoJson::JsonArray runs = songTracks.add<ArduinoJson::JsonArray>();
+    for (int row = 0; row < songLen;) {
+      int pattern = scene_.song.pattern(row, t);
+      int run = 1;
+      while (row + run < songLen && scene_.song.pattern(row + run, t) == pattern) ++run;
+      runs.add(pattern);
+      runs.add(run);
+      row += run;
+    }
   }
 
   ArduinoJson::JsonObject state = root["state"].to<ArduinoJson::JsonObject>();
   state["drumPatternIndex"] = drumPatternIndex_;
   state["bpm"] = bpm_;
+  state["swing"] = swing_;
   state["songMode"] = songMode_;
   state["songPosition"] = clampSongPosition(songPosition_);
   state["loopMode"] = loopMode_;
@@ -1170,14 +1533,14 @@ bool SceneManager::applySceneDocument(const ArduinoJson::JsonDocument& doc) {
   if (drumBanksVal.isNull()) drumBanksVal = obj["drumBank"];
   if (synthABanksVal.isNull()) synthABanksVal = obj["synthABank"];
   if (synthBBanksVal.isNull()) synthBBanksVal = obj["synthBBank"];
-  if (drumBanksVal.isNull() || synthABanksVal.isNull() || synthBBanksVal.isNull()) return false;
 
   auto loaded = std::make_unique<Scene>();
   clearSceneData(*loaded);
 
-  if (!deserializeDrumBanks(drumBanksVal, loaded->drumBanks)) return false;
-  if (!deserializeSynthBanks(synthABanksVal, loaded->synthABanks)) return false;
-  if (!deserializeSynthBanks(synthBBanksVal, loaded->synthBBanks)) return false;
+  // Current files keep banks in separate segments; older ones inline them.
+  if (!drumBanksVal.isNull() && !deserializeDrumBanks(drumBanksVal, *loaded)) return false;
+  if (!synthABanksVal.isNull() && !deserializeSynthBanks(synthABanksVal, *loaded, false)) return false;
+  if (!synthBBanksVal.isNull() && !deserializeSynthBanks(synthBBanksVal, *loaded, true)) return false;
 
   int drumPatternIndex = 0;
   int synthPatternIndexA = 0;
@@ -1191,6 +1554,7 @@ bool SceneManager::applySceneDocument(const ArduinoJson::JsonDocument& doc) {
   bool synthDelay[2] = {false, false};
   SynthParameters synthParams[2] = {SynthParameters(), SynthParameters()};
   float bpm = bpm_;
+  float swing = 0.0f;
   Song loadedSong{};
   clearSong(loadedSong);
   bool hasSongObj = false;
@@ -1204,8 +1568,8 @@ bool SceneManager::applySceneDocument(const ArduinoJson::JsonDocument& doc) {
   ArduinoJson::JsonObjectConst songObj = obj["song"].as<ArduinoJson::JsonObjectConst>();
   if (!songObj.isNull()) {
     hasSongObj = true;
-    int length = valueToInt(songObj["length"], loadedSong.length);
-    loadedSong.length = clampSongLength(length);
+    int length = valueToInt(songObj["length"], loadedSong.length());
+    loadedSong.setLength(clampSongLength(length));
     ArduinoJson::JsonArrayConst positions = songObj["positions"].as<ArduinoJson::JsonArrayConst>();
     if (!positions.isNull()) {
       int posIdx = 0;
@@ -1216,20 +1580,32 @@ bool SceneManager::applySceneDocument(const ArduinoJson::JsonDocument& doc) {
           auto a = posObj["a"];
           auto b = posObj["b"];
           auto d = posObj["drums"];
-          if (a.is<int>()) {
-            loadedSong.positions[posIdx].patterns[0] = clampSongPatternIndex(a.as<int>());
-          }
-          if (b.is<int>()) {
-            loadedSong.positions[posIdx].patterns[1] = clampSongPatternIndex(b.as<int>());
-          }
-          if (d.is<int>()) {
-            loadedSong.positions[posIdx].patterns[2] = clampSongPatternIndex(d.as<int>());
-          }
+          if (posIdx + 1 > loadedSong.length()) loadedSong.setLength(posIdx + 1);
+          if (a.is<int>()) loadedSong.setPattern(posIdx, 0, clampSongPatternIndex(a.as<int>()));
+          if (b.is<int>()) loadedSong.setPattern(posIdx, 1, clampSongPatternIndex(b.as<int>()));
+          if (d.is<int>()) loadedSong.setPattern(posIdx, 2, clampSongPatternIndex(d.as<int>()));
         }
-        if (posIdx + 1 > loadedSong.length) loadedSong.length = posIdx + 1;
+        if (posIdx + 1 > loadedSong.length()) loadedSong.setLength(posIdx + 1);
         ++posIdx;
       }
     }
+    ArduinoJson::JsonArrayConst tracks = songObj["tracks"].as<ArduinoJson::JsonArrayConst>();
+    if (!tracks.isNull()) {
+      int trackIdx = 0;
+      for (ArduinoJson::JsonVariantConst trackVal : tracks) {
+        if (trackIdx >= Song::kTrackCount) break;
+        ArduinoJson::JsonArrayConst runs = trackVal.as<ArduinoJson::JsonArrayConst>();
+        int row = 0;
+        for (size_t i = 0; i + 1 < runs.size(); i += 2) {
+          int pattern = clampSongPatternIndex(valueToInt(runs[i], -1));
+          int end = row + valueToInt(runs[i + 1], 0);
+          if (end > Song::kMaxPositions) end = Song::kMaxPositions;
+          if (pattern >= 0 && end > loadedSong.length()) loadedSong.setLength(end);
+          for (; row < end; ++row) loadedSong.setPattern(row, trackIdx, pattern);
+        }
+        ++trackIdx;
+      }
+    }
     ArduinoJson::JsonArrayConst songDistortionArr = songObj["synthDistortion"].as<ArduinoJson::JsonArrayConst>();
     if (!songDistortionArr.isNull()) {
       if (!deserializeBoolArray(songDistortionArr, synthDistortion, 2)) return false;
@@ -1244,6 +1620,7 @@ bool SceneManager::applySceneDocument(const ArduinoJson::JsonDocument& doc) {
   if (!state.isNull()) {
     drumPatternIndex = valueToInt(state["drumPatternIndex"], drumPatternIndex);
     bpm = valueToFloat(state["bpm"], bpm);
+    swing = valueToFloat(state["swing"], swing);
     ArduinoJson::JsonArrayConst synthPatternIndexArr = state["synthPatternIndex"].as<ArduinoJson::JsonArrayConst>();
     if (!synthPatternIndexArr.isNull()) {
       if (synthPatternIndexArr.size() > 0) synthPatternIndexA = valueToInt(synthPatternIndexArr[0], synthPatternIndexA);
@@ -1295,17 +1672,18 @@ bool SceneManager::applySceneDocument(const ArduinoJson::JsonDocument& doc) {
   }
 
   if (!hasSongObj) {
-    loadedSong.length = 1;
-    loadedSong.positions[0].patterns[0] = songPatternFromBank(synthBankIndexA,
-                                                             clampPatternIndex(synthPatternIndexA));
-    loadedSong.positions[0].patterns[1] = songPatternFromBank(synthBankIndexB,
-                                                             clampPatternIndex(synthPatternIndexB));
-    loadedSong.positions[0].patterns[2] = songPatternFromBank(drumBankIndex,
-                                                             clampPatternIndex(drumPatternIndex));
+    loadedSong.setLength(1);
+    loadedSong.setPattern(0, 0, songPatternFromBank(synthBankIndexA,
+                                                    clampPatternIndex(synthPatternIndexA)));
+    loadedSong.setPattern(0, 1, songPatternFromBank(synthBankIndexB,
+                                                    clampPatternIndex(synthPatternIndexB)));
+    loadedSong.setPattern(0, 2, songPatternFromBank(drumBankIndex,
+                                                    clampPatternIndex(drumPatternIndex)));
   }
 
   scene_ = *loaded;
   scene_.song = loadedSong;
+  bankSceneName_.clear();
   drumPatternIndex_ = clampPatternIndex(drumPatternIndex);
   synthPatternIndex_[0] = clampPatternIndex(synthPatternIndexA);
   synthPatternIndex_[1] = clampPatternIndex(synthPatternIndexB);
@@ -1324,7 +1702,7 @@ bool SceneManager::applySceneDocument(const ArduinoJson::JsonDocument& doc) {
   synthParameters_[0] = synthParams[0];
   synthParameters_[1] = synthParams[1];
   drumEngineName_ = drumEngineName;
-  setSongLength(scene_.song.length);
+  setSongLength(scene_.song.length());
   songPosition_ = clampSongPosition(songPosition);
   songMode_ = songMode;
   loopMode_ = loopMode;
@@ -1332,6 +1710,7 @@ bool SceneManager::applySceneDocument(const ArduinoJson::JsonDocument& doc) {
   loopEndRow_ = loopEndRow;
   clampLoopRange();
   setBpm(bpm);
+  setSwing(swing);
   return true;
 }
 
@@ -1368,6 +1747,7 @@ bool SceneManager::loadSceneEventedWithReader(JsonVisitor::NextChar nextChar) {
 
   scene_ = *loaded;
   scene_.song = observer.song();
+  bankSceneName_.clear();
   drumPatternIndex_ = clampPatternIndex(observer.drumPatternIndex());
   synthPatternIndex_[0] = clampPatternIndex(observer.synthPatternIndex(0));
   synthPatternIndex_[1] = clampPatternIndex(observer.synthPatternIndex(1));
@@ -1375,13 +1755,10 @@ bool SceneManager::loadSceneEventedWithReader(JsonVisitor::NextChar nextChar) {
   synthBankIndex_[0] = clampIndex(observer.synthBankIndex(0), kBankCount);
   synthBankIndex_[1] = clampIndex(observer.synthBankIndex(1), kBankCount);
   if (!observer.hasSong()) {
-    scene_.song.length = 1;
-    scene_.song.positions[0].patterns[0] = songPatternFromBank(synthBankIndex_[0],
-                                                               synthPatternIndex_[0]);
-    scene_.song.positions[0].patterns[1] = songPatternFromBank(synthBankIndex_[1],
-                                                               synthPatternIndex_[1]);
-    scene_.song.positions[0].patterns[2] = songPatternFromBank(drumBankIndex_,
-                                                               drumPatternIndex_);
+    scene_.song.setLength(1);
+    scene_.song.setPattern(0, 0, songPatternFromBank(synthBankIndex_[0], synthPatternIndex_[0]));
+    scene_.song.setPattern(0, 1, songPatternFromBank(synthBankIndex_[1], synthPatternIndex_[1]));
+    scene_.song.setPattern(0, 2, songPatternFromBank(drumBankIndex_, drumPatternIndex_));
   }
   for (int i = 0; i < DrumPatternSet::kVoices; ++i) {
     drumMute_[i] = observer.drumMute(i);
@@ -1395,7 +1772,7 @@ bool SceneManager::loadSceneEventedWithReader(JsonVisitor::NextChar nextChar) {
   synthParameters_[0] = observer.synthParameters(0);
   synthParameters_[1] = observer.synthParameters(1);
   drumEngineName_ = observer.drumEngineName();
-  setSongLength(scene_.song.length);
+  setSongLength(scene_.song.length());
   songPosition_ = clampSongPosition(observer.songPosition());
   songMode_ = observer.songMode();
   loopMode_ = observer.loopMode();
@@ -1403,6 +1780,7 @@ bool SceneManager::loadSceneEventedWithReader(JsonVisitor::NextChar nextChar) {
   loopEndRow_ = observer.loopEndRow();
   clampLoopRange();
   setBpm(observer.bpm());
+  setSwing(observer.swing());
   return true;
 }
 
@@ -1445,23 +1823,10 @@ int SceneManager::songTrackToIndex(SongTrack track) const {
 }
 
 void SceneManager::trimSongLength() {
-  int lastUsed = -1;
-  for (int pos = scene_.song.length - 1; pos >= 0; --pos) {
-    bool hasData = false;
-    for (int t = 0; t < SongPosition::kTrackCount; ++t) {
-      if (scene_.song.positions[pos].patterns[t] >= 0) {
-        hasData = true;
-        break;
-      }
-    }
-    if (hasData) {
-      lastUsed = pos;
-      break;
-    }
-  }
+  int lastUsed = scene_.song.lastUsedRow(scene_.song.length());
   int newLength = lastUsed >= 0 ? lastUsed + 1 : 1;
-  scene_.song.length = clampSongLength(newLength);
-  if (songPosition_ >= scene_.song.length) songPosition_ = scene_.song.length - 1;
+  scene_.song.setLength(clampSongLength(newLength));
+  if (songPosition_ >= scene_.song.length()) songPosition_ = scene_.song.length() - 1;
   clampLoopRange();
 }
 
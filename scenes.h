@@ -1,8 +1,10 @@
 #pragma once
 
 #include <stdint.h>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
+#include <memory>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -44,14 +46,23 @@ bool writeChunk(Writer& writer, const char* data, size_t len) {
 }
 } // namespace scene_json_detail
 
-struct DrumStep {
-  bool hit;
-  bool accent;
-};
-
+// Sixteen steps as bit masks, bit n being step n, so the sequencer reads a
+// step (or all voices of a step) with a few bit operations.
 struct DrumPattern {
   static constexpr int kSteps = 16;
-  DrumStep steps[kSteps];
+  uint16_t hits = 0;
+  uint16_t accents = 0;
+
+  bool hit(int step) const { return (hits >> step) & 1u; }
+  bool accent(int step) const { return (accents >> step) & 1u; }
+  void setHit(int step, bool on) { setBit(hits, step, on); }
+  void setAccent(int step, bool on) { setBit(accents, step, on); }
+
+private:
+  static void setBit(uint16_t& mask, int step, bool on) {
+    uint16_t bit = static_cast<uint16_t>(1u << step);
+    mask = on ? static_cast<uint16_t>(mask | bit) : static_cast<uint16_t>(mask & ~bit);
+  }
 };
 
 struct DrumPatternSet {
@@ -60,14 +71,37 @@ struct DrumPatternSet {
 };
 
 struct SynthStep {
-  int note; 
-  bool slide;
-  bool accent;
+  int8_t note; // -1 is a rest
+  uint8_t slide : 1;
+  uint8_t accent : 1;
 };
+static_assert(sizeof(SynthStep) == 2, "SynthStep should pack into two bytes");
 
 struct SynthPattern {
   static constexpr int kSteps = 16;
   SynthStep steps[kSteps];
+
+  uint16_t accentMask() const {
+    uint16_t mask = 0;
+    for (int i = 0; i < kSteps; ++i) mask |= static_cast<uint16_t>(steps[i].accent << i);
+    return mask;
+  }
+  uint16_t slideMask() const {
+    uint16_t mask = 0;
+    for (int i = 0; i < kSteps; ++i) mask |= static_cast<uint16_t>(steps[i].slide << i);
+    return mask;
+  }
+};
+
+// Per-step views handed to the UI; they index like the arrays they replace.
+struct StepMask {
+  uint16_t bits = 0;
+  bool operator[](int step) const { return (bits >> step) & 1u; }
+};
+
+struct SynthNoteSteps {
+  const SynthPattern* pattern = nullptr;
+  int operator[](int step) const { return pattern->steps[step].note; }
 };
 
 struct SynthParameters {
@@ -84,15 +118,45 @@ enum class SongTrack : uint8_t {
   Drums = 2,
 };
 
-struct SongPosition {
+// Arrangement rows, kept in chunks of kChunkRows. Copies share chunks until
+// one side writes to them, so snapshots (undo, saves, the scene cache) cost a
+// pointer per chunk, and chunks that were never written are not allocated.
+// Rows at or past length() are always empty.
+class Song {
+public:
   static constexpr int kTrackCount = 3;
-  int8_t patterns[kTrackCount] = {-1, -1, -1};
-};
+  static constexpr int kChunkRows = 32;
+  static constexpr int kMaxPositions = 2048;
+  static constexpr int kChunks = kMaxPositions / kChunkRows;
+
+  int length() const { return length_; }
+  // Shrinking clears the rows that fall off the end.
+  void setLength(int length);
+  int pattern(int row, int track) const {
+    if (row < 0 || row >= kMaxPositions || track < 0 || track >= kTrackCount) return -1;
+    const Chunk* chunk = chunks_[row / kChunkRows].get();
+    return chunk ? chunk->patterns[row % kChunkRows][track] : -1;
+  }
+  void setPattern(int row, int track, int pattern);
+  void clear();
+  // Copies 'rows' x 'tracks' cells of 'src'. Whole aligned chunks are shared
+  // rather than copied. Cells that land outside the song are dropped; the
+  // length is left alone.
+  void copyRange(const Song& src, int srcRow, int dstRow, int rows,
+                 int srcTrack, int dstTrack, int tracks);
+  // Last row before 'end' with any pattern set, or -1.
+  int lastUsedRow(int end) const;
+  size_t allocatedBytes() const;
+
+private:
+  struct Chunk {
+    int8_t patterns[kChunkRows][kTrackCount];
+  };
+
+  Chunk* writableChunk(int index);
 
-struct Song {
-  static constexpr int kMaxPositions = 128;
-  SongPosition positions[kMaxPositions];
-  int length = 1;
+  std::shared_ptr<Chunk> chunks_[kChunks];
+  int length_ = 1;
 };
 
 template <typename PatternType>
@@ -101,8 +165,19 @@ struct Bank {
   PatternType patterns[kPatterns];
 };
 
-static constexpr int kBankCount = 4;
+static constexpr int kBankCount = 16;
 static constexpr int kSongPatternCount = kBankCount * Bank<SynthPattern>::kPatterns;
+// Banks held in memory at once; the others are paged in from storage.
+// Song playback needs up to three current banks plus three for the next
+// row, and paging keeps one more slot free for the next bank to come in,
+// so 7 is the least that prefetches a row ahead (768 bytes per bank).
+#if defined(ARDUINO)
+static constexpr int kResidentBankCount = 7;
+#else
+static constexpr int kResidentBankCount = 8;
+#endif
+// Drum engine of new scenes.
+static constexpr const char* kDefaultDrumEngineName = "808";
 
 inline int clampSongPatternIndex(int idx) {
   if (idx < -1) return -1;
@@ -130,13 +205,92 @@ inline int songPatternFromBank(int bankIndex, int patternIndex) {
   return bankIndex * Bank<SynthPattern>::kPatterns + patternIndex;
 }
 
+struct SceneBank {
+  Bank<DrumPatternSet> drums;
+  Bank<SynthPattern> synthA;
+  Bank<SynthPattern> synthB;
+};
+
+struct SceneBankSlot {
+  // -1 while empty or being refilled. Stored with release after the data and
+  // loaded with acquire, so the audio thread never sees a half loaded bank
+  // under a valid index.
+  std::atomic<int8_t> bank{-1};
+  bool dirty = false;
+  // Unpublished, but a reader may still hold its data until 'retireTicket'
+  // is done (see SceneBankReaders).
+  bool retiring = false;
+  uint32_t retireTicket = 0;
+  uint32_t lastUse = 0;
+  SceneBank data;
+
+  SceneBankSlot() = default;
+  // Scenes are copied whole (clones for rendering), index included. Nobody
+  // reads the copy yet, so it is never retiring.
+  SceneBankSlot(const SceneBankSlot& other) { *this = other; }
+  SceneBankSlot& operator=(const SceneBankSlot& other) {
+    bank.store(other.bank.load(std::memory_order_acquire), std::memory_order_release);
+    dirty = other.dirty;
+    retiring = false;
+    lastUse = other.lastUse;
+    data = other.data;
+    return *this;
+  }
+};
+
 struct Scene {
-  Bank<DrumPatternSet> drumBanks[kBankCount];
-  Bank<SynthPattern> synthABanks[kBankCount];
-  Bank<SynthPattern> synthBBanks[kBankCount];
+  SceneBankSlot banks[kResidentBankCount];
   Song song;
 };
 
+// Fixed-size binary form of one SceneBank, so bank N of a scene can be read
+// or rewritten at offset N * kBytes without touching the others.
+struct SceneBankSegment {
+  static constexpr size_t kDrumBytes = Bank<DrumPatternSet>::kPatterns * DrumPatternSet::kVoices * 4;
+  static constexpr size_t kSynthBytes = Bank<SynthPattern>::kPatterns * SynthPattern::kSteps * 2;
+  static constexpr size_t kBytes = 4 + kDrumBytes + 2 * kSynthBytes;
+
+  static void encode(const SceneBank& bank, uint8_t* out);
+  // Returns false (and clears 'bank') when 'in' does not hold a bank.
+  static bool decode(const uint8_t* in, SceneBank& bank);
+};
+
+void clearSceneBank(SceneBank& bank);
+
+// Where paged-out banks live. Missing banks read back as false and are
+// treated as empty.
+class SceneBankStore {
+public:
+  virtual ~SceneBankStore() = default;
+  virtual bool readBank(const std::string& sceneName, int bankIndex, SceneBank& out) = 0;
+  virtual bool writeBank(const std::string& sceneName, int bankIndex, const SceneBank& bank) = 0;
+};
+
+// Set on scenes the audio thread plays from: paging keeps the banks it is
+// about to use and never refills a slot it may still be reading.
+class SceneBankReaders {
+public:
+  virtual ~SceneBankReaders() = default;
+  // Banks to keep resident besides the current ones (the next song row).
+  virtual uint32_t pinnedBanks() const = 0;
+  // Called right after a slot is unpublished; the slot is refilled only
+  // once readsDone() returns true for the ticket.
+  virtual uint32_t readTicket() const = 0;
+  virtual bool readsDone(uint32_t ticket) const = 0;
+};
+
+// Bank store held in memory, for a scene copy that must never touch
+// storage. Scene names are ignored.
+class MemoryBankStore : public SceneBankStore {
+public:
+  bool readBank(const std::string& sceneName, int bankIndex, SceneBank& out) override;
+  bool writeBank(const std::string& sceneName, int bankIndex, const SceneBank& bank) override;
+  bool hasBank(int bankIndex) const;
+
+private:
+  std::unique_ptr<SceneBank> banks_[kBankCount];
+};
+
 class SceneJsonObserver : public JsonObserver {
 public:
   explicit SceneJsonObserver(Scene& scene, float defaultBpm = 100.0f);
@@ -165,6 +319,7 @@ public:
   bool synthDelayEnabled(int idx) const;
   const SynthParameters& synthParameters(int synthIdx) const;
   float bpm() const;
+  float swing() const;
   const Song& song() const;
   bool hasSong() const;
   bool songMode() const;
@@ -202,6 +357,8 @@ private:
     Song,
     SongPositions,
     SongPosition,
+    SongTracks,
+    SongTrackRuns,
     Unknown,
   };
 
@@ -238,14 +395,17 @@ private:
   bool synthDelay_[2] = {false, false};
   SynthParameters synthParameters_[2];
   float bpm_ = 100.0f;
+  float swing_ = 0.0f;
   Song song_;
   bool hasSong_ = false;
+  int runPattern_ = -1;
+  int runRow_ = 0;
   bool songMode_ = false;
   int songPosition_ = 0;
   bool loopMode_ = false;
   int loopStartRow_ = 0;
   int loopEndRow_ = 0;
-  std::string drumEngineName_ = "808";
+  std::string drumEngineName_ = kDefaultDrumEngineName;
 };
 
 class SceneManager {
@@ -255,14 +415,17 @@ public:
   const Scene& currentScene() const;
 
   const DrumPatternSet& getCurrentDrumPattern() const;
-  DrumPatternSet& editCurrentDrumPattern();
+  // The edit accessors page the bank in and mark it dirty. They return null
+  // when no slot can be freed for it (every resident bank is in use or has
+  // unsaved edits with nowhere to write them).
+  DrumPatternSet* editCurrentDrumPattern();
 
   const SynthPattern& getCurrentSynthPattern(int synthIndex) const;
-  SynthPattern& editCurrentSynthPattern(int synthIndex);
+  SynthPattern* editCurrentSynthPattern(int synthIndex);
   const SynthPattern& getSynthPattern(int synthIndex, int patternIndex) const;
-  SynthPattern& editSynthPattern(int synthIndex, int patternIndex);
+  SynthPattern* editSynthPattern(int synthIndex, int patternIndex);
   const DrumPatternSet& getDrumPatternSet(int patternIndex) const;
-  DrumPatternSet& editDrumPatternSet(int patternIndex);
+  DrumPatternSet* editDrumPatternSet(int patternIndex);
 
   void setCurrentDrumPatternIndex(int idx);
   void setCurrentSynthPatternIndex(int synthIdx, int idx);
@@ -292,12 +455,18 @@ public:
   const std::string& getDrumEngineName() const;
   void setBpm(float bpm);
   float getBpm() const;
+  void setSwing(float swing);
+  float getSwing() const;
 
   const Song& song() const;
   Song& editSong();
   void setSongPattern(int position, SongTrack track, int patternIndex);
   void clearSongPattern(int position, SongTrack track);
   int songPattern(int position, SongTrack track) const;
+  // Copies a block of cells from 'src' (which may be song()), growing or
+  // trimming the song length to fit what was written.
+  void copySongRange(const Song& src, int srcRow, int dstRow, int rows,
+                     int srcTrack, int dstTrack, int tracks);
   void setSongLength(int length);
   int songLength() const;
   void setSongPosition(int position);
@@ -310,6 +479,30 @@ public:
   int loopStartRow() const;
   int loopEndRow() const;
 
+  // Bank paging: only kResidentBankCount banks are held in memory, the rest
+  // are read from the bank store of 'sceneName' when needed. Banks that are
+  // not resident read as empty patterns, so readers never wait on storage.
+  void setBankStore(SceneBankStore* store, const std::string& sceneName);
+  void setBankReaders(const SceneBankReaders* readers);
+  const std::string& bankSceneName() const;
+  bool isBankResident(int bankIndex) const;
+  const SceneBank* residentBank(int bankIndex) const;
+  // Loads 'bankIndex' if needed into a free slot, writing back and
+  // unpublishing a victim when there is none. The current banks, those in
+  // 'keepMask' and those pinned by the readers are never evicted. With
+  // readers set, a victim is refilled only after their reads are done and
+  // one slot is kept free ahead, so this returns false while waiting.
+  bool ensureBankResident(int bankIndex, uint32_t keepMask = 0);
+  uint32_t currentBanksMask() const;
+  uint32_t residentBanksMask() const;
+  // Drops the banks that match storage, keeping only unsaved edits.
+  void releaseCleanBanks();
+  // Writes the banks of this scene as 'sceneName'. Banks that are not
+  // resident are copied from the scene they were loaded from.
+  bool writeBanks(SceneBankStore& store, const std::string& sceneName) const;
+  // Call once a save of this scene as 'sceneName' has been queued.
+  void markBanksSaved(const std::string& sceneName);
+
   template <typename TWriter>
   bool writeSceneJson(TWriter&& writer) const;
   template <typename TReader>
@@ -332,8 +525,15 @@ private:
   void buildSceneDocument(ArduinoJson::JsonDocument& doc) const;
   bool applySceneDocument(const ArduinoJson::JsonDocument& doc);
   bool loadSceneEventedWithReader(JsonVisitor::NextChar nextChar);
+  SceneBank* editBank(int bankIndex);
+  int freeBankSlot();
+  bool retireBankSlot(uint32_t keepMask);
 
   Scene scene_;
+  SceneBankStore* bankStore_ = nullptr;
+  const SceneBankReaders* bankReaders_ = nullptr;
+  std::string bankSceneName_;
+  uint32_t bankClock_ = 0;
   int drumPatternIndex_ = 0;
   int synthPatternIndex_[2] = {0, 0};
   int drumBankIndex_ = 0;
@@ -344,12 +544,13 @@ private:
   bool synthDelay_[2] = {false, false};
   SynthParameters synthParameters_[2];
   float bpm_ = 100.0f;
+  float swing_ = 0.0f;
   bool songMode_ = false;
   int songPosition_ = 0;
   bool loopMode_ = false;
   int loopStartRow_ = 0;
   int loopEndRow_ = 0;
-  std::string drumEngineName_ = "808";
+  std::string drumEngineName_ = kDefaultDrumEngineName;
 };
 
 // inline constexpr size_t SceneManager::sceneJsonCapacity() {
@@ -416,97 +617,29 @@ bool SceneManager::writeSceneJson(TWriter&& writer) const {
     }
     return writeChar('"');
   };
-  auto writeDrumPattern = [&](const DrumPattern& pattern) -> bool {
-    if (!writeLiteral("{\"hit\":[")) return false;
-    for (int i = 0; i < DrumPattern::kSteps; ++i) {
-      if (i > 0 && !writeChar(',')) return false;
-      if (!writeBool(pattern.steps[i].hit)) return false;
-    }
-    if (!writeLiteral("],\"accent\":[")) return false;
-    for (int i = 0; i < DrumPattern::kSteps; ++i) {
-      if (i > 0 && !writeChar(',')) return false;
-      if (!writeBool(pattern.steps[i].accent)) return false;
-    }
-    return writeLiteral("]}");
-  };
-  auto writeDrumBank = [&](const Bank<DrumPatternSet>& bank) -> bool {
-    if (!writeChar('[')) return false;
-    for (int p = 0; p < Bank<DrumPatternSet>::kPatterns; ++p) {
-      if (p > 0 && !writeChar(',')) return false;
-      if (!writeChar('[')) return false;
-      for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
-        if (v > 0 && !writeChar(',')) return false;
-        if (!writeDrumPattern(bank.patterns[p].voices[v])) return false;
-      }
-      if (!writeChar(']')) return false;
-    }
-    return writeChar(']');
-  };
-  auto writeDrumBanks = [&](const Bank<DrumPatternSet>* banks) -> bool {
-    if (!writeChar('[')) return false;
-    for (int b = 0; b < kBankCount; ++b) {
-      if (b > 0 && !writeChar(',')) return false;
-      if (!writeDrumBank(banks[b])) return false;
-    }
-    return writeChar(']');
-  };
-  auto writeSynthPattern = [&](const SynthPattern& pattern) -> bool {
-    if (!writeChar('[')) return false;
-    for (int i = 0; i < SynthPattern::kSteps; ++i) {
-      if (i > 0 && !writeChar(',')) return false;
-      if (!writeLiteral("{\"note\":")) return false;
-      if (!writeInt(pattern.steps[i].note)) return false;
-      if (!writeLiteral(",\"slide\":")) return false;
-      if (!writeBool(pattern.steps[i].slide)) return false;
-      if (!writeLiteral(",\"accent\":")) return false;
-      if (!writeBool(pattern.steps[i].accent)) return false;
-      if (!writeChar('}')) return false;
-    }
-    return writeChar(']');
-  };
-  auto writeSynthBank = [&](const Bank<SynthPattern>& bank) -> bool {
-    if (!writeChar('[')) return false;
-    for (int p = 0; p < Bank<SynthPattern>::kPatterns; ++p) {
-      if (p > 0 && !writeChar(',')) return false;
-      if (!writeSynthPattern(bank.patterns[p])) return false;
-    }
-    return writeChar(']');
-  };
-  auto writeSynthBanks = [&](const Bank<SynthPattern>* banks) -> bool {
-    if (!writeChar('[')) return false;
-    for (int b = 0; b < kBankCount; ++b) {
-      if (b > 0 && !writeChar(',')) return false;
-      if (!writeSynthBank(banks[b])) return false;
-    }
-    return writeChar(']');
-  };
-
+  // Pattern banks are stored separately as SceneBankSegments (writeBanks()).
   if (!writeChar('{')) return false;
 
-  if (!writeLiteral("\"drumBanks\":")) return false;
-  if (!writeDrumBanks(scene_.drumBanks)) return false;
-
-  if (!writeLiteral(",\"synthABanks\":")) return false;
-  if (!writeSynthBanks(scene_.synthABanks)) return false;
-
-  if (!writeLiteral(",\"synthBBanks\":")) return false;
-  if (!writeSynthBanks(scene_.synthBBanks)) return false;
-
-  if (!writeLiteral(",\"song\":{")) return false;
+  if (!writeLiteral("\"song\":{")) return false;
   int songLen = songLength();
   if (!writeLiteral("\"length\":")) return false;
   if (!writeInt(songLen)) return false;
-  if (!writeLiteral(",\"positions\":[")) return false;
-  for (int i = 0; i < songLen; ++i) {
-    if (i > 0 && !writeChar(',')) return false;
-    if (!writeChar('{')) return false;
-    if (!writeLiteral("\"a\":")) return false;
-    if (!writeInt(scene_.song.positions[i].patterns[0])) return false;
-    if (!writeLiteral(",\"b\":")) return false;
-    if (!writeInt(scene_.song.positions[i].patterns[1])) return false;
-    if (!writeLiteral(",\"drums\":")) return false;
-    if (!writeInt(scene_.song.positions[i].patterns[2])) return false;
-    if (!writeChar('}')) return false;
+  // Each track is a run-length list: pattern, row count, pattern, row count...
+  if (!writeLiteral(",\"tracks\":[")) return false;
+  for (int t = 0; t < Song::kTrackCount; ++t) {
+    if (t > 0 && !writeChar(',')) return false;
+    if (!writeChar('[')) return false;
+    for (int row = 0; row < songLen;) {
+      int pattern = scene_.song.pattern(row, t);
+      int run = 1;
+      while (row + run < songLen && scene_.song.pattern(row + run, t) == pattern) ++run;
+      if (row > 0 && !writeChar(',')) return false;
+      if (!writeInt(pattern)) return false;
+      if (!writeChar(',')) return false;
+      if (!writeInt(run)) return false;
+      row += run;
+    }
+    if (!writeChar(']')) return false;
   }
   if (!writeChar(']')) return false;
   if (!writeChar('}')) return false;
@@ -516,6 +649,8 @@ bool SceneManager::writeSceneJson(TWriter&& writer) const {
   if (!writeInt(drumPatternIndex_)) return false;
   if (!writeLiteral(",\"bpm\":")) return false;
   if (!writeFloat(bpm_)) return false;
+  if (!writeLiteral(",\"swing\":")) return false;
+  if (!writeFloat(swing_)) return false;
   if (!writeLiteral(",\"songMode\":")) return false;
   if (!writeBool(songMode_)) return false;
   if (!writeLiteral(",\"songPosition\":")) return false;
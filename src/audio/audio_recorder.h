@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <string>
 
+#include "recording_codec.h"
+
 // Abstract interface for audio recording
 class IAudioRecorder {
  public:
@@ -13,5 +15,15 @@ class IAudioRecorder {
   virtual void stop() = 0;
   virtual bool isRecording() const = 0;
   virtual void writeSamples(const int16_t* samples, size_t sampleCount) = 0;
+  // For producers that can wait, such as an offline render: queues the
+  // samples if they fit and returns false, dropping nothing, if they do not.
+  virtual bool offerSamples(const int16_t* samples, size_t sampleCount) {
+    writeSamples(samples, sampleCount);
+    return true;
+  }
   virtual const std::string& filename() const = 0;
+  // Picks the format of the next recording. Returns false for formats the
+  // recorder cannot write; plain 16-bit WAV always works.
+  virtual bool setFormat(RecordingFormat format) { return format == RecordingFormat::Pcm16; }
+  virtual RecordingFormat format() const { return RecordingFormat::Pcm16; }
 };
@@ -1,33 +1,30 @@
 #pragma once
 
-#include "audio_recorder.h"
+#include "threaded_audio_recorder.h"
 
 #if defined(ARDUINO)
 #include <SD.h>
 #include <FS.h>
 
-// Cardputer implementation that streams WAV to SD card
-class CardputerAudioRecorder : public IAudioRecorder {
+// Cardputer implementation that streams recordings to the SD card. SD writes happen on
+// the writer task, so card latency spikes no longer stall the audio task.
+class CardputerAudioRecorder : public ThreadedAudioRecorder {
  public:
   CardputerAudioRecorder();
   ~CardputerAudioRecorder() override;
 
-  bool start(int sampleRate, int channels) override;
-  void stop() override;
-  bool isRecording() const override;
-  void writeSamples(const int16_t* samples, size_t sampleCount) override;
-  const std::string& filename() const override;
+ protected:
+  bool openSink(int track, const char* name, const char* extension,
+                std::string& filename) override;
+  std::size_t writeSink(int track, const std::uint8_t* data, std::size_t size) override;
+  void closeSink(int track, const std::uint8_t* header, std::size_t headerSize) override;
 
  private:
-  std::string generateTimestampFilename() const;
-  void writeHeaderPlaceholder();
-  void finalizeHeader();
+  static std::string generateTimestamp();
 
-  File file_;
-  std::string filename_;
-  std::uint32_t dataBytes_ = 0;
-  int sampleRate_ = 0;
-  int channels_ = 0;
+  File files_[kMaxTracks];
+  // Shared by the tracks of one recording.
+  std::string timestamp_;
 };
 
 #endif // ARDUINO
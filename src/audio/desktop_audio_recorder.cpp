@@ -3,76 +3,55 @@
 #include <cstring>
 #include <ctime>
 
-namespace {
-
-void writeLE16(std::uint8_t* dst, std::uint16_t value) {
-  dst[0] = static_cast<std::uint8_t>(value & 0xFF);
-  dst[1] = static_cast<std::uint8_t>((value >> 8) & 0xFF);
-}
-
-void writeLE32(std::uint8_t* dst, std::uint32_t value) {
-  dst[0] = static_cast<std::uint8_t>(value & 0xFF);
-  dst[1] = static_cast<std::uint8_t>((value >> 8) & 0xFF);
-  dst[2] = static_cast<std::uint8_t>((value >> 16) & 0xFF);
-  dst[3] = static_cast<std::uint8_t>((value >> 24) & 0xFF);
-}
-
-}  // namespace
-
 DesktopAudioRecorder::DesktopAudioRecorder() = default;
 
 DesktopAudioRecorder::~DesktopAudioRecorder() {
   stop();
 }
 
-bool DesktopAudioRecorder::start(int sampleRate, int channels) {
-  if (file_) {
+bool DesktopAudioRecorder::openSink(int track, const char* name, const char* extension,
+                                   std::string& filename) {
+  if (files_[track]) {
     return false;
   }
 
-  filename_ = generateTimestampFilename();
-  file_ = std::fopen(filename_.c_str(), "wb");
-  if (!file_) {
-    filename_.clear();
-    return false;
+  if (track == 0) timestamp_ = generateTimestamp();
+  filename = "miniacid_" + timestamp_;
+  if (name[0]) {
+    filename += "_";
+    filename += name;
   }
-
-  sampleRate_ = sampleRate;
-  channels_ = channels;
-  dataBytes_ = 0;
-  writeHeaderPlaceholder();
-  return true;
+  filename += ".";
+  filename += extension;
+  files_[track] = std::fopen(filename.c_str(), "wb");
+  return files_[track] != nullptr;
 }
 
-void DesktopAudioRecorder::stop() {
-  if (!file_) {
+void DesktopAudioRecorder::closeSink(int track, const std::uint8_t* header,
+                                     std::size_t headerSize) {
+  std::FILE* file = files_[track];
+  if (!file) {
     return;
   }
 
-  finalizeHeader();
-  std::fclose(file_);
-  file_ = nullptr;
-  dataBytes_ = 0;
-}
-
-bool DesktopAudioRecorder::isRecording() const {
-  return file_ != nullptr;
-}
-
-void DesktopAudioRecorder::writeSamples(const int16_t* samples, size_t sampleCount) {
-  if (!file_ || !samples || sampleCount == 0) {
-    return;
+  if (headerSize > 0) {
+    std::fseek(file, 0, SEEK_SET);
+    std::fwrite(header, 1, headerSize, file);
   }
-
-  size_t written = std::fwrite(samples, sizeof(int16_t), sampleCount, file_);
-  dataBytes_ += static_cast<std::uint32_t>(written * sizeof(int16_t));
+  std::fflush(file);
+  std::fclose(file);
+  files_[track] = nullptr;
 }
 
-const std::string& DesktopAudioRecorder::filename() const {
-  return filename_;
+std::size_t DesktopAudioRecorder::writeSink(int track, const std::uint8_t* data,
+                                            std::size_t size) {
+  if (!files_[track]) {
+    return 0;
+  }
+  return std::fwrite(data, 1, size, files_[track]);
 }
 
-std::string DesktopAudioRecorder::generateTimestampFilename() const {
+std::string DesktopAudioRecorder::generateTimestamp() {
   char timestamp[32] = "unknown";
   std::time_t now = std::time(nullptr);
   std::tm tm{};
@@ -85,43 +64,5 @@ std::string DesktopAudioRecorder::generateTimestampFilename() const {
   if (std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &tm) == 0) {
     std::snprintf(timestamp, sizeof(timestamp), "unknown");
   }
-
-  std::string filename = "miniacid_";
-  filename += timestamp;
-  filename += ".wav";
-  return filename;
-}
-
-void DesktopAudioRecorder::writeHeaderPlaceholder() {
-  std::uint8_t header[44];
-  std::memcpy(header, "RIFF", 4);
-  writeLE32(header + 4, 36 + dataBytes_);
-  std::memcpy(header + 8, "WAVE", 4);
-  std::memcpy(header + 12, "fmt ", 4);
-  writeLE32(header + 16, 16);
-  writeLE16(header + 20, 1);
-  writeLE16(header + 22, static_cast<std::uint16_t>(channels_));
-  writeLE32(header + 24, static_cast<std::uint32_t>(sampleRate_));
-  std::uint32_t byteRate = static_cast<std::uint32_t>(sampleRate_ * channels_ * sizeof(int16_t));
-  writeLE32(header + 28, byteRate);
-  std::uint16_t blockAlign = static_cast<std::uint16_t>(channels_ * sizeof(int16_t));
-  writeLE16(header + 32, blockAlign);
-  writeLE16(header + 34, 16);
-  std::memcpy(header + 36, "data", 4);
-  writeLE32(header + 40, dataBytes_);
-
-  std::fwrite(header, sizeof(header), 1, file_);
-}
-
-void DesktopAudioRecorder::finalizeHeader() {
-  std::uint8_t sizeField[4];
-  writeLE32(sizeField, 36 + dataBytes_);
-  std::fseek(file_, 4, SEEK_SET);
-  std::fwrite(sizeField, sizeof(sizeField), 1, file_);
-
-  writeLE32(sizeField, dataBytes_);
-  std::fseek(file_, 40, SEEK_SET);
-  std::fwrite(sizeField, sizeof(sizeField), 1, file_);
-
-  std::fflush(file_);
+  return timestamp;
 }
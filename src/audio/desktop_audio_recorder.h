@@ -1,29 +1,25 @@
 #pragma once
 
 
-#include "audio_recorder.h"
+#include "threaded_audio_recorder.h"
 #include <cstdio>
 
-// Desktop implementation using FILE* to write WAV files
-class DesktopAudioRecorder : public IAudioRecorder {
+// Desktop implementation using FILE* to write recordings from the writer thread
+class DesktopAudioRecorder : public ThreadedAudioRecorder {
  public:
   DesktopAudioRecorder();
   ~DesktopAudioRecorder() override;
 
-  bool start(int sampleRate, int channels) override;
-  void stop() override;
-  bool isRecording() const override;
-  void writeSamples(const int16_t* samples, size_t sampleCount) override;
-  const std::string& filename() const override;
+ protected:
+  bool openSink(int track, const char* name, const char* extension,
+                std::string& filename) override;
+  std::size_t writeSink(int track, const std::uint8_t* data, std::size_t size) override;
+  void closeSink(int track, const std::uint8_t* header, std::size_t headerSize) override;
 
  private:
-  std::string generateTimestampFilename() const;
-  void writeHeaderPlaceholder();
-  void finalizeHeader();
+  static std::string generateTimestamp();
 
-  std::FILE* file_ = nullptr;
-  std::string filename_;
-  std::uint32_t dataBytes_ = 0;
-  int sampleRate_ = 0;
-  int channels_ = 0;
+  std::FILE* files_[kMaxTracks] = {};
+  // Shared by the tracks of one recording.
+  std::string timestamp_;
 };
@@ -0,0 +1,267 @@
+#include "pcm_stream_output.h"
+
+#ifdef MINIACID_PCM_STREAM
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../dsp/sample_convert.h"
+
+namespace {
+
+// How long the writer waits for data, a reader or room in the pipe before
+// checking for stop().
+constexpr int kWriterPollMs = 2;
+constexpr int kConnectPollMs = 20;
+// How long a free-running render waits for the writer to make room.
+constexpr auto kRenderWait = std::chrono::milliseconds(1);
+
+bool setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+}  // namespace
+
+static_assert((PcmStreamOutput::kRingBytes & (PcmStreamOutput::kRingBytes - 1)) == 0,
+              "the ring size must be a power of two");
+
+PcmStreamOutput::~PcmStreamOutput() {
+  stop();
+  if (fd_ >= 0) ::close(fd_);
+  if (listenFd_ >= 0) {
+    ::close(listenFd_);
+    ::unlink(path_.c_str());
+  }
+}
+
+bool PcmStreamOutput::open(const std::string& target) {
+  if (running_.load() || kind_ != Kind::None || target.empty()) {
+    return false;
+  }
+  if (target == "-") {
+    fd_ = ::dup(STDOUT_FILENO);
+    if (fd_ < 0) return false;
+    // Keep the stream clean of everything the program prints.
+    ::dup2(STDERR_FILENO, STDOUT_FILENO);
+    kind_ = Kind::Stdout;
+    return true;
+  }
+
+  const std::string socketPrefix = "unix:";
+  if (target.compare(0, socketPrefix.size(), socketPrefix) == 0) {
+    path_ = target.substr(socketPrefix.size());
+    sockaddr_un addr{};
+    if (path_.empty() || path_.size() >= sizeof(addr.sun_path)) return false;
+    struct stat st;
+    // A socket left behind by an earlier run would make bind() fail.
+    if (::stat(path_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) ::unlink(path_.c_str());
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd_ < 0) return false;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path_.c_str(), path_.size() + 1);
+    if (::bind(listenFd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd_, 1) != 0 || !setNonBlocking(listenFd_)) {
+      ::close(listenFd_);
+      listenFd_ = -1;
+      return false;
+    }
+    kind_ = Kind::Socket;
+    return true;
+  }
+
+  path_ = target;
+  struct stat st;
+  if (::stat(path_.c_str(), &st) == 0 && S_ISFIFO(st.st_mode)) {
+    // Opened by the writer once a reader shows up.
+    kind_ = Kind::Path;
+    return true;
+  }
+  fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) return false;
+  kind_ = Kind::Path;
+  return true;
+}
+
+void PcmStreamOutput::setAheadFrames(std::size_t frames) {
+  if (running_.load()) {
+    return;
+  }
+  aheadFrames_ = frames;
+}
+
+bool PcmStreamOutput::start(int sampleRate, PcmStreamFormat format, PcmStreamPacing pacing,
+                            RenderFn render) {
+  if (running_.load() || kind_ == Kind::None || !render || sampleRate <= 0) {
+    return false;
+  }
+  if (!ring_) {
+    ring_.reset(new (std::nothrow) std::uint8_t[kRingBytes]);
+    if (!ring_) return false;
+  }
+  // A reader that goes away must not take the whole program with it.
+  std::signal(SIGPIPE, SIG_IGN);
+  if (fd_ >= 0) setNonBlocking(fd_);
+  render_ = std::move(render);
+  sampleRate_ = sampleRate;
+  format_ = format;
+  pacing_ = pacing;
+  ringWritten_.store(0);
+  ringRead_.store(0);
+  rendered_.store(0);
+  dropped_.store(0);
+  written_.store(0);
+  failed_.store(false);
+  renderDone_.store(false);
+  running_.store(true);
+  writerThread_ = std::thread(&PcmStreamOutput::writerLoop, this);
+  renderThread_ = std::thread(&PcmStreamOutput::renderLoop, this);
+  return true;
+}
+
+void PcmStreamOutput::stop() {
+  if (!running_.load()) {
+    return;
+  }
+  running_.store(false);
+  // The renderer goes first so the writer can flush what is left.
+  if (renderThread_.joinable()) renderThread_.join();
+  if (writerThread_.joinable()) writerThread_.join();
+}
+
+std::size_t PcmStreamOutput::ringUsed() const {
+  return ringWritten_.load(std::memory_order_acquire) - ringRead_.load(std::memory_order_acquire);
+}
+
+bool PcmStreamOutput::push(const std::uint8_t* data, std::size_t size) {
+  std::size_t written = ringWritten_.load(std::memory_order_relaxed);
+  std::size_t read = ringRead_.load(std::memory_order_acquire);
+  if (size > kRingBytes - (written - read)) return false;
+  std::size_t start = written & (kRingBytes - 1);
+  std::size_t first = size < kRingBytes - start ? size : kRingBytes - start;
+  std::memcpy(ring_.get() + start, data, first);
+  std::memcpy(ring_.get(), data + first, size - first);
+  ringWritten_.store(written + size, std::memory_order_release);
+  return true;
+}
+
+void PcmStreamOutput::renderLoop() {
+  const std::size_t frameBytes = format_ == PcmStreamFormat::S16 ? 2 : 4;
+  const std::size_t blockBytes = kBlockFrames * frameBytes;
+  float block[kBlockFrames];
+  std::int16_t pcm[kBlockFrames];
+  const auto started = std::chrono::steady_clock::now();
+  std::uint64_t frames = 0;
+  while (running_.load()) {
+    if (pacing_ == PcmStreamPacing::WallClock) {
+      // Block N is due once the clock is aheadFrames_ short of its start.
+      std::uint64_t lead = frames > aheadFrames_ ? frames - aheadFrames_ : 0;
+      std::this_thread::sleep_until(
+          started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(static_cast<double>(lead) / sampleRate_)));
+    } else if (kRingBytes - ringUsed() < blockBytes) {
+      std::this_thread::sleep_for(kRenderWait);
+      continue;
+    }
+
+    render_(block, kBlockFrames);
+    // Both formats go out in native byte order, little endian on every
+    // desktop the build targets.
+    const std::uint8_t* wire = reinterpret_cast<const std::uint8_t*>(block);
+    if (format_ == PcmStreamFormat::S16) {
+      convertFloatToInt16(block, pcm, kBlockFrames, 1.0f);
+      wire = reinterpret_cast<const std::uint8_t*>(pcm);
+    }
+    if (!push(wire, blockBytes)) dropped_.fetch_add(kBlockFrames);
+    frames += kBlockFrames;
+    rendered_.store(frames);
+  }
+  renderDone_.store(true);
+}
+
+bool PcmStreamOutput::connect() {
+  const std::size_t frameBytes = format_ == PcmStreamFormat::S16 ? 2 : 4;
+  while (fd_ < 0 && running_.load()) {
+    if (kind_ == Kind::Socket) {
+      pollfd p{listenFd_, POLLIN, 0};
+      if (::poll(&p, 1, kConnectPollMs) > 0) {
+        int client = ::accept(listenFd_, nullptr, nullptr);
+        if (client >= 0 && setNonBlocking(client)) {
+          fd_ = client;
+          continue;
+        }
+        if (client >= 0) ::close(client);
+      }
+    } else if (kind_ == Kind::Path) {
+      // Non-blocking, a FIFO only opens once it has a reader.
+      int fifo = ::open(path_.c_str(), O_WRONLY | O_NONBLOCK);
+      if (fifo >= 0) {
+        fd_ = fifo;
+        continue;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(kConnectPollMs));
+    } else {
+      return false;
+    }
+    // Nobody is listening; a live stream keeps only what comes next.
+    if (pacing_ == PcmStreamPacing::WallClock) {
+      std::size_t read = ringRead_.load(std::memory_order_relaxed);
+      std::size_t used = ringUsed();
+      ringRead_.store(read + used, std::memory_order_release);
+      dropped_.fetch_add(used / frameBytes);
+    }
+  }
+  return fd_ >= 0;
+}
+
+void PcmStreamOutput::disconnect() {
+  ::close(fd_);
+  fd_ = -1;
+  // Only a socket or a FIFO can get another reader.
+  struct stat st;
+  bool fifo = kind_ == Kind::Path && ::stat(path_.c_str(), &st) == 0 && S_ISFIFO(st.st_mode);
+  if (kind_ != Kind::Socket && !fifo) failed_.store(true);
+}
+
+void PcmStreamOutput::writerLoop() {
+  while (!failed_.load() && connect()) {
+    std::size_t used = ringUsed();
+    if (used == 0) {
+      // The renderer may have pushed its last block since 'used' was read.
+      if (renderDone_.load() && ringUsed() == 0) break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(kWriterPollMs));
+      continue;
+    }
+    pollfd p{fd_, POLLOUT, 0};
+    if (::poll(&p, 1, kWriterPollMs) <= 0) {
+      // A reader that stalls past stop() loses the rest.
+      if (renderDone_.load()) break;
+      continue;
+    }
+    std::size_t read = ringRead_.load(std::memory_order_relaxed);
+    std::size_t start = read & (kRingBytes - 1);
+    std::size_t count = used;
+    if (count > kRingBytes - start) count = kRingBytes - start;
+    if (count > kWriteBytes) count = kWriteBytes;
+    ssize_t n = ::write(fd_, ring_.get() + start, count);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+      disconnect();
+      continue;
+    }
+    ringRead_.store(read + static_cast<std::size_t>(n), std::memory_order_release);
+    written_.fetch_add(static_cast<std::uint64_t>(n));
+  }
+}
+
+#endif  // MINIACID_PCM_STREAM
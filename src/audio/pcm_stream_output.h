@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+// MINIACID_PCM_STREAM comes from the platform build (the desktop target in
+// platform_sdl/Makefile); it needs POSIX file descriptors and threads.
+#ifdef MINIACID_PCM_STREAM
+#if defined(ARDUINO) || defined(__EMSCRIPTEN__) || defined(_WIN32)
+#error "MINIACID_PCM_STREAM is only supported on POSIX desktop builds"
+#endif
+#include <thread>
+#endif
+
+enum class PcmStreamFormat : std::uint8_t {
+  S16 = 0,  // signed 16-bit little endian
+  F32,      // 32-bit float little endian, full scale +-1
+};
+
+enum class PcmStreamPacing : std::uint8_t {
+  // Renders at the sample rate, a little ahead of the wall clock. A reader
+  // that falls behind loses whole blocks; the engine never waits for it.
+  WallClock = 0,
+  // Renders as fast as the reader takes the data, for offline encoders.
+  FreeRun,
+};
+
+#ifdef MINIACID_PCM_STREAM
+
+// Desktop audio output that writes mono engine blocks as raw PCM to stdout,
+// a FIFO, a file or the clients of a Unix domain socket, so MiniAcid can
+// feed encoders, analyzers and mixers directly. A render thread fills a
+// lock-free ring in the wire format and a writer thread writes it out in
+// pieces of up to kWriteBytes straight from the ring memory. Neither
+// thread ever waits on the other: a full ring drops blocks (wall clock)
+// or holds the renderer back (free run), and the writer alone blocks on
+// the file descriptor.
+//
+// Targets: "-" is stdout (whatever the program prints afterwards goes to
+// stderr), "unix:<path>" listens on a socket and streams to one client at
+// a time, anything else is a path opened for writing (a FIFO waits for its
+// reader, and a new reader picks up after the old one leaves).
+class PcmStreamOutput {
+ public:
+  // Fills 'frames' floats of engine output.
+  using RenderFn = std::function<void(float* out, std::size_t frames)>;
+
+  static constexpr std::size_t kRingBytes = 256 * 1024;
+  static constexpr std::size_t kWriteBytes = 64 * 1024;
+  static constexpr std::size_t kBlockFrames = 256;
+  // Default render-ahead in wall clock mode, in frames.
+  static constexpr std::size_t kDefaultAheadFrames = 1024;
+
+  PcmStreamOutput() = default;
+  ~PcmStreamOutput();
+
+  // Prepares 'target'. Returns false when it cannot be used.
+  bool open(const std::string& target);
+  bool start(int sampleRate, PcmStreamFormat format, PcmStreamPacing pacing, RenderFn render);
+  void stop();
+  bool isRunning() const { return running_.load(); }
+  // How far the render runs ahead of the wall clock. Ignored while running.
+  void setAheadFrames(std::size_t frames);
+
+  std::uint64_t renderedFrames() const { return rendered_.load(); }
+  // Frames dropped because the reader was not keeping up, or not there.
+  std::uint64_t droppedFrames() const { return dropped_.load(); }
+  std::uint64_t writtenBytes() const { return written_.load(); }
+  // False once a file or stdout refused a write; sockets and FIFOs wait
+  // for the next reader instead.
+  bool healthy() const { return !failed_.load(); }
+
+ private:
+  enum class Kind : std::uint8_t { None = 0, Stdout, Path, Socket };
+
+  void renderLoop();
+  void writerLoop();
+  // Waits for a reader (socket client, FIFO reader). False on stop.
+  bool connect();
+  void disconnect();
+  bool push(const std::uint8_t* data, std::size_t size);
+  std::size_t ringUsed() const;
+
+  Kind kind_ = Kind::None;
+  std::string path_;
+  int fd_ = -1;
+  int listenFd_ = -1;
+  RenderFn render_;
+  int sampleRate_ = 0;
+  PcmStreamFormat format_ = PcmStreamFormat::S16;
+  PcmStreamPacing pacing_ = PcmStreamPacing::WallClock;
+  std::size_t aheadFrames_ = kDefaultAheadFrames;
+
+  std::unique_ptr<std::uint8_t[]> ring_;
+  std::atomic<std::size_t> ringWritten_{0};
+  std::atomic<std::size_t> ringRead_{0};
+
+  std::atomic<bool> running_{false};
+  std::atomic<bool> failed_{false};
+  // Set once the last block is in the ring; the writer flushes up to it.
+  std::atomic<bool> renderDone_{false};
+  std::atomic<std::uint64_t> rendered_{0};
+  std::atomic<std::uint64_t> dropped_{0};
+  std::atomic<std::uint64_t> written_{0};
+  std::thread renderThread_;
+  std::thread writerThread_;
+};
+
+#endif  // MINIACID_PCM_STREAM
@@ -0,0 +1,490 @@
+#include "recording_codec.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t kPcmBlockSamples = 2048;
+
+constexpr std::size_t kAdpcmBlockBytes = 256;
+constexpr std::size_t kAdpcmBlockSamples = 1 + (kAdpcmBlockBytes - 4) * 2;
+
+constexpr std::size_t kRiceBlockSamples = 2048;
+// sample count, mode and payload size.
+constexpr std::size_t kRiceBlockHeader = 5;
+// Mode byte: 0 is verbatim, otherwise the predictor order in the top three
+// bits and the Rice parameter plus one in the low five.
+constexpr std::uint8_t kRiceVerbatim = 0;
+constexpr int kRiceMaxOrder = 3;
+// Quotients this long are escaped and followed by the raw residual.
+constexpr int kRiceEscape = 24;
+// Zigzagged third-order residuals of 16-bit input fit in 19 bits.
+constexpr int kRiceRawBits = 19;
+constexpr std::uint16_t kRiceVersion = 1;
+
+const int kAdpcmIndexTable[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+const std::int16_t kAdpcmStepTable[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+  11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767,
+};
+
+void writeLE16(std::uint8_t* dst, std::uint16_t value) {
+  dst[0] = static_cast<std::uint8_t>(value & 0xFF);
+  dst[1] = static_cast<std::uint8_t>((value >> 8) & 0xFF);
+}
+
+void writeLE32(std::uint8_t* dst, std::uint32_t value) {
+  dst[0] = static_cast<std::uint8_t>(value & 0xFF);
+  dst[1] = static_cast<std::uint8_t>((value >> 8) & 0xFF);
+  dst[2] = static_cast<std::uint8_t>((value >> 16) & 0xFF);
+  dst[3] = static_cast<std::uint8_t>((value >> 24) & 0xFF);
+}
+
+std::uint16_t readLE16(const std::uint8_t* p) {
+  return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+std::uint32_t readLE32(const std::uint8_t* p) {
+  return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) |
+         (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+int clampIndex(int index) {
+  return index < 0 ? 0 : index > 88 ? 88 : index;
+}
+
+int clampSample(int value) {
+  return value < -32768 ? -32768 : value > 32767 ? 32767 : value;
+}
+
+// One IMA-ADPCM step. Encoder and decoder share it so they stay in lockstep.
+void adpcmApply(int nibble, int& predictor, int& index) {
+  int step = kAdpcmStepTable[index];
+  int diff = step >> 3;
+  if (nibble & 4) diff += step;
+  if (nibble & 2) diff += step >> 1;
+  if (nibble & 1) diff += step >> 2;
+  predictor = clampSample((nibble & 8) ? predictor - diff : predictor + diff);
+  index = clampIndex(index + kAdpcmIndexTable[nibble]);
+}
+
+int adpcmNibble(int sample, int predictor, int index) {
+  int step = kAdpcmStepTable[index];
+  int diff = sample - predictor;
+  int nibble = 0;
+  if (diff < 0) {
+    nibble = 8;
+    diff = -diff;
+  }
+  if (diff >= step) {
+    nibble |= 4;
+    diff -= step;
+  }
+  if (diff >= (step >> 1)) {
+    nibble |= 2;
+    diff -= step >> 1;
+  }
+  if (diff >= (step >> 2)) nibble |= 1;
+  return nibble;
+}
+
+std::uint32_t zigzag(std::int32_t value) {
+  return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+}
+
+std::int32_t unzigzag(std::uint32_t value) {
+  return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+}
+
+// Fixed polynomial predictors, as in FLAC.
+std::int32_t predict(const std::int16_t* x, std::size_t i, int order) {
+  const std::int32_t a = x[i - 1];
+  if (order == 1) return a;
+  const std::int32_t b = x[i - 2];
+  if (order == 2) return 2 * a - b;
+  return 3 * a - 3 * b + x[i - 3];
+}
+
+class BitWriter {
+ public:
+  BitWriter(std::uint8_t* out, std::size_t capacity) : out_(out), capacity_(capacity) {}
+
+  // Returns false once the block no longer fits.
+  bool put(std::uint32_t bits, int count) {
+    while (count > 0) {
+      int take = count < 8 - used_ ? count : 8 - used_;
+      std::uint32_t chunk = (bits >> (count - take)) & ((1u << take) - 1u);
+      current_ = static_cast<std::uint8_t>(current_ | (chunk << (8 - used_ - take)));
+      used_ += take;
+      count -= take;
+      if (used_ == 8 && !flushByte()) return false;
+    }
+    return true;
+  }
+  bool ones(int count) {
+    for (; count > 24; count -= 24) {
+      if (!put(0xFFFFFFu, 24)) return false;
+    }
+    return put((1u << count) - 1u, count);
+  }
+  bool finish() { return used_ == 0 || flushByte(); }
+  std::size_t size() const { return size_; }
+
+ private:
+  bool flushByte() {
+    if (size_ >= capacity_) return false;
+    out_[size_++] = current_;
+    current_ = 0;
+    used_ = 0;
+    return true;
+  }
+
+  std::uint8_t* out_;
+  std::size_t capacity_;
+  std::size_t size_ = 0;
+  std::uint8_t current_ = 0;
+  int used_ = 0;
+};
+
+class BitReader {
+ public:
+  BitReader(const std::uint8_t* in, std::size_t size) : in_(in), size_(size) {}
+
+  bool get(int count, std::uint32_t& value) {
+    value = 0;
+    while (count-- > 0) {
+      if (pos_ >= size_ * 8) return false;
+      value = (value << 1) | ((in_[pos_ >> 3] >> (7 - (pos_ & 7))) & 1u);
+      ++pos_;
+    }
+    return true;
+  }
+
+ private:
+  const std::uint8_t* in_;
+  std::size_t size_;
+  std::size_t pos_ = 0;
+};
+
+bool decodeRiceBlock(const std::uint8_t* block, std::size_t size, std::size_t& used,
+                     std::vector<std::int16_t>& out) {
+  if (size < kRiceBlockHeader) return false;
+  std::size_t count = readLE16(block);
+  std::uint8_t mode = block[2];
+  std::size_t payload = readLE16(block + 3);
+  if (count == 0 || count > kRiceBlockSamples || payload > size - kRiceBlockHeader) return false;
+  const std::uint8_t* p = block + kRiceBlockHeader;
+  used = kRiceBlockHeader + payload;
+  std::size_t base = out.size();
+  if (mode == kRiceVerbatim) {
+    if (payload != count * 2) return false;
+    for (std::size_t i = 0; i < count; ++i) {
+      out.push_back(static_cast<std::int16_t>(readLE16(p + i * 2)));
+    }
+    return true;
+  }
+  int order = mode >> 5;
+  int k = (mode & 0x1F) - 1;
+  if (order < 1 || order > kRiceMaxOrder || k < 0) return false;
+  std::size_t warmup = static_cast<std::size_t>(order);
+  if (count <= warmup) return false;
+  if (payload < warmup * 2) return false;
+  for (std::size_t i = 0; i < warmup; ++i) {
+    out.push_back(static_cast<std::int16_t>(readLE16(p + i * 2)));
+  }
+  BitReader reader(p + warmup * 2, payload - warmup * 2);
+  for (std::size_t i = warmup; i < count; ++i) {
+    int q = 0;
+    std::uint32_t bit = 1;
+    while (q < kRiceEscape) {
+      if (!reader.get(1, bit)) return false;
+      if (!bit) break;
+      ++q;
+    }
+    std::uint32_t u = 0;
+    if (q == kRiceEscape) {
+      if (!reader.get(kRiceRawBits, u)) return false;
+    } else {
+      std::uint32_t low = 0;
+      if (!reader.get(k, low)) return false;
+      u = (static_cast<std::uint32_t>(q) << k) | low;
+    }
+    const std::int16_t* x = out.data() + base;
+    std::int32_t value = predict(x, i, order) + unzigzag(u);
+    if (value < -32768 || value > 32767) return false;
+    out.push_back(static_cast<std::int16_t>(value));
+  }
+  return true;
+}
+
+}  // namespace
+
+const char* recordingFormatExtension(RecordingFormat format) {
+  return format == RecordingFormat::RiceLossless ? "mar" : "wav";
+}
+
+std::size_t recordingBlockSamples(RecordingFormat format) {
+  switch (format) {
+    case RecordingFormat::ImaAdpcm: return kAdpcmBlockSamples;
+    case RecordingFormat::RiceLossless: return kRiceBlockSamples;
+    case RecordingFormat::Pcm16: break;
+  }
+  return kPcmBlockSamples;
+}
+
+std::size_t recordingMaxBlockBytes(RecordingFormat format) {
+  switch (format) {
+    case RecordingFormat::ImaAdpcm: return kAdpcmBlockBytes;
+    case RecordingFormat::RiceLossless: return kRiceBlockHeader + kRiceBlockSamples * 2;
+    case RecordingFormat::Pcm16: break;
+  }
+  return kPcmBlockSamples * 2;
+}
+
+std::size_t recordingHeaderBytes(RecordingFormat format) {
+  switch (format) {
+    case RecordingFormat::ImaAdpcm: return 60;
+    case RecordingFormat::RiceLossless: return 24;
+    case RecordingFormat::Pcm16: break;
+  }
+  return 44;
+}
+
+std::size_t writeRecordingHeader(RecordingFormat format, int sampleRate, int channels,
+                                 std::uint32_t samples, std::uint32_t dataBytes,
+                                 std::uint8_t* out) {
+  const std::uint32_t rate = static_cast<std::uint32_t>(sampleRate);
+  if (format == RecordingFormat::RiceLossless) {
+    std::memcpy(out, "MARC", 4);
+    writeLE16(out + 4, kRiceVersion);
+    writeLE16(out + 6, static_cast<std::uint16_t>(channels));
+    writeLE32(out + 8, rate);
+    writeLE32(out + 12, samples);
+    writeLE32(out + 16, static_cast<std::uint32_t>(kRiceBlockSamples));
+    writeLE32(out + 20, dataBytes);
+    return 24;
+  }
+
+  const std::size_t size = recordingHeaderBytes(format);
+  std::memcpy(out, "RIFF", 4);
+  writeLE32(out + 4, static_cast<std::uint32_t>(size - 8) + dataBytes);
+  std::memcpy(out + 8, "WAVE", 4);
+  std::memcpy(out + 12, "fmt ", 4);
+  std::uint8_t* fmt = out + 20;
+  if (format == RecordingFormat::ImaAdpcm) {
+    writeLE32(out + 16, 20);
+    writeLE16(fmt, 0x0011);
+    writeLE16(fmt + 2, static_cast<std::uint16_t>(channels));
+    writeLE32(fmt + 4, rate);
+    writeLE32(fmt + 8, static_cast<std::uint32_t>(rate * kAdpcmBlockBytes / kAdpcmBlockSamples));
+    writeLE16(fmt + 12, static_cast<std::uint16_t>(kAdpcmBlockBytes));
+    writeLE16(fmt + 14, 4);
+    writeLE16(fmt + 16, 2);
+    writeLE16(fmt + 18, static_cast<std::uint16_t>(kAdpcmBlockSamples));
+    std::memcpy(out + 40, "fact", 4);
+    writeLE32(out + 44, 4);
+    writeLE32(out + 48, samples);
+  } else {
+    writeLE32(out + 16, 16);
+    writeLE16(fmt, 1);
+    writeLE16(fmt + 2, static_cast<std::uint16_t>(channels));
+    writeLE32(fmt + 4, rate);
+    writeLE32(fmt + 8, rate * static_cast<std::uint32_t>(channels) * 2);
+    writeLE16(fmt + 12, static_cast<std::uint16_t>(channels * 2));
+    writeLE16(fmt + 14, 16);
+  }
+  std::memcpy(out + size - 8, "data", 4);
+  writeLE32(out + size - 4, dataBytes);
+  return size;
+}
+
+void RecordingEncoder::reset(RecordingFormat format) {
+  format_ = format;
+  adpcmIndex_ = 0;
+}
+
+std::size_t RecordingEncoder::encodeBlock(const std::int16_t* in, std::size_t count,
+                                          std::uint8_t* out) {
+  if (count == 0) return 0;
+  if (count > recordingBlockSamples(format_)) count = recordingBlockSamples(format_);
+  switch (format_) {
+    case RecordingFormat::ImaAdpcm: return encodeAdpcm(in, count, out);
+    case RecordingFormat::RiceLossless: return encodeRice(in, count, out);
+    case RecordingFormat::Pcm16: break;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    writeLE16(out + i * 2, static_cast<std::uint16_t>(in[i]));
+  }
+  return count * 2;
+}
+
+std::size_t RecordingEncoder::encodeAdpcm(const std::int16_t* in, std::size_t count,
+                                          std::uint8_t* out) {
+  // The block header carries the first sample exactly; the step index runs
+  // on from the previous block. A short last block is padded with its final
+  // sample, and the 'fact' chunk holds the real length.
+  int predictor = in[0];
+  int index = adpcmIndex_;
+  writeLE16(out, static_cast<std::uint16_t>(predictor));
+  out[2] = static_cast<std::uint8_t>(index);
+  out[3] = 0;
+  std::uint8_t* data = out + 4;
+  std::memset(data, 0, kAdpcmBlockBytes - 4);
+  for (std::size_t i = 1; i < kAdpcmBlockSamples; ++i) {
+    int sample = in[i < count ? i : count - 1];
+    int nibble = adpcmNibble(sample, predictor, index);
+    adpcmApply(nibble, predictor, index);
+    std::size_t n = i - 1;
+    data[n >> 1] = static_cast<std::uint8_t>(data[n >> 1] | (nibble << ((n & 1) * 4)));
+  }
+  adpcmIndex_ = index;
+  return kAdpcmBlockBytes;
+}
+
+std::size_t RecordingEncoder::encodeRice(const std::int16_t* in, std::size_t count,
+                                         std::uint8_t* out) {
+  std::uint8_t* payload = out + kRiceBlockHeader;
+  const std::size_t raw = count * 2;
+  writeLE16(out, static_cast<std::uint16_t>(count));
+
+  // The order with the smallest residuals wins; 'sum' also sets k.
+  int order = 0;
+  std::uint64_t sum = 0;
+  for (int o = 1; o <= kRiceMaxOrder && static_cast<std::size_t>(o) < count; ++o) {
+    std::uint64_t total = 0;
+    for (std::size_t i = static_cast<std::size_t>(kRiceMaxOrder); i < count; ++i) {
+      total += zigzag(in[i] - predict(in, i, o));
+    }
+    if (order == 0 || total < sum) {
+      order = o;
+      sum = total;
+    }
+  }
+  const std::size_t warmup = static_cast<std::size_t>(order);
+  int k = 0;
+  if (count > warmup) {
+    std::uint64_t mean = sum / (count - warmup);
+    while (k < 16 && (1ull << (k + 1)) <= mean) ++k;
+  }
+
+  bool fits = order > 0 && count > warmup;
+  std::size_t size = 0;
+  if (fits) {
+    for (std::size_t i = 0; i < warmup; ++i) {
+      writeLE16(payload + i * 2, static_cast<std::uint16_t>(in[i]));
+    }
+    // Anything not smaller than the raw samples is stored verbatim.
+    BitWriter bits(payload + warmup * 2, raw - warmup * 2 - 1);
+    for (std::size_t i = warmup; i < count && fits; ++i) {
+      std::uint32_t u = zigzag(in[i] - predict(in, i, order));
+      std::uint32_t q = u >> k;
+      if (q >= static_cast<std::uint32_t>(kRiceEscape)) {
+        fits = bits.ones(kRiceEscape) && bits.put(u, kRiceRawBits);
+      } else {
+        fits = bits.ones(static_cast<int>(q)) && bits.put(0, 1) &&
+               bits.put(u & ((1u << k) - 1u), k);
+      }
+    }
+    fits = fits && bits.finish();
+    size = warmup * 2 + bits.size();
+  }
+  if (!fits) {
+    out[2] = kRiceVerbatim;
+    for (std::size_t i = 0; i < count; ++i) {
+      writeLE16(payload + i * 2, static_cast<std::uint16_t>(in[i]));
+    }
+    size = raw;
+  } else {
+    out[2] = static_cast<std::uint8_t>((order << 5) | (k + 1));
+  }
+  writeLE16(out + 3, static_cast<std::uint16_t>(size));
+  return kRiceBlockHeader + size;
+}
+
+bool decodeRecording(const std::uint8_t* data, std::size_t size, std::vector<std::int16_t>& out,
+                     int& sampleRate) {
+  out.clear();
+  if (!data || size < 24) return false;
+
+  if (std::memcmp(data, "MARC", 4) == 0) {
+    if (readLE16(data + 4) != kRiceVersion || readLE16(data + 6) != 1) return false;
+    sampleRate = static_cast<int>(readLE32(data + 8));
+    std::uint32_t samples = readLE32(data + 12);
+    std::size_t end = 24 + static_cast<std::size_t>(readLE32(data + 20));
+    if (end > size) end = size;
+    out.reserve(samples);
+    std::size_t pos = 24;
+    while (pos < end && out.size() < samples) {
+      std::size_t used = 0;
+      if (!decodeRiceBlock(data + pos, end - pos, used, out)) return false;
+      pos += used;
+    }
+    return out.size() == samples;
+  }
+
+  if (size < 44 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+  std::uint16_t format = 0;
+  std::uint16_t channels = 0;
+  std::uint16_t blockAlign = 0;
+  std::uint16_t blockSamples = 0;
+  std::uint32_t factSamples = 0;
+  bool haveFact = false;
+  std::size_t offset = 12;
+  while (offset + 8 <= size) {
+    const std::uint8_t* chunk = data + offset;
+    std::uint32_t chunkSize = readLE32(chunk + 4);
+    const std::uint8_t* body = chunk + 8;
+    std::size_t available = size - offset - 8;
+    if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+      format = readLE16(body);
+      channels = readLE16(body + 2);
+      sampleRate = static_cast<int>(readLE32(body + 4));
+      blockAlign = readLE16(body + 12);
+      if (format == 0x0011 && chunkSize >= 20 && available >= 20) blockSamples = readLE16(body + 18);
+    } else if (std::memcmp(chunk, "fact", 4) == 0 && available >= 4) {
+      factSamples = readLE32(body);
+      haveFact = true;
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      if (channels != 1) return false;
+      std::size_t bytes = chunkSize < available ? chunkSize : available;
+      if (format == 1) {
+        for (std::size_t i = 0; i + 1 < bytes; i += 2) {
+          out.push_back(static_cast<std::int16_t>(readLE16(body + i)));
+        }
+        return true;
+      }
+      if (format != 0x0011 || blockAlign < 4 || blockSamples != 1 + (blockAlign - 4) * 2) {
+        return false;
+      }
+      for (std::size_t b = 0; b + blockAlign <= bytes; b += blockAlign) {
+        const std::uint8_t* block = body + b;
+        int predictor = static_cast<std::int16_t>(readLE16(block));
+        int index = block[2];
+        if (index > 88) return false;
+        out.push_back(static_cast<std::int16_t>(predictor));
+        for (int n = 0; n + 1 < blockSamples; ++n) {
+          int nibble = (block[4 + (n >> 1)] >> ((n & 1) * 4)) & 0x0F;
+          adpcmApply(nibble, predictor, index);
+          out.push_back(static_cast<std::int16_t>(predictor));
+        }
+      }
+      if (haveFact && factSamples < out.size()) out.resize(factSamples);
+      return true;
+    }
+    std::size_t next = static_cast<std::size_t>(chunkSize) + (chunkSize & 1u);
+    if (next > available) return false;
+    offset += 8 + next;
+  }
+  return false;
+}
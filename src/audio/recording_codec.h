@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How recordings are stored. PCM and IMA-ADPCM are WAV files any player
+// opens; the lossless mode is MiniAcid's own ".mar" file, which
+// decodeRecording() (and the desktop miniacid-decode tool) turns back into
+// WAV.
+enum class RecordingFormat : std::uint8_t {
+  Pcm16 = 0,
+  // 4 bits per sample, 4:1. 256-byte blocks of 505 samples.
+  ImaAdpcm,
+  // Fixed polynomial prediction (order 1-3 per block) with Rice-coded
+  // residuals. Bright, loud acid lines only shrink by about a fifth; quiet
+  // or sparse material does much better. Blocks that would grow are stored
+  // verbatim.
+  RiceLossless,
+};
+
+// File extension without the dot.
+const char* recordingFormatExtension(RecordingFormat format);
+// Samples per encoded block (mono). Every block but the last is full.
+std::size_t recordingBlockSamples(RecordingFormat format);
+// Largest encoded block, header included.
+std::size_t recordingMaxBlockBytes(RecordingFormat format);
+// Size of the file header, the same before and after the counts are known.
+std::size_t recordingHeaderBytes(RecordingFormat format);
+// Writes recordingHeaderBytes() bytes to 'out'. Pass zero counts for the
+// placeholder written at the start.
+std::size_t writeRecordingHeader(RecordingFormat format, int sampleRate, int channels,
+                                 std::uint32_t samples, std::uint32_t dataBytes,
+                                 std::uint8_t* out);
+
+// Block encoder for mono recordings. Cheap enough for the recorder's
+// writer thread on the Cardputer: a few integer operations per sample.
+class RecordingEncoder {
+ public:
+  void reset(RecordingFormat format);
+  RecordingFormat format() const { return format_; }
+
+  // Encodes up to recordingBlockSamples() samples into 'out' and returns
+  // the bytes written.
+  std::size_t encodeBlock(const std::int16_t* in, std::size_t count, std::uint8_t* out);
+
+ private:
+  std::size_t encodeAdpcm(const std::int16_t* in, std::size_t count, std::uint8_t* out);
+  std::size_t encodeRice(const std::int16_t* in, std::size_t count, std::uint8_t* out);
+
+  RecordingFormat format_ = RecordingFormat::Pcm16;
+  int adpcmIndex_ = 0;
+};
+
+// Decodes a whole recording file held in memory to 16-bit samples.
+// Returns false for anything that is not a mono recording written by
+// RecordingEncoder (or a plain 16-bit PCM WAV).
+bool decodeRecording(const std::uint8_t* data, std::size_t size, std::vector<std::int16_t>& out,
+                     int& sampleRate);
@@ -0,0 +1,166 @@
+#include "song_bouncer.h"
+
+#if defined(ESP_PLATFORM) && defined(MINIACID_BOUNCE_THREAD)
+#include <esp_pthread.h>
+#endif
+#if defined(__linux__) && defined(MINIACID_BOUNCE_THREAD)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// How long the render waits for the recorder to make room.
+constexpr auto kRecorderWait = std::chrono::milliseconds(2);
+
+}  // namespace
+
+SongBouncer::~SongBouncer() {
+  cancel();
+#ifdef MINIACID_BOUNCE_THREAD
+  if (thread_.joinable()) thread_.join();
+#else
+  while (renderSome(AUDIO_BUFFER_SAMPLES)) {
+  }
+#endif
+}
+
+void SongBouncer::setRecorder(IAudioRecorder* recorder) {
+  if (isRendering()) {
+    return;
+  }
+  recorder_ = recorder;
+}
+
+bool SongBouncer::start(std::unique_ptr<MiniAcid> engine) {
+  if (!recorder_ || !engine || isRendering()) {
+    return false;
+  }
+#ifdef MINIACID_BOUNCE_THREAD
+  if (thread_.joinable()) thread_.join();
+#endif
+
+  engine->setSongMode(true);
+  engine->setLoopMode(false);
+  engine->setSongPosition(0);
+  engine->start();
+  sampleRate_ = static_cast<int>(engine->sampleRate());
+  // Swing moves steps within the bar, never the bar lines.
+  double stepSeconds = 15.0 / static_cast<double>(engine->bpm());
+  double frames = engine->songLength() * SEQ_STEPS * stepSeconds * sampleRate_;
+  totalFrames_ = static_cast<std::uint32_t>(frames + 0.5);
+  if (!recorder_->start(sampleRate_, 1)) {
+    state_.store(State::Failed);
+    return false;
+  }
+  filename_ = recorder_->filename();
+  engine_ = std::move(engine);
+  framesDone_.store(0);
+  renderSeconds_.store(0.0f);
+  cancelRequested_.store(false);
+  started_ = std::chrono::steady_clock::now();
+  state_.store(State::Rendering);
+#ifdef MINIACID_BOUNCE_THREAD
+#if defined(ESP_PLATFORM)
+  // Below the audio task and the recorder's writer, on the UI core.
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = 8192;
+  cfg.prio = 1;
+  cfg.pin_to_core = 0;
+  cfg.thread_name = "songBounce";
+  esp_pthread_set_cfg(&cfg);
+#endif
+  thread_ = std::thread(&SongBouncer::renderLoop, this);
+#endif
+  return true;
+}
+
+void SongBouncer::cancel() {
+  if (isRendering()) {
+    cancelRequested_.store(true);
+  }
+}
+
+void SongBouncer::update() {
+#ifdef MINIACID_BOUNCE_THREAD
+  if (!isRendering() && thread_.joinable()) thread_.join();
+#else
+  if (!isRendering()) {
+    return;
+  }
+  const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(kSliceMs);
+  while (std::chrono::steady_clock::now() < until) {
+    if (!renderSome(AUDIO_BUFFER_SAMPLES * 8)) break;
+  }
+#endif
+}
+
+float SongBouncer::progress() const {
+  if (totalFrames_ == 0) {
+    return state() == State::Done ? 1.0f : 0.0f;
+  }
+  return static_cast<float>(framesDone_.load()) / static_cast<float>(totalFrames_);
+}
+
+float SongBouncer::songSeconds() const {
+  if (sampleRate_ <= 0) {
+    return 0.0f;
+  }
+  return static_cast<float>(totalFrames_) / static_cast<float>(sampleRate_);
+}
+
+#ifdef MINIACID_BOUNCE_THREAD
+void SongBouncer::renderLoop() {
+#if defined(__linux__)
+  // Let the audio callback and the UI win every contest for the CPU.
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+  while (renderSome(AUDIO_BUFFER_SAMPLES)) {
+  }
+}
+#endif
+
+bool SongBouncer::renderSome(std::size_t maxFrames) {
+  if (!isRendering()) {
+    return false;
+  }
+  std::uint32_t done = framesDone_.load();
+  std::size_t rendered = 0;
+  while (rendered < maxFrames && done < totalFrames_) {
+    if (cancelRequested_.load()) {
+      finish(State::Cancelled);
+      return false;
+    }
+    std::size_t count = totalFrames_ - done;
+    if (count > AUDIO_BUFFER_SAMPLES) count = AUDIO_BUFFER_SAMPLES;
+    engine_->generateAudioBuffer(block_, count);
+    // The clone stands in for the UI thread that pages banks in live.
+    engine_->updateBankPaging();
+    while (!recorder_->offerSamples(block_, count)) {
+      if (cancelRequested_.load() || !recorder_->isRecording()) {
+        finish(cancelRequested_.load() ? State::Cancelled : State::Failed);
+        return false;
+      }
+#ifdef MINIACID_BOUNCE_THREAD
+      std::this_thread::sleep_for(kRecorderWait);
+#endif
+    }
+    done += static_cast<std::uint32_t>(count);
+    rendered += count;
+    framesDone_.store(done);
+  }
+  if (done < totalFrames_) {
+    return true;
+  }
+  finish(State::Done);
+  return false;
+}
+
+void SongBouncer::finish(State state) {
+  recorder_->stop();
+  engine_.reset();
+  std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - started_;
+  renderSeconds_.store(elapsed.count());
+  state_.store(state);
+}
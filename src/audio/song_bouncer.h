@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "audio_recorder.h"
+#include "../dsp/miniacid_engine.h"
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define MINIACID_BOUNCE_THREAD 1
+#include <thread>
+#endif
+
+// Exports the song arrangement to a file while the live engine keeps
+// playing. start() takes a clone of the engine (see
+// MiniAcid::cloneForSongRender()) and renders its song once from the top
+// on a low-priority thread, as fast as the recorder takes the samples.
+// Without threads (the web build without pthreads) update() renders a
+// slice of the song per call instead. The file ends with the last step of
+// the song; a cancelled export keeps what was rendered so far.
+class SongBouncer {
+ public:
+  enum class State : std::uint8_t {
+    Idle = 0,
+    Rendering,
+    Done,
+    Cancelled,
+    Failed,
+  };
+  // Rendering time update() may take per call, without a thread.
+  static constexpr int kSliceMs = 20;
+
+  SongBouncer() = default;
+  ~SongBouncer();
+
+  // Where exports go: a recorder of its own, not the one used live.
+  void setRecorder(IAudioRecorder* recorder);
+  bool available() const { return recorder_ != nullptr; }
+
+  // Starts rendering 'engine's song. Call from the UI thread. Returns false
+  // when no recorder is set, an export is running or the file cannot be
+  // created.
+  bool start(std::unique_ptr<MiniAcid> engine);
+  // Stops the render at the next block; the file is closed as it is.
+  void cancel();
+  // Call regularly from the UI thread: renders without a thread and
+  // cleans up once the render has ended.
+  void update();
+
+  State state() const { return state_.load(); }
+  bool isRendering() const { return state() == State::Rendering; }
+  // Rendered part of the song, 0..1.
+  float progress() const;
+  // File of the current or last export.
+  const std::string& filename() const { return filename_; }
+  // Length of the song and the time spent rendering it, for the last export.
+  float songSeconds() const;
+  float renderSeconds() const { return renderSeconds_.load(); }
+
+ private:
+  // Renders up to 'maxFrames' and returns false once the render is over.
+  bool renderSome(std::size_t maxFrames);
+  void finish(State state);
+#ifdef MINIACID_BOUNCE_THREAD
+  void renderLoop();
+#endif
+
+  IAudioRecorder* recorder_ = nullptr;
+  std::unique_ptr<MiniAcid> engine_;
+  std::string filename_;
+  std::atomic<State> state_{State::Idle};
+  std::atomic<bool> cancelRequested_{false};
+  std::atomic<std::uint32_t> framesDone_{0};
+  std::uint32_t totalFrames_ = 0;
+  int sampleRate_ = 0;
+  std::chrono::steady_clock::time_point started_;
+  std::atomic<float> renderSeconds_{0.0f};
+  std::int16_t block_[AUDIO_BUFFER_SAMPLES];
+#ifdef MINIACID_BOUNCE_THREAD
+  std::thread thread_;
+#endif
+};
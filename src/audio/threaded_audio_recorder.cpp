@@ -0,0 +1,302 @@
+#include "threaded_audio_recorder.h"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#if defined(ESP_PLATFORM) && defined(MINIACID_RECORDER_THREAD)
+#include <esp_pthread.h>
+#endif
+
+namespace {
+
+// A chunk is ~45 ms of mono audio at 44.1 kHz, so polling at this interval
+// keeps the writer well ahead of the ring.
+constexpr auto kWriterPoll = std::chrono::milliseconds(10);
+
+}  // namespace
+
+bool SampleRing::allocate(std::size_t capacity) {
+  std::size_t size = 1;
+  while (size < capacity) size <<= 1;
+  if (!data_ || mask_ + 1 != size) {
+    data_.reset(new (std::nothrow) std::int16_t[size]);
+    if (!data_) {
+      mask_ = 0;
+      return false;
+    }
+    mask_ = size - 1;
+  }
+  clear();
+  return true;
+}
+
+void SampleRing::release() {
+  data_.reset();
+  mask_ = 0;
+  clear();
+}
+
+void SampleRing::clear() {
+  written_.store(0);
+  read_.store(0);
+}
+
+std::size_t SampleRing::available() const {
+  return written_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire);
+}
+
+bool SampleRing::push(const std::int16_t* samples, std::size_t count) {
+  if (!data_) return false;
+  std::size_t written = written_.load(std::memory_order_relaxed);
+  std::size_t read = read_.load(std::memory_order_acquire);
+  if (count > capacity() - (written - read)) return false;
+  std::size_t start = written & mask_;
+  std::size_t first = count < capacity() - start ? count : capacity() - start;
+  std::memcpy(data_.get() + start, samples, first * sizeof(std::int16_t));
+  std::memcpy(data_.get(), samples + first, (count - first) * sizeof(std::int16_t));
+  written_.store(written + count, std::memory_order_release);
+  return true;
+}
+
+std::size_t SampleRing::pop(std::int16_t* dst, std::size_t maxCount) {
+  if (!data_) return 0;
+  std::size_t read = read_.load(std::memory_order_relaxed);
+  std::size_t written = written_.load(std::memory_order_acquire);
+  std::size_t count = written - read;
+  if (count > maxCount) count = maxCount;
+  std::size_t start = read & mask_;
+  std::size_t first = count < capacity() - start ? count : capacity() - start;
+  std::memcpy(dst, data_.get() + start, first * sizeof(std::int16_t));
+  std::memcpy(dst + first, data_.get(), (count - first) * sizeof(std::int16_t));
+  read_.store(read + count, std::memory_order_release);
+  return count;
+}
+
+ThreadedAudioRecorder::~ThreadedAudioRecorder() {
+#ifdef MINIACID_RECORDER_THREAD
+  // Only reached if a subclass did not stop(); the sink is gone by now.
+  if (writer_.joinable()) {
+    stopRequested_.store(true);
+    writer_.join();
+  }
+#endif
+}
+
+bool ThreadedAudioRecorder::start(int sampleRate, int channels) {
+  if (recording_.load()) {
+    return false;
+  }
+  const int names = static_cast<int>(trackNames_.size());
+  const bool split = names > 1;
+  if (channels < 1 || (split && names != channels)) {
+    return false;
+  }
+  // Compressed formats only come in mono files.
+  if (format_ != RecordingFormat::Pcm16 && channels != 1 && !split) {
+    return false;
+  }
+  channels_ = channels;
+  trackCount_ = split ? channels : 1;
+  if (!allocate()) {
+    return false;
+  }
+
+  for (int t = 0; t < trackCount_; ++t) {
+    std::string filename;
+    const char* name = names > 0 ? trackNames_[t].c_str() : "";
+    if (!openSink(t, name, recordingFormatExtension(format_), filename)) {
+      while (t-- > 0) closeSink(t, nullptr, 0);
+      releaseBuffers();
+      return false;
+    }
+    if (t == 0) filename_ = filename;
+  }
+  sampleRate_ = sampleRate;
+  samples_ = 0;
+  blockCount_ = 0;
+  std::uint8_t header[64];
+  std::size_t headerSize =
+      writeRecordingHeader(format_, sampleRate_, split ? 1 : channels_, 0, 0, header);
+  for (int t = 0; t < trackCount_; ++t) {
+    tracks_[t].encoder.reset(format_);
+    writeSink(t, header, headerSize);
+  }
+  dropped_.store(0);
+  dataBytes_.store(0);
+  stopRequested_.store(false);
+#ifdef MINIACID_RECORDER_THREAD
+#if defined(ESP_PLATFORM)
+  // Below the audio task, on the core the audio task leaves to the UI.
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = 6144;
+  cfg.prio = 2;
+  cfg.pin_to_core = 0;
+  cfg.thread_name = "recWriter";
+  esp_pthread_set_cfg(&cfg);
+#endif
+  writer_ = std::thread(&ThreadedAudioRecorder::writerLoop, this);
+#endif
+  recording_.store(true);
+  return true;
+}
+
+void ThreadedAudioRecorder::stop() {
+  if (!recording_.load()) {
+    return;
+  }
+
+  recording_.store(false);
+  while (pushing_.load() != 0) {
+#ifdef MINIACID_RECORDER_THREAD
+    std::this_thread::yield();
+#endif
+  }
+  stopRequested_.store(true);
+#ifdef MINIACID_RECORDER_THREAD
+  if (writer_.joinable()) writer_.join();
+#else
+  drain(true);
+#endif
+  const int fileChannels = trackCount_ > 1 ? 1 : channels_;
+  for (int t = 0; t < trackCount_; ++t) {
+    std::uint8_t header[64];
+    std::size_t headerSize = writeRecordingHeader(format_, sampleRate_, fileChannels, samples_,
+                                                  tracks_[t].dataBytes, header);
+    closeSink(t, header, headerSize);
+  }
+  releaseBuffers();
+}
+
+bool ThreadedAudioRecorder::isRecording() const {
+  return recording_.load();
+}
+
+void ThreadedAudioRecorder::writeSamples(const int16_t* samples, size_t sampleCount) {
+  if (!samples || sampleCount == 0) {
+    return;
+  }
+
+  pushing_.fetch_add(1);
+  if (recording_.load()) {
+    if (!ring_.push(samples, sampleCount)) {
+      dropped_.fetch_add(static_cast<std::uint32_t>(sampleCount));
+    }
+#ifndef MINIACID_RECORDER_THREAD
+    drain(false);
+#endif
+  }
+  pushing_.fetch_sub(1);
+}
+
+bool ThreadedAudioRecorder::offerSamples(const int16_t* samples, size_t sampleCount) {
+  if (!samples || sampleCount == 0) {
+    return true;
+  }
+
+  pushing_.fetch_add(1);
+  bool queued = false;
+  if (recording_.load()) {
+    queued = ring_.push(samples, sampleCount);
+#ifndef MINIACID_RECORDER_THREAD
+    drain(false);
+#endif
+  }
+  pushing_.fetch_sub(1);
+  return queued;
+}
+
+const std::string& ThreadedAudioRecorder::filename() const {
+  return filename_;
+}
+
+bool ThreadedAudioRecorder::setFormat(RecordingFormat format) {
+  if (recording_.load()) {
+    return false;
+  }
+  format_ = format;
+  return true;
+}
+
+bool ThreadedAudioRecorder::setTrackNames(const std::vector<std::string>& names) {
+  if (recording_.load() || names.size() > static_cast<std::size_t>(kMaxTracks)) {
+    return false;
+  }
+  trackNames_ = names;
+  return true;
+}
+
+bool ThreadedAudioRecorder::allocate() {
+  const std::size_t blockSamples = recordingBlockSamples(format_);
+  const std::size_t outBytes = kChunkBytes + recordingMaxBlockBytes(format_);
+  tracks_.reset(new (std::nothrow) Track[trackCount_]);
+  block_.reset(new (std::nothrow) std::int16_t[blockSamples * trackCount_]);
+  if (trackCount_ > 1) mono_.reset(new (std::nothrow) std::int16_t[blockSamples]);
+  bool ok = tracks_ && block_ && (trackCount_ == 1 || mono_);
+  for (int t = 0; ok && t < trackCount_; ++t) {
+    tracks_[t].out.reset(new (std::nothrow) std::uint8_t[outBytes]);
+    ok = tracks_[t].out != nullptr;
+  }
+  // The ring holds the same time span whatever the channel count.
+  if (!ok || !ring_.allocate(kRingSamples * static_cast<std::size_t>(channels_))) {
+    releaseBuffers();
+    return false;
+  }
+  return true;
+}
+
+void ThreadedAudioRecorder::releaseBuffers() {
+  ring_.release();
+  tracks_.reset();
+  block_.reset();
+  mono_.reset();
+}
+
+#ifdef MINIACID_RECORDER_THREAD
+void ThreadedAudioRecorder::writerLoop() {
+  while (true) {
+    bool stopping = stopRequested_.load();
+    drain(stopping);
+    if (stopping) break;
+    std::this_thread::sleep_for(kWriterPoll);
+  }
+}
+#endif
+
+void ThreadedAudioRecorder::drain(bool flush) {
+  // Frames are never split: pushes hold whole frames and 'block_' is a
+  // whole number of them.
+  const std::size_t stride = static_cast<std::size_t>(trackCount_);
+  const std::size_t blockSamples = recordingBlockSamples(format_) * stride;
+  while (true) {
+    blockCount_ += ring_.pop(block_.get() + blockCount_, blockSamples - blockCount_);
+    if (blockCount_ == 0 || (blockCount_ < blockSamples && !flush)) break;
+    const std::size_t count = blockCount_ / stride;
+    for (int t = 0; t < trackCount_; ++t) {
+      Track& track = tracks_[t];
+      const std::int16_t* in = block_.get();
+      if (stride > 1) {
+        for (std::size_t i = 0; i < count; ++i) mono_[i] = block_[i * stride + t];
+        in = mono_.get();
+      }
+      track.outCount += track.encoder.encodeBlock(in, count, track.out.get() + track.outCount);
+      // Whole chunks only, so the card sees large aligned writes.
+      while (track.outCount >= kChunkBytes) writeOut(t, kChunkBytes);
+    }
+    samples_ += static_cast<std::uint32_t>(count);
+    blockCount_ = 0;
+  }
+  if (!flush) return;
+  for (int t = 0; t < trackCount_; ++t) {
+    if (tracks_[t].outCount > 0) writeOut(t, tracks_[t].outCount);
+  }
+}
+
+void ThreadedAudioRecorder::writeOut(int track, std::size_t bytes) {
+  Track& out = tracks_[track];
+  std::size_t written = writeSink(track, out.out.get(), bytes);
+  out.dataBytes += static_cast<std::uint32_t>(written);
+  dataBytes_.fetch_add(static_cast<std::uint32_t>(written));
+  out.outCount -= bytes;
+  if (out.outCount > 0) std::memmove(out.out.get(), out.out.get() + bytes, out.outCount);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "audio_recorder.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define MINIACID_RECORDER_THREAD 1
+#include <thread>
+#endif
+
+// Single-producer, single-consumer ring of samples. The audio thread pushes
+// and the writer pops without locks; a push that does not fit is refused
+// whole so the file never has a gap in the middle of a block.
+class SampleRing {
+ public:
+  SampleRing() = default;
+
+  // Capacity is rounded up to a power of two. Returns false when the
+  // memory cannot be allocated. Neither side may be active.
+  bool allocate(std::size_t capacity);
+  void release();
+  void clear();
+
+  std::size_t capacity() const { return mask_ + 1; }
+  std::size_t available() const;
+  bool push(const std::int16_t* samples, std::size_t count);
+  std::size_t pop(std::int16_t* dst, std::size_t maxCount);
+
+ private:
+  std::unique_ptr<std::int16_t[]> data_;
+  std::size_t mask_ = 0;
+  std::atomic<std::size_t> written_{0};
+  std::atomic<std::size_t> read_{0};
+};
+
+// Recorder whose writeSamples() never touches the file: samples go into a
+// SampleRing and a writer thread (a FreeRTOS task pinned to the UI core on
+// the Cardputer) encodes it in the chosen RecordingFormat and writes it in
+// kChunkBytes pieces. Blocks that find the ring full are dropped and
+// counted. A multichannel recording goes to one interleaved file, or to one
+// mono file per channel (a track) after setTrackNames(). Subclasses provide
+// the files and must call stop() from their destructor, while their
+// overrides still exist.
+class ThreadedAudioRecorder : public IAudioRecorder {
+ public:
+#if defined(ARDUINO)
+  static constexpr std::size_t kRingSamples = 16384;
+#else
+  static constexpr std::size_t kRingSamples = 65536;
+#endif
+  static constexpr std::size_t kChunkBytes = 4096;
+  static constexpr int kMaxTracks = 16;
+
+  ThreadedAudioRecorder() = default;
+  ~ThreadedAudioRecorder() override;
+
+  bool start(int sampleRate, int channels) override;
+  void stop() override;
+  bool isRecording() const override;
+  void writeSamples(const int16_t* samples, size_t sampleCount) override;
+  bool offerSamples(const int16_t* samples, size_t sampleCount) override;
+  const std::string& filename() const override;
+  // Compressed formats need mono input. Ignored while recording.
+  bool setFormat(RecordingFormat format) override;
+  RecordingFormat format() const override { return format_; }
+  // Names that go into the file names. One name (or none) keeps a single
+  // interleaved file; one per channel splits the recording into a mono
+  // file per channel, and start() fails for any other count. Ignored while
+  // recording.
+  bool setTrackNames(const std::vector<std::string>& names);
+
+  // Samples dropped because the writer fell behind, this recording.
+  std::uint32_t droppedSamples() const { return dropped_.load(); }
+  // Encoded bytes that reached the files, this recording.
+  std::uint32_t dataBytes() const { return dataBytes_.load(); }
+
+ protected:
+  // Called from start() for each track, in order. Creates an empty file for
+  // it named with 'name' (empty for a single file) and 'extension'.
+  virtual bool openSink(int track, const char* name, const char* extension,
+                        std::string& filename) = 0;
+  // Called from start() for the header placeholder, then from the writer
+  // thread. Returns the bytes written.
+  virtual std::size_t writeSink(int track, const std::uint8_t* data, std::size_t size) = 0;
+  // Called from stop() once everything queued is written: overwrites the
+  // start of the file with the final header and closes it. Also called for
+  // the tracks already open when a later openSink() fails, with no header.
+  virtual void closeSink(int track, const std::uint8_t* header, std::size_t headerSize) = 0;
+
+ private:
+#ifdef MINIACID_RECORDER_THREAD
+  void writerLoop();
+#endif
+  // Per-file encoder state.
+  struct Track {
+    RecordingEncoder encoder;
+    std::unique_ptr<std::uint8_t[]> out;
+    std::size_t outCount = 0;
+    std::uint32_t dataBytes = 0;
+  };
+
+  bool allocate();
+  void releaseBuffers();
+  // Encodes what is queued and writes whole chunks; 'flush' also encodes a
+  // partial last block and writes everything.
+  void drain(bool flush);
+  void writeOut(int track, std::size_t bytes);
+
+  SampleRing ring_;
+  std::string filename_;
+  std::atomic<bool> recording_{false};
+  std::atomic<bool> stopRequested_{false};
+  // writeSamples() calls in progress; stop() waits them out before the
+  // last drain.
+  std::atomic<int> pushing_{0};
+  std::atomic<std::uint32_t> dropped_{0};
+  std::atomic<std::uint32_t> dataBytes_{0};
+
+  // Writer side, allocated with the ring on start(). 'block_' holds
+  // interleaved frames; with tracks each channel is split out into 'mono_'
+  // before encoding.
+  RecordingFormat format_ = RecordingFormat::Pcm16;
+  std::vector<std::string> trackNames_;
+  int sampleRate_ = 0;
+  int channels_ = 0;
+  int trackCount_ = 0;
+  // Samples in each file so far.
+  std::uint32_t samples_ = 0;
+  std::unique_ptr<Track[]> tracks_;
+  std::unique_ptr<std::int16_t[]> block_;
+  std::size_t blockCount_ = 0;
+  std::unique_ptr<std::int16_t[]> mono_;
+#ifdef MINIACID_RECORDER_THREAD
+  std::thread writer_;
+#endif
+};
@@ -1,31 +1,35 @@
 #pragma once
 
-#include "audio_recorder.h"
+#include "threaded_audio_recorder.h"
 
 #if defined(__EMSCRIPTEN__)
-#include <vector>
 
-// WASM implementation that accumulates data and calls JS callback on stop
-class WasmAudioRecorder : public IAudioRecorder {
+// WASM implementation. Without threads the ring drains as samples arrive,
+// and every kChunkBytes chunk is copied straight out to JavaScript, so the
+// WASM heap stays bounded however long the take. The page keeps the chunks,
+// puts the final header in front of them on stop and hands the file to
+// window.miniacidDownloadRecording().
+class WasmAudioRecorder : public ThreadedAudioRecorder {
  public:
   WasmAudioRecorder();
   ~WasmAudioRecorder() override;
 
-  bool start(int sampleRate, int channels) override;
-  void stop() override;
-  bool isRecording() const override;
-  void writeSamples(const int16_t* samples, size_t sampleCount) override;
-  const std::string& filename() const override;
+ protected:
+  bool openSink(int track, const char* name, const char* extension,
+                std::string& filename) override;
+  std::size_t writeSink(int track, const std::uint8_t* data, std::size_t size) override;
+  void closeSink(int track, const std::uint8_t* header, std::size_t headerSize) override;
 
  private:
-  std::string generateTimestampFilename() const;
-  void sendToJavaScript();
-
-  std::vector<int16_t> buffer_;
-  std::string filename_;
-  int sampleRate_ = 0;
-  int channels_ = 0;
-  bool recording_ = false;
+  static std::string generateTimestamp();
+
+  // Index of this recorder's tracks in Module.miniacidRecordingParts, so
+  // two recorders (a take and a song export) can run at once.
+  int partsIndex(int track) const { return instance_ * kMaxTracks + track; }
+
+  int instance_;
+  std::string filenames_[kMaxTracks];
+  std::string timestamp_;
 };
 
 #endif // __EMSCRIPTEN__
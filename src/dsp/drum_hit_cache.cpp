@@ -0,0 +1,209 @@
+#include "drum_hit_cache.h"
+
+namespace {
+// Hits are stored as 16-bit values covering +-4, which leaves headroom for
+// the driven accents.
+constexpr float kStoreScale = 8192.0f;
+constexpr float kPlayScale = 1.0f / kStoreScale;
+
+bool laneHasNoise(const DrumLaneSpec& lane) {
+  return lane.noise.level.normal > 0.0f || lane.noise.level.accent > 0.0f;
+}
+} // namespace
+
+CachedDrumKit::CachedDrumKit(const DrumKitSpec& spec, float sampleRate, size_t budgetBytes)
+  : live_(spec, sampleRate),
+    sampleRate_(sampleRate),
+    budgetBytes_(budgetBytes),
+    cachedBytes_(0),
+    cachedMask_(0),
+    rng_(0x2545F491u),
+    playingMask_(0) {
+  params[static_cast<int>(DrumParamId::MainVolume)] = live_.parameter(DrumParamId::MainVolume);
+  for (int l = 0; l < kDrumLanes; ++l) {
+    variants_[l] = 0;
+    lastVariant_[l] = -1;
+  }
+  reset();
+  render();
+}
+
+void CachedDrumKit::reset() {
+  live_.reset();
+  playingMask_ = 0;
+  for (int l = 0; l < kDrumLanes; ++l) {
+    playing_[l] = nullptr;
+    length_[l] = 0;
+    pos_[l] = 0;
+    gain_[l] = 0.0f;
+  }
+  const Parameter& volume = live_.parameter(DrumParamId::MainVolume);
+  if (params[static_cast<int>(DrumParamId::MainVolume)].value() != volume.value()) {
+    params[static_cast<int>(DrumParamId::MainVolume)] = volume;
+    render();
+  }
+}
+
+void CachedDrumKit::setSampleRate(float sampleRate) {
+  live_.setSampleRate(sampleRate);
+  sampleRate_ = sampleRate;
+  playingMask_ = 0;
+  render();
+}
+
+void CachedDrumKit::render() {
+  playingMask_ = 0;
+  cachedMask_ = 0;
+  cachedBytes_ = 0;
+  for (int l = 0; l < kDrumLanes; ++l) dropLane(l);
+
+  const DrumKitSpec& spec = live_.spec();
+  DrumKit renderer(spec, sampleRate_);
+  for (int l = 0; l < kDrumLanes; ++l) {
+    int variants = laneHasNoise(spec.lanes[l]) ? kNoiseVariants : 1;
+    size_t laneBytes = 0;
+    bool ok = true;
+    for (int accent = 0; accent < 2 && ok; ++accent) {
+      for (int v = 0; v < variants && ok; ++v) {
+        Hit& hit = hits_[l][accent][v];
+        ok = renderHit(renderer, l, accent != 0, v, hit);
+        laneBytes += hit.samples.size() * sizeof(int16_t);
+        if (cachedBytes_ + laneBytes > budgetBytes_) ok = false;
+      }
+    }
+    if (!ok) {
+      dropLane(l);
+      continue;
+    }
+    variants_[l] = variants;
+    cachedBytes_ += laneBytes;
+    cachedMask_ |= 1u << l;
+  }
+
+  // A cached lane cannot damp a lane the kernel is playing, so it goes live too.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int l = 0; l < kDrumLanes; ++l) {
+      int choke = spec.lanes[l].chokeLane;
+      if (!(cachedMask_ & (1u << l)) || choke < 0 || choke >= kDrumLanes ||
+          (cachedMask_ & (1u << choke))) {
+        continue;
+      }
+      for (int accent = 0; accent < 2; ++accent) {
+        for (int v = 0; v < variants_[l]; ++v) {
+          cachedBytes_ -= hits_[l][accent][v].samples.size() * sizeof(int16_t);
+        }
+      }
+      dropLane(l);
+      cachedMask_ &= ~(1u << l);
+      changed = true;
+    }
+  }
+}
+
+bool CachedDrumKit::renderHit(DrumKit& renderer, int lane, bool accent, int variant,
+                              Hit& out) const {
+  renderer.reset();
+  renderer.setParameter(DrumParamId::MainVolume,
+                        params[static_cast<int>(DrumParamId::MainVolume)].value());
+  renderer.setNoiseSeed(static_cast<uint32_t>(variant));
+  renderer.trigger(lane, accent);
+
+  const uint32_t bit = 1u << lane;
+  const uint32_t others = ~bit;
+  const size_t maxSamples = static_cast<size_t>(kMaxHitSeconds * sampleRate_);
+  out.samples.clear();
+  while (renderer.activeLanes() & bit) {
+    if (out.samples.size() >= maxSamples) {
+      out.samples.clear();
+      out.samples.shrink_to_fit();
+      return false;
+    }
+    float s = renderer.process(others) * kStoreScale;
+    if (s > 32767.0f) s = 32767.0f;
+    if (s < -32768.0f) s = -32768.0f;
+    out.samples.push_back(static_cast<int16_t>(s));
+  }
+  out.samples.shrink_to_fit();
+  return true;
+}
+
+void CachedDrumKit::dropLane(int lane) {
+  for (int accent = 0; accent < 2; ++accent) {
+    for (int v = 0; v < kNoiseVariants; ++v) {
+      std::vector<int16_t>().swap(hits_[lane][accent][v].samples);
+    }
+  }
+  variants_[lane] = 0;
+  lastVariant_[lane] = -1;
+}
+
+int CachedDrumKit::pickVariant(int lane) {
+  int count = variants_[lane];
+  if (count <= 1) return 0;
+  rng_ = rng_ * 1664525u + 1013904223u;
+  int pick = static_cast<int>((rng_ >> 16) % static_cast<uint32_t>(count));
+  if (pick == lastVariant_[lane]) pick = (pick + 1) % count;
+  lastVariant_[lane] = pick;
+  return pick;
+}
+
+void CachedDrumKit::trigger(int lane, bool accent) {
+  if (lane < 0 || lane >= kDrumLanes) return;
+  const DrumLaneSpec& spec = live_.spec().lanes[lane];
+  int choke = spec.chokeLane;
+  if (choke >= 0 && choke < kDrumLanes && (cachedMask_ & (1u << choke))) {
+    gain_[choke] *= spec.chokeAmount;
+  }
+  if (!(cachedMask_ & (1u << lane))) {
+    live_.trigger(lane, accent);
+    return;
+  }
+  const Hit& hit = hits_[lane][accent ? 1 : 0][pickVariant(lane)];
+  if (hit.samples.empty()) return;
+  playing_[lane] = hit.samples.data();
+  length_[lane] = static_cast<uint32_t>(hit.samples.size());
+  pos_[lane] = 0;
+  gain_[lane] = kPlayScale;
+  playingMask_ |= 1u << lane;
+}
+
+float CachedDrumKit::process(uint32_t muteMask) {
+  float sum = live_.process(muteMask | cachedMask_);
+  if (!playingMask_) return sum;
+  return mixCached(sum, muteMask, nullptr);
+}
+
+float CachedDrumKit::processLanes(uint32_t muteMask, float* lanes) {
+  // The live kit reports zero for every cached lane.
+  float sum = live_.processLanes(muteMask | cachedMask_, lanes);
+  if (!playingMask_) return sum;
+  return mixCached(sum, muteMask, lanes);
+}
+
+float CachedDrumKit::mixCached(float sum, uint32_t muteMask, float* lanes) {
+  for (int l = 0; l < kDrumLanes; ++l) {
+    uint32_t bit = 1u << l;
+    if (!(playingMask_ & bit)) continue;
+    float value = static_cast<float>(playing_[l][pos_[l]]) * gain_[l];
+    if (!(muteMask & bit)) {
+      sum += value;
+      if (lanes) lanes[l] = value;
+    }
+    if (++pos_[l] >= length_[l]) playingMask_ &= ~bit;
+  }
+  return sum;
+}
+
+const Parameter& CachedDrumKit::parameter(DrumParamId id) const {
+  return params[static_cast<int>(id)];
+}
+
+void CachedDrumKit::setParameter(DrumParamId id, float value) {
+  Parameter& param = params[static_cast<int>(id)];
+  float before = param.value();
+  param.setValue(value);
+  live_.setParameter(id, param.value());
+  if (param.value() != before) render();
+}
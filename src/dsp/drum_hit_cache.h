@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "mini_drumvoices.h"
+
+// Plays a synthesized kit from pre-rendered hits. Every lane's hit is
+// rendered once per accent level when the kit, sample rate or a parameter
+// changes; lanes with noise get several renders with different noise seeds
+// and each trigger picks one, so repeated hats do not sound identical.
+// Lanes that do not fit the byte budget, ring longer than kMaxHitSeconds or
+// are choked by a live lane keep running on the synthesis kernel.
+class CachedDrumKit : public DrumSynthVoice {
+public:
+#if defined(ARDUINO)
+  static constexpr size_t kDefaultBudgetBytes = 96 * 1024;
+#else
+  static constexpr size_t kDefaultBudgetBytes = 4 * 1024 * 1024;
+#endif
+  static constexpr int kNoiseVariants = 4;
+  static constexpr float kMaxHitSeconds = 2.0f;
+
+  CachedDrumKit(const DrumKitSpec& spec, float sampleRate,
+                size_t budgetBytes = kDefaultBudgetBytes);
+
+  void reset() override;
+  void setSampleRate(float sampleRate) override;
+  void trigger(int lane, bool accent) override;
+  float process(uint32_t muteMask) override;
+  float processLanes(uint32_t muteMask, float* lanes) override;
+
+  const Parameter& parameter(DrumParamId id) const override;
+  void setParameter(DrumParamId id, float value) override;
+
+  const char* name() const { return live_.name(); }
+  // Lanes played from the cache, one bit per lane.
+  uint32_t cachedLanes() const { return cachedMask_; }
+  size_t cachedBytes() const { return cachedBytes_; }
+
+private:
+  struct Hit {
+    std::vector<int16_t> samples;
+  };
+
+  void render();
+  bool renderHit(DrumKit& renderer, int lane, bool accent, int variant, Hit& out) const;
+  void dropLane(int lane);
+  int pickVariant(int lane);
+  // Adds the cached lanes to 'sum', and to 'lanes' when it is set.
+  float mixCached(float sum, uint32_t muteMask, float* lanes);
+
+  DrumKit live_;
+  float sampleRate_;
+  size_t budgetBytes_;
+  size_t cachedBytes_;
+  uint32_t cachedMask_;
+  uint32_t rng_;
+
+  int variants_[kDrumLanes];
+  int lastVariant_[kDrumLanes];
+  Hit hits_[kDrumLanes][2][kNoiseVariants];
+
+  // Playback of cached lanes.
+  const int16_t* playing_[kDrumLanes];
+  uint32_t length_[kDrumLanes];
+  uint32_t pos_[kDrumLanes];
+  float gain_[kDrumLanes];
+  uint32_t playingMask_;
+
+  Parameter params[static_cast<int>(DrumParamId::Count)];
+};
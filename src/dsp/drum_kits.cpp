@@ -0,0 +1,197 @@
+#include "mini_drumvoices.h"
+
+// Kit tables for DrumKit. Lane order: kick, snare, closed hat, open hat,
+// mid tom, high tom, rim, clap. Decays are per sample at 22.05 kHz.
+
+namespace {
+constexpr DrumFilterSpec kNoFilter{DrumFilterType::None, 0.0f, 0.0f};
+constexpr DrumToneSpec kNoTone{
+  {0.0f, 0.0f}, 0.0f, 0.0f, 0.0f, 0.0f, {0.0f, 0.0f}, 1.0f,
+  0.0f, {0.0f, 0.0f}, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+constexpr DrumNoiseSpec kNoNoise{
+  0.0f, 0.0f, 0.0f, 0.0f, {0.0f, 0.0f}, 1.0f,
+  0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, kNoFilter, kNoFilter, {1.0f, 1.0f}};
+constexpr DrumBurstSpec kNoBursts{0, 0.0f, 1.0f, 0.0f};
+
+// A single sine at 'freq'.
+constexpr DrumToneSpec sineTone(DrumAccentPair freq, float level) {
+  return DrumToneSpec{freq, 0.0f, 0.0f, 1.0f, 0.0f, {level, level}, 1.0f,
+                      0.0f, {0.0f, 0.0f}, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+}
+
+// Two sine partials with their own decay, on top of a noise bed.
+constexpr DrumToneSpec pairTone(float freqA, float freqB, float phaseB, float mixA, float mixB,
+                                DrumAccentPair level, float decay) {
+  return DrumToneSpec{{freqA, freqA}, freqB, phaseB, mixA, mixB, level, decay,
+                      0.0f, {0.0f, 0.0f}, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+}
+
+// Sine whose pitch falls from freq + sweepHz * start to freq.
+constexpr DrumToneSpec sweptTone(DrumAccentPair freq, float sweepHz, DrumAccentPair start,
+                                 float sweepDecay, float curve) {
+  return DrumToneSpec{freq, 0.0f, 0.0f, 1.0f, 0.0f, {1.0f, 1.0f}, 1.0f,
+                      sweepHz, start, sweepDecay, curve, 0.0f, 0.0f, 0.0f, 0.0f};
+}
+
+// White noise with an optional click offset and its own decay.
+constexpr DrumNoiseSpec plainNoise(float scale, float offset, DrumAccentPair level, float decay) {
+  return DrumNoiseSpec{scale, offset, 0.0f, 0.0f, level, decay,
+                       0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, kNoFilter, kNoFilter, {1.0f, 1.0f}};
+}
+
+// Noise (and metal) through up to two filters.
+constexpr DrumNoiseSpec filteredNoise(float scale, float metal, float metalDrive, float level,
+                                      DrumFilterSpec a, DrumFilterSpec b,
+                                      DrumAccentPair filterScale, float decay = 1.0f) {
+  return DrumNoiseSpec{scale, 0.0f, metal, metalDrive, {level, level}, decay,
+                       0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, a, b, filterScale};
+}
+
+// Snare noise through the state-variable stage.
+constexpr DrumNoiseSpec svfNoise(float f, float damp, float bpMix, float hpMix, float colorMix,
+                                 float colorCoeff, float level) {
+  return DrumNoiseSpec{1.0f, 0.0f, 0.0f, 0.0f, {level, level}, 1.0f,
+                       f, damp, bpMix, hpMix, colorMix, colorCoeff,
+                       kNoFilter, kNoFilter, {1.0f, 1.0f}};
+}
+
+constexpr DrumFilterSpec highPass(float freq) { return {DrumFilterType::HighPass, freq, 0.0f}; }
+constexpr DrumFilterSpec bandPass(float freq, float q) { return {DrumFilterType::BandPass, freq, q}; }
+constexpr DrumFilterSpec lowPass(float freq, float q) { return {DrumFilterType::LowPass, freq, q}; }
+
+const DrumKitSpec kDrumKits[] = {
+  {
+    "808",
+    {
+      // kick: squared pitch drop into a driven sine, with a third-harmonic snap
+      {{1.2f, 1.4f}, {0.9995f, 0.99965f}, 0.0008f, {1.0f, 1.15f}, {0.0f, 3.0f},
+       {{42.0f, 36.0f}, 0.0f, 0.0f, 1.0f, 0.0f, {0.85f, 0.85f}, 1.0f,
+        170.0f, {1.0f, 1.0f}, 0.997f, 1.0f, 3.0f, 0.25f, 2.8f, 0.6f},
+       kNoNoise, kNoBursts, -1, 1.0f},
+      // snare: bright noise with a short 330/180 Hz tone
+      {{1.0f, 1.4f}, {0.9985f, 0.9985f}, 0.0002f, {1.0f, 1.15f}, {0.0f, 3.0f},
+       pairTone(330.0f, 180.0f, 0.0f, 0.55f, 0.45f, {0.65f, 1.053f}, 0.99999f),
+       svfNoise(0.28f, 0.20f, 0.35f, 0.65f, 0.0f, 0.0f, 0.75f), kNoBursts, -1, 1.0f},
+      // closed hat: chokes the open hat
+      {{0.5f, 0.7f}, {0.998f, 0.998f}, 0.0005f, {0.6f, 0.84f}, {0.0f, 3.0f},
+       pairTone(6200.0f, 7400.0f, 0.25f, 0.5f, 0.5f, {0.7f, 1.015f}, 0.92f),
+       filteredNoise(1.0f, 0.0f, 0.0f, 0.65f, highPass(293.0f), kNoFilter, {1.0f, 1.0f}),
+       kNoBursts, 3, 0.3f},
+      // open hat
+      {{0.9f, 0.999f}, {0.9993f, 0.9993f}, 0.0004f, {0.7f, 0.91f}, {0.0f, 3.0f},
+       pairTone(5100.0f, 6600.0f, 0.37f, 0.5f, 0.5f, {0.95f, 1.1875f}, 0.94f),
+       filteredNoise(1.0f, 0.0f, 0.0f, 0.55f, highPass(255.0f), kNoFilter, {1.0f, 1.0f}),
+       kNoBursts, -1, 1.0f},
+      // mid tom
+      {{1.0f, 1.0f}, {0.99925f, 0.99925f}, 0.0003f, {0.8f, 1.16f}, {0.0f, 3.0f},
+       sineTone({180.0f, 180.0f}, 0.9f), plainNoise(1.0f, 0.0f, {0.05f, 0.05f}, 1.0f),
+       kNoBursts, -1, 1.0f},
+      // high tom
+      {{1.0f, 1.0f}, {0.99915f, 0.99915f}, 0.0003f, {0.75f, 1.0875f}, {0.0f, 3.0f},
+       sineTone({240.0f, 240.0f}, 0.88f), plainNoise(1.0f, 0.0f, {0.04f, 0.04f}, 1.0f),
+       kNoBursts, -1, 1.0f},
+      // rim: 900 Hz ping with a decaying click
+      {{1.0f, 1.0f}, {0.9985f, 0.9985f}, 0.0004f, {0.8f, 1.12f}, {0.0f, 3.0f},
+       sineTone({900.0f, 900.0f}, 0.5f), plainNoise(0.6f, 0.4f, {1.0f, 1.0f}, 0.9985f),
+       kNoBursts, -1, 1.0f},
+      // clap: three bursts and a 120 ms tail, band- then low-passed
+      {{1.0f, 1.0f}, {0.9992f, 0.9992f}, 0.0002f, {0.8f, 1.16f}, {0.0f, 3.0f},
+       kNoTone,
+       {1.0f, 0.0f, 0.0f, 0.0f, {1.0f, 1.12f}, 0.99962214f,
+        0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+        bandPass(1200.0f, 0.6f), lowPass(4500.0f, 0.7f), {1.0f, 1.1f}},
+       {3, 0.0075f, 0.99547512f, 0.02f}, -1, 1.0f},
+    },
+    {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f},
+  },
+  {
+    "909",
+    {
+      // kick: tighter body, fourth-harmonic snap and a noise click
+      {{1.15f, 1.35f}, {0.99925f, 0.99935f}, 0.0008f, {1.0f, 1.2f}, {0.0f, 2.2f},
+       {{48.0f, 46.0f}, 0.0f, 0.0f, 1.0f, 0.0f, {0.9f, 0.9f}, 1.0f,
+        140.0f, {0.85f, 0.85f}, 0.996f, 1.0f, 4.0f, 0.2f, 2.4f, 0.7f},
+       plainNoise(0.4f, 0.6f, {0.17f, 0.2f}, 0.94f), kNoBursts, -1, 1.0f},
+      // snare: darker, coloured noise and a louder tone
+      {{1.0f, 1.25f}, {0.9976f, 0.9976f}, 0.00025f, {1.0f, 1.15f}, {0.0f, 2.2f},
+       pairTone(330.0f, 200.0f, 0.0f, 0.6f, 0.4f, {1.0625f, 1.793f}, 0.99965f),
+       svfNoise(0.32f, 0.18f, 0.25f, 0.0f, 0.75f, 0.08f, 0.75f), kNoBursts, -1, 1.0f},
+      // closed hat
+      {{0.42f, 0.6f}, {0.996f, 0.996f}, 0.00045f, {0.55f, 0.7425f}, {0.0f, 2.2f},
+       pairTone(8000.0f, 10400.0f, 0.33f, 0.5f, 0.5f, {1.0625f, 1.36f}, 0.9f),
+       filteredNoise(1.0f, 0.0f, 0.0f, 0.6f, highPass(180.0f), kNoFilter, {1.0f, 1.0f}),
+       kNoBursts, 3, 0.25f},
+      // open hat
+      {{0.95f, 0.9995f}, {0.99955f, 0.99955f}, 0.00035f, {0.65f, 0.8125f}, {0.0f, 2.2f},
+       pairTone(6200.0f, 8200.0f, 0.29f, 0.5f, 0.5f, {1.155f, 1.4175f}, 0.93f),
+       filteredNoise(1.0f, 0.0f, 0.0f, 0.5f, highPass(162.0f), kNoFilter, {1.0f, 1.0f}),
+       kNoBursts, -1, 1.0f},
+      // mid tom
+      {{1.0f, 1.0f}, {0.9989f, 0.9989f}, 0.0003f, {0.8f, 1.04f}, {0.0f, 2.2f},
+       sineTone({200.0f, 200.0f}, 0.92f), plainNoise(1.0f, 0.0f, {0.03f, 0.03f}, 1.0f),
+       kNoBursts, -1, 1.0f},
+      // high tom
+      {{1.0f, 1.0f}, {0.9988f, 0.9988f}, 0.0003f, {0.78f, 1.014f}, {0.0f, 2.2f},
+       sineTone({280.0f, 280.0f}, 0.9f), plainNoise(1.0f, 0.0f, {0.025f, 0.025f}, 1.0f),
+       kNoBursts, -1, 1.0f},
+      // rim
+      {{1.0f, 1.0f}, {0.9975f, 0.9975f}, 0.00035f, {0.85f, 1.1475f}, {0.0f, 2.2f},
+       sineTone({1200.0f, 1200.0f}, 0.6f), plainNoise(0.5f, 0.5f, {1.0f, 1.0f}, 0.9975f),
+       kNoBursts, -1, 1.0f},
+      // clap: six short bursts 6 ms apart, then a tail
+      {{1.0f, 1.0f}, {0.9988f, 0.9988f}, 0.0002f, {1.0f, 1.35f}, {0.0f, 2.2f},
+       kNoTone,
+       filteredNoise(1.0f, 0.0f, 0.0f, 1.0f, bandPass(1800.0f, 1.0f), kNoFilter, {1.0f, 1.0f},
+                     0.99918401f),
+       {6, 0.006f, 0.8928f, 0.02f}, -1, 1.0f},
+    },
+    {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f},
+  },
+  {
+    "606",
+    {
+      // kick: linear FM drop, no drive
+      {{1.245f, 1.7f}, {0.99974808f, 0.99974808f}, 0.0003f, {1.0f, 1.0f}, {0.0f, 0.0f},
+       sweptTone({58.0f, 58.0f}, 120.0f, {1.14f, 1.4f}, 0.99622784f, 0.0f),
+       kNoNoise, kNoBursts, -1, 1.0f},
+      // snare: tone decay is relative to the 115 ms noise envelope
+      {{1.28f, 1.8f}, {0.99960572f, 0.99960572f}, 0.0002f, {1.0f, 1.0f}, {0.0f, 0.0f},
+       pairTone(180.0f, 330.0f, 0.0f, 0.5f, 0.5f, {0.4008f, 0.35f}, 0.9997897f),
+       filteredNoise(1.0f, 0.0f, 0.0f, 0.55f, highPass(2200.0f), kNoFilter, {1.0f, 1.0f}),
+       kNoBursts, -1, 1.0f},
+      // closed hat: noise and metal bank, high-passed
+      {{1.21f, 1.6f}, {0.99886686f, 0.99886686f}, 0.0002f, {1.0f, 1.0f}, {0.0f, 0.0f},
+       kNoTone,
+       filteredNoise(0.6f, 0.4f, 0.0f, 1.0f, highPass(7000.0f), kNoFilter, {1.14f, 1.4f}),
+       kNoBursts, 3, 0.25f},
+      // open hat
+      {{1.21f, 1.6f}, {0.99983804f, 0.99983804f}, 0.0002f, {1.0f, 1.0f}, {0.0f, 0.0f},
+       kNoTone,
+       filteredNoise(0.6f, 0.4f, 0.0f, 1.0f, highPass(7000.0f), kNoFilter, {1.14f, 1.4f}),
+       kNoBursts, -1, 1.0f},
+      // mid tom
+      {{1.175f, 1.5f}, {0.99962214f, 0.99962214f}, 0.0002f, {1.0f, 1.0f}, {0.0f, 0.0f},
+       sweptTone({112.695f, 117.7f}, 60.0f, {1.0f, 1.0f}, 0.99547512f, 0.0f),
+       kNoNoise, kNoBursts, -1, 1.0f},
+      // high tom
+      {{1.175f, 1.5f}, {0.99952273f, 0.99952273f}, 0.0002f, {1.0f, 1.0f}, {0.0f, 0.0f},
+       sweptTone({174.165f, 181.9f}, 70.0f, {1.0f, 1.0f}, 0.99497362f, 0.0f),
+       kNoNoise, kNoBursts, -1, 1.0f},
+      // rim plays the cymbal: clipped metal bank through a band-pass
+      {{1.175f, 1.5f}, {0.99993567f, 0.99994961f}, 0.0002f, {1.0f, 1.0f}, {0.0f, 0.0f},
+       kNoTone,
+       filteredNoise(0.0f, 1.0f, 2.2f, 1.0f, bandPass(8000.0f, 0.9f), kNoFilter, {1.07f, 1.2f}),
+       kNoBursts, -1, 1.0f},
+      // no clap on the 606
+      {{0.0f, 0.0f}, {0.0f, 0.0f}, 1.0f, {0.0f, 0.0f}, {0.0f, 0.0f},
+       kNoTone, kNoNoise, kNoBursts, -1, 1.0f},
+    },
+    {330.0f, 558.0f, 880.0f, 1320.0f, 1760.0f, 2640.0f},
+  },
+};
+} // namespace
+
+const DrumKitSpec* drumKits(int& count) {
+  count = static_cast<int>(sizeof(kDrumKits) / sizeof(kDrumKits[0]));
+  return kDrumKits;
+}
@@ -0,0 +1,89 @@
+#include "fork_join.h"
+
+#if defined(ESP_PLATFORM) && defined(MINIACID_RENDER_THREADS)
+#include <esp_pthread.h>
+#endif
+
+ForkJoinBarrier::~ForkJoinBarrier() { stop(); }
+
+#ifdef MINIACID_RENDER_THREADS
+
+bool ForkJoinBarrier::start() {
+  if (thread_.joinable()) return true;
+  stopRequested_ = false;
+#if defined(ESP_PLATFORM)
+  // Same priority as the audio task, on the core the audio task leaves to the UI.
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = 4096;
+  cfg.prio = 3;
+  cfg.pin_to_core = 0;
+  cfg.thread_name = "renderHelper";
+  esp_pthread_set_cfg(&cfg);
+#endif
+  thread_ = std::thread(&ForkJoinBarrier::threadLoop, this);
+  return true;
+}
+
+void ForkJoinBarrier::stop() {
+  if (!thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopRequested_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+bool ForkJoinBarrier::running() const { return thread_.joinable(); }
+
+void ForkJoinBarrier::run(Job helperJob, void* helperContext, Job localJob, void* localContext) {
+  if (!thread_.joinable()) {
+    helperJob(helperContext);
+    localJob(localContext);
+    return;
+  }
+  uint32_t ticket;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = helperJob;
+    context_ = helperContext;
+    ticket = ++posted_;
+  }
+  wake_.notify_one();
+  localJob(localContext);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this, ticket]() { return finished_ == ticket; });
+}
+
+void ForkJoinBarrier::threadLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // A job posted before this thread got the lock is still pending.
+  uint32_t seen = finished_;
+  while (true) {
+    wake_.wait(lock, [this, seen]() { return posted_ != seen || stopRequested_; });
+    if (posted_ == seen) break;
+    seen = posted_;
+    Job job = job_;
+    void* context = context_;
+    lock.unlock();
+    job(context);
+    lock.lock();
+    finished_ = seen;
+    done_.notify_one();
+  }
+}
+
+#else
+
+bool ForkJoinBarrier::start() { return false; }
+
+void ForkJoinBarrier::stop() {}
+
+bool ForkJoinBarrier::running() const { return false; }
+
+void ForkJoinBarrier::run(Job helperJob, void* helperContext, Job localJob, void* localContext) {
+  helperJob(helperContext);
+  localJob(localContext);
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define MINIACID_RENDER_THREADS 1
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// Fork/join barrier for splitting an audio block in two: run() hands one
+// job to a helper thread, runs the other on the caller and returns once
+// both are done. On the Cardputer the helper is pinned to core 0, next to
+// the UI, while the audio task keeps core 1. Before start(), and in builds
+// without thread support, run() simply calls both jobs in turn.
+class ForkJoinBarrier {
+public:
+  using Job = void (*)(void* context);
+
+  ForkJoinBarrier() = default;
+  ~ForkJoinBarrier();
+
+  ForkJoinBarrier(const ForkJoinBarrier&) = delete;
+  ForkJoinBarrier& operator=(const ForkJoinBarrier&) = delete;
+
+  // Starts the helper thread. Returns false when threads are unavailable.
+  // Neither may be called while run() is in progress.
+  bool start();
+  void stop();
+  bool running() const;
+
+  void run(Job helperJob, void* helperContext, Job localJob, void* localContext);
+
+private:
+#ifdef MINIACID_RENDER_THREADS
+  void threadLoop();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::thread thread_;
+  Job job_ = nullptr;
+  void* context_ = nullptr;
+  uint32_t posted_ = 0;
+  uint32_t finished_ = 0;
+  bool stopRequested_ = false;
+#endif
+};
@@ -3,463 +3,231 @@
 #include <stdint.h>
 
 #include "mini_dsp_params.h"
-#include "tube_distortion.h"
 
 enum class DrumParamId : uint8_t {
   MainVolume = 0,
   Count
 };
 
+static constexpr int kDrumLanes = 8;
+
 class DrumSynthVoice {
 public:
   virtual ~DrumSynthVoice() = default;
 
   virtual void reset() = 0;
   virtual void setSampleRate(float sampleRate) = 0;
-  virtual void triggerKick(bool accent = false) = 0;
-  virtual void triggerSnare(bool accent = false) = 0;
-  virtual void triggerHat(bool accent = false) = 0;
-  virtual void triggerOpenHat(bool accent = false) = 0;
-  virtual void triggerMidTom(bool accent = false) = 0;
-  virtual void triggerHighTom(bool accent = false) = 0;
-  virtual void triggerRim(bool accent = false) = 0;
-  virtual void triggerClap(bool accent = false) = 0;
-  virtual void triggerCymbal(bool accent = false) = 0;
-
-  virtual float processKick() = 0;
-  virtual float processSnare() = 0;
-  virtual float processHat() = 0;
-  virtual float processOpenHat() = 0;
-  virtual float processMidTom() = 0;
-  virtual float processHighTom() = 0;
-  virtual float processRim() = 0;
-  virtual float processClap() = 0;
-  virtual float processCymbal() = 0;
+  // Lanes follow the drum pattern order: kick, snare, closed hat, open hat,
+  // mid tom, high tom, rim, clap.
+  virtual void trigger(int lane, bool accent) = 0;
+  // Renders one sample and returns the sum of every lane whose bit is not
+  // set in 'muteMask'. Muted lanes keep decaying silently.
+  virtual float process(uint32_t muteMask) = 0;
+  // process() that also writes each lane's share of the sum to
+  // 'lanes[kDrumLanes]' (zero for muted and idle lanes).
+  virtual float processLanes(uint32_t muteMask, float* lanes) = 0;
 
   virtual const Parameter& parameter(DrumParamId id) const = 0;
   virtual void setParameter(DrumParamId id, float value) = 0;
 };
 
-class TR808DrumSynthVoice : public DrumSynthVoice {
-public:
-  explicit TR808DrumSynthVoice(float sampleRate);
-
-  void reset() override;
-  void setSampleRate(float sampleRate) override;
-  void triggerKick(bool accent = false) override;
-  void triggerSnare(bool accent = false) override;
-  void triggerHat(bool accent = false) override;
-  void triggerOpenHat(bool accent = false) override;
-  void triggerMidTom(bool accent = false) override;
-  void triggerHighTom(bool accent = false) override;
-  void triggerRim(bool accent = false) override;
-  void triggerClap(bool accent = false) override;
-  void triggerCymbal(bool accent = false) override;
-
-  float processKick() override;
-  float processSnare() override;
-  float processHat() override;
-  float processOpenHat() override;
-  float processMidTom() override;
-  float processHighTom() override;
-  float processRim() override;
-  float processClap() override;
-  float processCymbal() override;
-
-  const Parameter& parameter(DrumParamId id) const override;
-  void setParameter(DrumParamId id, float value) override;
-
-private:
-  struct Biquad {
-    float a0;
-    float a1;
-    float a2;
-    float b1;
-    float b2;
-    float z1;
-    float z2;
-
-    float process(float input) {
-      float output = a0 * input + z1;
-      z1 = a1 * input - b1 * output + z2;
-      z2 = a2 * input - b2 * output;
-      return output;
-    }
-
-    void reset() {
-      z1 = 0.0f;
-      z2 = 0.0f;
-    }
-  };
-
-  float frand();
-  float applyAccentDistortion(float input, bool accent);
-  void updateClapFilters(float accentAmount);
-
-  float kickPhase;
-  float kickFreq;
-  float kickEnvAmp;
-  float kickEnvPitch;
-  bool kickActive;
-  float kickAccentGain;
-  bool kickAccentDistortion;
-  float kickAmpDecay;
-  float kickBaseFreq;
-
-  float snareEnvAmp;
-  float snareToneEnv;
-  bool snareActive;
-  float snareBp;
-  float snareLp;
-  float snareTonePhase;
-  float snareTonePhase2;
-  float snareAccentGain;
-  float snareToneGain;
-  bool snareAccentDistortion;
-
-  float hatEnvAmp;
-  float hatToneEnv;
-  bool hatActive;
-  float hatHp;
-  float hatPrev;
-  float hatPhaseA;
-  float hatPhaseB;
-  float hatAccentGain;
-  float hatBrightness;
-  bool hatAccentDistortion;
-
-  float openHatEnvAmp;
-  float openHatToneEnv;
-  bool openHatActive;
-  float openHatHp;
-  float openHatPrev;
-  float openHatPhaseA;
-  float openHatPhaseB;
-  float openHatAccentGain;
-  float openHatBrightness;
-  bool openHatAccentDistortion;
-
-  float midTomPhase;
-  float midTomEnv;
-  bool midTomActive;
-  float midTomAccentGain;
-  bool midTomAccentDistortion;
-
-  float highTomPhase;
-  float highTomEnv;
-  bool highTomActive;
-  float highTomAccentGain;
-  bool highTomAccentDistortion;
-
-  float rimPhase;
-  float rimEnv;
-  bool rimActive;
-  float rimAccentGain;
-  bool rimAccentDistortion;
-
-  float clapEnv;
-  float clapTrans;
-  float clapNoise;
-  bool clapActive;
-  float clapDelay;
-  float clapTime;
-  float clapAccentAmount;
-  float clapAccentGain;
-  bool clapAccentDistortion;
-  Biquad clapBandpass;
-  Biquad clapLowpass;
-
-  float cymbalEnv;
-  float cymbalToneEnv;
-  bool cymbalActive;
-  float cymbalHp;
-  float cymbalPrev;
-  float cymbalPhaseA;
-  float cymbalPhaseB;
-  float cymbalAccentGain;
-  float cymbalBrightness;
-  bool cymbalAccentDistortion;
-
-  float sampleRate;
-  float invSampleRate;
-
-  TubeDistortion accentDistortion;
-
-  Parameter params[static_cast<int>(DrumParamId::Count)];
+// A value that changes on accented hits.
+struct DrumAccentPair {
+  float normal;
+  float accent;
 };
 
-class TR909DrumSynthVoice : public DrumSynthVoice {
-public:
-  explicit TR909DrumSynthVoice(float sampleRate);
-
-  void reset() override;
-  void setSampleRate(float sampleRate) override;
-  void triggerKick(bool accent = false) override;
-  void triggerSnare(bool accent = false) override;
-  void triggerHat(bool accent = false) override;
-  void triggerOpenHat(bool accent = false) override;
-  void triggerMidTom(bool accent = false) override;
-  void triggerHighTom(bool accent = false) override;
-  void triggerRim(bool accent = false) override;
-  void triggerClap(bool accent = false) override;
-  void triggerCymbal(bool accent = false) override;
-
-  float processKick() override;
-  float processSnare() override;
-  float processHat() override;
-  float processOpenHat() override;
-  float processMidTom() override;
-  float processHighTom() override;
-  float processRim() override;
-  float processClap() override;
-  float processCymbal() override;
-
-  const Parameter& parameter(DrumParamId id) const override;
-  void setParameter(DrumParamId id, float value) override;
-
-private:
-  struct Biquad {
-    float a0;
-    float a1;
-    float a2;
-    float b1;
-    float b2;
-    float z1;
-    float z2;
-
-    float process(float input) {
-      float output = a0 * input + z1;
-      z1 = a1 * input - b1 * output + z2;
-      z2 = a2 * input - b2 * output;
-      return output;
-    }
-
-    void reset() {
-      z1 = 0.0f;
-      z2 = 0.0f;
-    }
-  };
-
-  float frand();
-  float applyAccentDistortion(float input, bool accent);
-  void updateClapFilter();
-
-  float kickPhase;
-  float kickFreq;
-  float kickEnvAmp;
-  float kickEnvPitch;
-  bool kickActive;
-  float kickAccentGain;
-  bool kickAccentDistortion;
-  float kickAmpDecay;
-  float kickBaseFreq;
-  float kickClickEnv;
-
-  float snareEnvAmp;
-  float snareToneEnv;
-  bool snareActive;
-  float snareBp;
-  float snareLp;
-  float snareTonePhase;
-  float snareTonePhase2;
-  float snareAccentGain;
-  float snareToneGain;
-  bool snareAccentDistortion;
-  float snareNoiseColor;
-
-  float hatEnvAmp;
-  float hatToneEnv;
-  bool hatActive;
-  float hatHp;
-  float hatPrev;
-  float hatPhaseA;
-  float hatPhaseB;
-  float hatAccentGain;
-  float hatBrightness;
-  bool hatAccentDistortion;
-
-  float openHatEnvAmp;
-  float openHatToneEnv;
-  bool openHatActive;
-  float openHatHp;
-  float openHatPrev;
-  float openHatPhaseA;
-  float openHatPhaseB;
-  float openHatAccentGain;
-  float openHatBrightness;
-  bool openHatAccentDistortion;
-
-  float midTomPhase;
-  float midTomEnv;
-  bool midTomActive;
-  float midTomAccentGain;
-  bool midTomAccentDistortion;
+enum class DrumFilterType : uint8_t {
+  None = 0,
+  HighPass, // one pole
+  BandPass,
+  LowPass,
+};
 
-  float highTomPhase;
-  float highTomEnv;
-  bool highTomActive;
-  float highTomAccentGain;
-  bool highTomAccentDistortion;
+struct DrumFilterSpec {
+  DrumFilterType type;
+  float freqHz;
+  float q;
+};
 
-  float rimPhase;
-  float rimEnv;
-  bool rimActive;
-  float rimAccentGain;
-  bool rimAccentDistortion;
+// Decays and the state-variable filter coefficients are per-sample values at
+// DrumKitSpec::kReferenceRate; DrumKit rescales them for other rates.
+struct DrumToneSpec {
+  // Two sine partials. A is swept by the pitch envelope.
+  DrumAccentPair freqA;
+  float freqB;
+  float phaseB;     // start phase of B
+  float mixA;
+  float mixB;
+  DrumAccentPair level;
+  float decay;
+  float sweepHz;    // added to A at full pitch envelope
+  DrumAccentPair sweepStart;
+  float sweepDecay;
+  float sweepCurve; // 1 squares the pitch envelope, 0 keeps it linear
+  float harmonic;   // ratio of a transient partial of A, following the sweep
+  float harmonicLevel;
+  float drive;      // tanh drive on the A/B mix, 0 is clean
+  float driveEnv;   // extra drive per unit of amplitude envelope
+};
 
-  float clapEnv;
-  float clapTrans;
-  float clapNoise;
-  bool clapActive;
-  float clapDelay;
-  float clapTime;
-  float clapAccentGain;
-  bool clapAccentDistortion;
-  Biquad clapBandpass;
+struct DrumNoiseSpec {
+  // Source: white noise * scale + offset, plus the kit's metal bank.
+  float scale;
+  float offset;
+  float metal;
+  float metalDrive; // tanh drive on the metal bank, 0 is clean
+  DrumAccentPair level;
+  float decay;      // envelope on the source only (clicks, clap tail)
+  // State-variable stage: output = bp * bpMix + hp * hpMix + lowpassed hp * colorMix.
+  // f = 0 and hpMix = 1 passes the source through.
+  float svfF;
+  float svfDamp;
+  float bpMix;
+  float hpMix;
+  float colorMix;
+  float colorCoeff;
+  DrumFilterSpec filterA;
+  DrumFilterSpec filterB;
+  DrumAccentPair filterScale; // multiplies both filter frequencies
+};
 
-  float cymbalEnv;
-  float cymbalToneEnv;
-  bool cymbalActive;
-  float cymbalHp;
-  float cymbalPrev;
-  float cymbalPhaseA;
-  float cymbalPhaseB;
-  float cymbalAccentGain;
-  float cymbalBrightness;
-  bool cymbalAccentDistortion;
+// Clap-style retriggered bursts. The source envelope starts after the last
+// burst window, at tailDelay.
+struct DrumBurstSpec {
+  int count;
+  float spacing;    // seconds
+  float decay;
+  float tailDelay;  // seconds
+};
 
-  float sampleRate;
-  float invSampleRate;
+struct DrumLaneSpec {
+  DrumAccentPair level;
+  DrumAccentPair ampDecay;
+  float stopLevel;  // the lane goes idle once its envelope falls below this
+  DrumAccentPair gain;
+  DrumAccentPair drive; // tube drive on the lane output, 0 is clean
+  DrumToneSpec tone;
+  DrumNoiseSpec noise;
+  DrumBurstSpec bursts;
+  int chokeLane;    // lane damped by this one, -1 for none
+  float chokeAmount;
+};
 
-  TubeDistortion accentDistortion;
+struct DrumKitSpec {
+  static constexpr float kReferenceRate = 22050.0f;
+  static constexpr int kMetalOscillators = 6;
 
-  Parameter params[static_cast<int>(DrumParamId::Count)];
+  const char* name;
+  DrumLaneSpec lanes[kDrumLanes];
+  // Square oscillators summed into the metal source; all zero for none.
+  float metalFreqs[kMetalOscillators];
 };
 
-class TR606DrumSynthVoice : public DrumSynthVoice {
+// Built-in kits, in the order the drum engine list shows them.
+const DrumKitSpec* drumKits(int& count);
+
+// Renders every lane of a kit together. Lane state lives in one array per
+// field and process() advances all lanes in straight-line passes over those
+// arrays, so the compiler can run them on vector units. Kits only differ by
+// their DrumKitSpec.
+class DrumKit : public DrumSynthVoice {
 public:
-  explicit TR606DrumSynthVoice(float sampleRate);
+  DrumKit(const DrumKitSpec& spec, float sampleRate);
 
   void reset() override;
   void setSampleRate(float sampleRate) override;
-  void triggerKick(bool accent = false) override;
-  void triggerSnare(bool accent = false) override;
-  void triggerHat(bool accent = false) override;
-  void triggerOpenHat(bool accent = false) override;
-  void triggerMidTom(bool accent = false) override;
-  void triggerHighTom(bool accent = false) override;
-  void triggerRim(bool accent = false) override;
-  void triggerClap(bool accent = false) override;
-  void triggerCymbal(bool accent = false) override;
-
-  float processKick() override;
-  float processSnare() override;
-  float processHat() override;
-  float processOpenHat() override;
-  float processMidTom() override;
-  float processHighTom() override;
-  float processRim() override;
-  float processClap() override;
-  float processCymbal() override;
+  void trigger(int lane, bool accent) override;
+  float process(uint32_t muteMask) override;
+  float processLanes(uint32_t muteMask, float* lanes) override;
 
   const Parameter& parameter(DrumParamId id) const override;
   void setParameter(DrumParamId id, float value) override;
 
-private:
-  struct OnePole {
-    float z;
-    float a;
-    float process(float input) { return z += a * (input - z); }
-    void reset() { z = 0.0f; }
-  };
+  const char* name() const { return spec_.name; }
+  const DrumKitSpec& spec() const { return spec_; }
+  // Lanes that are still sounding, one bit per lane.
+  uint32_t activeLanes() const { return activeMask_; }
+  // Restarts every lane's noise generator from 'seed'; reset() restores seed 0.
+  void setNoiseSeed(uint32_t seed);
 
+private:
   struct Biquad {
-    float a0;
-    float a1;
-    float a2;
-    float b1;
-    float b2;
-    float z1;
-    float z2;
-
-    float process(float input) {
-      float output = a0 * input + z1;
-      z1 = a1 * input - b1 * output + z2;
-      z2 = a2 * input - b2 * output;
-      return output;
-    }
-
-    void reset() {
-      z1 = 0.0f;
-      z2 = 0.0f;
-    }
+    alignas(16) float a0[kDrumLanes];
+    alignas(16) float a1[kDrumLanes];
+    alignas(16) float a2[kDrumLanes];
+    alignas(16) float b1[kDrumLanes];
+    alignas(16) float b2[kDrumLanes];
+    alignas(16) float z1[kDrumLanes];
+    alignas(16) float z2[kDrumLanes];
   };
 
-  float frand();
-  float decayCoeff(float timeSeconds) const;
-  float onePoleCoeff(float cutoffHz) const;
-  float square(float phase) const;
-  void setAccent(bool accent);
-  void updateMetalBank();
-  void updateHatFilters(float accent);
-  void updateCymbalFilter(float accent, Biquad& filter);
-
-  float kickPhase;
-  float kickAmpEnv;
-  float kickFmEnv;
-  bool kickActive;
-  float kickAmpDecay;
-  float kickFmDecay;
-
-  float snareTonePhaseA;
-  float snareTonePhaseB;
-  float snareToneEnv;
-  float snareNoiseEnv;
-  bool snareActive;
-  float snareToneDecay;
-  float snareNoiseDecay;
-  OnePole snareNoiseLp;
-  float snareNoiseLpCoeff;
-
-  float midTomPhase;
-  float midTomAmpEnv;
-  float midTomFmEnv;
-  bool midTomActive;
-  float midTomAmpDecay;
-  float midTomFmDecay;
-
-  float highTomPhase;
-  float highTomAmpEnv;
-  float highTomFmEnv;
-  bool highTomActive;
-  float highTomAmpDecay;
-  float highTomFmDecay;
-
-  float hatEnv;
-  float openHatEnv;
-  bool hatActive;
-  bool openHatActive;
-  float hatDecay;
-  float openHatDecay;
-  OnePole hatNoiseLp;
-  OnePole hatMetalLp;
-  float hatNoiseLpCoeff;
-  float hatMetalLpCoeff;
-
-  float cymbalEnv;
-  bool cymbalActive;
-  float cymbalDecay;
-  Biquad cymbalBandpass;
-
-  float accentEnv;
-  float accentDecay;
-
-  float sampleRate;
-  float invSampleRate;
-
-  float metalPhases[6];
-  float metalSignal;
-  const float metalFreqs[6] = {330.0f, 558.0f, 880.0f, 1320.0f, 1760.0f, 2640.0f};
+  float rateDecay(float referenceDecay) const;
+  void setFilter(Biquad& filter, int lane, const DrumFilterSpec& spec, float scale);
+  float processMetal();
+  void silenceLane(int lane);
+
+  const DrumKitSpec& spec_;
+  float sampleRate_;
+  float invSampleRate_;
+  uint32_t activeMask_;
+  bool hasMetal_;
+  float metalPhases_[DrumKitSpec::kMetalOscillators];
+
+  // Envelopes and output.
+  alignas(16) float amp_[kDrumLanes];
+  alignas(16) float ampDecay_[kDrumLanes];
+  alignas(16) float stop_[kDrumLanes];
+  alignas(16) float gain_[kDrumLanes];
+  alignas(16) float drive_[kDrumLanes];
+  alignas(16) float driveComp_[kDrumLanes];
+
+  // Tone.
+  alignas(16) float phaseA_[kDrumLanes];
+  alignas(16) float phaseB_[kDrumLanes];
+  alignas(16) float freqA_[kDrumLanes];
+  alignas(16) float incB_[kDrumLanes];
+  alignas(16) float mixA_[kDrumLanes];
+  alignas(16) float mixB_[kDrumLanes];
+  alignas(16) float toneEnv_[kDrumLanes];
+  alignas(16) float toneDecay_[kDrumLanes];
+  alignas(16) float sweep_[kDrumLanes];
+  alignas(16) float sweepHz_[kDrumLanes];
+  alignas(16) float sweepDecay_[kDrumLanes];
+  alignas(16) float sweepCurve_[kDrumLanes];
+  alignas(16) float harmonic_[kDrumLanes];
+  alignas(16) float harmonicLevel_[kDrumLanes];
+  alignas(16) float bodyDrive_[kDrumLanes];
+  alignas(16) float bodyDriveEnv_[kDrumLanes];
+
+  // Noise.
+  alignas(16) uint32_t rng_[kDrumLanes];
+  alignas(16) float noiseScale_[kDrumLanes];
+  alignas(16) float noiseOffset_[kDrumLanes];
+  alignas(16) float metalLevel_[kDrumLanes];
+  alignas(16) float metalDrive_[kDrumLanes];
+  alignas(16) float noiseLevel_[kDrumLanes];
+  alignas(16) float noiseEnv_[kDrumLanes];
+  alignas(16) float noiseDecay_[kDrumLanes];
+  alignas(16) float burstEnv_[kDrumLanes];
+  alignas(16) float burstDecay_[kDrumLanes];
+  alignas(16) float burstTimer_[kDrumLanes];
+  alignas(16) float burstSpacing_[kDrumLanes];
+  alignas(16) float burstsLeft_[kDrumLanes];
+  alignas(16) float tailTimer_[kDrumLanes];
+  alignas(16) float svfF_[kDrumLanes];
+  alignas(16) float svfDamp_[kDrumLanes];
+  alignas(16) float bpMix_[kDrumLanes];
+  alignas(16) float hpMix_[kDrumLanes];
+  alignas(16) float colorMix_[kDrumLanes];
+  alignas(16) float colorCoeff_[kDrumLanes];
+  alignas(16) float svfBp_[kDrumLanes];
+  alignas(16) float svfLp_[kDrumLanes];
+  alignas(16) float color_[kDrumLanes];
+  Biquad filterA_;
+  Biquad filterB_;
+
+  alignas(16) float out_[kDrumLanes];
 
   Parameter params[static_cast<int>(DrumParamId::Count)];
 };
@@ -6,182 +6,201 @@
 namespace {
 const char* const kOscillatorOptions[] = {"saw", "sqr", "super"};
 const char* const kFilterTypeOptions[] = {"lp", "bp", "hp"};
+
+const float kSuperSawDetune[] = {
+  -0.019f, 0.019f, -0.012f, 0.012f, -0.0065f, 0.0065f
+};
+
+// Share of the remaining glide covered per sample at kSlideReferenceRate.
+constexpr float kSlideSpeed = 0.001f;
+constexpr float kSlideReferenceRate = 22050.0f;
 } // namespace
 
-TB303Voice::TB303Voice(float sampleRate)
-  : sampleRate(sampleRate),
-    invSampleRate(0.0f),
-    nyquist(0.0f),
-    filter(nullptr) {
+TB303VoiceBank::TB303VoiceBank(float sampleRate, int voiceCount)
+  : voiceCount_(1),
+    sampleRate_(sampleRate),
+    invSampleRate_(0.0f),
+    nyquist_(0.0f) {
+  setVoiceCount(voiceCount);
   setSampleRate(sampleRate);
-  createFilter(0); // Default to lowpass
   reset();
 }
 
-void TB303Voice::reset() {
-  initParameters();
-  phase = 0.0f;
-  for (int i = 0; i < kSuperSawOscCount; ++i) {
-    float seed = (static_cast<float>(i) + 1.0f) * 0.137f;
-    superPhases[i] = seed - floorf(seed);
-  }
-  freq = 110.0f;
-  targetFreq = 110.0f;
-  slideSpeed = 0.001f;
-  env = 0.0f;
-  gate = false;
-  slide = false;
-  amp = 0.3f;
-  if (filter) {
-    filter->reset();
-  }
+void TB303VoiceBank::setVoiceCount(int voiceCount) {
+  if (voiceCount < 1) voiceCount = 1;
+  if (voiceCount > kMaxVoices) voiceCount = kMaxVoices;
+  voiceCount_ = voiceCount;
 }
 
-void TB303Voice::setSampleRate(float sampleRateHz) {
-  if (sampleRateHz <= 0.0f) sampleRateHz = 44100.0f;
-  sampleRate = sampleRateHz;
-  invSampleRate = 1.0f / sampleRate;
-  nyquist = sampleRate * 0.5f;
-  if (filter) {
-    filter->setSampleRate(sampleRate);
+void TB303VoiceBank::reset() {
+  for (int v = 0; v < kMaxVoices; ++v) {
+    initParameters(v);
+    resetVoice(v);
   }
 }
 
-void TB303Voice::startNote(float freqHz, bool accent, bool slideFlag) {
-  slide = slideFlag;
-
-  if (!slide) {
-    freq = freqHz;
+void TB303VoiceBank::resetVoice(int v) {
+  phase_[v] = 0.0f;
+  for (int i = 0; i < kSuperSawOscCount; ++i) {
+    float seed = (static_cast<float>(i) + 1.0f) * 0.137f;
+    superPhases_[i][v] = seed - floorf(seed);
   }
-  targetFreq = freqHz;
-
-  gate = true;
-  env = accent ? 2.0f : 1.0f;
+  freq_[v] = 110.0f;
+  targetFreq_[v] = 110.0f;
+  env_[v] = 0.0f;
+  gate_[v] = 0;
+  amp_[v] = 0.3f;
+  lp_[v] = 0.0f;
+  bp_[v] = 0.0f;
+  hp_[v] = 0.0f;
+  updateVoiceSettings(v);
+}
+
+void TB303VoiceBank::setSampleRate(float sampleRateHz) {
+  if (sampleRateHz <= 0.0f) sampleRateHz = 44100.0f;
+  sampleRate_ = sampleRateHz;
+  invSampleRate_ = 1.0f / sampleRate_;
+  nyquist_ = sampleRate_ * 0.5f;
+  for (int v = 0; v < kMaxVoices; ++v) updateVoiceSettings(v);
 }
 
-void TB303Voice::release() { gate = false; }
+int TB303VoiceBank::clampVoice(int voice) const {
+  if (voice < 0) return 0;
+  if (voice >= kMaxVoices) return kMaxVoices - 1;
+  return voice;
+}
 
-float TB303Voice::oscSaw() {
-  phase += freq * invSampleRate;
-  if (phase >= 1.0f) {
-    phase -= 1.0f;
+void TB303VoiceBank::startNote(int voice, float freqHz, bool accent, bool slideFlag) {
+  int v = clampVoice(voice);
+  if (!slideFlag) {
+    freq_[v] = freqHz;
   }
-  return 2.0f * phase - 1.0f;
-}
+  targetFreq_[v] = freqHz;
 
-float TB303Voice::oscSquare(float saw) {
-  return saw >= 0.0f ? 1.0f : -1.0f;
+  gate_[v] = 1;
+  env_[v] = accent ? 2.0f : 1.0f;
 }
 
-float TB303Voice::oscSuperSaw() {
-  static const float kSuperSawDetune[kSuperSawOscCount] = {
-    -0.019f, 0.019f, -0.012f, 0.012f, -0.0065f, 0.0065f
-  };
-
-  float basePhaseInc = freq * invSampleRate;
-  phase += basePhaseInc;
-  if (phase >= 1.0f) {
-    phase -= 1.0f;
-  }
+void TB303VoiceBank::release(int voice) { gate_[clampVoice(voice)] = 0; }
 
-  float sum = 2.0f * phase - 1.0f;
+void TB303VoiceBank::process(float* out, uint32_t skipMask) {
+  const int n = voiceCount_;
 
-  for (int i = 0; i < kSuperSawOscCount; ++i) {
-    float detunedFreq = freq * (1.0f + kSuperSawDetune[i]);
-    float inc = detunedFreq * invSampleRate;
-    superPhases[i] += inc;
-    if (superPhases[i] >= 1.0f) {
-      superPhases[i] -= floorf(superPhases[i]);
-    } else if (superPhases[i] < 0.0f) {
-      superPhases[i] += 1.0f;
-    }
-    sum += 2.0f * superPhases[i] - 1.0f;
+  for (int v = 0; v < n; ++v) {
+    active_[v] = !(skipMask & (1u << v)) && (gate_[v] || env_[v] >= 0.0001f);
   }
 
-  // constexpr float kGain = 1.0f / (1.0f + TB303Voice::kSuperSawOscCount);
-  constexpr float kGain = 1.0f / (TB303Voice::kSuperSawOscCount - 5);
-  return sum * kGain;
-}
-
-float TB303Voice::oscillatorSample() {
-  int oscIdx = oscillatorIndex();
-  if (oscIdx == 1) {
-    float saw = oscSaw();
-    return oscSquare(saw);
+  // Oscillators. Every shape starts from the base saw.
+  for (int v = 0; v < n; ++v) {
+    if (!active_[v]) continue;
+    phase_[v] += freq_[v] * invSampleRate_;
+    if (phase_[v] >= 1.0f) {
+      phase_[v] -= 1.0f;
+    }
+    osc_[v] = 2.0f * phase_[v] - 1.0f;
   }
-  if (oscIdx == 2) {
-    return oscSuperSaw();
+  for (int v = 0; v < n; ++v) {
+    if (!active_[v]) continue;
+    if (oscType_[v] == 1) {
+      osc_[v] = osc_[v] >= 0.0f ? 1.0f : -1.0f;
+    } else if (oscType_[v] == 2) {
+      float sum = osc_[v];
+      for (int i = 0; i < kSuperSawOscCount; ++i) {
+        float inc = freq_[v] * (1.0f + kSuperSawDetune[i]) * invSampleRate_;
+        float p = superPhases_[i][v] + inc;
+        if (p >= 1.0f) {
+          p -= floorf(p);
+        } else if (p < 0.0f) {
+          p += 1.0f;
+        }
+        superPhases_[i][v] = p;
+        sum += 2.0f * p - 1.0f;
+      }
+      constexpr float kGain = 1.0f / (kSuperSawOscCount - 5);
+      osc_[v] = sum * kGain;
+    }
   }
-  return oscSaw();
-}
 
-float TB303Voice::svfProcess(float input) {
-  // Slide toward target frequency
-  freq += (targetFreq - freq) * slideSpeed;
-  if (!isfinite(freq))
-    freq = targetFreq;
-
-  // Envelope decay
-  if (gate || env > 0.0001f) {
-    float decayMs = parameterValue(TB303ParamId::EnvDecay);
-    float decaySamples = decayMs * sampleRate * 0.001f;
-    if (decaySamples < 1.0f)
-      decaySamples = 1.0f;
-    // 0.01 represents roughly -40 dB, a practical "off" point for the envelope.
-    constexpr float kDecayTargetLog = -4.60517019f; // ln(0.01f)
-    float decayCoeff = expf(kDecayTargetLog / decaySamples);
-    env *= decayCoeff;
+  // Slide, envelope and filter cutoff.
+  const float maxCutoff = nyquist_ * 0.9f;
+  for (int v = 0; v < n; ++v) {
+    if (!active_[v]) continue;
+    freq_[v] += (targetFreq_[v] - freq_[v]) * slideSpeed_[v];
+    if (!isfinite(freq_[v])) freq_[v] = targetFreq_[v];
+    if (gate_[v] || env_[v] > 0.0001f) env_[v] *= decayCoeff_[v];
+
+    float cutoffHz = params_[v][static_cast<int>(TB303ParamId::Cutoff)].value() +
+                     params_[v][static_cast<int>(TB303ParamId::EnvAmount)].value() * env_[v];
+    if (cutoffHz < 50.0f) cutoffHz = 50.0f;
+    if (cutoffHz > maxCutoff) cutoffHz = maxCutoff;
+    cutoff_[v] = cutoffHz;
   }
 
-  float cutoffHz = parameterValue(TB303ParamId::Cutoff) + parameterValue(TB303ParamId::EnvAmount) * env;
-  if (cutoffHz < 50.0f)
-    cutoffHz = 50.0f;
-  float maxCutoff = nyquist * 0.9f;
-  if (cutoffHz > maxCutoff)
-    cutoffHz = maxCutoff;
-
-
-  return filter->process(input, cutoffHz, parameterValue(TB303ParamId::Resonance));
-}
-
-float TB303Voice::process() {
-  if (!gate && env < 0.0001f) {
-    return 0.0f;
+  // Chamberlin state-variable filter.
+  const float kStateLimit = 50.0f;
+  for (int v = 0; v < n; ++v) {
+    if (!active_[v]) {
+      out[v] = 0.0f;
+      continue;
+    }
+    float f = 2.0f * sinf(3.14159265f * cutoff_[v] / sampleRate_);
+    if (!isfinite(f)) f = 0.0f;
+
+    float hp = osc_[v] - lp_[v] - q_[v] * bp_[v];
+    float bp = bp_[v] + f * hp;
+    float lp = lp_[v] + f * bp;
+    bp = tanhf(bp * 1.3f);
+
+    // Keep states bounded to avoid numeric blowups
+    if (lp > kStateLimit) lp = kStateLimit;
+    if (lp < -kStateLimit) lp = -kStateLimit;
+    if (bp > kStateLimit) bp = kStateLimit;
+    if (bp < -kStateLimit) bp = -kStateLimit;
+    if (hp > kStateLimit) hp = kStateLimit;
+    if (hp < -kStateLimit) hp = -kStateLimit;
+    lp_[v] = lp;
+    bp_[v] = bp;
+    hp_[v] = hp;
+
+    float filtered = filterType_[v] == 1 ? bp : filterType_[v] == 2 ? hp : lp;
+    out[v] = filtered * amp_[v];
   }
-
-  float osc = oscillatorSample();
-  float out = svfProcess(osc);
-
-  return out * amp;
 }
 
-const Parameter& TB303Voice::parameter(TB303ParamId id) const {
-  return params[static_cast<int>(id)];
+const Parameter& TB303VoiceBank::parameter(int voice, TB303ParamId id) const {
+  return params_[clampVoice(voice)][static_cast<int>(id)];
 }
 
-void TB303Voice::setParameter(TB303ParamId id, float value) {
-  params[static_cast<int>(id)].setValue(value);
-  if (id == TB303ParamId::FilterType) {
-    createFilter(params[static_cast<int>(id)].optionIndex());
+void TB303VoiceBank::setParameter(int voice, TB303ParamId id, float value) {
+  int v = clampVoice(voice);
+  int oldFilter = filterType_[v];
+  params_[v][static_cast<int>(id)].setValue(value);
+  updateVoiceSettings(v);
+  if (filterType_[v] != oldFilter) {
+    lp_[v] = bp_[v] = hp_[v] = 0.0f;
   }
 }
 
-void TB303Voice::adjustParameter(TB303ParamId id, int steps) {
-  params[static_cast<int>(id)].addSteps(steps);
-  if (id == TB303ParamId::FilterType) {
-    createFilter(params[static_cast<int>(id)].optionIndex());
+void TB303VoiceBank::adjustParameter(int voice, TB303ParamId id, int steps) {
+  int v = clampVoice(voice);
+  int oldFilter = filterType_[v];
+  params_[v][static_cast<int>(id)].addSteps(steps);
+  updateVoiceSettings(v);
+  if (filterType_[v] != oldFilter) {
+    lp_[v] = bp_[v] = hp_[v] = 0.0f;
   }
 }
 
-float TB303Voice::parameterValue(TB303ParamId id) const {
-  return params[static_cast<int>(id)].value();
+float TB303VoiceBank::parameterValue(int voice, TB303ParamId id) const {
+  return params_[clampVoice(voice)][static_cast<int>(id)].value();
 }
 
-int TB303Voice::oscillatorIndex() const {
-  return params[static_cast<int>(TB303ParamId::Oscillator)].optionIndex();
+int TB303VoiceBank::oscillatorIndex(int voice) const {
+  return params_[clampVoice(voice)][static_cast<int>(TB303ParamId::Oscillator)].optionIndex();
 }
 
-void TB303Voice::initParameters() {
+void TB303VoiceBank::initParameters(int v) {
+  Parameter* params = params_[v];
   params[static_cast<int>(TB303ParamId::Cutoff)] = Parameter("cut", "Hz", 60.0f, 2500.0f, 800.0f, (2500.f - 60.0f) / 128);
   params[static_cast<int>(TB303ParamId::Resonance)] = Parameter("res", "", 0.05f, 0.85f, 0.6f, (0.85f - 0.05f) / 128);
   params[static_cast<int>(TB303ParamId::EnvAmount)] = Parameter("env", "Hz", 0.0f, 2000.0f, 400.0f, (2000.0f - 0.0f) / 128);
@@ -191,19 +210,25 @@ void TB303Voice::initParameters() {
   params[static_cast<int>(TB303ParamId::MainVolume)] = Parameter("vol", "", 0.0f, 1.0f, 0.8f, 1.0f / 128);
 }
 
-void TB303Voice::createFilter(int filterTypeIndex) {
-  switch (filterTypeIndex) {
-    case 0: // lp
-      filter = std::make_unique<ChamberlinFilterLp>(sampleRate);
-      break;
-    case 1: // bp
-      filter = std::make_unique<ChamberlinFilterBp>(sampleRate);
-      break;
-    case 2: // hp
-      filter = std::make_unique<ChamberlinFilterHp>(sampleRate);
-      break;
-    default:
-      filter = std::make_unique<ChamberlinFilterLp>(sampleRate);
-      break;
-  }
+// Caches what process() would otherwise recompute from the parameters on
+// every sample.
+void TB303VoiceBank::updateVoiceSettings(int v) {
+  float decayMs = params_[v][static_cast<int>(TB303ParamId::EnvDecay)].value();
+  float decaySamples = decayMs * sampleRate_ * 0.001f;
+  if (decaySamples < 1.0f)
+    decaySamples = 1.0f;
+  // 0.01 represents roughly -40 dB, a practical "off" point for the envelope.
+  constexpr float kDecayTargetLog = -4.60517019f; // ln(0.01f)
+  decayCoeff_[v] = expf(kDecayTargetLog / decaySamples);
+  // Same glide time at every rate.
+  slideSpeed_[v] = 1.0f - powf(1.0f - kSlideSpeed, kSlideReferenceRate * invSampleRate_);
+
+  float q = 1.0f / (1.0f + params_[v][static_cast<int>(TB303ParamId::Resonance)].value() * 4.0f);
+  if (q < 0.06f)
+    q = 0.06f;
+  q_[v] = q;
+
+  oscType_[v] = static_cast<uint8_t>(oscillatorIndex(v));
+  filterType_[v] = static_cast<uint8_t>(
+      params_[v][static_cast<int>(TB303ParamId::FilterType)].optionIndex());
 }
@@ -1,9 +1,7 @@
 #pragma once
 
 #include <stdint.h>
-#include <memory>
 
-#include "filter.h"
 #include "mini_dsp_params.h"
 
 enum class TB303ParamId : uint8_t {
@@ -17,46 +15,65 @@ enum class TB303ParamId : uint8_t {
   Count
 };
 
-class TB303Voice {
+// A bank of 303 voices. Oscillator, envelope and filter state is kept as
+// one array per field (structure-of-arrays), and process() renders a sample
+// for every voice in a few passes over those arrays instead of running each
+// voice on its own.
+class TB303VoiceBank {
 public:
-  explicit TB303Voice(float sampleRate);
+  static constexpr int kMaxVoices = 8;
+
+  TB303VoiceBank(float sampleRate, int voiceCount);
 
   void reset();
   void setSampleRate(float sampleRate);
-  void startNote(float freqHz, bool accent, bool slideFlag);
-  void release();
-  float process();
-  const Parameter& parameter(TB303ParamId id) const;
-  void setParameter(TB303ParamId id, float value);
-  void adjustParameter(TB303ParamId id, int steps);
-  float parameterValue(TB303ParamId id) const;
-  int oscillatorIndex() const;
+  int voiceCount() const { return voiceCount_; }
+  void setVoiceCount(int voiceCount);
+  void startNote(int voice, float freqHz, bool accent, bool slideFlag);
+  void release(int voice);
+  // Writes one sample per voice to out[0..voiceCount()). Voices whose bit
+  // is set in 'skipMask' keep their state and output silence.
+  void process(float* out, uint32_t skipMask = 0);
+  const Parameter& parameter(int voice, TB303ParamId id) const;
+  void setParameter(int voice, TB303ParamId id, float value);
+  void adjustParameter(int voice, TB303ParamId id, int steps);
+  float parameterValue(int voice, TB303ParamId id) const;
+  int oscillatorIndex(int voice) const;
 
 private:
-  float oscSaw();
-  float oscSquare(float saw);
-  float oscSuperSaw();
-  float oscillatorSample();
-  float svfProcess(float input);
-  void initParameters();
-  void createFilter(int filterTypeIndex);
-
   static constexpr int kSuperSawOscCount = 6;
 
-  float phase;
-  float superPhases[kSuperSawOscCount];
-  float freq;       // current frequency (Hz)
-  float targetFreq; // slide target
-  float slideSpeed; // how fast we slide toward target
-  float env;        // filter envelope value
-  bool gate;        // note on/off
-  bool slide;       // slide flag for next note
-  float amp;        // amplitude
-
-  float sampleRate;
-  float invSampleRate;
-  float nyquist;
-
-  Parameter params[static_cast<int>(TB303ParamId::Count)];
-  std::unique_ptr<AudioFilter> filter;
+  int clampVoice(int voice) const;
+  void resetVoice(int voice);
+  void initParameters(int voice);
+  void updateVoiceSettings(int voice);
+
+  int voiceCount_;
+  float sampleRate_;
+  float invSampleRate_;
+  float nyquist_;
+
+  // Per-voice state, one lane per voice.
+  alignas(16) float phase_[kMaxVoices];
+  alignas(16) float superPhases_[kSuperSawOscCount][kMaxVoices];
+  alignas(16) float freq_[kMaxVoices];       // current frequency (Hz)
+  alignas(16) float targetFreq_[kMaxVoices]; // slide target
+  alignas(16) float slideSpeed_[kMaxVoices]; // how fast we slide toward target
+  alignas(16) float env_[kMaxVoices];        // filter envelope value
+  alignas(16) float amp_[kMaxVoices];
+  alignas(16) float lp_[kMaxVoices];
+  alignas(16) float bp_[kMaxVoices];
+  alignas(16) float hp_[kMaxVoices];
+  alignas(16) float osc_[kMaxVoices];
+  alignas(16) float cutoff_[kMaxVoices];
+  uint8_t gate_[kMaxVoices];
+  uint8_t active_[kMaxVoices];
+
+  // Per-voice settings derived from the parameters.
+  alignas(16) float decayCoeff_[kMaxVoices];
+  alignas(16) float q_[kMaxVoices];
+  uint8_t oscType_[kMaxVoices];
+  uint8_t filterType_[kMaxVoices];
+
+  Parameter params_[kMaxVoices][static_cast<int>(TB303ParamId::Count)];
 };
@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <new>
 #include <string>
 
 namespace {
@@ -15,6 +17,13 @@ constexpr int kDrumMidTomVoice = 4;
 constexpr int kDrumHighTomVoice = 5;
 constexpr int kDrumRimVoice = 6;
 constexpr int kDrumClapVoice = 7;
+// Sample kits are listed as this prefix followed by the kit folder name.
+const char* const kSampleDrumEnginePrefix = "wav:";
+// Headroom of the mix before the soft clipper; stems are scaled the same.
+constexpr float kMixGain = 0.65f;
+const char* const kStemNames[kMaxStems] = {
+  "303a", "303b", "kick", "snare", "hat", "openhat", "midtom", "hightom", "rim", "clap",
+};
 
 SynthPattern makeEmptySynthPattern() {
   SynthPattern pattern{};
@@ -26,19 +35,32 @@ SynthPattern makeEmptySynthPattern() {
   return pattern;
 }
 
-DrumPatternSet makeEmptyDrumPatternSet() {
-  DrumPatternSet set{};
-  for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
-    for (int s = 0; s < DrumPattern::kSteps; ++s) {
-      set.voices[v].steps[s].hit = false;
-      set.voices[v].steps[s].accent = false;
+const SynthPattern kEmptySynthPattern = makeEmptySynthPattern();
+const DrumPatternSet kEmptyDrumPatternSet{};
+
+// Delay settings of a 303 channel; the first voice gets a slightly wetter delay.
+void configure303Delay(TempoDelay& delay, int voice, bool enabled, float bpm) {
+  delay.reset();
+  delay.setBeats(0.5f); // eighth note
+  delay.setMix(voice == 0 ? 0.25f : 0.22f);
+  delay.setFeedback(voice == 0 ? 0.35f : 0.32f);
+  delay.setEnabled(enabled);
+  delay.setBpm(bpm);
+}
+
+bool sameSynthPattern(const SynthPattern& a, const SynthPattern& b) {
+  for (int i = 0; i < SynthPattern::kSteps; ++i) {
+    if (a.steps[i].note != b.steps[i].note || a.steps[i].slide != b.steps[i].slide ||
+        a.steps[i].accent != b.steps[i].accent) {
+      return false;
     }
   }
-  return set;
+  return true;
 }
 
-const SynthPattern kEmptySynthPattern = makeEmptySynthPattern();
-const DrumPatternSet kEmptyDrumPatternSet = makeEmptyDrumPatternSet();
+size_t frozenLoopBytes(const std::unique_ptr<Frozen303Loop>& loop) {
+  return loop ? loop->samples.capacity() * sizeof(int16_t) : 0;
+}
 
 std::string toLowerCopy(std::string value) {
   for (char& ch : value) {
@@ -48,16 +70,32 @@ std::string toLowerCopy(std::string value) {
 }
 }
 
+int stemCount(StemLayout layout) {
+  return NUM_303_VOICES + (layout == StemLayout::PerLane ? kDrumLanes : 1);
+}
+
+const char* stemName(StemLayout layout, int stem) {
+  if (stem < 0 || stem >= stemCount(layout)) return "";
+  if (stem == NUM_303_VOICES && layout == StemLayout::Grouped) return "drums";
+  return kStemNames[stem];
+}
+
 TempoDelay::TempoDelay(float sampleRate)
+  : TempoDelay(sampleRate, kMaxDelaySamples) {}
+
+TempoDelay::TempoDelay(float sampleRate, int maxSamples)
   : buffer(),
     writeIndex(0),
     delaySamples(1),
     sampleRate(0.0f),
     maxDelaySamples(0),
+    sampleLimit(maxSamples),
     beats(0.25f),
     mix(0.35f),
     feedback(0.45f),
     enabled(false) {
+  if (sampleLimit > kMaxDelaySamples)
+    sampleLimit = kMaxDelaySamples;
   setSampleRate(sampleRate);
   reset();
 }
@@ -77,6 +115,8 @@ void TempoDelay::setSampleRate(float sr) {
   if (sr <= 0.0f) sr = 44100.0f;
   sampleRate = sr;
   maxDelaySamples = static_cast<int>(sampleRate * kMaxDelaySeconds);
+  if (maxDelaySamples > sampleLimit)
+    maxDelaySamples = sampleLimit;
   if (maxDelaySamples < 1)
     maxDelaySamples = 1;
   buffer.assign(static_cast<size_t>(maxDelaySamples), 0.0f);
@@ -145,16 +185,25 @@ float TempoDelay::process(float input) {
 }
 
 MiniAcid::MiniAcid(float sampleRate, SceneStorage* sceneStorage)
-  : voice303(sampleRate),
-    voice3032(sampleRate),
-    drums(std::make_unique<TR808DrumSynthVoice>(sampleRate)),
-    // drums(std::make_unique<TR909DrumSynthVoice>(sampleRate)),
+  : voices303_(sampleRate, NUM_303_VOICES),
+    drums(),
     sampleRateValue(sampleRate),
-    drumEngineName_("808"),
+    drumEngineName_(kDefaultDrumEngineName),
+    drumHitCache_(false),
+    sceneManager_(std::make_unique<SceneManager>()),
     sceneStorage_(sceneStorage),
+    sceneWriter_(sceneStorage),
+    stagedDrumsHitCache_(false),
+    transitionState_(kTransitionIdle),
+    transitionQuantize_(SceneTransitionQuantize::Bar),
+    transitionDrumsHitCache_(false),
+    transitionDrumsDeferred_(false),
+    transitionSettled_(false),
+    bankRequests_(0),
+    renderEpoch_(0),
+    bankReaders_(*this),
+    sceneCache_(sceneStorage),
     playing(false),
-    mute303(false),
-    mute303_2(false),
     muteKick(false),
     muteSnare(false),
     muteHat(false),
@@ -163,26 +212,34 @@ MiniAcid::MiniAcid(float sampleRate, SceneStorage* sceneStorage)
     muteHighTom(false),
     muteRim(false),
     muteClap(false),
-    delay303Enabled(false),
-    delay3032Enabled(false),
-    distortion303Enabled(false),
-    distortion3032Enabled(false),
     bpmValue(100.0f),
+    swingValue_(0.0f),
     currentStepIndex(-1),
-    samplesIntoStep(0),
-    samplesPerStep(0.0f),
+    tickPosition_(0.0),
+    ticksPerSample_(0.0),
+    eventCursor_(0),
+    timelineDirty_(0),
+    timelineSynths_{nullptr, nullptr},
+    timelineDrums_(nullptr),
+    timelineSwing_(0.0f),
     songMode_(false),
-    drumCycleIndex_(0),
     songPlayheadPosition_(0),
     patternModeDrumPatternIndex_(0),
     patternModeDrumBankIndex_(0),
     patternModeSynthPatternIndex_{0, 0},
     patternModeSynthBankIndex_{0, 0},
-    delay303(sampleRate),
-    delay3032(sampleRate),
-    distortion303(),
-    distortion3032() {
+    chunkEventCount_(0),
+    chunkLength_(0),
+    renderMuted303_(0),
+    renderFrozen303_(0),
+    renderMutedDrums_(0),
+    stemLayout_(StemLayout::Grouped),
+    renderStems_(nullptr) {
   if (sampleRateValue <= 0.0f) sampleRateValue = 44100.0f;
+  channels303_.reserve(NUM_303_VOICES);
+  for (int v = 0; v < NUM_303_VOICES; ++v) channels303_.emplace_back(sampleRateValue);
+  std::string kitName;
+  drums = makeDrumVoice(drumEngineName_, drumHitCache_, kitName);
   reset();
 }
 
@@ -199,16 +256,15 @@ void MiniAcid::init() {
 }
 
 void MiniAcid::reset() {
-  voice303.reset();
-  voice3032.reset();
-  // make the second voice have different params
-  voice3032.adjustParameter(TB303ParamId::Cutoff, -3);
-  voice3032.adjustParameter(TB303ParamId::Resonance, -3);
-  voice3032.adjustParameter(TB303ParamId::EnvAmount, -1);
+  voices303_.reset();
+  // make the other voices have different params
+  for (int v = 1; v < NUM_303_VOICES; ++v) {
+    voices303_.adjustParameter(v, TB303ParamId::Cutoff, -3);
+    voices303_.adjustParameter(v, TB303ParamId::Resonance, -3);
+    voices303_.adjustParameter(v, TB303ParamId::EnvAmount, -1);
+  }
   drums->reset();
   playing = false;
-  mute303 = false;
-  mute303_2 = false;
   muteKick = false;
   muteSnare = false;
   muteHat = false;
@@ -217,30 +273,25 @@ void MiniAcid::reset() {
   muteHighTom = false;
   muteRim = false;
   muteClap = false;
-  delay303Enabled = false;
-  delay3032Enabled = false;
-  distortion303Enabled = false;
-  distortion3032Enabled = false;
   bpmValue = 100.0f;
+  swingValue_ = 0.0f;
   currentStepIndex = -1;
-  samplesIntoStep = 0;
-  updateSamplesPerStep();
-  delay303.reset();
-  delay303.setBeats(0.5f); // eighth note
-  delay303.setMix(0.25f);
-  delay303.setFeedback(0.35f);
-  delay303.setEnabled(delay303Enabled);
-  delay303.setBpm(bpmValue);
-  delay3032.reset();
-  delay3032.setBeats(0.5f);
-  delay3032.setMix(0.22f);
-  delay3032.setFeedback(0.32f);
-  delay3032.setEnabled(delay3032Enabled);
-  delay3032.setBpm(bpmValue);
-  distortion303.setEnabled(distortion303Enabled);
-  distortion3032.setEnabled(distortion3032Enabled);
-  lastBufferCount = 0;
-  for (int i = 0; i < AUDIO_BUFFER_SAMPLES; ++i) lastBuffer[i] = 0;
+  tickPosition_ = 0.0;
+  eventCursor_ = 0;
+  updateTickRate();
+  markTimelineDirty();
+  for (int v = 0; v < NUM_303_VOICES; ++v) {
+    Synth303Channel& channel = channels303_[v];
+    channel.muted = false;
+    channel.delayEnabled = false;
+    channel.distortionEnabled = false;
+    channel.frozen = false;
+    channel.freezeLoop.reset();
+    preparedFreeze_[v].reset();
+    configure303Delay(channel.delay, v, false, bpmValue);
+    channel.distortion.setEnabled(false);
+  }
+  scope_.reset();
   songMode_ = false;
   songPlayheadPosition_ = 0;
   patternModeDrumPatternIndex_ = 0;
@@ -251,10 +302,11 @@ void MiniAcid::reset() {
 void MiniAcid::start() {
   playing = true;
   currentStepIndex = -1;
-  samplesIntoStep = static_cast<unsigned long>(samplesPerStep);
+  tickPosition_ = 0.0;
+  eventCursor_ = 0;
   if (songMode_) {
-    songPlayheadPosition_ = clampSongPosition(sceneManager_.getSongPosition());
-    sceneManager_.setSongPosition(songPlayheadPosition_);
+    songPlayheadPosition_ = clampSongPosition(sceneManager_->getSongPosition());
+    sceneManager_->setSongPosition(songPlayheadPosition_);
     applySongPositionSelection();
   }
 }
@@ -262,12 +314,12 @@ void MiniAcid::start() {
 void MiniAcid::stop() {
   playing = false;
   currentStepIndex = -1;
-  samplesIntoStep = 0;
-  voice303.release();
-  voice3032.release();
+  tickPosition_ = 0.0;
+  eventCursor_ = 0;
+  for (int v = 0; v < NUM_303_VOICES; ++v) voices303_.release(v);
   drums->reset();
   if (songMode_) {
-    sceneManager_.setSongPosition(clampSongPosition(songPlayheadPosition_));
+    sceneManager_->setSongPosition(clampSongPosition(songPlayheadPosition_));
   }
 
   saveSceneToStorage();
@@ -279,39 +331,58 @@ void MiniAcid::setBpm(float bpm) {
     bpmValue = 40.0f;
   if (bpmValue > 200.0f)
     bpmValue = 200.0f;
-  updateSamplesPerStep();
-  delay303.setBpm(bpmValue);
-  delay3032.setBpm(bpmValue);
+  updateTickRate();
+  for (auto& channel : channels303_) channel.delay.setBpm(bpmValue);
 }
 
 float MiniAcid::bpm() const { return bpmValue; }
+
+void MiniAcid::setSwing(float amount) {
+  if (amount < 0.0f) amount = 0.0f;
+  if (amount > 1.0f) amount = 1.0f;
+  swingValue_ = amount;
+}
+
+float MiniAcid::swing() const { return swingValue_; }
 float MiniAcid::sampleRate() const { return sampleRateValue; }
 
+void MiniAcid::setSampleRate(float sampleRate) {
+  if (sampleRate <= 0.0f || sampleRate == sampleRateValue) return;
+  sampleRateValue = sampleRate;
+  voices303_.setSampleRate(sampleRate);
+  for (auto& channel : channels303_) {
+    channel.delay.setSampleRate(sampleRate);
+    channel.delay.setBpm(bpmValue);
+  }
+  drums->setSampleRate(sampleRate);
+  updateTickRate();
+}
+
 bool MiniAcid::isPlaying() const { return playing; }
 
 int MiniAcid::currentStep() const { return currentStepIndex; }
 
 int MiniAcid::currentDrumPatternIndex() const {
-  return sceneManager_.getCurrentDrumPatternIndex();
+  return sceneManager_->getCurrentDrumPatternIndex();
 }
 
 int MiniAcid::current303PatternIndex(int voiceIndex) const {
   int idx = clamp303Voice(voiceIndex);
-  return sceneManager_.getCurrentSynthPatternIndex(idx);
+  return sceneManager_->getCurrentSynthPatternIndex(idx);
 }
 
 int MiniAcid::currentDrumBankIndex() const {
-  return sceneManager_.getCurrentBankIndex(0);
+  return sceneManager_->getCurrentBankIndex(0);
 }
 
 int MiniAcid::current303BankIndex(int voiceIndex) const {
   int idx = clamp303Voice(voiceIndex);
-  return sceneManager_.getCurrentBankIndex(idx + 1);
+  return sceneManager_->getCurrentBankIndex(idx + 1);
 }
 
 bool MiniAcid::is303Muted(int voiceIndex) const {
   int idx = clamp303Voice(voiceIndex);
-  return idx == 0 ? mute303 : mute303_2;
+  return channels303_[idx].muted;
 }
 bool MiniAcid::isKickMuted() const { return muteKick; }
 bool MiniAcid::isSnareMuted() const { return muteSnare; }
@@ -323,110 +394,82 @@ bool MiniAcid::isRimMuted() const { return muteRim; }
 bool MiniAcid::isClapMuted() const { return muteClap; }
 bool MiniAcid::is303DelayEnabled(int voiceIndex) const {
   int idx = clamp303Voice(voiceIndex);
-  return idx == 0 ? delay303Enabled : delay3032Enabled;
+  return channels303_[idx].delayEnabled;
 }
 bool MiniAcid::is303DistortionEnabled(int voiceIndex) const {
   int idx = clamp303Voice(voiceIndex);
-  return idx == 0 ? distortion303Enabled : distortion3032Enabled;
+  return channels303_[idx].distortionEnabled;
 }
 const Parameter& MiniAcid::parameter303(TB303ParamId id, int voiceIndex) const {
   int idx = clamp303Voice(voiceIndex);
-  return idx == 0 ? voice303.parameter(id) : voice3032.parameter(id);
+  return voices303_.parameter(idx, id);
 }
-const int8_t* MiniAcid::pattern303Steps(int voiceIndex) const {
-  int idx = clamp303Voice(voiceIndex);
-  refreshSynthCaches(idx);
-  return synthNotesCache_[idx];
+SynthNoteSteps MiniAcid::pattern303Steps(int voiceIndex) const {
+  return SynthNoteSteps{&activeSynthPattern(clamp303Voice(voiceIndex))};
 }
-const bool* MiniAcid::pattern303AccentSteps(int voiceIndex) const {
-  int idx = clamp303Voice(voiceIndex);
-  refreshSynthCaches(idx);
-  return synthAccentCache_[idx];
+StepMask MiniAcid::pattern303AccentSteps(int voiceIndex) const {
+  return StepMask{activeSynthPattern(clamp303Voice(voiceIndex)).accentMask()};
 }
-const bool* MiniAcid::pattern303SlideSteps(int voiceIndex) const {
-  int idx = clamp303Voice(voiceIndex);
-  refreshSynthCaches(idx);
-  return synthSlideCache_[idx];
+StepMask MiniAcid::pattern303SlideSteps(int voiceIndex) const {
+  return StepMask{activeSynthPattern(clamp303Voice(voiceIndex)).slideMask()};
 }
-const bool* MiniAcid::patternKickSteps() const {
-  refreshDrumCache(kDrumKickVoice);
-  return drumHitCache_[kDrumKickVoice];
+StepMask MiniAcid::patternKickSteps() const {
+  return StepMask{activeDrumPattern(kDrumKickVoice).hits};
 }
-const bool* MiniAcid::patternSnareSteps() const {
-  refreshDrumCache(kDrumSnareVoice);
-  return drumHitCache_[kDrumSnareVoice];
+StepMask MiniAcid::patternSnareSteps() const {
+  return StepMask{activeDrumPattern(kDrumSnareVoice).hits};
 }
-const bool* MiniAcid::patternHatSteps() const {
-  refreshDrumCache(kDrumHatVoice);
-  return drumHitCache_[kDrumHatVoice];
+StepMask MiniAcid::patternHatSteps() const {
+  return StepMask{activeDrumPattern(kDrumHatVoice).hits};
 }
-const bool* MiniAcid::patternOpenHatSteps() const {
-  refreshDrumCache(kDrumOpenHatVoice);
-  return drumHitCache_[kDrumOpenHatVoice];
+StepMask MiniAcid::patternOpenHatSteps() const {
+  return StepMask{activeDrumPattern(kDrumOpenHatVoice).hits};
 }
-const bool* MiniAcid::patternMidTomSteps() const {
-  refreshDrumCache(kDrumMidTomVoice);
-  return drumHitCache_[kDrumMidTomVoice];
+StepMask MiniAcid::patternMidTomSteps() const {
+  return StepMask{activeDrumPattern(kDrumMidTomVoice).hits};
 }
-const bool* MiniAcid::patternHighTomSteps() const {
-  refreshDrumCache(kDrumHighTomVoice);
-  return drumHitCache_[kDrumHighTomVoice];
+StepMask MiniAcid::patternHighTomSteps() const {
+  return StepMask{activeDrumPattern(kDrumHighTomVoice).hits};
 }
-const bool* MiniAcid::patternRimSteps() const {
-  refreshDrumCache(kDrumRimVoice);
-  return drumHitCache_[kDrumRimVoice];
+StepMask MiniAcid::patternRimSteps() const {
+  return StepMask{activeDrumPattern(kDrumRimVoice).hits};
 }
-const bool* MiniAcid::patternClapSteps() const {
-  refreshDrumCache(kDrumClapVoice);
-  return drumHitCache_[kDrumClapVoice];
+StepMask MiniAcid::patternClapSteps() const {
+  return StepMask{activeDrumPattern(kDrumClapVoice).hits};
 }
-const bool* MiniAcid::patternDrumAccentSteps() const {
-  int pat = songPatternIndexForTrack(SongTrack::Drums);
-  const DrumPatternSet& set = pat >= 0 ? sceneManager_.getDrumPatternSet(pat)
-                                       : kEmptyDrumPatternSet;
-  for (int i = 0; i < SEQ_STEPS; ++i) {
-    bool accent = false;
-    for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
-      if (set.voices[v].steps[i].accent) {
-        accent = true;
-        break;
-      }
-    }
-    drumStepAccentCache_[i] = accent;
-  }
-  return drumStepAccentCache_;
+StepMask MiniAcid::patternDrumAccentSteps() const {
+  const DrumPatternSet& set = activeDrumPatternSet();
+  uint16_t accents = 0;
+  for (int v = 0; v < DrumPatternSet::kVoices; ++v) accents |= set.voices[v].accents;
+  return StepMask{accents};
+}
+StepMask MiniAcid::patternKickAccentSteps() const {
+  return drumAccentMask(kDrumKickVoice);
 }
-const bool* MiniAcid::patternKickAccentSteps() const {
-  refreshDrumCache(kDrumKickVoice);
-  return drumAccentCache_[kDrumKickVoice];
+StepMask MiniAcid::patternSnareAccentSteps() const {
+  return drumAccentMask(kDrumSnareVoice);
 }
-const bool* MiniAcid::patternSnareAccentSteps() const {
-  refreshDrumCache(kDrumSnareVoice);
-  return drumAccentCache_[kDrumSnareVoice];
+StepMask MiniAcid::patternHatAccentSteps() const {
+  return drumAccentMask(kDrumHatVoice);
 }
-const bool* MiniAcid::patternHatAccentSteps() const {
-  refreshDrumCache(kDrumHatVoice);
-  return drumAccentCache_[kDrumHatVoice];
+StepMask MiniAcid::patternOpenHatAccentSteps() const {
+  return drumAccentMask(kDrumOpenHatVoice);
 }
-const bool* MiniAcid::patternOpenHatAccentSteps() const {
-  refreshDrumCache(kDrumOpenHatVoice);
-  return drumAccentCache_[kDrumOpenHatVoice];
+StepMask MiniAcid::patternMidTomAccentSteps() const {
+  return drumAccentMask(kDrumMidTomVoice);
 }
-const bool* MiniAcid::patternMidTomAccentSteps() const {
-  refreshDrumCache(kDrumMidTomVoice);
-  return drumAccentCache_[kDrumMidTomVoice];
+StepMask MiniAcid::patternHighTomAccentSteps() const {
+  return drumAccentMask(kDrumHighTomVoice);
 }
-const bool* MiniAcid::patternHighTomAccentSteps() const {
-  refreshDrumCache(kDrumHighTomVoice);
-  return drumAccentCache_[kDrumHighTomVoice];
+StepMask MiniAcid::patternRimAccentSteps() const {
+  return drumAccentMask(kDrumRimVoice);
 }
-const bool* MiniAcid::patternRimAccentSteps() const {
-  refreshDrumCache(kDrumRimVoice);
-  return drumAccentCache_[kDrumRimVoice];
+StepMask MiniAcid::patternClapAccentSteps() const {
+  return drumAccentMask(kDrumClapVoice);
 }
-const bool* MiniAcid::patternClapAccentSteps() const {
-  refreshDrumCache(kDrumClapVoice);
-  return drumAccentCache_[kDrumClapVoice];
+StepMask MiniAcid::drumAccentMask(int drumVoiceIndex) const {
+  const DrumPattern& pattern = activeDrumPattern(clampDrumVoice(drumVoiceIndex));
+  return StepMask{static_cast<uint16_t>(pattern.hits & pattern.accents)};
 }
 
 bool MiniAcid::songModeEnabled() const { return songMode_; }
@@ -434,114 +477,181 @@ bool MiniAcid::songModeEnabled() const { return songMode_; }
 void MiniAcid::setSongMode(bool enabled) {
   if (enabled == songMode_) return;
   if (enabled) {
-    patternModeDrumPatternIndex_ = sceneManager_.getCurrentDrumPatternIndex();
-    patternModeSynthPatternIndex_[0] = sceneManager_.getCurrentSynthPatternIndex(0);
-    patternModeSynthPatternIndex_[1] = sceneManager_.getCurrentSynthPatternIndex(1);
-    patternModeDrumBankIndex_ = sceneManager_.getCurrentBankIndex(0);
-    patternModeSynthBankIndex_[0] = sceneManager_.getCurrentBankIndex(1);
-    patternModeSynthBankIndex_[1] = sceneManager_.getCurrentBankIndex(2);
-    songPlayheadPosition_ = clampSongPosition(sceneManager_.getSongPosition());
-    sceneManager_.setSongPosition(songPlayheadPosition_);
+    patternModeDrumPatternIndex_ = sceneManager_->getCurrentDrumPatternIndex();
+    patternModeSynthPatternIndex_[0] = sceneManager_->getCurrentSynthPatternIndex(0);
+    patternModeSynthPatternIndex_[1] = sceneManager_->getCurrentSynthPatternIndex(1);
+    patternModeDrumBankIndex_ = sceneManager_->getCurrentBankIndex(0);
+    patternModeSynthBankIndex_[0] = sceneManager_->getCurrentBankIndex(1);
+    patternModeSynthBankIndex_[1] = sceneManager_->getCurrentBankIndex(2);
+    songPlayheadPosition_ = clampSongPosition(sceneManager_->getSongPosition());
+    sceneManager_->setSongPosition(songPlayheadPosition_);
     applySongPositionSelection();
   } else {
-    sceneManager_.setCurrentDrumPatternIndex(patternModeDrumPatternIndex_);
-    sceneManager_.setCurrentSynthPatternIndex(0, patternModeSynthPatternIndex_[0]);
-    sceneManager_.setCurrentSynthPatternIndex(1, patternModeSynthPatternIndex_[1]);
-    sceneManager_.setCurrentBankIndex(0, patternModeDrumBankIndex_);
-    sceneManager_.setCurrentBankIndex(1, patternModeSynthBankIndex_[0]);
-    sceneManager_.setCurrentBankIndex(2, patternModeSynthBankIndex_[1]);
+    sceneManager_->setCurrentDrumPatternIndex(patternModeDrumPatternIndex_);
+    sceneManager_->setCurrentSynthPatternIndex(0, patternModeSynthPatternIndex_[0]);
+    sceneManager_->setCurrentSynthPatternIndex(1, patternModeSynthPatternIndex_[1]);
+    sceneManager_->setCurrentBankIndex(0, patternModeDrumBankIndex_);
+    sceneManager_->setCurrentBankIndex(1, patternModeSynthBankIndex_[0]);
+    sceneManager_->setCurrentBankIndex(2, patternModeSynthBankIndex_[1]);
   }
   songMode_ = enabled;
-  sceneManager_.setSongMode(songMode_);
+  sceneManager_->setSongMode(songMode_);
 }
 
 void MiniAcid::toggleSongMode() { setSongMode(!songMode_); }
 
-bool MiniAcid::loopModeEnabled() const { return sceneManager_.loopMode(); }
+bool MiniAcid::loopModeEnabled() const { return sceneManager_->loopMode(); }
 
-void MiniAcid::setLoopMode(bool enabled) { sceneManager_.setLoopMode(enabled); }
+void MiniAcid::setLoopMode(bool enabled) { sceneManager_->setLoopMode(enabled); }
 
 void MiniAcid::setLoopRange(int startRow, int endRow) {
-  sceneManager_.setLoopRange(startRow, endRow);
+  sceneManager_->setLoopRange(startRow, endRow);
 }
 
-int MiniAcid::loopStartRow() const { return sceneManager_.loopStartRow(); }
+int MiniAcid::loopStartRow() const { return sceneManager_->loopStartRow(); }
 
-int MiniAcid::loopEndRow() const { return sceneManager_.loopEndRow(); }
+int MiniAcid::loopEndRow() const { return sceneManager_->loopEndRow(); }
 
-int MiniAcid::songLength() const { return sceneManager_.songLength(); }
+int MiniAcid::songLength() const { return sceneManager_->songLength(); }
 
-int MiniAcid::currentSongPosition() const { return sceneManager_.getSongPosition(); }
+int MiniAcid::currentSongPosition() const { return sceneManager_->getSongPosition(); }
 
 int MiniAcid::songPlayheadPosition() const { return songPlayheadPosition_; }
 
 void MiniAcid::setSongPosition(int position) {
   int pos = clampSongPosition(position);
-  sceneManager_.setSongPosition(pos);
+  sceneManager_->setSongPosition(pos);
   if (!playing) songPlayheadPosition_ = pos;
   if (songMode_) applySongPositionSelection();
 }
 
 void MiniAcid::setSongPattern(int position, SongTrack track, int patternIndex) {
-  sceneManager_.setSongPattern(position, track, patternIndex);
+  sceneManager_->setSongPattern(position, track, patternIndex);
   if (songMode_ && position == currentSongPosition()) {
     applySongPositionSelection();
   }
 }
 
 void MiniAcid::clearSongPattern(int position, SongTrack track) {
-  sceneManager_.clearSongPattern(position, track);
-  int pos = clampSongPosition(sceneManager_.getSongPosition());
-  sceneManager_.setSongPosition(pos);
+  sceneManager_->clearSongPattern(position, track);
+  int pos = clampSongPosition(sceneManager_->getSongPosition());
+  sceneManager_->setSongPosition(pos);
   if (songMode_ && position == pos) {
     applySongPositionSelection();
   }
 }
 
 int MiniAcid::songPatternAt(int position, SongTrack track) const {
-  return sceneManager_.songPattern(position, track);
+  return sceneManager_->songPattern(position, track);
 }
 
-const Song& MiniAcid::song() const { return sceneManager_.song(); }
+void MiniAcid::copySongRange(const Song& src, int srcRow, int dstRow, int rows,
+                             int srcTrack, int dstTrack, int tracks) {
+  sceneManager_->copySongRange(src, srcRow, dstRow, rows, srcTrack, dstTrack, tracks);
+  int pos = clampSongPosition(sceneManager_->getSongPosition());
+  sceneManager_->setSongPosition(pos);
+  if (songMode_ && pos >= dstRow && pos < dstRow + rows) {
+    applySongPositionSelection();
+  }
+}
+
+const Song& MiniAcid::song() const { return sceneManager_->song(); }
 
 int MiniAcid::display303PatternIndex(int voiceIndex) const {
   int idx = clamp303Voice(voiceIndex);
   if (songMode_) {
-    int combined = sceneManager_.songPattern(sceneManager_.getSongPosition(),
+    int combined = sceneManager_->songPattern(sceneManager_->getSongPosition(),
                                              idx == 0 ? SongTrack::SynthA : SongTrack::SynthB);
     if (combined < 0) return -1;
     return songPatternIndexInBank(combined);
   }
-  return sceneManager_.getCurrentSynthPatternIndex(idx);
+  return sceneManager_->getCurrentSynthPatternIndex(idx);
 }
 
 int MiniAcid::displayDrumPatternIndex() const {
   if (songMode_) {
-    int combined = sceneManager_.songPattern(sceneManager_.getSongPosition(), SongTrack::Drums);
+    int combined = sceneManager_->songPattern(sceneManager_->getSongPosition(), SongTrack::Drums);
     if (combined < 0) return -1;
     return songPatternIndexInBank(combined);
   }
-  return sceneManager_.getCurrentDrumPatternIndex();
+  return sceneManager_->getCurrentDrumPatternIndex();
 }
 
 std::vector<std::string> MiniAcid::getAvailableDrumEngines() const {
-  return {"808", "909", "606"};
+  int count = 0;
+  const DrumKitSpec* kits = drumKits(count);
+  std::vector<std::string> names;
+  names.reserve(count);
+  for (int k = 0; k < count; ++k) names.push_back(kits[k].name);
+  if (sceneStorage_) {
+    for (const auto& kit : sceneStorage_->drumSampleKitNames()) {
+      names.push_back(kSampleDrumEnginePrefix + kit);
+    }
+  }
+  return names;
 }
 
-void MiniAcid::setDrumEngine(const std::string& engineName) {
+std::unique_ptr<DrumSynthVoice> MiniAcid::makeDrumVoice(const std::string& engineName,
+                                                        bool hitCache,
+                                                        std::string& canonicalName) const {
+  size_t prefixLength = std::strlen(kSampleDrumEnginePrefix);
+  if (engineName.compare(0, prefixLength, kSampleDrumEnginePrefix) == 0) {
+    if (!sceneStorage_) return nullptr;
+    auto kit = sceneStorage_->loadDrumSampleKit(engineName.substr(prefixLength));
+    if (!kit) return nullptr;
+    canonicalName = engineName;
+    return std::make_unique<SampleDrumVoice>(std::move(kit), sampleRateValue);
+  }
   std::string name = toLowerCopy(engineName);
-  if (name.find("909") != std::string::npos) {
-    drums = std::make_unique<TR909DrumSynthVoice>(sampleRateValue);
-    drumEngineName_ = "909";
-  } else if (name.find("606") != std::string::npos) {
-    drums = std::make_unique<TR606DrumSynthVoice>(sampleRateValue);
-    drumEngineName_ = "606";
-  } else if (name.find("808") != std::string::npos) {
-    drums = std::make_unique<TR808DrumSynthVoice>(sampleRateValue);
-    drumEngineName_ = "808";
-  } else {
-    return;
+  int count = 0;
+  const DrumKitSpec* kits = drumKits(count);
+  for (int k = 0; k < count; ++k) {
+    if (name.find(kits[k].name) != std::string::npos) {
+      canonicalName = kits[k].name;
+      if (hitCache) return std::make_unique<CachedDrumKit>(kits[k], sampleRateValue);
+      return std::make_unique<DrumKit>(kits[k], sampleRateValue);
+    }
   }
+  return nullptr;
+}
+
+bool MiniAcid::prepareDrumEngine(const std::string& engineName) {
+  return stageDrumVoice(engineName, drumHitCache_);
+}
+
+bool MiniAcid::stageDrumVoice(const std::string& engineName, bool hitCache) {
+  stagedDrums_.reset();
+  stagedDrumsRequest_.clear();
+  std::string canonicalName;
+  std::unique_ptr<DrumSynthVoice> voice = makeDrumVoice(engineName, hitCache, canonicalName);
+  if (!voice) return false;
+  voice->reset();
+  stagedDrums_ = std::move(voice);
+  stagedDrumsRequest_ = engineName;
+  stagedDrumsName_ = canonicalName;
+  stagedDrumsHitCache_ = hitCache;
+  return true;
+}
+
+std::unique_ptr<DrumSynthVoice> MiniAcid::takeDrumVoice(const std::string& engineName,
+                                                        bool hitCache,
+                                                        std::string& canonicalName) {
+  if (stagedDrums_ && stagedDrumsRequest_ == engineName && stagedDrumsHitCache_ == hitCache) {
+    stagedDrumsRequest_.clear();
+    canonicalName = stagedDrumsName_;
+    return std::move(stagedDrums_);
+  }
+  return makeDrumVoice(engineName, hitCache, canonicalName);
+}
+
+void MiniAcid::setDrumEngine(const std::string& engineName) {
+  // A kit picked now wins over one a scene transition left to install.
+  pendingSceneDrums_.clear();
+  std::string canonicalName;
+  std::unique_ptr<DrumSynthVoice> voice = takeDrumVoice(engineName, drumHitCache_, canonicalName);
+  if (!voice) return;
+  drums = std::move(voice);
+  drumEngineName_ = canonicalName;
   drums->reset();
 }
 
@@ -549,20 +659,38 @@ std::string MiniAcid::currentDrumEngineName() const {
   return drumEngineName_;
 }
 
-size_t MiniAcid::copyLastAudio(int16_t *dst, size_t maxSamples) const {
-  if (!dst || maxSamples == 0) return 0;
-  size_t n = lastBufferCount;
-  if (n > maxSamples) n = maxSamples;
-  for (size_t i = 0; i < n; ++i) dst[i] = lastBuffer[i];
-  return n;
+bool MiniAcid::prepareDrumHitCache(bool enabled) {
+  return stageDrumVoice(drumEngineName_, enabled);
 }
 
+void MiniAcid::setDrumHitCacheEnabled(bool enabled) {
+  if (drumHitCache_ == enabled) return;
+  std::string canonicalName;
+  std::unique_ptr<DrumSynthVoice> voice = takeDrumVoice(drumEngineName_, enabled, canonicalName);
+  drumHitCache_ = enabled;
+  if (!voice) return;
+  drums = std::move(voice);
+  drumEngineName_ = canonicalName;
+  drums->reset();
+}
+
+bool MiniAcid::drumHitCacheEnabled() const { return drumHitCache_; }
+
 void MiniAcid::toggleMute303(int voiceIndex) {
-  int idx = clamp303Voice(voiceIndex);
-  if (idx == 0)
-    mute303 = !mute303;
-  else
-    mute303_2 = !mute303_2;
+  Synth303Channel& channel = channels303_[clamp303Voice(voiceIndex)];
+  channel.muted = !channel.muted;
+}
+uint32_t MiniAcid::drumMuteMask() const {
+  uint32_t mask = 0;
+  if (muteKick) mask |= 1u << kDrumKickVoice;
+  if (muteSnare) mask |= 1u << kDrumSnareVoice;
+  if (muteHat) mask |= 1u << kDrumHatVoice;
+  if (muteOpenHat) mask |= 1u << kDrumOpenHatVoice;
+  if (muteMidTom) mask |= 1u << kDrumMidTomVoice;
+  if (muteHighTom) mask |= 1u << kDrumHighTomVoice;
+  if (muteRim) mask |= 1u << kDrumRimVoice;
+  if (muteClap) mask |= 1u << kDrumClapVoice;
+  return mask;
 }
 void MiniAcid::toggleMuteKick() { muteKick = !muteKick; }
 void MiniAcid::toggleMuteSnare() { muteSnare = !muteSnare; }
@@ -573,89 +701,232 @@ void MiniAcid::toggleMuteHighTom() { muteHighTom = !muteHighTom; }
 void MiniAcid::toggleMuteRim() { muteRim = !muteRim; }
 void MiniAcid::toggleMuteClap() { muteClap = !muteClap; }
 void MiniAcid::toggleDelay303(int voiceIndex) {
-  int idx = clamp303Voice(voiceIndex);
-  if (idx == 0) {
-    delay303Enabled = !delay303Enabled;
-    delay303.setEnabled(delay303Enabled);
-  } else {
-    delay3032Enabled = !delay3032Enabled;
-    delay3032.setEnabled(delay3032Enabled);
-  }
+  Synth303Channel& channel = channels303_[clamp303Voice(voiceIndex)];
+  channel.delayEnabled = !channel.delayEnabled;
+  channel.delay.setEnabled(channel.delayEnabled);
 }
 void MiniAcid::toggleDistortion303(int voiceIndex) {
-  int idx = clamp303Voice(voiceIndex);
-  if (idx == 0) {
-    distortion303Enabled = !distortion303Enabled;
-    distortion303.setEnabled(distortion303Enabled);
-  } else {
-    distortion3032Enabled = !distortion3032Enabled;
-    distortion3032.setEnabled(distortion3032Enabled);
+  Synth303Channel& channel = channels303_[clamp303Voice(voiceIndex)];
+  channel.distortionEnabled = !channel.distortionEnabled;
+  channel.distortion.setEnabled(channel.distortionEnabled);
+}
+
+void MiniAcid::captureFreezeSource(int voice, Frozen303Loop& loop) const {
+  loop.pattern = activeSynthPattern(voice);
+  for (int id = 0; id < static_cast<int>(TB303ParamId::Count); ++id) {
+    loop.params[id] = voices303_.parameterValue(voice, static_cast<TB303ParamId>(id));
+  }
+  loop.bpm = bpmValue;
+  loop.swing = swingValue_;
+  loop.sampleRate = sampleRateValue;
+  loop.delayEnabled = channels303_[voice].delayEnabled;
+  loop.distortionEnabled = channels303_[voice].distortionEnabled;
+  loop.distortion = channels303_[voice].distortion;
+}
+
+bool MiniAcid::freezeSourceMatches(int voice, const Frozen303Loop& loop) const {
+  if (loop.bpm != bpmValue || loop.swing != swingValue_ || loop.sampleRate != sampleRateValue ||
+      loop.delayEnabled != channels303_[voice].delayEnabled ||
+      loop.distortionEnabled != channels303_[voice].distortionEnabled) {
+    return false;
+  }
+  for (int id = 0; id < static_cast<int>(TB303ParamId::Count); ++id) {
+    if (loop.params[id] != voices303_.parameterValue(voice, static_cast<TB303ParamId>(id))) {
+      return false;
+    }
+  }
+  return sameSynthPattern(loop.pattern, activeSynthPattern(voice));
+}
+
+// Runs the pattern through a private voice, distortion and delay exactly the
+// way generateAudioBuffer() does and keeps the second of two bars, so delay
+// tails from the end of the bar are already folded into its start.
+// Only 'source' is read, so this runs without the audio guard.
+std::unique_ptr<Frozen303Loop> MiniAcid::render303Freeze(int voice,
+                                                         const Frozen303Loop& source) const {
+  std::unique_ptr<Frozen303Loop> loop(new (std::nothrow) Frozen303Loop(source));
+  if (!loop) return nullptr;
+
+  const double ticksPerSample = static_cast<double>(loop->bpm) *
+                                SequencerTimeline::kTicksPerQuarter /
+                                (60.0 * static_cast<double>(loop->sampleRate));
+  const size_t length =
+    static_cast<size_t>(ceil(SequencerTimeline::kTicksPerBar / ticksPerSample)) + 1;
+  loop->samples.reserve(length);
+  if (loop->samples.capacity() < length) return nullptr;
+  loop->samples.assign(length, 0);
+
+  TB303VoiceBank bank(loop->sampleRate, 1);
+  for (int id = 0; id < static_cast<int>(TB303ParamId::Count); ++id) {
+    bank.setParameter(0, static_cast<TB303ParamId>(id), loop->params[id]);
+  }
+  TempoDelay delay(loop->sampleRate);
+  configure303Delay(delay, voice, loop->delayEnabled, loop->bpm);
+  TubeDistortion distortion = loop->distortion;
+  distortion.setEnabled(loop->distortionEnabled);
+
+  // The offline timeline only carries this pattern, so voice 0's events are
+  // the ones to play.
+  std::unique_ptr<SequencerTimeline> timeline(new (std::nothrow) SequencerTimeline());
+  if (!timeline) return nullptr;
+  const SynthPattern* synths[NUM_303_VOICES] = {&loop->pattern, &loop->pattern};
+  for (int step = 0; step < SequencerTimeline::kSteps; ++step) {
+    timeline->compileStep(step, synths, kEmptyDrumPatternSet, loop->swing);
+  }
+
+  std::vector<bool> written(length, false);
+  int step = -1;
+  double tick = 0.0;
+  int cursor = 0;
+  int bar = 0;
+  float out = 0.0f;
+  while (bar < 2) {
+    if (tick >= (step + 1) * SequencerTimeline::kTicksPerStep) {
+      if (step == SEQ_STEPS - 1) {
+        tick -= SequencerTimeline::kTicksPerBar;
+        if (++bar == 2) break;
+      }
+      step = (step + 1) % SEQ_STEPS;
+      cursor = 0;
+    }
+    int count = timeline->eventCount(step);
+    const SequencerEvent* events = timeline->events(step);
+    while (cursor < count && events[cursor].tick <= tick) {
+      const SequencerEvent& event = events[cursor++];
+      if (event.voice != 0) continue;
+      if (event.type == SequencerEvent::SynthNote) {
+        bank.startNote(0, noteToFreq(event.note), (event.flags & SequencerEvent::kAccent) != 0,
+                       (event.flags & SequencerEvent::kSlide) != 0);
+      } else if (event.type == SequencerEvent::SynthRelease) {
+        bank.release(0);
+      }
+    }
+    size_t index = static_cast<size_t>(tick / ticksPerSample);
+    tick += ticksPerSample;
+
+    bank.process(&out);
+    float sample = delay.process(distortion.process(out * 0.5f));
+    if (bar == 1 && index < length) {
+      float scaled = sample * Frozen303Loop::kScale;
+      if (scaled > 32767.0f) scaled = 32767.0f;
+      if (scaled < -32768.0f) scaled = -32768.0f;
+      loop->samples[index] = static_cast<int16_t>(scaled);
+      written[index] = true;
+    }
+  }
+  // A playhead that lands between rendered positions repeats the previous one.
+  for (size_t i = 1; i < length; ++i) {
+    if (!written[i]) loop->samples[i] = loop->samples[i - 1];
+  }
+  return loop;
+}
+
+bool MiniAcid::capture303Freeze(int voiceIndex) {
+  int voice = clamp303Voice(voiceIndex);
+  captureFreezeSource(voice, freezeSource_[voice]);
+  return true;
+}
+
+bool MiniAcid::prepare303Freeze(int voiceIndex) {
+  int voice = clamp303Voice(voiceIndex);
+  preparedFreeze_[voice].reset();
+  size_t inUse = frozen303Bytes() - frozenLoopBytes(channels303_[voice].freezeLoop);
+  std::unique_ptr<Frozen303Loop> loop = render303Freeze(voice, freezeSource_[voice]);
+  if (!loop || inUse + frozenLoopBytes(loop) > kFreeze303BudgetBytes) return false;
+  preparedFreeze_[voice] = std::move(loop);
+  return true;
+}
+
+bool MiniAcid::freeze303(int voiceIndex) {
+  int voice = clamp303Voice(voiceIndex);
+  Synth303Channel& channel = channels303_[voice];
+  // Rendering here would hold the audio guard for two bars of 303; a stale
+  // loop is dropped and the caller prepares a new one.
+  std::unique_ptr<Frozen303Loop> loop = std::move(preparedFreeze_[voice]);
+  if (!loop || !freezeSourceMatches(voice, *loop)) return false;
+  channel.freezeLoop = std::move(loop);
+  channel.frozen = true;
+  voices303_.release(voice);
+  return true;
+}
+
+void MiniAcid::unfreeze303(int voiceIndex) {
+  int voice = clamp303Voice(voiceIndex);
+  Synth303Channel& channel = channels303_[voice];
+  if (channel.frozen) channel.delay.reset();
+  channel.frozen = false;
+  channel.freezeLoop.reset();
+  preparedFreeze_[voice].reset();
+}
+
+bool MiniAcid::is303Frozen(int voiceIndex) const {
+  return channels303_[clamp303Voice(voiceIndex)].frozen;
+}
+
+size_t MiniAcid::frozen303Bytes() const {
+  size_t bytes = 0;
+  for (int v = 0; v < NUM_303_VOICES; ++v) {
+    bytes += frozenLoopBytes(channels303_[v].freezeLoop) + frozenLoopBytes(preparedFreeze_[v]);
   }
+  return bytes;
 }
 
 void MiniAcid::setDrumPatternIndex(int patternIndex) {
-  sceneManager_.setCurrentDrumPatternIndex(patternIndex);
+  sceneManager_->setCurrentDrumPatternIndex(patternIndex);
 }
 
 void MiniAcid::shiftDrumPatternIndex(int delta) {
-  int current = sceneManager_.getCurrentDrumPatternIndex();
+  int current = sceneManager_->getCurrentDrumPatternIndex();
   int next = current + delta;
   if (next < 0) next = Bank<DrumPatternSet>::kPatterns - 1;
   if (next >= Bank<DrumPatternSet>::kPatterns) next = 0;
-  sceneManager_.setCurrentDrumPatternIndex(next);
+  sceneManager_->setCurrentDrumPatternIndex(next);
 }
 
 void MiniAcid::setDrumBankIndex(int bankIndex) {
-  sceneManager_.setCurrentBankIndex(0, bankIndex);
+  sceneManager_->setCurrentBankIndex(0, bankIndex);
 }
 
 void MiniAcid::adjust303Parameter(TB303ParamId id, int steps, int voiceIndex) {
-  int idx = clamp303Voice(voiceIndex);
-  if (idx == 0)
-    voice303.adjustParameter(id, steps);
-  else
-    voice3032.adjustParameter(id, steps);
+  voices303_.adjustParameter(clamp303Voice(voiceIndex), id, steps);
 }
 void MiniAcid::set303Parameter(TB303ParamId id, float value, int voiceIndex) {
-  int idx = clamp303Voice(voiceIndex);
-  if (idx == 0)
-    voice303.setParameter(id, value);
-  else
-    voice3032.setParameter(id, value);
+  voices303_.setParameter(clamp303Voice(voiceIndex), id, value);
 }
 void MiniAcid::set303PatternIndex(int voiceIndex, int patternIndex) {
   int idx = clamp303Voice(voiceIndex);
-  sceneManager_.setCurrentSynthPatternIndex(idx, patternIndex);
+  sceneManager_->setCurrentSynthPatternIndex(idx, patternIndex);
 }
 void MiniAcid::shift303PatternIndex(int voiceIndex, int delta) {
   int idx = clamp303Voice(voiceIndex);
-  int current = sceneManager_.getCurrentSynthPatternIndex(idx);
+  int current = sceneManager_->getCurrentSynthPatternIndex(idx);
   int next = current + delta;
   if (next < 0) next = Bank<SynthPattern>::kPatterns - 1;
   if (next >= Bank<SynthPattern>::kPatterns) next = 0;
-  sceneManager_.setCurrentSynthPatternIndex(idx, next);
+  sceneManager_->setCurrentSynthPatternIndex(idx, next);
 }
 
 void MiniAcid::set303BankIndex(int voiceIndex, int bankIndex) {
   int idx = clamp303Voice(voiceIndex);
-  sceneManager_.setCurrentBankIndex(idx + 1, bankIndex);
+  sceneManager_->setCurrentBankIndex(idx + 1, bankIndex);
 }
 void MiniAcid::adjust303StepNote(int voiceIndex, int stepIndex, int semitoneDelta) {
   int idx = clamp303Voice(voiceIndex);
   int step = clamp303Step(stepIndex);
-  SynthPattern& pattern = editSynthPattern(idx);
-  int note = pattern.steps[step].note;
+  SynthPattern* pattern = editSynthPattern(idx);
+  if (!pattern) return;
+  int note = pattern->steps[step].note;
   if (note < 0) {
     if (semitoneDelta <= 0) return; // keep rests when moving downward
     note = kMin303Note;
   }
   note += semitoneDelta;
   if (note < kMin303Note) {
-    pattern.steps[step].note = -1;
-    return;
+    pattern->steps[step].note = -1;
+  } else {
+    pattern->steps[step].note = static_cast<int8_t>(clamp303Note(note));
   }
-  note = clamp303Note(note);
-  pattern.steps[step].note = static_cast<int8_t>(note);
+  markTimelineDirty(step);
 }
 void MiniAcid::adjust303StepOctave(int voiceIndex, int stepIndex, int octaveDelta) {
   adjust303StepNote(voiceIndex, stepIndex, octaveDelta * 12);
@@ -663,20 +934,26 @@ void MiniAcid::adjust303StepOctave(int voiceIndex, int stepIndex, int octaveDelt
 void MiniAcid::clear303StepNote(int voiceIndex, int stepIndex) {
   int idx = clamp303Voice(voiceIndex);
   int step = clamp303Step(stepIndex);
-  SynthPattern& pattern = editSynthPattern(idx);
-  pattern.steps[step].note = -1;
+  SynthPattern* pattern = editSynthPattern(idx);
+  if (!pattern) return;
+  pattern->steps[step].note = -1;
+  markTimelineDirty(step);
 }
 void MiniAcid::toggle303AccentStep(int voiceIndex, int stepIndex) {
   int idx = clamp303Voice(voiceIndex);
   int step = clamp303Step(stepIndex);
-  SynthPattern& pattern = editSynthPattern(idx);
-  pattern.steps[step].accent = !pattern.steps[step].accent;
+  SynthPattern* pattern = editSynthPattern(idx);
+  if (!pattern) return;
+  pattern->steps[step].accent = !pattern->steps[step].accent;
+  markTimelineDirty(step);
 }
 void MiniAcid::toggle303SlideStep(int voiceIndex, int stepIndex) {
   int idx = clamp303Voice(voiceIndex);
   int step = clamp303Step(stepIndex);
-  SynthPattern& pattern = editSynthPattern(idx);
-  pattern.steps[step].slide = !pattern.steps[step].slide;
+  SynthPattern* pattern = editSynthPattern(idx);
+  if (!pattern) return;
+  pattern->steps[step].slide = !pattern->steps[step].slide;
+  markTimelineDirty(step);
 }
 
 void MiniAcid::toggleDrumStep(int voiceIndex, int stepIndex) {
@@ -684,26 +961,30 @@ void MiniAcid::toggleDrumStep(int voiceIndex, int stepIndex) {
   int step = stepIndex;
   if (step < 0) step = 0;
   if (step >= DrumPattern::kSteps) step = DrumPattern::kSteps - 1;
-  DrumPattern& pattern = editDrumPattern(voice);
-  pattern.steps[step].hit = !pattern.steps[step].hit;
+  DrumPattern* pattern = editDrumPattern(voice);
+  if (!pattern) return;
+  pattern->setHit(step, !pattern->hit(step));
+  markTimelineDirty(step);
 }
 
 void MiniAcid::toggleDrumAccentStep(int stepIndex) {
   int step = stepIndex;
   if (step < 0) step = 0;
   if (step >= DrumPattern::kSteps) step = DrumPattern::kSteps - 1;
-  DrumPatternSet& patternSet = sceneManager_.editCurrentDrumPattern();
+  DrumPatternSet* patternSet = sceneManager_->editCurrentDrumPattern();
+  if (!patternSet) return;
   bool anyAccent = false;
   for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
-    if (patternSet.voices[v].steps[step].accent) {
+    if (patternSet->voices[v].accent(step)) {
       anyAccent = true;
       break;
     }
   }
   bool newAccent = !anyAccent;
   for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
-    patternSet.voices[v].steps[step].accent = newAccent;
+    patternSet->voices[v].setAccent(step, newAccent);
   }
+  markTimelineDirty(step);
 }
 
 void MiniAcid::setDrumAccentStep(int voiceIndex, int stepIndex, bool accent) {
@@ -711,8 +992,10 @@ void MiniAcid::setDrumAccentStep(int voiceIndex, int stepIndex, bool accent) {
   int step = stepIndex;
   if (step < 0) step = 0;
   if (step >= DrumPattern::kSteps) step = DrumPattern::kSteps - 1;
-  DrumPattern& pattern = editDrumPattern(voice);
-  pattern.steps[step].accent = accent;
+  DrumPattern* pattern = editDrumPattern(voice);
+  if (!pattern) return;
+  pattern->setAccent(step, accent);
+  markTimelineDirty(step);
 }
 
 int MiniAcid::clamp303Voice(int voiceIndex) const {
@@ -738,41 +1021,42 @@ int MiniAcid::clamp303Note(int note) const {
 
 const SynthPattern& MiniAcid::synthPattern(int synthIndex) const {
   int idx = clamp303Voice(synthIndex);
-  return sceneManager_.getCurrentSynthPattern(idx);
+  return sceneManager_->getCurrentSynthPattern(idx);
 }
 
-SynthPattern& MiniAcid::editSynthPattern(int synthIndex) {
+SynthPattern* MiniAcid::editSynthPattern(int synthIndex) {
   int idx = clamp303Voice(synthIndex);
-  return sceneManager_.editCurrentSynthPattern(idx);
+  return sceneManager_->editCurrentSynthPattern(idx);
 }
 
 const DrumPattern& MiniAcid::drumPattern(int drumVoiceIndex) const {
   int idx = clampDrumVoice(drumVoiceIndex);
-  const DrumPatternSet& patternSet = sceneManager_.getCurrentDrumPattern();
+  const DrumPatternSet& patternSet = sceneManager_->getCurrentDrumPattern();
   return patternSet.voices[idx];
 }
 
-DrumPattern& MiniAcid::editDrumPattern(int drumVoiceIndex) {
+DrumPattern* MiniAcid::editDrumPattern(int drumVoiceIndex) {
   int idx = clampDrumVoice(drumVoiceIndex);
-  DrumPatternSet& patternSet = sceneManager_.editCurrentDrumPattern();
-  return patternSet.voices[idx];
+  DrumPatternSet* patternSet = sceneManager_->editCurrentDrumPattern();
+  if (!patternSet) return nullptr;
+  return &patternSet->voices[idx];
 }
 
 int MiniAcid::songPatternIndexForTrack(SongTrack track) const {
   if (!songMode_) {
     switch (track) {
     case SongTrack::SynthA:
-      return sceneManager_.getCurrentSynthPatternIndex(0);
+      return sceneManager_->getCurrentSynthPatternIndex(0);
     case SongTrack::SynthB:
-      return sceneManager_.getCurrentSynthPatternIndex(1);
+      return sceneManager_->getCurrentSynthPatternIndex(1);
     case SongTrack::Drums:
-      return sceneManager_.getCurrentDrumPatternIndex();
+      return sceneManager_->getCurrentDrumPatternIndex();
     default:
       return -1;
     }
   }
-  int pos = clampSongPosition(sceneManager_.getSongPosition());
-  int combined = sceneManager_.songPattern(pos, track);
+  int pos = clampSongPosition(sceneManager_->getSongPosition());
+  int combined = sceneManager_->songPattern(pos, track);
   if (combined < 0) return -1;
   return songPatternIndexInBank(combined);
 }
@@ -782,19 +1066,20 @@ const SynthPattern& MiniAcid::activeSynthPattern(int synthIndex) const {
   SongTrack track = idx == 0 ? SongTrack::SynthA : SongTrack::SynthB;
   int pat = songPatternIndexForTrack(track);
   if (pat < 0) return kEmptySynthPattern;
-  return sceneManager_.getSynthPattern(idx, pat);
+  return sceneManager_->getSynthPattern(idx, pat);
 }
 
 const DrumPattern& MiniAcid::activeDrumPattern(int drumVoiceIndex) const {
-  int idx = clampDrumVoice(drumVoiceIndex);
+  return activeDrumPatternSet().voices[clampDrumVoice(drumVoiceIndex)];
+}
+
+const DrumPatternSet& MiniAcid::activeDrumPatternSet() const {
   int pat = songPatternIndexForTrack(SongTrack::Drums);
-  const DrumPatternSet& set = pat >= 0 ? sceneManager_.getDrumPatternSet(pat)
-                                       : kEmptyDrumPatternSet;
-  return set.voices[idx];
+  return pat >= 0 ? sceneManager_->getDrumPatternSet(pat) : kEmptyDrumPatternSet;
 }
 
 int MiniAcid::clampSongPosition(int position) const {
-  int len = sceneManager_.songLength();
+  int len = sceneManager_->songLength();
   if (len < 1) len = 1;
   if (position < 0) return 0;
   if (position >= len) return len - 1;
@@ -804,57 +1089,73 @@ int MiniAcid::clampSongPosition(int position) const {
 
 void MiniAcid::applySongPositionSelection() {
   if (!songMode_) return;
-  int pos = clampSongPosition(sceneManager_.getSongPosition());
-  sceneManager_.setSongPosition(pos);
+  int pos = clampSongPosition(sceneManager_->getSongPosition());
+  sceneManager_->setSongPosition(pos);
   songPlayheadPosition_ = pos;
-  int patA = sceneManager_.songPattern(pos, SongTrack::SynthA);
-  int patB = sceneManager_.songPattern(pos, SongTrack::SynthB);
-  int patD = sceneManager_.songPattern(pos, SongTrack::Drums);
+  int patA = sceneManager_->songPattern(pos, SongTrack::SynthA);
+  int patB = sceneManager_->songPattern(pos, SongTrack::SynthB);
+  int patD = sceneManager_->songPattern(pos, SongTrack::Drums);
 
   if (patA < 0) {
-    sceneManager_.setCurrentBankIndex(1, patternModeSynthBankIndex_[0]);
-    sceneManager_.setCurrentSynthPatternIndex(0, patternModeSynthPatternIndex_[0]);
+    sceneManager_->setCurrentBankIndex(1, patternModeSynthBankIndex_[0]);
+    sceneManager_->setCurrentSynthPatternIndex(0, patternModeSynthPatternIndex_[0]);
   } else {
     int bank = songPatternBank(patA);
     int pat = songPatternIndexInBank(patA);
     if (bank < 0) bank = 0;
     if (bank >= kBankCount) bank = kBankCount - 1;
-    sceneManager_.setCurrentBankIndex(1, bank);
-    sceneManager_.setCurrentSynthPatternIndex(0, pat);
+    sceneManager_->setCurrentBankIndex(1, bank);
+    sceneManager_->setCurrentSynthPatternIndex(0, pat);
   }
 
   if (patB < 0) {
-    sceneManager_.setCurrentBankIndex(2, patternModeSynthBankIndex_[1]);
-    sceneManager_.setCurrentSynthPatternIndex(1, patternModeSynthPatternIndex_[1]);
+    sceneManager_->setCurrentBankIndex(2, patternModeSynthBankIndex_[1]);
+    sceneManager_->setCurrentSynthPatternIndex(1, patternModeSynthPatternIndex_[1]);
   } else {
     int bank = songPatternBank(patB);
     int pat = songPatternIndexInBank(patB);
     if (bank < 0) bank = 0;
     if (bank >= kBankCount) bank = kBankCount - 1;
-    sceneManager_.setCurrentBankIndex(2, bank);
-    sceneManager_.setCurrentSynthPatternIndex(1, pat);
+    sceneManager_->setCurrentBankIndex(2, bank);
+    sceneManager_->setCurrentSynthPatternIndex(1, pat);
   }
 
   if (patD < 0) {
-    sceneManager_.setCurrentBankIndex(0, patternModeDrumBankIndex_);
-    sceneManager_.setCurrentDrumPatternIndex(patternModeDrumPatternIndex_);
+    sceneManager_->setCurrentBankIndex(0, patternModeDrumBankIndex_);
+    sceneManager_->setCurrentDrumPatternIndex(patternModeDrumPatternIndex_);
   } else {
     int bank = songPatternBank(patD);
     int pat = songPatternIndexInBank(patD);
     if (bank < 0) bank = 0;
     if (bank >= kBankCount) bank = kBankCount - 1;
-    sceneManager_.setCurrentBankIndex(0, bank);
-    sceneManager_.setCurrentDrumPatternIndex(pat);
+    sceneManager_->setCurrentBankIndex(0, bank);
+    sceneManager_->setCurrentDrumPatternIndex(pat);
+  }
+
+  // Ask the UI thread to page in the next position's banks a bar ahead.
+  uint32_t upcoming = songPositionBanksMask(nextSongPosition(pos));
+  if (upcoming & ~sceneManager_->residentBanksMask()) bankRequests_.fetch_or(upcoming);
+}
+
+uint32_t MiniAcid::songPositionBanksMask(int position) const {
+  uint32_t mask = 0;
+  const SongTrack tracks[] = {SongTrack::SynthA, SongTrack::SynthB, SongTrack::Drums};
+  for (SongTrack track : tracks) {
+    int pattern = sceneManager_->songPattern(position, track);
+    if (pattern < 0) continue;
+    int bank = songPatternBank(pattern);
+    if (bank >= 0 && bank < kBankCount) mask |= 1u << bank;
   }
+  return mask;
 }
 
-void MiniAcid::advanceSongPlayhead() {
-  int len = sceneManager_.songLength();
+int MiniAcid::nextSongPosition(int position) const {
+  int len = sceneManager_->songLength();
   if (len < 1) len = 1;
-  int nextPos = (songPlayheadPosition_ + 1) % len;
-  if (sceneManager_.loopMode()) {
-    int loopStart = sceneManager_.loopStartRow();
-    int loopEnd = sceneManager_.loopEndRow();
+  int nextPos = (position + 1) % len;
+  if (sceneManager_->loopMode()) {
+    int loopStart = sceneManager_->loopStartRow();
+    int loopEnd = sceneManager_->loopEndRow();
     if (loopStart < 0) loopStart = 0;
     if (loopEnd < 0) loopEnd = 0;
     if (loopStart >= len) loopStart = len - 1;
@@ -864,40 +1165,26 @@ void MiniAcid::advanceSongPlayhead() {
       loopStart = loopEnd;
       loopEnd = tmp;
     }
-    if (songPlayheadPosition_ < loopStart || songPlayheadPosition_ > loopEnd) {
+    if (position < loopStart || position > loopEnd) {
       nextPos = loopStart;
-    } else if (songPlayheadPosition_ >= loopEnd) {
+    } else if (position >= loopEnd) {
       nextPos = loopStart;
     } else {
-      nextPos = songPlayheadPosition_ + 1;
+      nextPos = position + 1;
     }
   }
-  songPlayheadPosition_ = nextPos;
-  sceneManager_.setSongPosition(songPlayheadPosition_);
-  applySongPositionSelection();
-}
-
-void MiniAcid::refreshSynthCaches(int synthIndex) const {
-  int idx = clamp303Voice(synthIndex);
-  const SynthPattern& pattern = activeSynthPattern(idx);
-  for (int i = 0; i < SEQ_STEPS; ++i) {
-    synthNotesCache_[idx][i] = static_cast<int8_t>(pattern.steps[i].note);
-    synthAccentCache_[idx][i] = pattern.steps[i].accent;
-    synthSlideCache_[idx][i] = pattern.steps[i].slide;
-  }
+  return nextPos;
 }
 
-void MiniAcid::refreshDrumCache(int drumVoiceIndex) const {
-  int idx = clampDrumVoice(drumVoiceIndex);
-  const DrumPattern& pattern = activeDrumPattern(idx);
-  for (int i = 0; i < SEQ_STEPS; ++i) {
-    drumHitCache_[idx][i] = pattern.steps[i].hit;
-    drumAccentCache_[idx][i] = pattern.steps[i].accent && pattern.steps[i].hit;
-  }
+void MiniAcid::advanceSongPlayhead() {
+  songPlayheadPosition_ = nextSongPosition(songPlayheadPosition_);
+  sceneManager_->setSongPosition(songPlayheadPosition_);
+  applySongPositionSelection();
 }
 
-void MiniAcid::updateSamplesPerStep() {
-  samplesPerStep = sampleRateValue * 60.0f / (bpmValue * 4.0f);
+void MiniAcid::updateTickRate() {
+  ticksPerSample_ = static_cast<double>(bpmValue) * SequencerTimeline::kTicksPerQuarter /
+                    (60.0 * static_cast<double>(sampleRateValue));
 }
 
 float MiniAcid::noteToFreq(int note) {
@@ -908,177 +1195,272 @@ void MiniAcid::advanceStep() {
   int prevStep = currentStepIndex;
   currentStepIndex = (currentStepIndex + 1) % SEQ_STEPS;
 
+  bool wrapped = prevStep < 0;
   if (songMode_) {
     if (prevStep < 0) {
-      songPlayheadPosition_ = clampSongPosition(sceneManager_.getSongPosition());
-      sceneManager_.setSongPosition(songPlayheadPosition_);
+      songPlayheadPosition_ = clampSongPosition(sceneManager_->getSongPosition());
+      sceneManager_->setSongPosition(songPlayheadPosition_);
       applySongPositionSelection();
     } else if (currentStepIndex == 0) {
+      int previousPosition = songPlayheadPosition_;
       advanceSongPlayhead();
+      wrapped = songPlayheadPosition_ <= previousPosition;
     }
   }
 
-  // DEBUG: toggle drum kit every measure for testing
-  /*
-  if (prevStep >= 0 && currentStepIndex == 0) {
-    drumCycleIndex_ = (drumCycleIndex_ + 1) % 3;
-    if (drumCycleIndex_ == 0) {
-      drums = std::make_unique<TR808DrumSynthVoice>(sampleRateValue);
-      // printf("Switched to TR-808 drum kit\n");
-    } else if (drumCycleIndex_ == 1) {
-      drums = std::make_unique<TR909DrumSynthVoice>(sampleRateValue);
-      // printf("Switched to TR-909 drum kit\n");
-    } else {
-      drums = std::make_unique<TR606DrumSynthVoice>(sampleRateValue);
-      // printf("Switched to TR-606 drum kit\n");
-    }
+  if (currentStepIndex == 0 && sceneTransitionReady()) {
+    bool waitForLoop = transitionQuantize_ == SceneTransitionQuantize::Loop && songMode_;
+    if (!waitForLoop || wrapped) applySceneTransition();
   }
-  */
-  int songPatternA = songPatternIndexForTrack(SongTrack::SynthA);
-  int songPatternB = songPatternIndexForTrack(SongTrack::SynthB);
-  int songPatternDrums = songPatternIndexForTrack(SongTrack::Drums);
-
-  // 303 voices
-  const SynthPattern& synthA = activeSynthPattern(0);
-  const SynthPattern& synthB = activeSynthPattern(1);
-  const SynthStep& stepA = synthA.steps[currentStepIndex];
-  const SynthStep& stepB = synthB.steps[currentStepIndex];
-  int note = stepA.note;
-  bool accent = stepA.accent;
-  bool slide = stepA.slide;
-
-  int note2 = stepB.note;
-  bool accent2 = stepB.accent;
-  bool slide2 = stepB.slide;
-
-  if (!mute303 && songPatternA >= 0 && note >= 0)
-    voice303.startNote(noteToFreq(note), accent, slide);
-  else
-    voice303.release();
-
-  if (!mute303_2 && songPatternB >= 0 && note2 >= 0)
-    voice3032.startNote(noteToFreq(note2), accent2, slide2);
-  else
-    voice3032.release();
-
-  // Drums
-  const DrumPattern& kick = activeDrumPattern(kDrumKickVoice);
-  const DrumPattern& snare = activeDrumPattern(kDrumSnareVoice);
-  const DrumPattern& hat = activeDrumPattern(kDrumHatVoice);
-  const DrumPattern& openHat = activeDrumPattern(kDrumOpenHatVoice);
-  const DrumPattern& midTom = activeDrumPattern(kDrumMidTomVoice);
-  const DrumPattern& highTom = activeDrumPattern(kDrumHighTomVoice);
-  const DrumPattern& rim = activeDrumPattern(kDrumRimVoice);
-  const DrumPattern& clap = activeDrumPattern(kDrumClapVoice);
-
-  bool drumsActive = songPatternDrums >= 0;
-  bool stepAccent =
-    kick.steps[currentStepIndex].accent ||
-    snare.steps[currentStepIndex].accent ||
-    hat.steps[currentStepIndex].accent ||
-    openHat.steps[currentStepIndex].accent ||
-    midTom.steps[currentStepIndex].accent ||
-    highTom.steps[currentStepIndex].accent ||
-    rim.steps[currentStepIndex].accent ||
-    clap.steps[currentStepIndex].accent;
-
-  if (kick.steps[currentStepIndex].hit && !muteKick && drumsActive)
-    drums->triggerKick(stepAccent);
-  if (snare.steps[currentStepIndex].hit && !muteSnare && drumsActive)
-    drums->triggerSnare(stepAccent);
-  if (hat.steps[currentStepIndex].hit && !muteHat && drumsActive)
-    drums->triggerHat(stepAccent);
-  if (openHat.steps[currentStepIndex].hit && !muteOpenHat && drumsActive)
-    drums->triggerOpenHat(stepAccent);
-  if (midTom.steps[currentStepIndex].hit && !muteMidTom && drumsActive)
-    drums->triggerMidTom(stepAccent);
-  if (highTom.steps[currentStepIndex].hit && !muteHighTom && drumsActive)
-    drums->triggerHighTom(stepAccent);
-  if (rim.steps[currentStepIndex].hit && !muteRim && drumsActive)
-    drums->triggerRim(stepAccent);
-  if (clap.steps[currentStepIndex].hit && !muteClap && drumsActive)
-    //drums->triggerCymbal(stepAccent);
-    drums->triggerClap(stepAccent);
+
+  syncTimeline();
+  eventCursor_ = 0;
 }
 
-void MiniAcid::generateAudioBuffer(int16_t *buffer, size_t numSamples) {
-  if (!buffer || numSamples == 0) {
-    return;
+void MiniAcid::markTimelineDirty(int step) {
+  uint32_t bits = step < 0 ? 0xFFFFu : (1u << (step & (SequencerTimeline::kSteps - 1)));
+  timelineDirty_.fetch_or(bits);
+}
+
+void MiniAcid::syncTimeline() {
+  const SynthPattern* synths[NUM_303_VOICES] = {&activeSynthPattern(0), &activeSynthPattern(1)};
+  const DrumPatternSet* drumSet = &activeDrumPatternSet();
+  float swing = swingValue_;
+  uint32_t dirty = timelineDirty_.exchange(0);
+  if (synths[0] != timelineSynths_[0] || synths[1] != timelineSynths_[1] ||
+      drumSet != timelineDrums_ || swing != timelineSwing_) {
+    dirty = 0xFFFFu;
+    timelineSynths_[0] = synths[0];
+    timelineSynths_[1] = synths[1];
+    timelineDrums_ = drumSet;
+    timelineSwing_ = swing;
+  }
+  for (int step = 0; dirty; ++step, dirty >>= 1) {
+    if (dirty & 1u) timeline_.compileStep(step, synths, *drumSet, swing);
   }
+}
 
-  updateSamplesPerStep();
-  delay303.setBpm(bpmValue);
-  delay3032.setBpm(bpmValue);
+void MiniAcid::play303Event(const SequencerEvent& event) {
+  int voice = clamp303Voice(event.voice);
+  const Synth303Channel& channel = channels303_[voice];
+  if (event.type == SequencerEvent::SynthNote && !channel.muted && !channel.frozen) {
+    voices303_.startNote(voice, noteToFreq(event.note), (event.flags & SequencerEvent::kAccent) != 0,
+                         (event.flags & SequencerEvent::kSlide) != 0);
+  } else {
+    voices303_.release(voice);
+  }
+}
 
-  for (size_t i = 0; i < numSamples; ++i) {
-    if (playing) {
-      if (samplesIntoStep >= (unsigned long)samplesPerStep) {
-        samplesIntoStep = 0;
-        advanceStep();
-      }
-      samplesIntoStep++;
+bool MiniAcid::setParallelRender(bool enabled) {
+  if (!enabled) {
+    renderSplit_.stop();
+    return true;
+  }
+  return renderSplit_.start();
+}
+
+bool MiniAcid::parallelRender() const { return renderSplit_.running(); }
+
+int MiniAcid::sequenceChunk(int maxSamples) {
+  chunkEventCount_ = 0;
+  int n = 0;
+  for (; n < maxSamples; ++n) {
+    if (tickPosition_ >= (currentStepIndex + 1) * SequencerTimeline::kTicksPerStep) {
+      // A scene change starts a new chunk, so the voices it swaps in never
+      // play events that were queued for the old ones.
+      if (n > 0 && currentStepIndex == SEQ_STEPS - 1 && sceneTransitionReady()) break;
+      if (chunkEventCount_ + SequencerTimeline::kMaxStepEvents > kMaxChunkEvents) break;
+      if (currentStepIndex == SEQ_STEPS - 1) tickPosition_ -= SequencerTimeline::kTicksPerBar;
+      advanceStep();
     }
+    int count = timeline_.eventCount(currentStepIndex);
+    const SequencerEvent* events = timeline_.events(currentStepIndex);
+    while (eventCursor_ < count && events[eventCursor_].tick <= tickPosition_) {
+      ChunkEvent& queued = chunkEvents_[chunkEventCount_++];
+      queued.offset = static_cast<uint16_t>(n);
+      queued.event = events[eventCursor_++];
+    }
+    chunkLoopIndex_[n] = static_cast<uint32_t>(tickPosition_ / ticksPerSample_);
+    tickPosition_ += ticksPerSample_;
+  }
+  return n;
+}
 
-    float sample = 0.0f;
-    if (playing) {
-      float sample303 = 0.0f;
-      if (!mute303) {
-        float v = voice303.process() * 0.5f;
-        v = distortion303.process(v);
-        sample303 += delay303.process(v);
+void MiniAcid::render303Chunk() {
+  constexpr float kFrozenScale = 1.0f / Frozen303Loop::kScale;
+  const uint32_t muted = renderMuted303_;
+  const uint32_t frozen = renderFrozen303_;
+  float voiceOut[TB303VoiceBank::kMaxVoices];
+  float* stems = renderStems_;
+  const int stride = stemCount(stemLayout_);
+  int next = 0;
+  for (int i = 0; i < chunkLength_; ++i) {
+    for (; next < chunkEventCount_ && chunkEvents_[next].offset == i; ++next) {
+      const SequencerEvent& event = chunkEvents_[next].event;
+      if (event.type != SequencerEvent::DrumHit) play303Event(event);
+    }
+    float sample303 = 0.0f;
+    voices303_.process(voiceOut, muted | frozen);
+    for (int v = 0; v < NUM_303_VOICES; ++v) {
+      Synth303Channel& channel = channels303_[v];
+      float out = 0.0f;
+      if (frozen & (1u << v)) {
+        if (!(muted & (1u << v))) {
+          const std::vector<int16_t>& loop = channel.freezeLoop->samples;
+          size_t index = chunkLoopIndex_[i] < loop.size() ? chunkLoopIndex_[i] : loop.size() - 1;
+          out = static_cast<float>(loop[index]) * kFrozenScale;
+        }
+      } else if (!(muted & (1u << v))) {
+        out = channel.delay.process(channel.distortion.process(voiceOut[v] * 0.5f));
       } else {
         // keep delay line ticking even while muted to let tails decay
-        delay303.process(0.0f);
+        channel.delay.process(0.0f);
       }
-      if (!mute303_2) {
-        float v = voice3032.process() * 0.5f;
-        v = distortion3032.process(v);
-        sample303 += delay3032.process(v);
-      } else {
-        delay3032.process(0.0f);
+      sample303 += out;
+      if (stems) stems[i * stride + v] = out * kMixGain;
+    }
+    chunk303_[i] = sample303;
+  }
+}
+
+void MiniAcid::renderDrumChunk() {
+  const uint32_t muted = renderMutedDrums_;
+  float* stems = renderStems_;
+  const bool perLane = stemLayout_ == StemLayout::PerLane;
+  const int stride = stemCount(stemLayout_);
+  float lanes[kDrumLanes];
+  int next = 0;
+  for (int i = 0; i < chunkLength_; ++i) {
+    for (; next < chunkEventCount_ && chunkEvents_[next].offset == i; ++next) {
+      const SequencerEvent& event = chunkEvents_[next].event;
+      if (event.type == SequencerEvent::DrumHit && !(muted & (1u << event.voice))) {
+        drums->trigger(event.voice, (event.flags & SequencerEvent::kAccent) != 0);
       }
-      if (!muteKick)
-        sample += drums->processKick();
-      if (!muteSnare)
-        sample += drums->processSnare();
-      if (!muteHat)
-        sample += drums->processHat();
-      if (!muteOpenHat)
-        sample += drums->processOpenHat();
-      if (!muteMidTom)
-        sample += drums->processMidTom();
-      if (!muteHighTom)
-        sample += drums->processHighTom();
-      if (!muteRim)
-        sample += drums->processRim();
-      if (!muteClap)
-        // sample += drums->processCymbal();
-        sample += drums->processClap();
-      sample += sample303;
     }
+    if (!stems) {
+      chunkDrums_[i] = drums->process(muted);
+    } else if (perLane) {
+      chunkDrums_[i] = drums->processLanes(muted, lanes);
+      float* frame = stems + i * stride + NUM_303_VOICES;
+      for (int l = 0; l < kDrumLanes; ++l) frame[l] = lanes[l] * kMixGain;
+    } else {
+      chunkDrums_[i] = drums->process(muted);
+      stems[i * stride + NUM_303_VOICES] = chunkDrums_[i] * kMixGain;
+    }
+  }
+}
+
+void MiniAcid::render303Job(void* engine) { static_cast<MiniAcid*>(engine)->render303Chunk(); }
+
+void MiniAcid::renderDrumJob(void* engine) { static_cast<MiniAcid*>(engine)->renderDrumChunk(); }
 
-    // Soft clipping/limiting
-    sample *= 0.65f;
-    if (sample > 1.0f)
-      sample = 1.0f;
-    if (sample < -1.0f)
-      sample = -1.0f;
+void MiniAcid::renderMix(float* buffer, size_t numSamples, float* stems) {
+  // Pairs with BankReaders::readTicket(): either paging sees this render
+  // start, or this render sees the slot it unpublished.
+  renderEpoch_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
 
+  if (!playing && sceneTransitionReady()) applySceneTransition();
 
-    float currentVolume = params[static_cast<int>(MiniAcidParamId::MainVolume)].value();
-    buffer[i] = static_cast<int16_t>(sample * 32767.0f * currentVolume);
+  updateTickRate();
+  for (auto& channel : channels303_) channel.delay.setBpm(bpmValue);
 
+  uint32_t muted303 = 0;
+  uint32_t frozen303 = 0;
+  for (int v = 0; v < NUM_303_VOICES; ++v) {
+    Synth303Channel& channel = channels303_[v];
+    if (channel.muted) muted303 |= 1u << v;
+    if (!channel.frozen) continue;
+    if (!channel.freezeLoop || !freezeSourceMatches(v, *channel.freezeLoop)) {
+      // Stale loop: go back to live synthesis with an empty delay line.
+      channel.frozen = false;
+      channel.delay.reset();
+      continue;
+    }
+    frozen303 |= 1u << v;
   }
+  renderMuted303_ = muted303;
+  renderFrozen303_ = frozen303;
+  renderMutedDrums_ = drumMuteMask();
+
+  // Each chunk is sequenced here first; the 303 section and the drums then
+  // render it side by side and are mixed below.
+  const size_t stemStride = static_cast<size_t>(stemCount(stemLayout_));
+  size_t done = 0;
+  while (done < numSamples) {
+    size_t remaining = numSamples - done;
+    int maxSamples = remaining < kRenderChunk ? static_cast<int>(remaining) : kRenderChunk;
+    bool rendering = playing;
+    renderStems_ = stems ? stems + done * stemStride : nullptr;
+    if (rendering) {
+      chunkLength_ = sequenceChunk(maxSamples);
+      renderSplit_.run(&MiniAcid::renderDrumJob, this, &MiniAcid::render303Job, this);
+    } else {
+      chunkLength_ = maxSamples;
+      if (renderStems_) {
+        std::fill(renderStems_, renderStems_ + chunkLength_ * stemStride, 0.0f);
+      }
+    }
 
-  size_t copyCount = numSamples;
-  if (copyCount > AUDIO_BUFFER_SAMPLES) copyCount = AUDIO_BUFFER_SAMPLES;
-  for (size_t i = 0; i < copyCount; ++i) lastBuffer[i] = buffer[i];
-  lastBufferCount = copyCount;
+    float* out = buffer + done;
+    for (int i = 0; i < chunkLength_; ++i) {
+      float sample = 0.0f;
+      if (rendering) {
+        sample += chunkDrums_[i];
+        sample += chunk303_[i];
+      }
+
+      // Soft clipping/limiting
+      sample *= kMixGain;
+      if (sample > 1.0f)
+        sample = 1.0f;
+      if (sample < -1.0f)
+        sample = -1.0f;
+
+      out[i] = sample;
+    }
+    done += static_cast<size_t>(chunkLength_);
+  }
+  renderStems_ = nullptr;
+
+  scope_.write(buffer, numSamples, params[static_cast<int>(MiniAcidParamId::MainVolume)].value());
+  renderEpoch_.fetch_add(1, std::memory_order_release);
+}
+
+void MiniAcid::renderFloat(float* out, size_t numSamples, float* stems) {
+  if (!out || numSamples == 0) return;
+  renderMix(out, numSamples, stems);
+  const float volume = params[static_cast<int>(MiniAcidParamId::MainVolume)].value();
+  for (size_t i = 0; i < numSamples; ++i) out[i] *= volume;
+}
+
+void MiniAcid::generateAudioBuffer(int16_t *buffer, size_t numSamples) {
+  if (!buffer || numSamples == 0) return;
+  const float volume = params[static_cast<int>(MiniAcidParamId::MainVolume)].value();
+  size_t done = 0;
+  while (done < numSamples) {
+    size_t count = numSamples - done;
+    if (count > kRenderChunk) count = kRenderChunk;
+    renderMix(mixBuffer_, count, nullptr);
+    convertFloatToInt16(mixBuffer_, buffer + done, count, volume, &outputDither_);
+    done += count;
+  }
 }
 
+void MiniAcid::setOutputDither(bool enabled) { outputDither_.enabled = enabled; }
+
+bool MiniAcid::outputDither() const { return outputDither_.enabled; }
+
+void MiniAcid::setStemLayout(StemLayout layout) { stemLayout_ = layout; }
+
+StemLayout MiniAcid::stemLayout() const { return stemLayout_; }
+
 void MiniAcid::randomize303Pattern(int voiceIndex) {
   int idx = clamp303Voice(voiceIndex);
-  PatternGenerator::generateRandom303Pattern(editSynthPattern(idx));
+  SynthPattern* pattern = editSynthPattern(idx);
+  if (!pattern) return;
+  PatternGenerator::generateRandom303Pattern(*pattern);
+  markTimelineDirty();
 }
 
 void MiniAcid::setParameter(MiniAcidParamId id, float value) {
@@ -1090,7 +1472,10 @@ void MiniAcid::adjustParameter(MiniAcidParamId id, int steps) {
 }
 
 void MiniAcid::randomizeDrumPattern() {
-  PatternGenerator::generateRandomDrumPattern(sceneManager_.editCurrentDrumPattern());
+  DrumPatternSet* patternSet = sceneManager_->editCurrentDrumPattern();
+  if (!patternSet) return;
+  PatternGenerator::generateRandomDrumPattern(*patternSet);
+  markTimelineDirty();
 }
 
 std::string MiniAcid::currentSceneName() const {
@@ -1100,34 +1485,78 @@ std::string MiniAcid::currentSceneName() const {
 
 std::vector<std::string> MiniAcid::availableSceneNames() const {
   if (!sceneStorage_) return {};
+  // Storage returns the index, which is already sorted by name.
   std::vector<std::string> names = sceneStorage_->getAvailableSceneNames();
-  if (names.empty() && sceneStorage_) {
-    std::string current = sceneStorage_->getCurrentSceneName();
-    if (!current.empty()) names.push_back(current);
+  std::string current = sceneStorage_->getCurrentSceneName();
+  if (names.empty() && !current.empty()) names.push_back(current);
+  // Scenes saved moments ago may still be queued on the writer.
+  for (auto& pending : sceneWriter_.pendingSceneNames()) {
+    auto it = std::lower_bound(names.begin(), names.end(), pending);
+    if (it == names.end() || *it != pending) names.insert(it, std::move(pending));
   }
-  std::sort(names.begin(), names.end());
-  names.erase(std::unique(names.begin(), names.end()), names.end());
   return names;
 }
 
-bool MiniAcid::loadSceneByName(const std::string& name) {
+size_t MiniAcid::sceneCount() const {
+  if (!sceneStorage_) return 0;
+  return sceneStorage_->sceneCount();
+}
+
+size_t MiniAcid::sceneInfos(size_t offset, size_t count, std::vector<SceneInfo>& out) const {
+  if (!sceneStorage_) return 0;
+  return sceneStorage_->readSceneInfos(offset, count, out);
+}
+
+int MiniAcid::findScene(const std::string& name) const {
+  if (!sceneStorage_) return -1;
+  return sceneStorage_->findScene(name);
+}
+
+bool MiniAcid::rebuildSceneIndex() {
   if (!sceneStorage_) return false;
-  std::string previousName = sceneStorage_->getCurrentSceneName();
-  sceneStorage_->setCurrentSceneName(name);
+  sceneWriter_.flush();
+  return sceneStorage_->rebuildSceneIndex();
+}
 
-  bool loaded = sceneStorage_->readScene(sceneManager_);
-  if (!loaded) {
-    std::string serialized;
-    loaded = sceneStorage_->readScene(serialized) && sceneManager_.loadScene(serialized);
+bool MiniAcid::prepareSceneLoad(const std::string& name) {
+  if (!sceneStorage_) return false;
+  if (!stagedScene_) stagedScene_ = std::make_unique<SceneManager>();
+  stagedSceneName_.clear();
+  if (!sceneCache_.fetch(name, *stagedScene_)) {
+    // Make sure a save still in flight has landed before reading it back.
+    sceneWriter_.flush();
+    if (!sceneStorage_->readScene(*stagedScene_, name)) return false;
+    sceneCache_.store(name, *stagedScene_);
   }
-  if (!loaded) {
-    sceneStorage_->setCurrentSceneName(previousName);
-    return false;
+  attachBankStore(*stagedScene_, name);
+  // Sample kits are read here too, so loadSceneByName() only swaps voices.
+  const std::string& drumEngineName = stagedScene_->getDrumEngineName();
+  if (!drumEngineName.empty()) prepareDrumEngine(drumEngineName);
+  stagedSceneName_ = name;
+  return true;
+}
+
+bool MiniAcid::loadSceneByName(const std::string& name) {
+  if (!sceneStorage_) return false;
+  if (!stagedScene_ || stagedSceneName_ != name) {
+    if (!prepareSceneLoad(name)) return false;
   }
+  cancelSceneTransition();
+  std::swap(sceneManager_, stagedScene_);
+  stagedSceneName_.clear();
+  sceneStorage_->setCurrentSceneName(name);
   applySceneStateFromManager();
   return true;
 }
 
+void MiniAcid::prefetchScenes(const std::vector<std::string>& names) {
+  sceneCache_.prefetch(names);
+}
+
+SceneCache::Stats MiniAcid::sceneCacheStats() const { return sceneCache_.stats(); }
+
+void MiniAcid::setSceneCacheBudget(size_t bytes) { sceneCache_.setBudget(bytes); }
+
 bool MiniAcid::saveSceneAs(const std::string& name) {
   if (!sceneStorage_) return false;
   sceneStorage_->setCurrentSceneName(name);
@@ -1135,121 +1564,368 @@ bool MiniAcid::saveSceneAs(const std::string& name) {
   return true;
 }
 
+bool MiniAcid::prepareNewScene() {
+  return prepareDrumEngine(kDefaultDrumEngineName);
+}
+
 bool MiniAcid::createNewSceneWithName(const std::string& name) {
   if (!sceneStorage_) return false;
   sceneStorage_->setCurrentSceneName(name);
-  sceneManager_.loadDefaultScene();
+  sceneManager_->loadDefaultScene();
+  // Nothing of the new scene is on storage until the save below lands.
+  sceneManager_->setBankStore(&sceneWriter_, std::string());
+  sceneManager_->setBankReaders(&bankReaders_);
   applySceneStateFromManager();
   saveSceneToStorage();
   return true;
 }
 
+AsyncSceneWriter::Status MiniAcid::sceneSaveStatus() const {
+  return sceneWriter_.status();
+}
+
+void MiniAcid::captureSongRender(SongRenderSnapshot& out) {
+  syncSceneStateToManager();
+  out.scene = *sceneManager_;
+  out.sampleRate = sampleRateValue;
+  out.mainVolume = params[static_cast<int>(MiniAcidParamId::MainVolume)];
+  out.drumsVolume = drums->parameter(DrumParamId::MainVolume).value();
+  for (int v = 0; v < NUM_303_VOICES; ++v) {
+    for (int p = 0; p < static_cast<int>(TB303ParamId::Count); ++p) {
+      out.synthParams[v][p] = voices303_.parameterValue(v, static_cast<TB303ParamId>(p));
+    }
+  }
+  out.drumHitCache = drumHitCache_;
+  out.outputDither = outputDither_.enabled;
+  out.drumEngineName = drumEngineName_;
+  out.sampleKit.reset();
+  size_t prefixLength = std::strlen(kSampleDrumEnginePrefix);
+  if (drumEngineName_.compare(0, prefixLength, kSampleDrumEnginePrefix) == 0) {
+    out.sampleKit = static_cast<const SampleDrumVoice&>(*drums).kit();
+  }
+}
+
+std::unique_ptr<MiniAcid> MiniAcid::cloneForSongRender(const SongRenderSnapshot& snapshot) {
+  auto clone = std::make_unique<MiniAcid>(snapshot.sampleRate, nullptr);
+  clone->params[static_cast<int>(MiniAcidParamId::MainVolume)] = snapshot.mainVolume;
+  clone->drumHitCache_ = snapshot.drumHitCache;
+  clone->outputDither_.enabled = snapshot.outputDither;
+
+  *clone->sceneManager_ = snapshot.scene;
+  clone->cloneBanks_ = std::make_unique<MemoryBankStore>();
+  for (int b = 0; b < kBankCount; ++b) {
+    const SceneBank* bank = snapshot.scene.residentBank(b);
+    if (bank) clone->cloneBanks_->writeBank(std::string(), b, *bank);
+  }
+  clone->sceneManager_->setBankStore(clone->cloneBanks_.get(), "clone");
+  clone->sceneManager_->setBankReaders(&clone->bankReaders_);
+  clone->applySceneStateFromManager();
+
+  if (snapshot.sampleKit) {
+    clone->drums = std::make_unique<SampleDrumVoice>(snapshot.sampleKit, snapshot.sampleRate);
+    clone->drumEngineName_ = snapshot.drumEngineName;
+  }
+  clone->drums->setParameter(DrumParamId::MainVolume, snapshot.drumsVolume);
+  for (int v = 0; v < NUM_303_VOICES; ++v) {
+    for (int p = 0; p < static_cast<int>(TB303ParamId::Count); ++p) {
+      clone->voices303_.setParameter(v, static_cast<TB303ParamId>(p), snapshot.synthParams[v][p]);
+    }
+  }
+  return clone;
+}
+
+uint32_t MiniAcid::loadSongRenderBanks(MiniAcid& clone) {
+  if (!clone.cloneBanks_) return 0;
+  uint32_t wanted = clone.sceneManager_->currentBanksMask();
+  int length = clone.songLength();
+  for (int pos = 0; pos < length; ++pos) wanted |= clone.songPositionBanksMask(pos);
+  uint32_t missing = 0;
+  std::unique_ptr<SceneBank> bank(new (std::nothrow) SceneBank());
+  for (int b = 0; b < kBankCount; ++b) {
+    if (!(wanted & (1u << b)) || clone.cloneBanks_->hasBank(b)) continue;
+    if (!bank) {
+      missing |= 1u << b;
+      continue;
+    }
+    // Banks never saved read back as empty, as they would in playback.
+    if (!sceneWriter_.readBank(sceneManager_->bankSceneName(), b, *bank)) clearSceneBank(*bank);
+    if (!clone.cloneBanks_->writeBank(std::string(), b, *bank)) missing |= 1u << b;
+  }
+  return missing;
+}
+
+bool MiniAcid::queueSceneTransition(const std::string& name, SceneTransitionQuantize quantize) {
+  if (!sceneStorage_ || name.empty()) return false;
+  updateSceneTransition();
+
+  // Take the request back from the audio thread before touching the buffers.
+  uint32_t state = transitionState_.load();
+  uint32_t generation = 0;
+  while (true) {
+    uint32_t phase = state & 0x3u;
+    if (phase == kTransitionApplied) {
+      updateSceneTransition();
+      state = transitionState_.load();
+      continue;
+    }
+    generation = (state >> 2) + 1;
+    if (transitionState_.compare_exchange_weak(state, (generation << 2) | kTransitionLoading)) break;
+  }
+
+  if (!transitionScene_) transitionScene_ = std::make_unique<SceneManager>();
+  transitionQuantize_ = quantize;
+  transitionSceneName_ = name;
+  std::string currentEngine = drumEngineName_;
+  bool hitCache = drumHitCache_;
+  sceneCache_.loadAsync(name, transitionScene_.get(),
+                        [this, generation, currentEngine, hitCache, name](bool ok) {
+    uint32_t expected = (generation << 2) | kTransitionLoading;
+    if (transitionState_.load() != expected) return;
+    // Build a different drum kit here so the audio thread only swaps pointers.
+    transitionDrums_.reset();
+    transitionDrumsName_.clear();
+    transitionDrumsHitCache_ = hitCache;
+    if (ok) attachBankStore(*transitionScene_, name);
+    const std::string& engine = transitionScene_->getDrumEngineName();
+    if (ok && !engine.empty()) {
+      std::string canonical;
+      std::unique_ptr<DrumSynthVoice> voice = makeDrumVoice(engine, hitCache, canonical);
+      if (voice && canonical != currentEngine) {
+        voice->reset();
+        transitionDrums_ = std::move(voice);
+      }
+      transitionDrumsName_ = canonical;
+    }
+    uint32_t next = (generation << 2) | (ok ? kTransitionReady : kTransitionIdle);
+    transitionState_.compare_exchange_strong(expected, next);
+  });
+  return true;
+}
+
+void MiniAcid::cancelSceneTransition() {
+  uint32_t state = transitionState_.load();
+  while ((state & 0x3u) == kTransitionLoading || (state & 0x3u) == kTransitionReady) {
+    uint32_t idle = (((state >> 2) + 1) << 2) | kTransitionIdle;
+    if (transitionState_.compare_exchange_weak(state, idle)) break;
+  }
+  updateSceneTransition();
+}
+
+std::string MiniAcid::queuedSceneName() const {
+  uint32_t phase = transitionState_.load() & 0x3u;
+  if (phase == kTransitionLoading || phase == kTransitionReady) return transitionSceneName_;
+  return {};
+}
+
+bool MiniAcid::updateSceneTransition() {
+  uint32_t state = transitionState_.load();
+  if ((state & 0x3u) != kTransitionApplied) return false;
+  // The previous scene now sits in transitionScene_ and is reused as the next buffer.
+  // Applied is claimed before the swap; wait until the audio thread is done.
+  if (!transitionSettled_.load(std::memory_order_acquire)) return false;
+  transitionDrums_.reset();
+  if (transitionDrumsDeferred_) pendingSceneDrums_ = transitionDrumsName_;
+  transitionDrumsDeferred_ = false;
+  if (sceneStorage_) sceneStorage_->setCurrentSceneName(transitionSceneName_);
+  stagedSceneName_.clear();
+  transitionSettled_.store(false, std::memory_order_relaxed);
+  transitionState_.store(state & ~0x3u);
+  return true;
+}
+
+bool MiniAcid::prepareSceneDrums() {
+  if (pendingSceneDrums_.empty()) return false;
+  prepareDrumEngine(pendingSceneDrums_);
+  return true;
+}
+
+void MiniAcid::applySceneDrums() {
+  if (pendingSceneDrums_.empty()) return;
+  std::string engineName;
+  engineName.swap(pendingSceneDrums_);
+  setDrumEngine(engineName);
+}
+
+bool MiniAcid::sceneTransitionReady() const {
+  return (transitionState_.load(std::memory_order_acquire) & 0x3u) == kTransitionReady;
+}
+
+void MiniAcid::applySceneTransition() {
+  uint32_t state = transitionState_.load();
+  if ((state & 0x3u) != kTransitionReady) return;
+  if (!transitionState_.compare_exchange_strong(state, (state & ~0x3u) | kTransitionApplied)) return;
+  std::swap(sceneManager_, transitionScene_);
+  if (!transitionDrumsName_.empty() && transitionDrumsName_ != drumEngineName_) {
+    if (transitionDrums_ && transitionDrumsHitCache_ == drumHitCache_) {
+      // Swapping the names too keeps allocation off this thread.
+      std::swap(drums, transitionDrums_);
+      std::swap(drumEngineName_, transitionDrumsName_);
+    } else {
+      transitionDrumsDeferred_ = true;
+    }
+  }
+  applySceneVoiceState();
+  transitionSettled_.store(true, std::memory_order_release);
+}
+
 void MiniAcid::loadSceneFromStorage() {
   if (sceneStorage_) {
-    if (sceneStorage_->readScene(sceneManager_)) return;
-
-    std::string serialized;
-    if (sceneStorage_->readScene(serialized) && sceneManager_.loadScene(serialized)) {
+    bool loaded = sceneStorage_->readScene(*sceneManager_);
+    if (!loaded) {
+      std::string serialized;
+      loaded = sceneStorage_->readScene(serialized) && sceneManager_->loadScene(serialized);
+    }
+    if (loaded) {
+      std::string name = sceneStorage_->getCurrentSceneName();
+      sceneCache_.store(name, *sceneManager_);
+      attachBankStore(*sceneManager_, name);
       return;
     }
   }
-  sceneManager_.loadDefaultScene();
+  sceneManager_->loadDefaultScene();
+  sceneManager_->setBankStore(&sceneWriter_, std::string());
+  sceneManager_->setBankReaders(&bankReaders_);
+}
+
+void MiniAcid::attachBankStore(SceneManager& scene, const std::string& sceneName) {
+  // Reads go through the writer so banks still queued for saving are seen.
+  scene.setBankStore(&sceneWriter_, sceneName);
+  // Any scene this engine owns may become the one the audio thread plays.
+  scene.setBankReaders(&bankReaders_);
+  uint32_t current = scene.currentBanksMask();
+  for (int b = 0; b < kBankCount; ++b) {
+    if (current & (1u << b)) scene.ensureBankResident(b, current);
+  }
+}
+
+void MiniAcid::pageInBank(int bankIndex) {
+  // The scene's readers pin the playing and upcoming banks.
+  sceneManager_->ensureBankResident(bankIndex);
+}
+
+void MiniAcid::updateBankPaging() {
+  uint32_t wanted = bankRequests_.exchange(0) | sceneManager_->currentBanksMask() |
+                    bankReaders_.pinnedBanks();
+  if (!(wanted & ~sceneManager_->residentBanksMask())) return;
+  for (int b = 0; b < kBankCount; ++b) {
+    if (wanted & (1u << b)) sceneManager_->ensureBankResident(b, wanted);
+  }
+}
+
+uint32_t MiniAcid::BankReaders::pinnedBanks() const {
+  if (!engine_.songMode_) return 0;
+  // The playhead may move on while paging runs; the row after it is kept
+  // too, so a bank the song is about to enter is never the victim.
+  int position = engine_.clampSongPosition(engine_.songPlayheadPosition_);
+  return engine_.songPositionBanksMask(position) |
+         engine_.songPositionBanksMask(engine_.nextSongPosition(position));
+}
+
+uint32_t MiniAcid::BankReaders::readTicket() const {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  // A render in progress (odd epoch) must finish first.
+  return (engine_.renderEpoch_.load() + 1) >> 1;
+}
+
+bool MiniAcid::BankReaders::readsDone(uint32_t ticket) const {
+  uint32_t finished = engine_.renderEpoch_.load(std::memory_order_acquire) >> 1;
+  return static_cast<int32_t>(finished - ticket) >= 0;
 }
 
 void MiniAcid::saveSceneToStorage() {
   if (!sceneStorage_) return;
   syncSceneStateToManager();
-  sceneStorage_->writeScene(sceneManager_);
+  // One snapshot copy happens here (usually under the audio guard), shared by
+  // the writer and the cache; serialization and file IO run on the writer
+  // thread.
+  std::string name = sceneStorage_->getCurrentSceneName();
+  std::shared_ptr<const SceneManager> snapshot = std::make_shared<SceneManager>(*sceneManager_);
+  sceneWriter_.enqueue(snapshot, name);
+  // From here on the writer holds every bank, so paging can drop them freely.
+  sceneManager_->markBanksSaved(name);
+  sceneCache_.storeSaved(name, std::move(snapshot));
+  if (stagedSceneName_ == name) stagedSceneName_.clear();
 }
 
 void MiniAcid::applySceneStateFromManager() {
-  setBpm(sceneManager_.getBpm());
-  const std::string& drumEngineName = sceneManager_.getDrumEngineName();
+  const std::string& drumEngineName = sceneManager_->getDrumEngineName();
   if (!drumEngineName.empty()) {
     setDrumEngine(drumEngineName);
   }
-  mute303 = sceneManager_.getSynthMute(0);
-  mute303_2 = sceneManager_.getSynthMute(1);
-
-  muteKick = sceneManager_.getDrumMute(kDrumKickVoice);
-  muteSnare = sceneManager_.getDrumMute(kDrumSnareVoice);
-  muteHat = sceneManager_.getDrumMute(kDrumHatVoice);
-  muteOpenHat = sceneManager_.getDrumMute(kDrumOpenHatVoice);
-  muteMidTom = sceneManager_.getDrumMute(kDrumMidTomVoice);
-  muteHighTom = sceneManager_.getDrumMute(kDrumHighTomVoice);
-  muteRim = sceneManager_.getDrumMute(kDrumRimVoice);
-  muteClap = sceneManager_.getDrumMute(kDrumClapVoice);
-  distortion303Enabled = sceneManager_.getSynthDistortionEnabled(0);
-  distortion3032Enabled = sceneManager_.getSynthDistortionEnabled(1);
-  delay303Enabled = sceneManager_.getSynthDelayEnabled(0);
-  delay3032Enabled = sceneManager_.getSynthDelayEnabled(1);
-
-  const SynthParameters& paramsA = sceneManager_.getSynthParameters(0);
-  const SynthParameters& paramsB = sceneManager_.getSynthParameters(1);
-
-  voice303.setParameter(TB303ParamId::Cutoff, paramsA.cutoff);
-  voice303.setParameter(TB303ParamId::Resonance, paramsA.resonance);
-  voice303.setParameter(TB303ParamId::EnvAmount, paramsA.envAmount);
-  voice303.setParameter(TB303ParamId::EnvDecay, paramsA.envDecay);
-  voice303.setParameter(TB303ParamId::Oscillator, static_cast<float>(paramsA.oscType));
-
-  voice3032.setParameter(TB303ParamId::Cutoff, paramsB.cutoff);
-  voice3032.setParameter(TB303ParamId::Resonance, paramsB.resonance);
-  voice3032.setParameter(TB303ParamId::EnvAmount, paramsB.envAmount);
-  voice3032.setParameter(TB303ParamId::EnvDecay, paramsB.envDecay);
-  voice3032.setParameter(TB303ParamId::Oscillator, static_cast<float>(paramsB.oscType));
-  distortion303.setEnabled(distortion303Enabled);
-  distortion3032.setEnabled(distortion3032Enabled);
-  delay303.setEnabled(delay303Enabled);
-  delay3032.setEnabled(delay3032Enabled);
-
-  patternModeDrumPatternIndex_ = sceneManager_.getCurrentDrumPatternIndex();
-  patternModeSynthPatternIndex_[0] = sceneManager_.getCurrentSynthPatternIndex(0);
-  patternModeSynthPatternIndex_[1] = sceneManager_.getCurrentSynthPatternIndex(1);
-  songMode_ = sceneManager_.songMode();
-  songPlayheadPosition_ = clampSongPosition(sceneManager_.getSongPosition());
+  applySceneVoiceState();
+  markTimelineDirty();
+}
+
+void MiniAcid::applySceneVoiceState() {
+  setBpm(sceneManager_->getBpm());
+  setSwing(sceneManager_->getSwing());
+
+  muteKick = sceneManager_->getDrumMute(kDrumKickVoice);
+  muteSnare = sceneManager_->getDrumMute(kDrumSnareVoice);
+  muteHat = sceneManager_->getDrumMute(kDrumHatVoice);
+  muteOpenHat = sceneManager_->getDrumMute(kDrumOpenHatVoice);
+  muteMidTom = sceneManager_->getDrumMute(kDrumMidTomVoice);
+  muteHighTom = sceneManager_->getDrumMute(kDrumHighTomVoice);
+  muteRim = sceneManager_->getDrumMute(kDrumRimVoice);
+  muteClap = sceneManager_->getDrumMute(kDrumClapVoice);
+
+  for (int v = 0; v < NUM_303_VOICES; ++v) {
+    Synth303Channel& channel = channels303_[v];
+    channel.muted = sceneManager_->getSynthMute(v);
+    channel.distortionEnabled = sceneManager_->getSynthDistortionEnabled(v);
+    channel.delayEnabled = sceneManager_->getSynthDelayEnabled(v);
+    channel.distortion.setEnabled(channel.distortionEnabled);
+    channel.delay.setEnabled(channel.delayEnabled);
+
+    const SynthParameters& params = sceneManager_->getSynthParameters(v);
+    voices303_.setParameter(v, TB303ParamId::Cutoff, params.cutoff);
+    voices303_.setParameter(v, TB303ParamId::Resonance, params.resonance);
+    voices303_.setParameter(v, TB303ParamId::EnvAmount, params.envAmount);
+    voices303_.setParameter(v, TB303ParamId::EnvDecay, params.envDecay);
+    voices303_.setParameter(v, TB303ParamId::Oscillator, static_cast<float>(params.oscType));
+  }
+
+  patternModeDrumPatternIndex_ = sceneManager_->getCurrentDrumPatternIndex();
+  patternModeSynthPatternIndex_[0] = sceneManager_->getCurrentSynthPatternIndex(0);
+  patternModeSynthPatternIndex_[1] = sceneManager_->getCurrentSynthPatternIndex(1);
+  songMode_ = sceneManager_->songMode();
+  songPlayheadPosition_ = clampSongPosition(sceneManager_->getSongPosition());
   if (songMode_) {
     applySongPositionSelection();
   }
 }
 
 void MiniAcid::syncSceneStateToManager() {
-  sceneManager_.setBpm(bpmValue);
-  sceneManager_.setDrumEngineName(drumEngineName_);
-  sceneManager_.setSynthMute(0, mute303);
-  sceneManager_.setSynthMute(1, mute303_2);
-
-  sceneManager_.setDrumMute(kDrumKickVoice, muteKick);
-  sceneManager_.setDrumMute(kDrumSnareVoice, muteSnare);
-  sceneManager_.setDrumMute(kDrumHatVoice, muteHat);
-  sceneManager_.setDrumMute(kDrumOpenHatVoice, muteOpenHat);
-  sceneManager_.setDrumMute(kDrumMidTomVoice, muteMidTom);
-  sceneManager_.setDrumMute(kDrumHighTomVoice, muteHighTom);
-  sceneManager_.setDrumMute(kDrumRimVoice, muteRim);
-  sceneManager_.setDrumMute(kDrumClapVoice, muteClap);
-  sceneManager_.setSynthDistortionEnabled(0, distortion303Enabled);
-  sceneManager_.setSynthDistortionEnabled(1, distortion3032Enabled);
-  sceneManager_.setSynthDelayEnabled(0, delay303Enabled);
-  sceneManager_.setSynthDelayEnabled(1, delay3032Enabled);
-  sceneManager_.setSongMode(songMode_);
-  int songPosToStore = songMode_ ? songPlayheadPosition_ : sceneManager_.getSongPosition();
-  sceneManager_.setSongPosition(clampSongPosition(songPosToStore));
-
-  SynthParameters paramsA;
-  paramsA.cutoff = voice303.parameterValue(TB303ParamId::Cutoff);
-  paramsA.resonance = voice303.parameterValue(TB303ParamId::Resonance);
-  paramsA.envAmount = voice303.parameterValue(TB303ParamId::EnvAmount);
-  paramsA.envDecay = voice303.parameterValue(TB303ParamId::EnvDecay);
-  paramsA.oscType = voice303.oscillatorIndex();
-  sceneManager_.setSynthParameters(0, paramsA);
-
-  SynthParameters paramsB;
-  paramsB.cutoff = voice3032.parameterValue(TB303ParamId::Cutoff);
-  paramsB.resonance = voice3032.parameterValue(TB303ParamId::Resonance);
-  paramsB.envAmount = voice3032.parameterValue(TB303ParamId::EnvAmount);
-  paramsB.envDecay = voice3032.parameterValue(TB303ParamId::EnvDecay);
-  paramsB.oscType = voice3032.oscillatorIndex();
-  sceneManager_.setSynthParameters(1, paramsB);
+  sceneManager_->setBpm(bpmValue);
+  sceneManager_->setSwing(swingValue_);
+  sceneManager_->setDrumEngineName(drumEngineName_);
+
+  sceneManager_->setDrumMute(kDrumKickVoice, muteKick);
+  sceneManager_->setDrumMute(kDrumSnareVoice, muteSnare);
+  sceneManager_->setDrumMute(kDrumHatVoice, muteHat);
+  sceneManager_->setDrumMute(kDrumOpenHatVoice, muteOpenHat);
+  sceneManager_->setDrumMute(kDrumMidTomVoice, muteMidTom);
+  sceneManager_->setDrumMute(kDrumHighTomVoice, muteHighTom);
+  sceneManager_->setDrumMute(kDrumRimVoice, muteRim);
+  sceneManager_->setDrumMute(kDrumClapVoice, muteClap);
+  sceneManager_->setSongMode(songMode_);
+  int songPosToStore = songMode_ ? songPlayheadPosition_ : sceneManager_->getSongPosition();
+  sceneManager_->setSongPosition(clampSongPosition(songPosToStore));
+
+  for (int v = 0; v < NUM_303_VOICES; ++v) {
+    const Synth303Channel& channel = channels303_[v];
+    sceneManager_->setSynthMute(v, channel.muted);
+    sceneManager_->setSynthDistortionEnabled(v, channel.distortionEnabled);
+    sceneManager_->setSynthDelayEnabled(v, channel.delayEnabled);
+
+    SynthParameters params;
+    params.cutoff = voices303_.parameterValue(v, TB303ParamId::Cutoff);
+    params.resonance = voices303_.parameterValue(v, TB303ParamId::Resonance);
+    params.envAmount = voices303_.parameterValue(v, TB303ParamId::EnvAmount);
+    params.envDecay = voices303_.parameterValue(v, TB303ParamId::EnvDecay);
+    params.oscType = voices303_.oscillatorIndex(v);
+    sceneManager_->setSynthParameters(v, params);
+  }
 }
 
 
@@ -1280,31 +1956,29 @@ void PatternGenerator::generateRandomDrumPattern(DrumPatternSet& patternSet) {
   const int drumVoiceCount = DrumPatternSet::kVoices;
 
   for (int v = 0; v < drumVoiceCount; ++v) {
-    for (int i = 0; i < stepCount; ++i) {
-      patternSet.voices[v].steps[i].hit = false;
-      patternSet.voices[v].steps[i].accent = false;
-    }
+    patternSet.voices[v].hits = 0;
+    patternSet.voices[v].accents = 0;
   }
 
   for (int i = 0; i < stepCount; ++i) {
     if (drumVoiceCount > kDrumKickVoice) {
       if (i % 4 == 0 || (rand() % 100) < 20) {
-        patternSet.voices[kDrumKickVoice].steps[i].hit = true;
+        patternSet.voices[kDrumKickVoice].setHit(i, true);
       } else {
-        patternSet.voices[kDrumKickVoice].steps[i].hit = false;
+        patternSet.voices[kDrumKickVoice].setHit(i, false);
       }
-      patternSet.voices[kDrumKickVoice].steps[i].accent =
-        patternSet.voices[kDrumKickVoice].steps[i].hit && (rand() % 100) < 35;
+      patternSet.voices[kDrumKickVoice].setAccent(
+        i, patternSet.voices[kDrumKickVoice].hit(i) && (rand() % 100) < 35);
     }
 
     if (drumVoiceCount > kDrumSnareVoice) {
       if (i % 4 == 2 || (rand() % 100) < 15) {
-        patternSet.voices[kDrumSnareVoice].steps[i].hit = (rand() % 100) < 80;
+        patternSet.voices[kDrumSnareVoice].setHit(i, (rand() % 100) < 80);
       } else {
-        patternSet.voices[kDrumSnareVoice].steps[i].hit = false;
+        patternSet.voices[kDrumSnareVoice].setHit(i, false);
       }
-      patternSet.voices[kDrumSnareVoice].steps[i].accent =
-        patternSet.voices[kDrumSnareVoice].steps[i].hit && (rand() % 100) < 30;
+      patternSet.voices[kDrumSnareVoice].setAccent(
+        i, patternSet.voices[kDrumSnareVoice].hit(i) && (rand() % 100) < 30);
     }
 
     bool hatVal = false;
@@ -1314,37 +1988,37 @@ void PatternGenerator::generateRandomDrumPattern(DrumPatternSet& patternSet) {
       } else {
         hatVal = false;
       }
-      patternSet.voices[kDrumHatVoice].steps[i].hit = hatVal;
-      patternSet.voices[kDrumHatVoice].steps[i].accent = hatVal && (rand() % 100) < 20;
+      patternSet.voices[kDrumHatVoice].setHit(i, hatVal);
+      patternSet.voices[kDrumHatVoice].setAccent(i, hatVal && (rand() % 100) < 20);
     }
 
     bool openVal = false;
     if (drumVoiceCount > kDrumOpenHatVoice) {
       openVal = (i % 4 == 3 && (rand() % 100) < 65) || ((rand() % 100) < 20 && hatVal);
-      patternSet.voices[kDrumOpenHatVoice].steps[i].hit = openVal;
-      patternSet.voices[kDrumOpenHatVoice].steps[i].accent = openVal && (rand() % 100) < 25;
+      patternSet.voices[kDrumOpenHatVoice].setHit(i, openVal);
+      patternSet.voices[kDrumOpenHatVoice].setAccent(i, openVal && (rand() % 100) < 25);
       if (openVal && drumVoiceCount > kDrumHatVoice) {
-        patternSet.voices[kDrumHatVoice].steps[i].hit = false;
-        patternSet.voices[kDrumHatVoice].steps[i].accent = false;
+        patternSet.voices[kDrumHatVoice].setHit(i, false);
+        patternSet.voices[kDrumHatVoice].setAccent(i, false);
       }
     }
 
     if (drumVoiceCount > kDrumMidTomVoice) {
       bool midTom = (i % 8 == 4 && (rand() % 100) < 75) || ((rand() % 100) < 8);
-      patternSet.voices[kDrumMidTomVoice].steps[i].hit = midTom;
-      patternSet.voices[kDrumMidTomVoice].steps[i].accent = midTom && (rand() % 100) < 35;
+      patternSet.voices[kDrumMidTomVoice].setHit(i, midTom);
+      patternSet.voices[kDrumMidTomVoice].setAccent(i, midTom && (rand() % 100) < 35);
     }
 
     if (drumVoiceCount > kDrumHighTomVoice) {
       bool highTom = (i % 8 == 6 && (rand() % 100) < 70) || ((rand() % 100) < 6);
-      patternSet.voices[kDrumHighTomVoice].steps[i].hit = highTom;
-      patternSet.voices[kDrumHighTomVoice].steps[i].accent = highTom && (rand() % 100) < 35;
+      patternSet.voices[kDrumHighTomVoice].setHit(i, highTom);
+      patternSet.voices[kDrumHighTomVoice].setAccent(i, highTom && (rand() % 100) < 35);
     }
 
     if (drumVoiceCount > kDrumRimVoice) {
       bool rim = (i % 4 == 1 && (rand() % 100) < 25);
-      patternSet.voices[kDrumRimVoice].steps[i].hit = rim;
-      patternSet.voices[kDrumRimVoice].steps[i].accent = rim && (rand() % 100) < 30;
+      patternSet.voices[kDrumRimVoice].setHit(i, rim);
+      patternSet.voices[kDrumRimVoice].setAccent(i, rim && (rand() % 100) < 30);
     }
 
     if (drumVoiceCount > kDrumClapVoice) {
@@ -1354,8 +2028,8 @@ void PatternGenerator::generateRandomDrumPattern(DrumPatternSet& patternSet) {
       } else {
         clap = (rand() % 100) < 5;
       }
-      patternSet.voices[kDrumClapVoice].steps[i].hit = clap;
-      patternSet.voices[kDrumClapVoice].steps[i].accent = clap && (rand() % 100) < 30;
+      patternSet.voices[kDrumClapVoice].setHit(i, clap);
+      patternSet.voices[kDrumClapVoice].setAccent(i, clap && (rand() % 100) < 30);
     }
   }
 }
@@ -2,29 +2,63 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <string>
 
 #include "scene_storage.h"
+#include "scene_cache.h"
+#include "scene_writer.h"
 #include "scenes.h"
 #include "mini_tb303.h"
 #include "mini_drumvoices.h"
+#include "drum_hit_cache.h"
+#include "fork_join.h"
+#include "sample_drum_voice.h"
+#include "sample_convert.h"
+#include "scope_buffer.h"
+#include "sequencer_timeline.h"
 #include "tube_distortion.h"
 
 // ===================== Audio config =====================
 
-static const int SAMPLE_RATE = 22050;        // Hz
+static const int SAMPLE_RATE = 22050;        // Hz, default engine rate
+// Rates the engine supports; probeEngineSampleRate() picks one at startup.
+static const int kEngineSampleRates[] = {22050, 32000, 44100, 48000};
+static const int kEngineSampleRateCount =
+    static_cast<int>(sizeof(kEngineSampleRates) / sizeof(kEngineSampleRates[0]));
 static const int AUDIO_BUFFER_SAMPLES = 256; // per buffer, mono
 static const int SEQ_STEPS = 16;             // 16-step sequencer
+// The engine loops over its 303 voices; scenes, songs and pages store two.
 static const int NUM_303_VOICES = 2;
 static const int NUM_DRUM_VOICES = DrumPatternSet::kVoices;
+// Pre-master buses for multitrack recording (see MiniAcid::renderFloat()).
+// Stems 0 and 1 are the 303 voices after their distortion and delay; the
+// drums follow as one bus or as one stem per lane.
+enum class StemLayout : uint8_t {
+  Grouped = 0,
+  PerLane,
+};
+static const int kMaxStems = NUM_303_VOICES + kDrumLanes;
+int stemCount(StemLayout layout);
+// Short name for file names and labels ("303a", "drums", "kick", ...).
+const char* stemName(StemLayout layout, int stem);
+// Cap on the memory of frozen 303 loops (see MiniAcid::freeze303()).
+#if defined(ARDUINO)
+static const size_t kFreeze303BudgetBytes = 128 * 1024;
+#else
+static const size_t kFreeze303BudgetBytes = 16 * 1024 * 1024;
+#endif
 
 // ===================== Parameters =====================
 
 class TempoDelay {
 public:
   explicit TempoDelay(float sampleRate);
+  // Caps the line at 'maxSamples' so short-lived delays (the boot rate
+  // probe) do not allocate a full second; longer times are clamped.
+  TempoDelay(float sampleRate, int maxSamples);
 
   void reset();
   void setSampleRate(float sr);
@@ -38,24 +72,87 @@ public:
   float process(float input);
 
 private:
-  // for 2 voices at 22050 Hz, this is the max that the cardputer can handle.
   static const int kMaxDelaySeconds = 1;
+  // Delay line memory per voice. For 2 voices this is the max that the
+  // cardputer can handle, so higher rates get a shorter maximum delay there.
+#if defined(ARDUINO)
+  static const int kMaxDelaySamples = 22050;
+#else
+  static const int kMaxDelaySamples = 48000;
+#endif
 
   std::vector<float> buffer;
   int writeIndex;
   int delaySamples;
   float sampleRate;
   int maxDelaySamples;
+  int sampleLimit; // kMaxDelaySamples unless capped at construction
   float beats;    // delay length in beats
   float mix;      // wet mix 0..1
   float feedback; // feedback 0..1
   bool enabled;
 };
 
+// One bar of a 303 channel rendered through its effects, plus everything it
+// was rendered from so playback can tell when it went stale.
+struct Frozen303Loop {
+  // Samples hold the channel output scaled by kScale.
+  static constexpr float kScale = 16384.0f;
+
+  std::vector<int16_t> samples;
+  SynthPattern pattern;
+  float params[static_cast<int>(TB303ParamId::Count)];
+  float bpm;
+  float swing;
+  float sampleRate;
+  bool delayEnabled;
+  bool distortionEnabled;
+  TubeDistortion distortion;
+};
+
+// Effects and switches behind one 303 voice.
+struct Synth303Channel {
+  explicit Synth303Channel(float sampleRate) : delay(sampleRate) {}
+
+  TempoDelay delay;
+  TubeDistortion distortion;
+  volatile bool muted = false;
+  volatile bool delayEnabled = false;
+  volatile bool distortionEnabled = false;
+  // While set the channel plays freezeLoop instead of synthesizing. The
+  // audio thread clears it when the pattern, parameters or tempo change;
+  // the loop itself is only released from the UI thread.
+  volatile bool frozen = false;
+  std::unique_ptr<Frozen303Loop> freezeLoop;
+};
+
+enum class SceneTransitionQuantize : uint8_t {
+  Bar = 0,
+  // Song mode: wait until the song or its loop wraps around. Same as Bar in pattern mode.
+  Loop,
+};
+
 enum class MiniAcidParamId : uint8_t {
   MainVolume = 0,
   Count
 };
+
+// What a song render copies from the live engine, taken under the audio
+// guard by MiniAcid::captureSongRender(). Plain values only; the copy of
+// the engine and its voices are built from it after the guard.
+struct SongRenderSnapshot {
+  // Synced with the engine, with the banks resident at the time.
+  SceneManager scene;
+  float sampleRate = 0.0f;
+  Parameter mainVolume;
+  float drumsVolume = 0.0f;
+  float synthParams[NUM_303_VOICES][static_cast<int>(TB303ParamId::Count)] = {};
+  bool drumHitCache = false;
+  bool outputDither = false;
+  std::string drumEngineName;
+  // Set for a sample kit engine: the copy has no storage to load it from.
+  std::shared_ptr<const DrumSampleKit> sampleKit;
+};
 class MiniAcid {
 public:
   static constexpr int kMin303Note = 24; // C1
@@ -69,7 +166,14 @@ public:
   void stop();
   void setBpm(float bpm);
   float bpm() const;
+  // 0 plays straight 16ths, 1 delays every second 16th by half a step.
+  void setSwing(float amount);
+  float swing() const;
   float sampleRate() const;
+  // Re-rates every voice, effect and the sequencer clock. Call while the
+  // audio thread is not rendering; delay lines are cleared and frozen 303
+  // tracks go live until they are frozen again.
+  void setSampleRate(float sampleRate);
   bool isPlaying() const;
   int currentStep() const;
   int currentDrumPatternIndex() const;
@@ -88,27 +192,28 @@ public:
   bool is303DelayEnabled(int voiceIndex = 0) const;
   bool is303DistortionEnabled(int voiceIndex = 0) const;
   const Parameter& parameter303(TB303ParamId id, int voiceIndex = 0) const;
-  size_t copyLastAudio(int16_t *dst, size_t maxSamples) const;
-  const int8_t* pattern303Steps(int voiceIndex = 0) const;
-  const bool* pattern303AccentSteps(int voiceIndex = 0) const;
-  const bool* pattern303SlideSteps(int voiceIndex = 0) const;
-  const bool* patternKickSteps() const;
-  const bool* patternSnareSteps() const;
-  const bool* patternHatSteps() const;
-  const bool* patternOpenHatSteps() const;
-  const bool* patternMidTomSteps() const;
-  const bool* patternHighTomSteps() const;
-  const bool* patternRimSteps() const;
-  const bool* patternClapSteps() const;
-  const bool* patternDrumAccentSteps() const;
-  const bool* patternKickAccentSteps() const;
-  const bool* patternSnareAccentSteps() const;
-  const bool* patternHatAccentSteps() const;
-  const bool* patternOpenHatAccentSteps() const;
-  const bool* patternMidTomAccentSteps() const;
-  const bool* patternHighTomAccentSteps() const;
-  const bool* patternRimAccentSteps() const;
-  const bool* patternClapAccentSteps() const;
+  // Recent output at the master volume, for scope views on any thread.
+  const ScopeBuffer& scope() const { return scope_; }
+  SynthNoteSteps pattern303Steps(int voiceIndex = 0) const;
+  StepMask pattern303AccentSteps(int voiceIndex = 0) const;
+  StepMask pattern303SlideSteps(int voiceIndex = 0) const;
+  StepMask patternKickSteps() const;
+  StepMask patternSnareSteps() const;
+  StepMask patternHatSteps() const;
+  StepMask patternOpenHatSteps() const;
+  StepMask patternMidTomSteps() const;
+  StepMask patternHighTomSteps() const;
+  StepMask patternRimSteps() const;
+  StepMask patternClapSteps() const;
+  StepMask patternDrumAccentSteps() const;
+  StepMask patternKickAccentSteps() const;
+  StepMask patternSnareAccentSteps() const;
+  StepMask patternHatAccentSteps() const;
+  StepMask patternOpenHatAccentSteps() const;
+  StepMask patternMidTomAccentSteps() const;
+  StepMask patternHighTomAccentSteps() const;
+  StepMask patternRimAccentSteps() const;
+  StepMask patternClapAccentSteps() const;
   bool songModeEnabled() const;
   void setSongMode(bool enabled);
   void toggleSongMode();
@@ -124,17 +229,81 @@ public:
   void setSongPattern(int position, SongTrack track, int patternIndex);
   void clearSongPattern(int position, SongTrack track);
   int songPatternAt(int position, SongTrack track) const;
+  void copySongRange(const Song& src, int srcRow, int dstRow, int rows,
+                     int srcTrack, int dstTrack, int tracks);
   const Song& song() const;
   int display303PatternIndex(int voiceIndex) const;
   int displayDrumPatternIndex() const;
   std::vector<std::string> getAvailableDrumEngines() const;
+  // Builds the drum voice for 'engineName' ahead of setDrumEngine(). Sample
+  // kits are read from storage here, so call it outside the audio guard.
+  bool prepareDrumEngine(const std::string& engineName);
+  // Switches to 'engineName' with the voice prepareDrumEngine() built for
+  // it. Without one the voice is built here, which only suits the times
+  // nothing plays (startup, clones).
   void setDrumEngine(const std::string& engineName);
   std::string currentDrumEngineName() const;
+  // Plays the synthesized kits from pre-rendered hits (see CachedDrumKit).
+  // Off by default. Rendering a cached kit takes a while, so build the
+  // current kit with prepareDrumHitCache() outside the audio guard, then
+  // switch under it; setDrumHitCacheEnabled() swaps the prepared kit in.
+  bool prepareDrumHitCache(bool enabled);
+  void setDrumHitCacheEnabled(bool enabled);
+  bool drumHitCacheEnabled() const;
   std::string currentSceneName() const;
   std::vector<std::string> availableSceneNames() const;
+  // Paged access to the storage scene index (sorted by name).
+  size_t sceneCount() const;
+  size_t sceneInfos(size_t offset, size_t count, std::vector<SceneInfo>& out) const;
+  int findScene(const std::string& name) const;
+  bool rebuildSceneIndex();
+  // Reads 'name' (from the scene cache when possible) into a staging buffer
+  // without touching playback state. Call outside the audio guard so the
+  // following loadSceneByName() only has to swap pointers.
+  bool prepareSceneLoad(const std::string& name);
   bool loadSceneByName(const std::string& name);
+  // Builds what createNewSceneWithName() needs; call outside the audio guard.
+  bool prepareNewScene();
+  // Parses the given scenes into the cache in the background.
+  void prefetchScenes(const std::vector<std::string>& names);
+  SceneCache::Stats sceneCacheStats() const;
+  void setSceneCacheBudget(size_t bytes);
+  // Loads 'name' in the background and switches to it at the next bar (or
+  // loop) boundary without interrupting playback. When stopped the switch
+  // happens on the next audio buffer. A newer request replaces a queued one.
+  bool queueSceneTransition(const std::string& name,
+                            SceneTransitionQuantize quantize = SceneTransitionQuantize::Bar);
+  void cancelSceneTransition();
+  // Name of the queued scene, empty when nothing is queued.
+  std::string queuedSceneName() const;
+  // Call regularly from the UI thread: finishes the bookkeeping for a
+  // transition the audio thread applied (current scene name, freeing the
+  // old drum voice). Returns true when a transition completed.
+  bool updateSceneTransition();
+  // A transition whose kit could not be built ahead leaves it to the UI:
+  // prepareSceneDrums() builds it outside the audio guard and returns true
+  // when there is one, then applySceneDrums() installs it under the guard.
+  bool prepareSceneDrums();
+  void applySceneDrums();
+  // Call regularly from the UI thread: pages in the banks that are playing
+  // or coming up in the song, so the audio thread never waits on storage.
+  void updateBankPaging();
+  // Loads a bank before it is selected; call outside the audio guard.
+  void pageInBank(int bankIndex);
   bool saveSceneAs(const std::string& name);
   bool createNewSceneWithName(const std::string& name);
+  // Saves run on a background writer; this reports its progress.
+  AsyncSceneWriter::Status sceneSaveStatus() const;
+  // A copy of this engine for rendering the song offline (see SongBouncer):
+  // same scene, sounds and mix settings, with its own bank copies and no
+  // storage. Only captureSongRender() needs the audio guard; allocate
+  // 'out' before taking it. cloneForSongRender() then builds the copy and
+  // loadSongRenderBanks() reads in the banks the song uses that were paged
+  // out, both outside the guard. Returns the banks still missing (0 when
+  // the clone is complete).
+  void captureSongRender(SongRenderSnapshot& out);
+  static std::unique_ptr<MiniAcid> cloneForSongRender(const SongRenderSnapshot& snapshot);
+  uint32_t loadSongRenderBanks(MiniAcid& clone);
 
   void toggleMute303(int voiceIndex = 0);
   void toggleMuteKick();
@@ -147,6 +316,21 @@ public:
   void toggleMuteClap();
   void toggleDelay303(int voiceIndex = 0);
   void toggleDistortion303(int voiceIndex = 0);
+  // Track freeze: renders one bar of the current pattern through the
+  // channel's effects and plays it back instead of synthesizing, until the
+  // pattern, a 303 parameter, the tempo or the swing changes.
+  // capture303Freeze() copies what the render needs under the audio guard,
+  // prepare303Freeze() renders from that copy outside it, and freeze303()
+  // swaps the loop in under the guard again. freeze303() returns false when
+  // nothing current was prepared (a setting changed since the capture).
+  // Rendering fails when the loops would exceed kFreeze303BudgetBytes.
+  bool capture303Freeze(int voiceIndex);
+  bool prepare303Freeze(int voiceIndex);
+  bool freeze303(int voiceIndex);
+  void unfreeze303(int voiceIndex);
+  bool is303Frozen(int voiceIndex) const;
+  // Memory held by frozen and prepared loops.
+  size_t frozen303Bytes() const;
   void setDrumPatternIndex(int patternIndex);
   void shiftDrumPatternIndex(int delta);
   void setDrumBankIndex(int bankIndex);
@@ -171,47 +355,149 @@ public:
   void setParameter(MiniAcidParamId id, float value);
   void adjustParameter(MiniAcidParamId id, int steps);
 
+  // Renders the 303 section and the drums of each block on two threads (see
+  // ForkJoinBarrier). Call under the audio guard. Returns false when the
+  // build has no thread support; rendering then stays on the audio thread.
+  bool setParallelRender(bool enabled);
+  bool parallelRender() const;
+
+  // Native output: the mix with the master volume applied, within +-1.
+  // When 'stems' is set it also receives stemCount(stemLayout()) interleaved
+  // values per sample: each bus at mix level, before the clipper and the
+  // master volume, so the stems sum to the unclipped mix.
+  void renderFloat(float* out, size_t numSamples, float* stems = nullptr);
+  // renderFloat() followed by the int16 conversion stage, which applies the
+  // master volume, saturates and, if enabled, dithers.
   void generateAudioBuffer(int16_t *buffer, size_t numSamples);
+  // TPDF dither on the int16 output. Off by default.
+  void setOutputDither(bool enabled);
+  bool outputDither() const;
+  // Call under the audio guard.
+  void setStemLayout(StemLayout layout);
+  StemLayout stemLayout() const;
 
 private:
-  void updateSamplesPerStep();
+  // Sequencer event due at 'offset' samples into the current chunk.
+  struct ChunkEvent {
+    uint16_t offset;
+    SequencerEvent event;
+  };
+  static constexpr int kRenderChunk = AUDIO_BUFFER_SAMPLES;
+  // A chunk is shorter than a step, so it sees events of two steps at most.
+  static constexpr int kMaxChunkEvents = 2 * SequencerTimeline::kMaxStepEvents;
+
+  void updateTickRate();
   void advanceStep();
-  float noteToFreq(int note);
+  void syncTimeline();
+  // Advances the sequencer over up to 'maxSamples' samples, collecting the
+  // events and frozen loop positions for the render jobs. Returns the
+  // chunk length.
+  int sequenceChunk(int maxSamples);
+  // Renders the clipped mix before the master volume, and the stems when
+  // 'stems' is set.
+  void renderMix(float* buffer, size_t numSamples, float* stems);
+  void render303Chunk();
+  void renderDrumChunk();
+  static void render303Job(void* engine);
+  static void renderDrumJob(void* engine);
+  void play303Event(const SequencerEvent& event);
+  // Recompiles one step of the timeline (or all of it for -1) at the next
+  // step boundary. Safe to call from the UI thread.
+  void markTimelineDirty(int step = -1);
+  static float noteToFreq(int note);
   int clamp303Voice(int voiceIndex) const;
   int clamp303Step(int stepIndex) const;
   int clamp303Note(int note) const;
   const SynthPattern& synthPattern(int synthIndex) const;
-  SynthPattern& editSynthPattern(int synthIndex);
+  SynthPattern* editSynthPattern(int synthIndex);
   const DrumPattern& drumPattern(int drumVoiceIndex) const;
-  DrumPattern& editDrumPattern(int drumVoiceIndex);
+  DrumPattern* editDrumPattern(int drumVoiceIndex);
   int clampDrumVoice(int voiceIndex) const;
-  void refreshSynthCaches(int synthIndex) const;
-  void refreshDrumCache(int drumVoiceIndex) const;
+  StepMask drumAccentMask(int drumVoiceIndex) const;
   const SynthPattern& activeSynthPattern(int synthIndex) const;
   const DrumPattern& activeDrumPattern(int drumVoiceIndex) const;
+  const DrumPatternSet& activeDrumPatternSet() const;
   int songPatternIndexForTrack(SongTrack track) const;
   void applySongPositionSelection();
   void advanceSongPlayhead();
+  int nextSongPosition(int position) const;
+  uint32_t songPositionBanksMask(int position) const;
   int clampSongPosition(int position) const;
+  void captureFreezeSource(int voice, Frozen303Loop& loop) const;
+  bool freezeSourceMatches(int voice, const Frozen303Loop& loop) const;
+  std::unique_ptr<Frozen303Loop> render303Freeze(int voice, const Frozen303Loop& source) const;
 
-  TB303Voice voice303;
-  TB303Voice voice3032;
+  TB303VoiceBank voices303_;
+  std::vector<Synth303Channel> channels303_;
+  // Settings copied by capture303Freeze() (no samples), and the loops
+  // prepare303Freeze() rendered from them, waiting for freeze303().
+  Frozen303Loop freezeSource_[NUM_303_VOICES];
+  std::unique_ptr<Frozen303Loop> preparedFreeze_[NUM_303_VOICES];
   std::unique_ptr<DrumSynthVoice> drums;
   float sampleRateValue;
   std::string drumEngineName_;
+  bool drumHitCache_;
 
-  SceneManager sceneManager_;
+  std::unique_ptr<SceneManager> sceneManager_;
+  // Banks of a clone made by cloneForSongRender().
+  std::unique_ptr<MemoryBankStore> cloneBanks_;
   SceneStorage* sceneStorage_;
-  mutable int8_t synthNotesCache_[NUM_303_VOICES][SEQ_STEPS];
-  mutable bool synthAccentCache_[NUM_303_VOICES][SEQ_STEPS];
-  mutable bool synthSlideCache_[NUM_303_VOICES][SEQ_STEPS];
-  mutable bool drumHitCache_[NUM_DRUM_VOICES][SEQ_STEPS];
-  mutable bool drumAccentCache_[NUM_DRUM_VOICES][SEQ_STEPS];
-  mutable bool drumStepAccentCache_[SEQ_STEPS];
+  AsyncSceneWriter sceneWriter_;
+  // Filled by prepareSceneLoad(); swapped with sceneManager_ on load.
+  std::unique_ptr<SceneManager> stagedScene_;
+  std::string stagedSceneName_;
+  // Built by prepareDrumEngine() for 'stagedDrumsRequest_', waiting for
+  // setDrumEngine() under the audio guard.
+  std::unique_ptr<DrumSynthVoice> stagedDrums_;
+  std::string stagedDrumsRequest_;
+  std::string stagedDrumsName_;
+  bool stagedDrumsHitCache_;
+  // Queued scene transition. The low bits of transitionState_ hold a
+  // TransitionState, the rest a request generation so a superseded
+  // background load can never mark a newer request ready.
+  enum TransitionState : uint32_t {
+    kTransitionIdle = 0,
+    kTransitionLoading,
+    kTransitionReady,
+    kTransitionApplied,
+  };
+  std::atomic<uint32_t> transitionState_;
+  SceneTransitionQuantize transitionQuantize_;
+  std::unique_ptr<SceneManager> transitionScene_;
+  // Built by the loader when the scene plays another kit; the audio thread
+  // only swaps it in. When it is missing or stale by then (the kit or the
+  // hit cache changed after queueing) the swap is deferred to the UI.
+  std::unique_ptr<DrumSynthVoice> transitionDrums_;
+  std::string transitionDrumsName_;
+  bool transitionDrumsHitCache_;
+  bool transitionDrumsDeferred_;
+  // Set by the audio thread once an applied transition is complete.
+  std::atomic<bool> transitionSettled_;
+  std::string transitionSceneName_;
+  // Kit of the last transition still to install; see prepareSceneDrums().
+  std::string pendingSceneDrums_;
+  // Banks the sequencer will need soon, set by the audio thread and paged
+  // in by updateBankPaging().
+  std::atomic<uint32_t> bankRequests_;
+  // Bumped on entry to and exit from renderMix(), so odd while the audio
+  // thread may hold pointers into the scene's bank slots.
+  std::atomic<uint32_t> renderEpoch_;
+  // What the audio thread reads, for paging in the scenes this engine owns.
+  class BankReaders : public SceneBankReaders {
+  public:
+    explicit BankReaders(const MiniAcid& engine) : engine_(engine) {}
+    uint32_t pinnedBanks() const override;
+    uint32_t readTicket() const override;
+    bool readsDone(uint32_t ticket) const override;
+
+  private:
+    const MiniAcid& engine_;
+  };
+  BankReaders bankReaders_;
+  // Declared after the buffers above so its loader thread is joined first.
+  SceneCache sceneCache_;
 
   volatile bool playing;
-  volatile bool mute303;
-  volatile bool mute303_2;
   volatile bool muteKick;
   volatile bool muteSnare;
   volatile bool muteHat;
@@ -220,33 +506,65 @@ private:
   volatile bool muteHighTom;
   volatile bool muteRim;
   volatile bool muteClap;
-  volatile bool delay303Enabled;
-  volatile bool delay3032Enabled;
-  volatile bool distortion303Enabled;
-  volatile bool distortion3032Enabled;
   volatile float bpmValue;
+  volatile float swingValue_;
   volatile int currentStepIndex;
-  unsigned long samplesIntoStep;
-  float samplesPerStep;
+  // Playback position in timeline ticks from the start of the bar. Kept as
+  // a fraction so step lengths never round and the tempo cannot drift.
+  double tickPosition_;
+  double ticksPerSample_;
+  int eventCursor_;
+  SequencerTimeline timeline_;
+  // One bit per step to recompile; bits are set by edits on the UI thread.
+  std::atomic<uint32_t> timelineDirty_;
+  // What the timeline was compiled from; a change recompiles the whole bar.
+  const SynthPattern* timelineSynths_[NUM_303_VOICES];
+  const DrumPatternSet* timelineDrums_;
+  float timelineSwing_;
   bool songMode_;
-  int drumCycleIndex_;
   int songPlayheadPosition_;
   int patternModeDrumPatternIndex_;
   int patternModeDrumBankIndex_;
   int patternModeSynthPatternIndex_[NUM_303_VOICES];
   int patternModeSynthBankIndex_[NUM_303_VOICES];
 
-  TempoDelay delay303;
-  TempoDelay delay3032;
-  TubeDistortion distortion303;
-  TubeDistortion distortion3032;
-  int16_t lastBuffer[AUDIO_BUFFER_SAMPLES];
-  size_t lastBufferCount;
+  ScopeBuffer scope_;
+  float mixBuffer_[kRenderChunk];
+  Int16Dither outputDither_;
+
+  // Per-chunk state shared by the sequencer pass and the render jobs.
+  ForkJoinBarrier renderSplit_;
+  ChunkEvent chunkEvents_[kMaxChunkEvents];
+  int chunkEventCount_;
+  int chunkLength_;
+  uint32_t chunkLoopIndex_[kRenderChunk];
+  uint32_t renderMuted303_;
+  uint32_t renderFrozen303_;
+  uint32_t renderMutedDrums_;
+  StemLayout stemLayout_;
+  // Stem frames of the current chunk, or nullptr when not capturing.
+  float* renderStems_;
+  // Each job writes its own buffer; keep them on separate cache lines.
+  alignas(64) float chunk303_[kRenderChunk];
+  alignas(64) float chunkDrums_[kRenderChunk];
 
   void loadSceneFromStorage();
   void saveSceneToStorage();
   void applySceneStateFromManager();
+  void attachBankStore(SceneManager& scene, const std::string& sceneName);
+  void applySceneVoiceState();
+  bool sceneTransitionReady() const;
+  void applySceneTransition();
   void syncSceneStateToManager();
+  // One bit per drum lane, set when the lane is muted.
+  uint32_t drumMuteMask() const;
+  std::unique_ptr<DrumSynthVoice> makeDrumVoice(const std::string& engineName, bool hitCache,
+                                                std::string& canonicalName) const;
+  bool stageDrumVoice(const std::string& engineName, bool hitCache);
+  // The staged voice when it was built for 'engineName' and 'hitCache',
+  // else a new one.
+  std::unique_ptr<DrumSynthVoice> takeDrumVoice(const std::string& engineName, bool hitCache,
+                                                std::string& canonicalName);
 
   Parameter params[static_cast<int>(MiniAcidParamId::Count)];
 };
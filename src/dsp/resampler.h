@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+enum class ResamplerQuality : uint8_t {
+  Low = 0,  // 8 taps per phase, more when downsampling
+  Medium,   // 16 taps
+  High,     // 32 taps
+};
+
+// Block-based polyphase resampler for a mono float stream, used to play
+// the engine's internal rate on a device running at another rate. The
+// rate ratio is reduced to L/M and the windowed-sinc prototype is split
+// into L phases, so each output sample is a single dot product with no
+// interpolation. Equal rates pass samples straight through.
+//
+// Pull model: ask inputNeeded() how many input samples the next
+// 'outFrames' outputs take, render exactly that many and call process().
+class PolyphaseResampler {
+public:
+  // Ratios whose reduced L exceeds this are rounded to kMaxPhases phases.
+  static constexpr uint32_t kMaxPhases = 2048;
+
+  PolyphaseResampler();
+
+  // Returns false for non-positive rates. Resets the filter history.
+  bool configure(uint32_t inputRate, uint32_t outputRate,
+                 ResamplerQuality quality = ResamplerQuality::Medium);
+  void reset();
+
+  uint32_t inputRate() const { return inputRate_; }
+  uint32_t outputRate() const { return outputRate_; }
+  ResamplerQuality quality() const { return quality_; }
+  bool passthrough() const { return interp_ == decim_; }
+  int tapsPerPhase() const { return taps_; }
+
+  size_t inputNeeded(size_t outFrames) const;
+  // Largest inputNeeded() for 'outFrames' from any phase.
+  size_t maxInputNeeded(size_t outFrames) const;
+  // Consumes inputNeeded(outFrames) samples of 'in'.
+  void process(const float* in, float* out, size_t outFrames);
+
+private:
+  uint32_t inputRate_;
+  uint32_t outputRate_;
+  ResamplerQuality quality_;
+  uint32_t interp_;  // L
+  uint32_t decim_;   // M
+  uint32_t phase_;   // position between inputs, in 1/L steps
+  int taps_;
+  // taps_ coefficients per phase, oldest input first.
+  std::vector<float> coeffs_;
+  // The last taps_ inputs followed by the block being processed.
+  std::vector<float> work_;
+};
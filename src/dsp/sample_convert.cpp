@@ -0,0 +1,60 @@
+#include "sample_convert.h"
+
+namespace {
+constexpr size_t kDitherBlock = 64;
+
+// Samples per vector step; fixed so -O2 builds vectorize the inner loop too.
+constexpr size_t kLanes = 8;
+
+inline int16_t convertSample(float v) {
+  v = v > 32767.0f ? 32767.0f : v;
+  v = v < -32768.0f ? -32768.0f : v;
+  return static_cast<int16_t>(static_cast<int32_t>(v));
+}
+
+inline void convertBlock(const float* in, int16_t* out, size_t count, float scale,
+                         const float* noise) {
+  size_t i = 0;
+  if (noise) {
+    for (; i + kLanes <= count; i += kLanes) {
+      for (size_t k = 0; k < kLanes; ++k) out[i + k] = convertSample(in[i + k] * scale + noise[i + k]);
+    }
+    for (; i < count; ++i) out[i] = convertSample(in[i] * scale + noise[i]);
+    return;
+  }
+  for (; i + kLanes <= count; i += kLanes) {
+    for (size_t k = 0; k < kLanes; ++k) out[i + k] = convertSample(in[i + k] * scale);
+  }
+  for (; i < count; ++i) out[i] = convertSample(in[i] * scale);
+}
+} // namespace
+
+void convertFloatToInt16(const float* in, int16_t* out, size_t count, float gain,
+                         Int16Dither* dither) {
+  if (!in || !out) return;
+  const float scale = gain * 32767.0f;
+  if (!dither || !dither->enabled) {
+    convertBlock(in, out, count, scale, nullptr);
+    return;
+  }
+
+  float noise[kDitherBlock];
+  uint32_t state = dither->state;
+  while (count > 0) {
+    size_t n = count < kDitherBlock ? count : kDitherBlock;
+    for (size_t i = 0; i < n; ++i) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      // Difference of two 16-bit uniforms: triangular over (-1, 1) LSB.
+      int32_t a = static_cast<int32_t>(state & 0xFFFFu);
+      int32_t b = static_cast<int32_t>(state >> 16);
+      noise[i] = static_cast<float>(a - b) * (1.0f / 65536.0f);
+    }
+    convertBlock(in, out, n, scale, noise);
+    in += n;
+    out += n;
+    count -= n;
+  }
+  dither->state = state;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Triangular (TPDF) dither for float to int16 conversion: two uniform
+// values per sample, one LSB peak, from a small xorshift generator.
+struct Int16Dither {
+  bool enabled = false;
+  uint32_t state = 0x9E3779B9u;
+};
+
+// Converts float samples (full scale +-1) to int16: scales by 'gain',
+// saturates to the int16 range and, when 'dither' is enabled, adds TPDF
+// dither before truncating. The scale/clamp/convert pass is branch-free
+// over a block so it vectorizes (SSE/NEON on desktop, WebAssembly SIMD
+// when enabled); the dither noise is generated up front in its own pass.
+void convertFloatToInt16(const float* in, int16_t* out, size_t count, float gain,
+                         Int16Dither* dither = nullptr);
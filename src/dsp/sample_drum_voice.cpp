@@ -0,0 +1,247 @@
+#include "sample_drum_voice.h"
+
+#include <math.h>
+#include <string.h>
+#include <new>
+
+namespace {
+const char* const kLaneFileNames[kDrumLanes] = {
+  "kick.wav", "snare.wav", "hat.wav", "openhat.wav",
+  "midtom.wav", "hightom.wav", "rim.wav", "clap.wav",
+};
+
+constexpr int kHatLane = 2;
+constexpr int kOpenHatLane = 3;
+constexpr float kNormalGain = 0.7f;
+constexpr float kAccentGain = 1.0f;
+constexpr float kMaxPitch = 24.0f;
+// A choked lane fades out over a few milliseconds instead of clicking.
+constexpr float kChokeSeconds = 0.005f;
+constexpr float kSilentRelease = 0.001f;
+
+uint16_t readLe16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t readLe32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+class ArenaDrumSampleKit : public DrumSampleKit {
+public:
+  std::unique_ptr<uint8_t[]> arena;
+};
+} // namespace
+
+bool parseWavSample(const uint8_t* bytes, size_t size, DrumSample& out) {
+  if (!bytes || size < 12) return false;
+  if (memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0) return false;
+
+  uint16_t format = 0;
+  uint16_t channels = 0;
+  uint16_t bits = 0;
+  uint32_t rate = 0;
+  bool haveFormat = false;
+  size_t offset = 12;
+  while (offset + 8 <= size) {
+    const uint8_t* chunk = bytes + offset;
+    uint32_t chunkSize = readLe32(chunk + 4);
+    size_t body = offset + 8;
+    size_t available = size - body;
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (chunkSize < 16 || available < 16) return false;
+      format = readLe16(bytes + body);
+      channels = readLe16(bytes + body + 2);
+      rate = readLe32(bytes + body + 4);
+      bits = readLe16(bytes + body + 14);
+      // WAVE_FORMAT_EXTENSIBLE carries the real format in its sub-format GUID.
+      if (format == 0xFFFE && chunkSize >= 26 && available >= 26) {
+        format = readLe16(bytes + body + 24);
+      }
+      haveFormat = true;
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (!haveFormat || format != 1 || bits != 16) return false;
+      if (channels < 1 || channels > 2 || rate == 0) return false;
+      // Played in place, so the samples must be 16-bit aligned.
+      if (reinterpret_cast<uintptr_t>(bytes + body) & 1u) return false;
+      size_t dataBytes = chunkSize < available ? chunkSize : available;
+      uint32_t frames = static_cast<uint32_t>(dataBytes / (2u * channels));
+      if (frames == 0) return false;
+      out.data = reinterpret_cast<const int16_t*>(bytes + body);
+      out.frames = frames;
+      out.channels = channels;
+      out.sampleRate = rate;
+      return true;
+    }
+    // Chunks are padded to an even size.
+    size_t next = static_cast<size_t>(chunkSize) + (chunkSize & 1u);
+    if (next > available) return false;
+    offset = body + next;
+  }
+  return false;
+}
+
+const char* drumSampleFileName(int lane) {
+  if (lane < 0 || lane >= kDrumLanes) return "";
+  return kLaneFileNames[lane];
+}
+
+bool isDrumSampleKitName(const std::string& name) {
+  if (name.empty() || name[0] == '.') return false;
+  return name.find_first_of("/\\:") == std::string::npos;
+}
+
+std::shared_ptr<const DrumSampleKit> loadDrumSampleKitArena(
+    const std::string& name, const size_t (&fileSizes)[kDrumLanes],
+    const std::function<bool(int lane, uint8_t* dst, size_t size)>& readFile) {
+  size_t offsets[kDrumLanes];
+  size_t total = 0;
+  for (int l = 0; l < kDrumLanes; ++l) {
+    offsets[l] = total;
+    total += (fileSizes[l] + 3u) & ~static_cast<size_t>(3u);
+  }
+  if (total == 0) return nullptr;
+
+  auto kit = std::make_shared<ArenaDrumSampleKit>();
+  kit->arena.reset(new (std::nothrow) uint8_t[total]);
+  if (!kit->arena) return nullptr;
+  kit->name = name;
+  bool any = false;
+  for (int l = 0; l < kDrumLanes; ++l) {
+    if (fileSizes[l] == 0) continue;
+    uint8_t* dst = kit->arena.get() + offsets[l];
+    if (!readFile(l, dst, fileSizes[l])) continue;
+    if (parseWavSample(dst, fileSizes[l], kit->lanes[l])) any = true;
+  }
+  if (!any) return nullptr;
+  return kit;
+}
+
+SampleDrumVoice::SampleDrumVoice(std::shared_ptr<const DrumSampleKit> kit, float sampleRate)
+  : kit_(std::move(kit)),
+    sampleRate_(sampleRate),
+    releaseCoeff_(0.0f),
+    activeMask_(0) {
+  for (int l = 0; l < kDrumLanes; ++l) {
+    pitch_[l] = 0.0f;
+    chokeGroup_[l] = 0;
+  }
+  chokeGroup_[kHatLane] = 1;
+  chokeGroup_[kOpenHatLane] = 1;
+  setSampleRate(sampleRate);
+  reset();
+}
+
+void SampleDrumVoice::reset() {
+  activeMask_ = 0;
+  for (int l = 0; l < kDrumLanes; ++l) {
+    pos_[l] = 0;
+    frac_[l] = 0;
+    gain_[l] = 0.0f;
+    release_[l] = 0.0f;
+    choked_[l] = false;
+  }
+  params[static_cast<int>(DrumParamId::MainVolume)] =
+    Parameter("vol", "", 0.0f, 1.0f, 0.8f, 1.0f / 128);
+}
+
+void SampleDrumVoice::setSampleRate(float sampleRateHz) {
+  if (sampleRateHz <= 0.0f) sampleRateHz = 44100.0f;
+  sampleRate_ = sampleRateHz;
+  releaseCoeff_ = expf(-1.0f / (kChokeSeconds * sampleRate_));
+  for (int l = 0; l < kDrumLanes; ++l) updateStep(l);
+}
+
+void SampleDrumVoice::updateStep(int lane) {
+  const DrumSample& sample = kit_->lanes[lane];
+  if (!sample.data) {
+    step_[lane] = 0;
+    return;
+  }
+  float ratio = static_cast<float>(sample.sampleRate) / sampleRate_ *
+                powf(2.0f, pitch_[lane] / 12.0f);
+  float step = ratio * 65536.0f + 0.5f;
+  step_[lane] = step < 1.0f ? 1u : static_cast<uint32_t>(step);
+}
+
+void SampleDrumVoice::setLanePitch(int lane, float semitones) {
+  if (lane < 0 || lane >= kDrumLanes) return;
+  if (semitones < -kMaxPitch) semitones = -kMaxPitch;
+  if (semitones > kMaxPitch) semitones = kMaxPitch;
+  pitch_[lane] = semitones;
+  updateStep(lane);
+}
+
+float SampleDrumVoice::lanePitch(int lane) const {
+  if (lane < 0 || lane >= kDrumLanes) return 0.0f;
+  return pitch_[lane];
+}
+
+void SampleDrumVoice::setChokeGroup(int lane, uint8_t group) {
+  if (lane < 0 || lane >= kDrumLanes) return;
+  chokeGroup_[lane] = group;
+}
+
+void SampleDrumVoice::trigger(int lane, bool accent) {
+  if (lane < 0 || lane >= kDrumLanes || !kit_->lanes[lane].data) return;
+  uint8_t group = chokeGroup_[lane];
+  if (group) {
+    for (int l = 0; l < kDrumLanes; ++l) {
+      if (l != lane && chokeGroup_[l] == group && (activeMask_ & (1u << l))) choked_[l] = true;
+    }
+  }
+  pos_[lane] = 0;
+  frac_[lane] = 0;
+  gain_[lane] = (accent ? kAccentGain : kNormalGain) * (1.0f / 32768.0f);
+  release_[lane] = 1.0f;
+  choked_[lane] = false;
+  activeMask_ |= 1u << lane;
+}
+
+float SampleDrumVoice::process(uint32_t muteMask) {
+  if (!activeMask_) return 0.0f;
+  return render(muteMask, nullptr);
+}
+
+float SampleDrumVoice::processLanes(uint32_t muteMask, float* lanes) {
+  for (int l = 0; l < kDrumLanes; ++l) lanes[l] = 0.0f;
+  if (!activeMask_) return 0.0f;
+  return render(muteMask, lanes);
+}
+
+float SampleDrumVoice::render(uint32_t muteMask, float* lanes) {
+  float sum = 0.0f;
+  for (int l = 0; l < kDrumLanes; ++l) {
+    uint32_t bit = 1u << l;
+    if (!(activeMask_ & bit)) continue;
+    const DrumSample& sample = kit_->lanes[l];
+    uint32_t pos = pos_[l];
+    if (pos >= sample.frames || release_[l] < kSilentRelease) {
+      activeMask_ &= ~bit;
+      continue;
+    }
+    float a = sample.data[pos * sample.channels];
+    float b = pos + 1 < sample.frames ? sample.data[(pos + 1) * sample.channels] : 0.0f;
+    float value = (a + (b - a) * static_cast<float>(frac_[l]) * (1.0f / 65536.0f)) *
+                  gain_[l] * release_[l];
+    if (!(muteMask & bit)) {
+      sum += value;
+      if (lanes) lanes[l] = value;
+    }
+
+    if (choked_[l]) release_[l] *= releaseCoeff_;
+    uint32_t frac = frac_[l] + step_[l];
+    pos_[l] = pos + (frac >> 16);
+    frac_[l] = frac & 0xFFFFu;
+  }
+  return sum;
+}
+
+const Parameter& SampleDrumVoice::parameter(DrumParamId id) const {
+  return params[static_cast<int>(id)];
+}
+
+void SampleDrumVoice::setParameter(DrumParamId id, float value) {
+  params[static_cast<int>(id)].setValue(value);
+}
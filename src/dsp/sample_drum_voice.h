@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mini_drumvoices.h"
+
+// A 16-bit PCM one-shot. 'data' points into memory owned by the kit that
+// holds the sample; frames are 'channels' interleaved values apart and only
+// the first channel is played.
+struct DrumSample {
+  const int16_t* data = nullptr;
+  uint32_t frames = 0;
+  uint16_t channels = 1;
+  uint32_t sampleRate = 0;
+};
+
+// Finds the PCM data of a 16-bit WAV file in 'bytes' without copying it.
+// Returns false for anything that is not 16-bit PCM with one or two channels.
+bool parseWavSample(const uint8_t* bytes, size_t size, DrumSample& out);
+
+// File name of a lane's one-shot inside a sample kit folder ("kick.wav", ...).
+const char* drumSampleFileName(int lane);
+
+// One-shots for the eight drum lanes. Sample memory belongs to the kit (a
+// file mapping or one arena) and is released when the last voice using the
+// kit goes away. Lanes without a sample stay empty.
+class DrumSampleKit {
+public:
+  virtual ~DrumSampleKit() = default;
+
+  std::string name;
+  DrumSample lanes[kDrumLanes];
+};
+
+// Copies the lane files into one contiguous allocation and parses them in
+// place. 'fileSizes' holds each lane's file size (0 for none) and 'readFile'
+// fills 'size' bytes of a lane's file into 'dst'. Returns nullptr when the
+// arena cannot be allocated or no lane holds a usable sample.
+std::shared_ptr<const DrumSampleKit> loadDrumSampleKitArena(
+    const std::string& name, const size_t (&fileSizes)[kDrumLanes],
+    const std::function<bool(int lane, uint8_t* dst, size_t size)>& readFile);
+
+// True for a plain folder name (no path separators, not hidden).
+bool isDrumSampleKitName(const std::string& name);
+
+// Storage side of the sample engine. Kits are folders of one-shots named
+// after drumSampleFileName() under kDrumSampleDirectory.
+class DrumSampleStore {
+public:
+  static constexpr const char* kDrumSampleDirectory = "drums";
+
+  virtual ~DrumSampleStore() = default;
+  virtual std::vector<std::string> drumSampleKitNames() const = 0;
+  // Returns nullptr when the kit is missing or has no usable sample.
+  virtual std::shared_ptr<const DrumSampleKit> loadDrumSampleKit(const std::string& kitName) = 0;
+};
+
+// Plays a DrumSampleKit. Each lane steps through its sample with a 16.16
+// fixed-point position and linear interpolation, which covers both the
+// file-to-engine rate conversion and the lane pitch. Lanes that share a
+// choke group cut each other off (closed hat chokes open hat).
+class SampleDrumVoice : public DrumSynthVoice {
+public:
+  SampleDrumVoice(std::shared_ptr<const DrumSampleKit> kit, float sampleRate);
+
+  void reset() override;
+  void setSampleRate(float sampleRate) override;
+  void trigger(int lane, bool accent) override;
+  float process(uint32_t muteMask) override;
+  float processLanes(uint32_t muteMask, float* lanes) override;
+
+  const Parameter& parameter(DrumParamId id) const override;
+  void setParameter(DrumParamId id, float value) override;
+
+  // Pitch offset in semitones applied from the next hit of 'lane'.
+  void setLanePitch(int lane, float semitones);
+  float lanePitch(int lane) const;
+  // Lanes with the same non-zero group choke each other.
+  void setChokeGroup(int lane, uint8_t group);
+
+  const std::string& kitName() const { return kit_->name; }
+  const std::shared_ptr<const DrumSampleKit>& kit() const { return kit_; }
+
+private:
+  void updateStep(int lane);
+  // process(), writing lane shares to 'lanes' when it is set.
+  float render(uint32_t muteMask, float* lanes);
+
+  std::shared_ptr<const DrumSampleKit> kit_;
+  float sampleRate_;
+  float releaseCoeff_;
+
+  float pitch_[kDrumLanes];
+  uint8_t chokeGroup_[kDrumLanes];
+  uint32_t step_[kDrumLanes]; // 16.16 frames per output sample
+  uint32_t pos_[kDrumLanes];
+  uint32_t frac_[kDrumLanes];
+  float gain_[kDrumLanes];
+  float release_[kDrumLanes]; // 1 while playing, decays once choked
+  bool choked_[kDrumLanes];
+  uint32_t activeMask_;
+
+  Parameter params[static_cast<int>(DrumParamId::Count)];
+};
@@ -0,0 +1,77 @@
+#include "sample_rate_probe.h"
+
+#include <chrono>
+#include <vector>
+
+namespace {
+constexpr int kProbeDelaySamples = 1024;
+
+// Average load of the probe pattern at one rate.
+float probeRate(float sampleRate, size_t blockSamples, int blocks) {
+  const size_t noteSamples = static_cast<size_t>(sampleRate * 60.0f / 140.0f / 4.0f);
+  static const float kNotes[] = {55.0f, 110.0f, 65.4f, 130.8f, 73.4f, 98.0f};
+
+  TB303VoiceBank bank(sampleRate, NUM_303_VOICES);
+  // Same per-sample work as the engine's delay, on a short line so the
+  // boot probe does not allocate a second set of full delay lines.
+  std::vector<TubeDistortion> distortions(NUM_303_VOICES);
+  std::vector<TempoDelay> delays;
+  delays.reserve(NUM_303_VOICES);
+  for (int v = 0; v < NUM_303_VOICES; ++v) {
+    delays.emplace_back(sampleRate, kProbeDelaySamples);
+    distortions[v].setEnabled(true);
+    delays[v].setBeats(0.5f);
+    delays[v].setBpm(140.0f);
+    delays[v].setEnabled(true);
+    bank.setParameter(v, TB303ParamId::Oscillator, 2.0f);
+  }
+  int kitCount = 0;
+  const DrumKitSpec* kits = drumKits(kitCount);
+  DrumKit drums(kits[0], sampleRate);
+
+  float out[NUM_303_VOICES];
+  volatile float sink = 0.0f;
+  size_t sampleIndex = 0;
+  double totalUs = 0.0;
+  for (int b = 0; b < blocks; ++b) {
+    auto start = std::chrono::steady_clock::now();
+    float mix = 0.0f;
+    for (size_t i = 0; i < blockSamples; ++i, ++sampleIndex) {
+      if (sampleIndex % noteSamples == 0) {
+        size_t step = sampleIndex / noteSamples;
+        for (int v = 0; v < NUM_303_VOICES; ++v) {
+          float freq = kNotes[(step + v) % (sizeof(kNotes) / sizeof(kNotes[0]))];
+          bank.startNote(v, freq, step % 4 == 0, step % 3 == 1);
+        }
+        for (int l = 0; l < kDrumLanes; ++l) {
+          if ((step + l) % 2 == 0) drums.trigger(l, step % 4 == 0);
+        }
+      }
+      bank.process(out);
+      for (int v = 0; v < NUM_303_VOICES; ++v) {
+        mix += delays[v].process(distortions[v].process(out[v] * 0.5f));
+      }
+      mix += drums.process(0);
+    }
+    sink = sink + mix;
+    totalUs += std::chrono::duration<double, std::micro>(
+                   std::chrono::steady_clock::now() - start).count();
+  }
+  const double deadlineUs = 1e6 * static_cast<double>(blockSamples) / sampleRate;
+  return static_cast<float>(totalUs / blocks / deadlineUs);
+}
+} // namespace
+
+SampleRateProbeResult probeEngineSampleRate(size_t blockSamples, int blocks, float budget,
+                                            int maxRate) {
+  SampleRateProbeResult result;
+  if (blockSamples == 0 || blocks <= 0) return result;
+  for (int r = 0; r < kEngineSampleRateCount; ++r) {
+    int rate = kEngineSampleRates[r];
+    if (rate > maxRate) break;
+    result.load[r] = probeRate(static_cast<float>(rate), blockSamples, blocks);
+    if (result.load[r] > budget) break;
+    result.sampleRate = rate;
+  }
+  return result;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "miniacid_engine.h"
+
+struct SampleRateProbeResult {
+  // Average block time at each of kEngineSampleRates, as a fraction of the
+  // block's playback time. Rates above 'maxRate' are left at 0.
+  float load[kEngineSampleRateCount] = {};
+  // Highest rate whose load fits the budget; the lowest rate when none does.
+  int sampleRate = kEngineSampleRates[0];
+};
+
+// Renders 'blocks' blocks of a busy pattern (both 303 voices as supersaws
+// through distortion and a short delay, plus a full drum kit) at each
+// supported rate up to 'maxRate' and picks the highest one whose average load stays within
+// 'budget', leaving the rest of each block to the UI and rendering peaks.
+SampleRateProbeResult probeEngineSampleRate(size_t blockSamples, int blocks, float budget,
+                                            int maxRate = kEngineSampleRates[kEngineSampleRateCount - 1]);
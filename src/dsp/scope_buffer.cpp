@@ -0,0 +1,127 @@
+#include "scope_buffer.h"
+
+namespace {
+
+constexpr uint32_t kEntryMask = ScopeBuffer::kEntries - 1;
+// Reads stay within half of each ring, so the writer has half a ring of
+// room before a read has to retry.
+constexpr uint32_t kMaxReadEntries = ScopeBuffer::kEntries / 2;
+constexpr int kReadAttempts = 3;
+// Samples between two publishes of the write position.
+constexpr size_t kPublishSamples = 256;
+
+static_assert((ScopeBuffer::kEntries & kEntryMask) == 0, "kEntries must be a power of two");
+
+inline int levelShift(int level) { return ScopeBuffer::kLevelShift * level; }
+
+}  // namespace
+
+ScopeBuffer::ScopeBuffer() { reset(); }
+
+void ScopeBuffer::reset() {
+  for (int k = 0; k < kLevels; ++k) {
+    for (uint32_t i = 0; i < kEntries; ++i) {
+      levels_[k][i].store(pack(0, 0), std::memory_order_relaxed);
+    }
+    partialMin_[k] = kFullScale;
+    partialMax_[k] = -kFullScale;
+  }
+  written_ = 0;
+  position_.store(0, std::memory_order_release);
+}
+
+uint16_t ScopeBuffer::pack(int lo, int hi) {
+  return static_cast<uint16_t>(static_cast<uint8_t>(lo) | (static_cast<uint8_t>(hi) << 8));
+}
+
+ScopeBuffer::Peak ScopeBuffer::unpack(uint16_t packed) {
+  Peak peak;
+  peak.min = static_cast<int8_t>(packed & 0xFF);
+  peak.max = static_cast<int8_t>(packed >> 8);
+  return peak;
+}
+
+void ScopeBuffer::publish(uint32_t position) {
+  position_.store(position, std::memory_order_release);
+}
+
+void ScopeBuffer::write(const float* samples, size_t count, float gain) {
+  if (!samples) return;
+  const float scale = gain * static_cast<float>(kFullScale);
+  uint32_t pos = written_;
+  for (size_t i = 0; i < count; ++i) {
+    float value = samples[i] * scale;
+    int q = static_cast<int>(value < 0.0f ? value - 0.5f : value + 0.5f);
+    if (q > kFullScale) q = kFullScale;
+    if (q < -kFullScale) q = -kFullScale;
+    levels_[0][pos & kEntryMask].store(pack(q, q), std::memory_order_relaxed);
+    ++pos;
+
+    // A completed entry feeds the one being gathered on the next level.
+    int lo = q;
+    int hi = q;
+    for (int k = 1; k < kLevels; ++k) {
+      if (lo < partialMin_[k]) partialMin_[k] = static_cast<int8_t>(lo);
+      if (hi > partialMax_[k]) partialMax_[k] = static_cast<int8_t>(hi);
+      const int shift = levelShift(k);
+      if ((pos & ((1u << shift) - 1)) != 0) break;
+      lo = partialMin_[k];
+      hi = partialMax_[k];
+      levels_[k][((pos >> shift) - 1) & kEntryMask].store(pack(lo, hi),
+                                                           std::memory_order_relaxed);
+      partialMin_[k] = kFullScale;
+      partialMax_[k] = -kFullScale;
+    }
+    if ((i + 1) % kPublishSamples == 0) publish(pos);
+  }
+  written_ = pos;
+  publish(pos);
+}
+
+uint32_t ScopeBuffer::maxSpan() {
+  return (kMaxReadEntries - 2) << levelShift(kLevels - 1);
+}
+
+bool ScopeBuffer::read(uint32_t span, Peak* out, int columns) const {
+  if (!out || columns <= 0 || span == 0 || span > maxSpan()) return false;
+
+  // The coarsest level with an entry per column, unless the span does not
+  // fit the finer levels at all.
+  int level = 0;
+  const uint32_t minEntries = static_cast<uint32_t>(columns);
+  while (level + 1 < kLevels && (span >> levelShift(level + 1)) >= minEntries) ++level;
+  while (level + 1 < kLevels && (span >> levelShift(level)) + 2 > kMaxReadEntries) ++level;
+  const int shift = levelShift(level);
+  const uint32_t entries = ((span - 1) >> shift) + 1;
+  const std::atomic<uint16_t>* ring = levels_[level];
+
+  for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+    const uint32_t pos = position_.load(std::memory_order_acquire);
+    // Index of the oldest entry of the span; the newest is the last one
+    // completed on this level.
+    const uint32_t first = (pos >> shift) - entries;
+    for (int c = 0; c < columns; ++c) {
+      uint32_t e0 = static_cast<uint32_t>(static_cast<uint64_t>(c) * entries / columns);
+      uint32_t e1 = static_cast<uint32_t>((static_cast<uint64_t>(c + 1) * entries + columns - 1) /
+                                          columns);
+      if (e1 <= e0) e1 = e0 + 1;
+      if (e1 > entries) e1 = entries;
+      Peak peak = unpack(ring[(first + e0) & kEntryMask].load(std::memory_order_relaxed));
+      for (uint32_t e = e0 + 1; e < e1; ++e) {
+        Peak next = unpack(ring[(first + e) & kEntryMask].load(std::memory_order_relaxed));
+        if (next.min < peak.min) peak.min = next.min;
+        if (next.max > peak.max) peak.max = next.max;
+      }
+      out[c] = peak;
+    }
+
+    // Valid unless the writer reached the oldest entry while it was read.
+    // Past what it published it may have stored up to kPublishSamples more.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint32_t now = position_.load(std::memory_order_relaxed);
+    const uint32_t advanced = ((now - pos) + (pos & ((1u << shift) - 1))) >> shift;
+    const uint32_t unpublished = static_cast<uint32_t>((kPublishSamples >> shift) + 1);
+    if (entries + advanced + unpublished < kEntries) return true;
+  }
+  return false;
+}
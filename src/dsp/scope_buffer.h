@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free history of the engine output for oscilloscope views. The audio
+// thread appends every rendered sample; the UI reads any span of the recent
+// past at any width without stopping it.
+//
+// Samples are kept as a peak pyramid: level 0 holds the samples themselves,
+// and every further level holds the min/max of four entries of the level
+// below, in a ring of kEntries per level. A read picks the coarsest level
+// that still has at least one entry per column, so drawing costs O(columns)
+// whether the span is a few milliseconds or several bars.
+//
+// The write position works as a seqlock: the writer publishes it after the
+// entries, and a reader copies what it needs and then checks that the
+// writer has not come round to those entries in the meantime, retrying if
+// it has. Peaks are stored as 8-bit values, plenty for a display.
+class ScopeBuffer {
+public:
+  struct Peak {
+    int8_t min;
+    int8_t max;
+  };
+
+  static constexpr int kLevels = 7;
+  // Each level merges 1 << kLevelShift entries of the level below.
+  static constexpr int kLevelShift = 2;
+  // Entries per level; a power of two.
+  static constexpr uint32_t kEntries = 1024;
+  // Peak value of a full-scale sample.
+  static constexpr int kFullScale = 127;
+
+  ScopeBuffer();
+
+  // Clears the history. Call with the writer stopped.
+  void reset();
+  // Audio thread: appends 'count' samples scaled by 'gain'.
+  void write(const float* samples, size_t count, float gain);
+
+  // Samples written so far, wrapping at 2^32.
+  uint32_t position() const { return position_.load(std::memory_order_acquire); }
+  // Longest span read() can cover.
+  static uint32_t maxSpan();
+
+  // Fills 'columns' peaks that split the last 'span' samples evenly, oldest
+  // first. Columns narrower than a sample repeat the sample they fall on.
+  // Returns false when 'span' is too long or the writer kept overwriting
+  // the entries being read.
+  bool read(uint32_t span, Peak* out, int columns) const;
+
+private:
+  // Min/max packed into one atomic so a single entry never tears.
+  static uint16_t pack(int lo, int hi);
+  static Peak unpack(uint16_t packed);
+  void publish(uint32_t position);
+
+  std::atomic<uint16_t> levels_[kLevels][kEntries];
+  std::atomic<uint32_t> position_;
+
+  // Writer-only: the entry being gathered on each level above 0.
+  int8_t partialMin_[kLevels];
+  int8_t partialMax_[kLevels];
+  uint32_t written_;
+};
@@ -0,0 +1,48 @@
+#include "sequencer_timeline.h"
+
+SequencerTimeline::SequencerTimeline() {
+  for (int i = 0; i < kSteps; ++i) counts_[i] = 0;
+}
+
+uint16_t SequencerTimeline::stepTick(int step, float swing) {
+  if (swing < 0.0f) swing = 0.0f;
+  if (swing > 1.0f) swing = 1.0f;
+  int tick = step * kTicksPerStep;
+  if (step & 1) tick += static_cast<int>(swing * (kTicksPerStep / 2) + 0.5f);
+  return static_cast<uint16_t>(tick);
+}
+
+void SequencerTimeline::compileStep(int step, const SynthPattern* const synths[kSynthVoices],
+                                    const DrumPatternSet& drums, float swing) {
+  if (step < 0 || step >= kSteps) return;
+  uint16_t tick = stepTick(step, swing);
+  SequencerEvent* out = events_[step];
+  int count = 0;
+
+  for (int v = 0; v < kSynthVoices; ++v) {
+    const SynthStep& s = synths[v]->steps[step];
+    SequencerEvent& e = out[count++];
+    e.tick = tick;
+    e.voice = static_cast<uint8_t>(v);
+    e.note = s.note;
+    e.type = s.note >= 0 ? SequencerEvent::SynthNote : SequencerEvent::SynthRelease;
+    e.flags = static_cast<uint8_t>((s.accent ? SequencerEvent::kAccent : 0) |
+                                   (s.slide ? SequencerEvent::kSlide : 0));
+  }
+
+  // Drum accents are shared by every voice hit on the step.
+  uint16_t stepBit = static_cast<uint16_t>(1u << step);
+  uint16_t accents = 0;
+  for (int v = 0; v < DrumPatternSet::kVoices; ++v) accents |= drums.voices[v].accents;
+  uint8_t drumFlags = (accents & stepBit) ? SequencerEvent::kAccent : 0;
+  for (int v = 0; v < DrumPatternSet::kVoices; ++v) {
+    if (!(drums.voices[v].hits & stepBit)) continue;
+    SequencerEvent& e = out[count++];
+    e.tick = tick;
+    e.type = SequencerEvent::DrumHit;
+    e.voice = static_cast<uint8_t>(v);
+    e.note = -1;
+    e.flags = drumFlags;
+  }
+  counts_[step] = static_cast<uint8_t>(count);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "scenes.h"
+
+struct SequencerEvent {
+  enum Type : uint8_t {
+    SynthNote = 0,
+    SynthRelease,
+    DrumHit,
+  };
+  static constexpr uint8_t kAccent = 1;
+  static constexpr uint8_t kSlide = 2;
+
+  uint16_t tick;  // from the start of the bar
+  uint8_t type;
+  uint8_t voice;  // 303 voice or drum voice
+  int8_t note;
+  uint8_t flags;
+};
+
+// One bar of sequencer events on a 96 PPQN grid, compiled from the patterns
+// that are playing. Events are stored per step in tick order, so an edit
+// only recompiles its own step and playback just walks a cursor.
+class SequencerTimeline {
+public:
+  static constexpr int kTicksPerQuarter = 96;
+  static constexpr int kTicksPerStep = kTicksPerQuarter / 4;
+  static constexpr int kSteps = 16;
+  static constexpr int kTicksPerBar = kTicksPerStep * kSteps;
+  static constexpr int kSynthVoices = 2;
+  static constexpr int kMaxStepEvents = kSynthVoices + DrumPatternSet::kVoices;
+
+  SequencerTimeline();
+
+  // Swing (0-1) delays every second 16th by up to half a step.
+  static uint16_t stepTick(int step, float swing);
+
+  void compileStep(int step, const SynthPattern* const synths[kSynthVoices],
+                   const DrumPatternSet& drums, float swing);
+  int eventCount(int step) const { return counts_[step]; }
+  const SequencerEvent* events(int step) const { return events_[step]; }
+
+private:
+  SequencerEvent events_[kSteps][kMaxStepEvents];
+  uint8_t counts_[kSteps];
+};
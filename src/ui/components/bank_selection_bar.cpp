@@ -36,9 +36,18 @@ bool BankSelectionBarComponent::computeLayout(IGfx& gfx, Layout& layout) const {
   layout.box_size = layout.label_h + 2;
   int bank_count = state_.bank_count;
   if (bank_count < 1) bank_count = 1;
+  int visible = state_.visible_count;
+  if (visible < 1 || visible > bank_count) visible = bank_count;
+  int focus = state_.show_cursor ? state_.cursor_index : state_.selected_index;
+  if (focus < 0) focus = 0;
+  if (focus >= bank_count) focus = bank_count - 1;
+  int first = (focus / visible) * visible;
+  if (first > bank_count - visible) first = bank_count - visible;
+  layout.first_index = first;
+  layout.visible_count = visible;
 
   layout.label_w = textWidth(gfx, label_.c_str());
-  int total_w = layout.label_w + layout.spacing + (layout.box_size + layout.spacing) * bank_count -
+  int total_w = layout.label_w + layout.spacing + (layout.box_size + layout.spacing) * visible -
                 layout.spacing;
   layout.bank_x = layout.bounds_x + layout.bounds_w - total_w;
   layout.bank_y = layout.bounds_y;
@@ -64,18 +73,17 @@ bool BankSelectionBarComponent::handleEvent(UIEvent& ui_event) {
   const Layout& layout = last_layout_;
   if (ui_event.y < layout.bank_y || ui_event.y >= layout.bank_y + layout.box_size) return false;
 
-  int bank_count = state_.bank_count;
-  if (bank_count < 1) return false;
+  if (state_.bank_count < 1) return false;
   int box_x = layout.bank_x + layout.label_w + layout.spacing;
   int rel_x = ui_event.x - box_x;
   if (rel_x < 0) return false;
   int stride = layout.box_size + layout.spacing;
-  int index = rel_x / stride;
-  if (index < 0 || index >= bank_count) return false;
-  int cell_x = box_x + index * stride;
+  int slot = rel_x / stride;
+  if (slot < 0 || slot >= layout.visible_count) return false;
+  int cell_x = box_x + slot * stride;
   if (ui_event.x >= cell_x + layout.box_size) return false;
   if (callbacks_.onSelect) {
-    callbacks_.onSelect(index);
+    callbacks_.onSelect(layout.first_index + slot);
   }
   return true;
 }
@@ -87,15 +95,14 @@ void BankSelectionBarComponent::draw(IGfx& gfx) {
   last_layout_valid_ = true;
 
   bool songMode = state_.song_mode;
-  int bank_count = state_.bank_count;
-  if (bank_count < 0) bank_count = 0;
 
   gfx.setTextColor(COLOR_LABEL);
   gfx.drawText(layout.bank_x, layout.label_y, label_.c_str());
 
   int box_x = layout.bank_x + layout.label_w + layout.spacing;
-  for (int i = 0; i < bank_count; ++i) {
-    int cell_x = box_x + i * (layout.box_size + layout.spacing);
+  for (int slot = 0; slot < layout.visible_count; ++slot) {
+    int i = layout.first_index + slot;
+    int cell_x = box_x + slot * (layout.box_size + layout.spacing);
     IGfxColor bg = songMode ? COLOR_GRAY_DARKER : COLOR_PANEL;
     IGfxColor border = songMode ? COLOR_LABEL : COLOR_WHITE;
     gfx.fillRect(cell_x, layout.bank_y, layout.box_size, layout.box_size, bg);
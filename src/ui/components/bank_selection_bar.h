@@ -9,6 +9,8 @@ class BankSelectionBarComponent : public Component {
  public:
   struct State {
     int bank_count = 4;
+    // Banks shown at once; the page follows the cursor (or selection).
+    int visible_count = 4;
     int selected_index = 0;
     int cursor_index = 0;
     bool show_cursor = false;
@@ -40,6 +42,8 @@ class BankSelectionBarComponent : public Component {
     int spacing = 2;
     int bank_x = 0;
     int bank_y = 0;
+    int first_index = 0;
+    int visible_count = 0;
   };
 
   bool computeLayout(IGfx& gfx, Layout& layout) const;
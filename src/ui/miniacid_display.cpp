@@ -49,7 +49,7 @@ MiniAcidDisplay::MiniAcidDisplay(IGfx& gfx, MiniAcid& mini_acid)
   pages_.push_back(std::make_unique<PatternEditPage>(gfx_, mini_acid_, audio_guard_, 1));
   pages_.push_back(std::make_unique<DrumSequencerPage>(gfx_, mini_acid_, audio_guard_));
   pages_.push_back(std::make_unique<SongPage>(gfx_, mini_acid_, audio_guard_));
-  pages_.push_back(std::make_unique<ProjectPage>(gfx_, mini_acid_, audio_guard_));
+  pages_.push_back(std::make_unique<ProjectPage>(gfx_, mini_acid_, audio_guard_, bouncer_));
   pages_.push_back(std::make_unique<WaveformPage>(gfx_, mini_acid_, audio_guard_));
   pages_.push_back(std::make_unique<HelpPage>());
 }
@@ -64,6 +64,10 @@ void MiniAcidDisplay::setAudioRecorder(IAudioRecorder* recorder) {
   audio_recorder_ = recorder;
 }
 
+void MiniAcidDisplay::setExportRecorder(IAudioRecorder* recorder) {
+  bouncer_.setRecorder(recorder);
+}
+
 void MiniAcidDisplay::dismissSplash() {
   splash_active_ = false;
 }
@@ -81,6 +85,16 @@ void MiniAcidDisplay::previousPage() {
 }
 
 void MiniAcidDisplay::update() {
+  mini_acid_.updateSceneTransition();
+  if (mini_acid_.prepareSceneDrums()) {
+    if (audio_guard_) {
+      audio_guard_([this]() { mini_acid_.applySceneDrums(); });
+    } else {
+      mini_acid_.applySceneDrums();
+    }
+  }
+  mini_acid_.updateBankPaging();
+  bouncer_.update();
   if (splash_active_) {
     unsigned long now = nowMillis();
     if (now - splash_start_ms_ >= 5000UL) splash_active_ = false;
@@ -3,6 +3,7 @@
 #include <memory>
 
 #include "ui_core.h"
+#include "../audio/song_bouncer.h"
 
 class IAudioRecorder;
 
@@ -12,6 +13,8 @@ public:
   ~MiniAcidDisplay();
   void setAudioGuard(AudioGuard guard);
   void setAudioRecorder(IAudioRecorder* recorder);
+  // Recorder for song exports from the project page; none disables them.
+  void setExportRecorder(IAudioRecorder* recorder);
   void update();
   void nextPage();
   void previousPage();
@@ -36,6 +39,7 @@ private:
 
   AudioGuard audio_guard_;
   IAudioRecorder* audio_recorder_ = nullptr;
+  SongBouncer bouncer_;
   std::vector<std::unique_ptr<IPage>> pages_;
   Container mute_buttons_container_;
   bool mute_buttons_initialized_ = false;
@@ -74,18 +74,18 @@ class DrumSequencerGridComponent : public Component {
     int cursorVoice = callbacks_.cursorVoice ? callbacks_.cursorVoice() : 0;
     bool gridFocus = callbacks_.gridFocused ? callbacks_.gridFocused() : false;
 
-    const bool* kick = mini_acid_.patternKickSteps();
-    const bool* snare = mini_acid_.patternSnareSteps();
-    const bool* hat = mini_acid_.patternHatSteps();
-    const bool* openHat = mini_acid_.patternOpenHatSteps();
-    const bool* midTom = mini_acid_.patternMidTomSteps();
-    const bool* highTom = mini_acid_.patternHighTomSteps();
-    const bool* rim = mini_acid_.patternRimSteps();
-    const bool* clap = mini_acid_.patternClapSteps();
-    const bool* accentSteps = mini_acid_.patternDrumAccentSteps();
+    StepMask kick = mini_acid_.patternKickSteps();
+    StepMask snare = mini_acid_.patternSnareSteps();
+    StepMask hat = mini_acid_.patternHatSteps();
+    StepMask openHat = mini_acid_.patternOpenHatSteps();
+    StepMask midTom = mini_acid_.patternMidTomSteps();
+    StepMask highTom = mini_acid_.patternHighTomSteps();
+    StepMask rim = mini_acid_.patternRimSteps();
+    StepMask clap = mini_acid_.patternClapSteps();
+    StepMask accentSteps = mini_acid_.patternDrumAccentSteps();
     int highlight = callbacks_.currentStep ? callbacks_.currentStep() : 0;
 
-    const bool* hits[NUM_DRUM_VOICES] = {kick, snare, hat, openHat, midTom, highTom, rim, clap};
+    StepMask hits[NUM_DRUM_VOICES] = {kick, snare, hat, openHat, midTom, highTom, rim, clap};
     const IGfxColor colors[NUM_DRUM_VOICES] = {COLOR_DRUM_KICK, COLOR_DRUM_SNARE, COLOR_DRUM_HAT,
                                                COLOR_DRUM_OPEN_HAT, COLOR_DRUM_MID_TOM,
                                                COLOR_DRUM_HIGH_TOM, COLOR_DRUM_RIM, COLOR_DRUM_CLAP};
@@ -226,17 +226,20 @@ class DrumSequencerMainPage : public Container {
 
 class GlobalDrumSettingsPage : public Container {
  public:
-  explicit GlobalDrumSettingsPage(MiniAcid& mini_acid);
+  GlobalDrumSettingsPage(MiniAcid& mini_acid, AudioGuard& audio_guard);
   bool handleEvent(UIEvent& ui_event) override;
  void draw(IGfx& gfx) override;
 
  private:
   void applyDrumEngineSelection();
   void syncDrumEngineSelection();
+  void withAudioGuard(const std::function<void()>& fn);
 
   MiniAcid& mini_acid_;
+  AudioGuard& audio_guard_;
   std::vector<std::string> drum_engine_options_;
   std::shared_ptr<LabelOptionComponent> character_control_;
+  std::shared_ptr<LabelOptionComponent> hit_cache_control_;
 };
 
 DrumSequencerMainPage::DrumSequencerMainPage(MiniAcid& mini_acid, AudioGuard& audio_guard)
@@ -255,7 +258,7 @@ DrumSequencerMainPage::DrumSequencerMainPage(MiniAcid& mini_acid, AudioGuard& au
   bank_index_ = mini_acid_.currentDrumBankIndex();
   bank_cursor_ = bank_index_;
   pattern_bar_ = std::make_shared<PatternSelectionBarComponent>("PATTERN");
-  bank_bar_ = std::make_shared<BankSelectionBarComponent>("BANK", "ABCD");
+  bank_bar_ = std::make_shared<BankSelectionBarComponent>("BANK", "ABCDEFGHIJKLMNOP");
   PatternSelectionBarComponent::Callbacks pattern_callbacks;
   pattern_callbacks.onSelect = [this](int index) {
     if (mini_acid_.songModeEnabled()) return;
@@ -443,6 +446,7 @@ void DrumSequencerMainPage::setBankIndex(int bankIndex) {
   if (bankIndex >= kBankCount) bankIndex = kBankCount - 1;
   if (bank_index_ == bankIndex) return;
   bank_index_ = bankIndex;
+  mini_acid_.pageInBank(bank_index_);
   withAudioGuard([&]() { mini_acid_.setDrumBankIndex(bank_index_); });
 }
 
@@ -462,7 +466,7 @@ bool DrumSequencerMainPage::handleEvent(UIEvent& ui_event) {
   if (ui_event.event_type == MINIACID_APPLICATION_EVENT) {
     switch (ui_event.app_event_type) {
       case MINIACID_APP_EVENT_COPY: {
-        const bool* hits[NUM_DRUM_VOICES] = {
+        StepMask hits[NUM_DRUM_VOICES] = {
           mini_acid_.patternKickSteps(),
           mini_acid_.patternSnareSteps(),
           mini_acid_.patternHatSteps(),
@@ -472,7 +476,7 @@ bool DrumSequencerMainPage::handleEvent(UIEvent& ui_event) {
           mini_acid_.patternRimSteps(),
           mini_acid_.patternClapSteps()
         };
-        const bool* accents[NUM_DRUM_VOICES] = {
+        StepMask accents[NUM_DRUM_VOICES] = {
           mini_acid_.patternKickAccentSteps(),
           mini_acid_.patternSnareAccentSteps(),
           mini_acid_.patternHatAccentSteps(),
@@ -483,10 +487,8 @@ bool DrumSequencerMainPage::handleEvent(UIEvent& ui_event) {
           mini_acid_.patternClapAccentSteps()
         };
         for (int v = 0; v < NUM_DRUM_VOICES; ++v) {
-          for (int i = 0; i < SEQ_STEPS; ++i) {
-            g_drum_pattern_clipboard.pattern.voices[v].steps[i].hit = hits[v][i];
-            g_drum_pattern_clipboard.pattern.voices[v].steps[i].accent = accents[v][i];
-          }
+          g_drum_pattern_clipboard.pattern.voices[v].hits = hits[v].bits;
+          g_drum_pattern_clipboard.pattern.voices[v].accents = accents[v].bits;
         }
         g_drum_pattern_clipboard.has_pattern = true;
         return true;
@@ -495,7 +497,7 @@ bool DrumSequencerMainPage::handleEvent(UIEvent& ui_event) {
         if (!g_drum_pattern_clipboard.has_pattern) return false;
         bool current_hits[NUM_DRUM_VOICES][SEQ_STEPS];
         bool current_accents[NUM_DRUM_VOICES][SEQ_STEPS];
-        const bool* hits[NUM_DRUM_VOICES] = {
+        StepMask hits[NUM_DRUM_VOICES] = {
           mini_acid_.patternKickSteps(),
           mini_acid_.patternSnareSteps(),
           mini_acid_.patternHatSteps(),
@@ -505,7 +507,7 @@ bool DrumSequencerMainPage::handleEvent(UIEvent& ui_event) {
           mini_acid_.patternRimSteps(),
           mini_acid_.patternClapSteps()
         };
-        const bool* accents[NUM_DRUM_VOICES] = {
+        StepMask accents[NUM_DRUM_VOICES] = {
           mini_acid_.patternKickAccentSteps(),
           mini_acid_.patternSnareAccentSteps(),
           mini_acid_.patternHatAccentSteps(),
@@ -525,8 +527,8 @@ bool DrumSequencerMainPage::handleEvent(UIEvent& ui_event) {
         withAudioGuard([&]() {
           for (int v = 0; v < NUM_DRUM_VOICES; ++v) {
             for (int i = 0; i < SEQ_STEPS; ++i) {
-              bool desiredHit = src.voices[v].steps[i].hit;
-              bool desiredAccent = src.voices[v].steps[i].accent && desiredHit;
+              bool desiredHit = src.voices[v].hit(i);
+              bool desiredAccent = src.voices[v].accent(i) && desiredHit;
               if (current_hits[v][i] != desiredHit) {
                 mini_acid_.toggleDrumStep(v, i);
               }
@@ -687,8 +689,9 @@ void DrumSequencerMainPage::draw(IGfx& gfx) {
 }
 } // namespace
 
-GlobalDrumSettingsPage::GlobalDrumSettingsPage(MiniAcid& mini_acid)
-  : mini_acid_(mini_acid) {
+GlobalDrumSettingsPage::GlobalDrumSettingsPage(MiniAcid& mini_acid, AudioGuard& audio_guard)
+  : mini_acid_(mini_acid),
+    audio_guard_(audio_guard) {
   character_control_ = std::make_shared<LabelOptionComponent>(
       "Character", COLOR_LABEL, COLOR_WHITE);
   drum_engine_options_ = mini_acid_.getAvailableDrumEngines();
@@ -697,15 +700,37 @@ GlobalDrumSettingsPage::GlobalDrumSettingsPage(MiniAcid& mini_acid)
   }
   character_control_->setOptions(drum_engine_options_);
   addChild(character_control_);
+  hit_cache_control_ = std::make_shared<LabelOptionComponent>(
+      "Hit cache", COLOR_LABEL, COLOR_WHITE);
+  hit_cache_control_->setOptions({"off", "on"});
+  hit_cache_control_->setOptionIndex(mini_acid_.drumHitCacheEnabled() ? 1 : 0);
+  addChild(hit_cache_control_);
 }
 
 bool GlobalDrumSettingsPage::handleEvent(UIEvent& ui_event) {
+  if (ui_event.event_type == MINIACID_KEY_DOWN) {
+    if (ui_event.scancode == MINIACID_LEFT) {
+      focusPrev();
+      return true;
+    }
+    if (ui_event.scancode == MINIACID_RIGHT) {
+      focusNext();
+      return true;
+    }
+  }
   int before = character_control_ ? character_control_->optionIndex() : -1;
+  int cache_before = hit_cache_control_ ? hit_cache_control_->optionIndex() : -1;
   bool handled = Container::handleEvent(ui_event);
   int after = character_control_ ? character_control_->optionIndex() : -1;
   if (before != after) {
     applyDrumEngineSelection();
   }
+  if (hit_cache_control_ && hit_cache_control_->optionIndex() != cache_before) {
+    bool enabled = hit_cache_control_->optionIndex() == 1;
+    // Rendering the cached kit takes a while; only the swap is guarded.
+    mini_acid_.prepareDrumHitCache(enabled);
+    withAudioGuard([&]() { mini_acid_.setDrumHitCacheEnabled(enabled); });
+  }
   return handled;
 }
 
@@ -725,6 +750,10 @@ void GlobalDrumSettingsPage::draw(IGfx& gfx) {
   if (character_control_) {
     character_control_->setBoundaries(Rect{x, row_y, w, gfx.fontHeight()});
   }
+  row_y += gfx.fontHeight() + 2;
+  if (hit_cache_control_) {
+    hit_cache_control_->setBoundaries(Rect{x, row_y, w, gfx.fontHeight()});
+  }
   Container::draw(gfx);
 }
 
@@ -732,7 +761,18 @@ void GlobalDrumSettingsPage::applyDrumEngineSelection() {
   if (!character_control_) return;
   int index = character_control_->optionIndex();
   if (index < 0 || index >= static_cast<int>(drum_engine_options_.size())) return;
-  mini_acid_.setDrumEngine(drum_engine_options_[index]);
+  const std::string& name = drum_engine_options_[index];
+  // Read the kit before taking the guard; the guarded part only swaps it in.
+  mini_acid_.prepareDrumEngine(name);
+  withAudioGuard([&]() { mini_acid_.setDrumEngine(name); });
+}
+
+void GlobalDrumSettingsPage::withAudioGuard(const std::function<void()>& fn) {
+  if (audio_guard_) {
+    audio_guard_(fn);
+    return;
+  }
+  fn();
 }
 
 void GlobalDrumSettingsPage::syncDrumEngineSelection() {
@@ -754,7 +794,7 @@ void GlobalDrumSettingsPage::syncDrumEngineSelection() {
 DrumSequencerPage::DrumSequencerPage(IGfx& gfx, MiniAcid& mini_acid, AudioGuard& audio_guard) {
   (void)gfx;
   addPage(std::make_shared<DrumSequencerMainPage>(mini_acid, audio_guard));
-  addPage(std::make_shared<GlobalDrumSettingsPage>(mini_acid));
+  addPage(std::make_shared<GlobalDrumSettingsPage>(mini_acid, audio_guard));
 }
 
 const std::string & DrumSequencerPage::getTitle() const {
@@ -33,7 +33,7 @@ PatternEditPage::PatternEditPage(IGfx& gfx, MiniAcid& mini_acid, AudioGuard& aud
   bank_cursor_ = bank_index_;
   title_ = voice_index_ == 0 ? "303A PATTERNS" : "303B PATTERNS";
   pattern_bar_ = std::make_shared<PatternSelectionBarComponent>("PATTERNS");
-  bank_bar_ = std::make_shared<BankSelectionBarComponent>("BANK", "ABCD");
+  bank_bar_ = std::make_shared<BankSelectionBarComponent>("BANK", "ABCDEFGHIJKLMNOP");
   PatternSelectionBarComponent::Callbacks pattern_callbacks;
   pattern_callbacks.onSelect = [this](int index) {
     if (mini_acid_.songModeEnabled()) return;
@@ -96,6 +96,7 @@ void PatternEditPage::setBankIndex(int bankIndex) {
   if (bankIndex >= kBankCount) bankIndex = kBankCount - 1;
   if (bank_index_ == bankIndex) return;
   bank_index_ = bankIndex;
+  mini_acid_.pageInBank(bank_index_);
   withAudioGuard([&]() { mini_acid_.set303BankIndex(voice_index_, bank_index_); });
 }
 
@@ -226,9 +227,9 @@ bool PatternEditPage::handleEvent(UIEvent& ui_event) {
   if (ui_event.event_type == MINIACID_APPLICATION_EVENT) {
     switch (ui_event.app_event_type) {
       case MINIACID_APP_EVENT_COPY: {
-        const int8_t* notes = mini_acid_.pattern303Steps(voice_index_);
-        const bool* accent = mini_acid_.pattern303AccentSteps(voice_index_);
-        const bool* slide = mini_acid_.pattern303SlideSteps(voice_index_);
+        SynthNoteSteps notes = mini_acid_.pattern303Steps(voice_index_);
+        StepMask accent = mini_acid_.pattern303AccentSteps(voice_index_);
+        StepMask slide = mini_acid_.pattern303SlideSteps(voice_index_);
         for (int i = 0; i < SEQ_STEPS; ++i) {
           g_pattern_clipboard.pattern.steps[i].note = notes[i];
           g_pattern_clipboard.pattern.steps[i].accent = accent[i];
@@ -242,9 +243,9 @@ bool PatternEditPage::handleEvent(UIEvent& ui_event) {
         int current_notes[SEQ_STEPS];
         bool current_accent[SEQ_STEPS];
         bool current_slide[SEQ_STEPS];
-        const int8_t* notes = mini_acid_.pattern303Steps(voice_index_);
-        const bool* accent = mini_acid_.pattern303AccentSteps(voice_index_);
-        const bool* slide = mini_acid_.pattern303SlideSteps(voice_index_);
+        SynthNoteSteps notes = mini_acid_.pattern303Steps(voice_index_);
+        StepMask accent = mini_acid_.pattern303AccentSteps(voice_index_);
+        StepMask slide = mini_acid_.pattern303SlideSteps(voice_index_);
         for (int i = 0; i < SEQ_STEPS; ++i) {
           current_notes[i] = notes[i];
           current_accent[i] = accent[i];
@@ -444,9 +445,9 @@ void PatternEditPage::draw(IGfx& gfx) {
   int body_h = h - 2;
   if (body_h <= 0) return;
 
-  const int8_t* notes = mini_acid_.pattern303Steps(voice_index_);
-  const bool* accent = mini_acid_.pattern303AccentSteps(voice_index_);
-  const bool* slide = mini_acid_.pattern303SlideSteps(voice_index_);
+  SynthNoteSteps notes = mini_acid_.pattern303Steps(voice_index_);
+  StepMask accent = mini_acid_.pattern303AccentSteps(voice_index_);
+  StepMask slide = mini_acid_.pattern303SlideSteps(voice_index_);
   int stepCursor = pattern_edit_cursor_;
   int playing = mini_acid_.currentStep();
   int selectedPattern = mini_acid_.display303PatternIndex(voice_index_);
@@ -6,6 +6,7 @@
 #include <cstdlib>
 
 #include "../help_dialog_frames.h"
+#include "../../audio/song_bouncer.h"
 
 namespace {
 std::string generateMemorableName() {
@@ -32,47 +33,77 @@ std::string generateMemorableName() {
 }
 } // namespace
 
-ProjectPage::ProjectPage(IGfx& gfx, MiniAcid& mini_acid, AudioGuard& audio_guard)
+ProjectPage::ProjectPage(IGfx& gfx, MiniAcid& mini_acid, AudioGuard& audio_guard,
+                         SongBouncer& bouncer)
   : gfx_(gfx),
     mini_acid_(mini_acid),
     audio_guard_(audio_guard),
+    bouncer_(bouncer),
     main_focus_(MainFocus::Load),
     dialog_type_(DialogType::None),
     dialog_focus_(DialogFocus::List),
     save_dialog_focus_(SaveDialogFocus::Input),
     selection_index_(0),
     scroll_offset_(0),
-    save_name_(generateMemorableName()) {
+    scene_count_(0),
+    page_offset_(-1),
+    seen_save_count_(0),
+    save_name_(generateMemorableName()),
+    export_failed_(false) {
   refreshScenes();
 }
 
 void ProjectPage::refreshScenes() {
-  scenes_ = mini_acid_.availableSceneNames();
-  if (scenes_.empty()) {
+  // Completed saves may have added or changed index entries.
+  uint32_t saves = mini_acid_.sceneSaveStatus().completedWrites;
+  if (saves != seen_save_count_) {
+    seen_save_count_ = saves;
+    invalidateScenePage();
+  }
+  int count = static_cast<int>(mini_acid_.sceneCount());
+  if (count != scene_count_) {
+    scene_count_ = count;
+    invalidateScenePage();
+  }
+  if (scene_count_ == 0) {
     selection_index_ = 0;
     scroll_offset_ = 0;
     return;
   }
   if (selection_index_ < 0) selection_index_ = 0;
-  int maxIdx = static_cast<int>(scenes_.size()) - 1;
+  int maxIdx = scene_count_ - 1;
   if (selection_index_ > maxIdx) selection_index_ = maxIdx;
   if (scroll_offset_ < 0) scroll_offset_ = 0;
   if (scroll_offset_ > maxIdx) scroll_offset_ = maxIdx;
 }
 
+void ProjectPage::invalidateScenePage() {
+  page_offset_ = -1;
+  page_.clear();
+}
+
+const SceneInfo* ProjectPage::sceneAt(int index) {
+  if (index < 0 || index >= scene_count_) return nullptr;
+  if (page_offset_ < 0 || index < page_offset_ ||
+      index >= page_offset_ + static_cast<int>(page_.size())) {
+    constexpr int kPageSize = 16;
+    page_offset_ = std::max(0, index - kPageSize / 2);
+    page_.clear();
+    mini_acid_.sceneInfos(static_cast<size_t>(page_offset_), kPageSize, page_);
+    if (index >= page_offset_ + static_cast<int>(page_.size())) return nullptr;
+  }
+  return &page_[index - page_offset_];
+}
+
 void ProjectPage::openLoadDialog() {
   dialog_type_ = DialogType::Load;
   dialog_focus_ = DialogFocus::List;
   save_dialog_focus_ = SaveDialogFocus::Input;
   refreshScenes();
-  std::string current = mini_acid_.currentSceneName();
-  for (size_t i = 0; i < scenes_.size(); ++i) {
-    if (scenes_[i] == current) {
-      selection_index_ = static_cast<int>(i);
-      break;
-    }
-  }
+  int current = mini_acid_.findScene(mini_acid_.currentSceneName());
+  if (current >= 0) selection_index_ = current;
   scroll_offset_ = selection_index_;
+  prefetchAroundSelection();
 }
 
 void ProjectPage::openSaveDialog() {
@@ -97,21 +128,36 @@ void ProjectPage::withAudioGuard(const std::function<void()>& fn) {
 }
 
 void ProjectPage::moveSelection(int delta) {
-  if (scenes_.empty() || delta == 0) return;
+  if (scene_count_ == 0 || delta == 0) return;
   selection_index_ += delta;
   if (selection_index_ < 0) selection_index_ = 0;
-  int maxIdx = static_cast<int>(scenes_.size()) - 1;
+  int maxIdx = scene_count_ - 1;
   if (selection_index_ > maxIdx) selection_index_ = maxIdx;
+  prefetchAroundSelection();
+}
+
+void ProjectPage::prefetchAroundSelection() {
+  if (scene_count_ == 0) return;
+  // Selected entry first, then its neighbours outwards.
+  constexpr int kPrefetchRadius = 2;
+  std::vector<std::string> names;
+  for (int d = 0; d <= kPrefetchRadius; ++d) {
+    const SceneInfo* below = sceneAt(selection_index_ + d);
+    const SceneInfo* above = d > 0 ? sceneAt(selection_index_ - d) : nullptr;
+    if (below) names.push_back(below->name);
+    if (above) names.push_back(above->name);
+  }
+  mini_acid_.prefetchScenes(names);
 }
 
 void ProjectPage::ensureSelectionVisible(int visibleRows) {
   if (visibleRows < 1) visibleRows = 1;
-  if (scenes_.empty()) {
+  if (scene_count_ == 0) {
     scroll_offset_ = 0;
     selection_index_ = 0;
     return;
   }
-  int maxIdx = static_cast<int>(scenes_.size()) - 1;
+  int maxIdx = scene_count_ - 1;
   if (selection_index_ < 0) selection_index_ = 0;
   if (selection_index_ > maxIdx) selection_index_ = maxIdx;
   if (scroll_offset_ < 0) scroll_offset_ = 0;
@@ -125,10 +171,24 @@ void ProjectPage::ensureSelectionVisible(int visibleRows) {
 }
 
 bool ProjectPage::loadSceneAtSelection() {
-  if (scenes_.empty()) return true;
-  if (selection_index_ < 0 || selection_index_ >= static_cast<int>(scenes_.size())) return true;
+  const SceneInfo* info = sceneAt(selection_index_);
+  if (!info) return true;
   bool loaded = false;
-  std::string name = scenes_[selection_index_];
+  std::string name = info->name;
+  if (mini_acid_.isPlaying()) {
+    // Keep playing; the engine switches scenes at the next bar.
+    if (mini_acid_.queueSceneTransition(name)) closeDialog();
+    return true;
+  }
+  // Parse (or copy from the cache) before taking the guard; the guarded
+  // part then only swaps the staged scene in.
+  if (!mini_acid_.prepareSceneLoad(name)) {
+    // The file is gone or unreadable, so the index is out of date.
+    mini_acid_.rebuildSceneIndex();
+    invalidateScenePage();
+    refreshScenes();
+    return true;
+  }
   withAudioGuard([&]() {
     loaded = mini_acid_.loadSceneByName(name);
   });
@@ -158,6 +218,7 @@ bool ProjectPage::createNewScene() {
   randomizeSaveName();
   bool created = false;
   std::string name = save_name_;
+  mini_acid_.prepareNewScene();
   withAudioGuard([&]() {
     created = mini_acid_.createNewSceneWithName(name);
   });
@@ -167,6 +228,25 @@ bool ProjectPage::createNewScene() {
   return true;
 }
 
+bool ProjectPage::toggleSongExport() {
+  if (bouncer_.isRendering()) {
+    bouncer_.cancel();
+    return true;
+  }
+  if (!bouncer_.available()) return true;
+  // Only the snapshot needs the guard; the clone is built and its
+  // paged-out banks are read after it.
+  auto snapshot = std::make_unique<SongRenderSnapshot>();
+  withAudioGuard([&]() {
+    mini_acid_.captureSongRender(*snapshot);
+  });
+  std::unique_ptr<MiniAcid> clone = MiniAcid::cloneForSongRender(*snapshot);
+  export_failed_ = mini_acid_.loadSongRenderBanks(*clone) != 0;
+  if (export_failed_) return true;
+  bouncer_.start(std::move(clone));
+  return true;
+}
+
 bool ProjectPage::handleSaveDialogInput(char key) {
   if (key == '\b') {
     if (!save_name_.empty()) save_name_.pop_back();
@@ -227,6 +307,12 @@ bool ProjectPage::handleEvent(UIEvent& ui_event) {
       closeDialog();
       return true;
     }
+    if (key == 'r' || key == 'R') {
+      mini_acid_.rebuildSceneIndex();
+      invalidateScenePage();
+      refreshScenes();
+      return true;
+    }
     return false;
   }
 
@@ -284,10 +370,12 @@ bool ProjectPage::handleEvent(UIEvent& ui_event) {
     case MINIACID_LEFT:
       if (main_focus_ == MainFocus::SaveAs) main_focus_ = MainFocus::Load;
       else if (main_focus_ == MainFocus::New) main_focus_ = MainFocus::SaveAs;
+      else if (main_focus_ == MainFocus::Export) main_focus_ = MainFocus::New;
       return true;
     case MINIACID_RIGHT:
       if (main_focus_ == MainFocus::Load) main_focus_ = MainFocus::SaveAs;
       else if (main_focus_ == MainFocus::SaveAs) main_focus_ = MainFocus::New;
+      else if (main_focus_ == MainFocus::New) main_focus_ = MainFocus::Export;
       return true;
     case MINIACID_UP:
     case MINIACID_DOWN:
@@ -306,6 +394,8 @@ bool ProjectPage::handleEvent(UIEvent& ui_event) {
       return true;
     } else if (main_focus_ == MainFocus::New) {
       return createNewScene();
+    } else if (main_focus_ == MainFocus::Export) {
+      return toggleSongExport();
     }
   }
   return false;
@@ -334,16 +424,18 @@ void ProjectPage::draw(IGfx& gfx) {
   gfx.setTextColor(COLOR_WHITE);
   gfx.drawText(x, body_y + line_h + 2, currentName.c_str());
 
-  int btn_w = 70;
-  if (btn_w > 90) btn_w = 90;
-  if (btn_w < 60) btn_w = 60;
+  constexpr int kButtons = 4;
+  int spacing = 6;
+  int btn_w = (w - spacing * (kButtons - 1)) / kButtons;
+  if (btn_w > 70) btn_w = 70;
+  if (btn_w < 48) btn_w = 48;
   int btn_h = line_h + 8;
   int btn_y = body_y + line_h * 2 + 8;
-  int spacing = 6;
-  int total_w = btn_w * 3 + spacing * 2;
+  int total_w = btn_w * kButtons + spacing * (kButtons - 1);
   int start_x = x + (w - total_w) / 2;
-  const char* labels[3] = {"Load", "Save As", "New"};
-  for (int i = 0; i < 3; ++i) {
+  const char* labels[kButtons] = {"Load", "Save As", "New",
+                                  bouncer_.isRendering() ? "Cancel" : "Export"};
+  for (int i = 0; i < kButtons; ++i) {
     int btn_x = start_x + i * (btn_w + spacing);
     bool focused = (dialog_type_ == DialogType::None && static_cast<int>(main_focus_) == i);
     gfx.fillRect(btn_x, btn_y, btn_w, btn_h, COLOR_PANEL);
@@ -354,6 +446,57 @@ void ProjectPage::draw(IGfx& gfx) {
 
   gfx.setTextColor(COLOR_LABEL);
   gfx.drawText(x, btn_y + btn_h + 6, "Enter to act, arrows to move focus");
+
+  AsyncSceneWriter::Status saveStatus = mini_acid_.sceneSaveStatus();
+  std::string saveText;
+  switch (saveStatus.state) {
+    case AsyncSceneWriter::State::Pending:
+    case AsyncSceneWriter::State::Writing:
+      saveText = "Saving " + saveStatus.sceneName + "...";
+      break;
+    case AsyncSceneWriter::State::Saved:
+      saveText = "Saved " + saveStatus.sceneName;
+      break;
+    case AsyncSceneWriter::State::Failed:
+      gfx.setTextColor(COLOR_ACCENT);
+      saveText = "Save failed: " + saveStatus.sceneName;
+      break;
+    default:
+      break;
+  }
+  if (!saveText.empty()) gfx.drawText(x, btn_y + btn_h + 6 + line_h + 2, saveText.c_str());
+  std::string queued = mini_acid_.queuedSceneName();
+  if (!queued.empty()) {
+    gfx.setTextColor(COLOR_ACCENT);
+    std::string nextText = "Next: " + queued;
+    gfx.drawText(x, btn_y + btn_h + 6 + (line_h + 2) * 2, nextText.c_str());
+  }
+  gfx.setTextColor(COLOR_LABEL);
+  char exportText[64];
+  exportText[0] = '\0';
+  // A clone that could not get its banks never reached the bouncer.
+  switch (export_failed_ ? SongBouncer::State::Failed : bouncer_.state()) {
+    case SongBouncer::State::Rendering:
+      std::snprintf(exportText, sizeof(exportText), "Exporting song %d%%",
+                    static_cast<int>(bouncer_.progress() * 100.0f));
+      break;
+    case SongBouncer::State::Done:
+      std::snprintf(exportText, sizeof(exportText), "Exported %s", bouncer_.filename().c_str());
+      break;
+    case SongBouncer::State::Cancelled:
+      std::snprintf(exportText, sizeof(exportText), "Export cancelled");
+      break;
+    case SongBouncer::State::Failed:
+      gfx.setTextColor(COLOR_ACCENT);
+      std::snprintf(exportText, sizeof(exportText), "Export failed");
+      break;
+    default:
+      if (!bouncer_.available() && main_focus_ == MainFocus::Export) {
+        std::snprintf(exportText, sizeof(exportText), "Export not available here");
+      }
+      break;
+  }
+  if (exportText[0]) gfx.drawText(x, btn_y + btn_h + 6 + (line_h + 2) * 3, exportText);
   gfx.setTextColor(COLOR_WHITE);
 
   if (dialog_type_ == DialogType::None) return;
@@ -377,6 +520,16 @@ void ProjectPage::draw(IGfx& gfx) {
     gfx.setTextColor(COLOR_WHITE);
     gfx.drawText(dialog_x + 4, dialog_y + 2, "Load Scene");
 
+    SceneCache::Stats cache = mini_acid_.sceneCacheStats();
+    uint32_t lookups = cache.hits + cache.misses;
+    int hitPercent = lookups > 0 ? static_cast<int>(cache.hits * 100 / lookups) : 0;
+    char cacheText[32];
+    std::snprintf(cacheText, sizeof(cacheText), "hit %d%% %uK", hitPercent,
+                  static_cast<unsigned>(cache.bytesUsed / 1024));
+    gfx.setTextColor(COLOR_LABEL);
+    gfx.drawText(dialog_x + dialog_w - textWidth(gfx, cacheText) - 4, dialog_y + 2, cacheText);
+    gfx.setTextColor(COLOR_WHITE);
+
     int row_h = line_h + 3;
     int cancel_h = line_h + 8;
     int list_y = dialog_y + header_h + 2;
@@ -387,24 +540,32 @@ void ProjectPage::draw(IGfx& gfx) {
 
     ensureSelectionVisible(visible_rows);
 
-    if (scenes_.empty()) {
+    if (scene_count_ == 0) {
       gfx.setTextColor(COLOR_LABEL);
       gfx.drawText(dialog_x + 4, list_y, "No scenes found");
       gfx.setTextColor(COLOR_WHITE);
     } else {
       int rowsToDraw = visible_rows;
-      if (rowsToDraw > static_cast<int>(scenes_.size()) - scroll_offset_) {
-        rowsToDraw = static_cast<int>(scenes_.size()) - scroll_offset_;
+      if (rowsToDraw > scene_count_ - scroll_offset_) {
+        rowsToDraw = scene_count_ - scroll_offset_;
       }
       for (int i = 0; i < rowsToDraw; ++i) {
         int sceneIdx = scroll_offset_ + i;
+        const SceneInfo* info = sceneAt(sceneIdx);
+        if (!info) break;
         int row_y = list_y + i * row_h;
         bool selected = sceneIdx == selection_index_;
         if (selected) {
           gfx.fillRect(dialog_x + 2, row_y, dialog_w - 4, row_h, COLOR_PANEL);
           gfx.drawRect(dialog_x + 2, row_y, dialog_w - 4, row_h, COLOR_ACCENT);
         }
-        gfx.drawText(dialog_x + 6, row_y + 1, scenes_[sceneIdx].c_str());
+        gfx.drawText(dialog_x + 6, row_y + 1, info->name.c_str());
+        char details[24];
+        std::snprintf(details, sizeof(details), "%d %s", static_cast<int>(info->bpm + 0.5f),
+                      info->drumEngine.c_str());
+        gfx.setTextColor(COLOR_LABEL);
+        gfx.drawText(dialog_x + dialog_w - textWidth(gfx, details) - 6, row_y + 1, details);
+        gfx.setTextColor(COLOR_WHITE);
       }
     }
 
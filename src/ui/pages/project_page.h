@@ -4,41 +4,55 @@
 #include "../ui_colors.h"
 #include "../ui_utils.h"
 
+class SongBouncer;
+
 class ProjectPage : public IPage{
  public:
-  ProjectPage(IGfx& gfx, MiniAcid& mini_acid, AudioGuard& audio_guard);
+  ProjectPage(IGfx& gfx, MiniAcid& mini_acid, AudioGuard& audio_guard, SongBouncer& bouncer);
   void draw(IGfx& gfx) override;
   bool handleEvent(UIEvent& ui_event) override;
   const std::string & getTitle() const override;
 
  private:
-  enum class MainFocus { Load = 0, SaveAs, New };
+  enum class MainFocus { Load = 0, SaveAs, New, Export };
   enum class DialogType { None = 0, Load, SaveAs };
   enum class DialogFocus { List = 0, Cancel };
   enum class SaveDialogFocus { Input = 0, Randomize, Save, Cancel };
 
   void refreshScenes();
+  void invalidateScenePage();
+  const SceneInfo* sceneAt(int index);
   void openLoadDialog();
   void openSaveDialog();
   void closeDialog();
   void moveSelection(int delta);
+  void prefetchAroundSelection();
   bool loadSceneAtSelection();
   void ensureSelectionVisible(int visibleRows);
   void randomizeSaveName();
   bool saveCurrentScene();
   bool createNewScene();
+  // Starts exporting the song, or cancels the export in progress.
+  bool toggleSongExport();
   bool handleSaveDialogInput(char key);
   void withAudioGuard(const std::function<void()>& fn);
 
   IGfx& gfx_;
   MiniAcid& mini_acid_;
   AudioGuard& audio_guard_;
+  SongBouncer& bouncer_;
   MainFocus main_focus_;
   DialogType dialog_type_;
   DialogFocus dialog_focus_;
   SaveDialogFocus save_dialog_focus_;
   int selection_index_;
   int scroll_offset_;
-  std::vector<std::string> scenes_;
+  // Scenes are paged in from the storage index as the list scrolls.
+  int scene_count_;
+  int page_offset_;
+  std::vector<SceneInfo> page_;
+  uint32_t seen_save_count_;
   std::string save_name_;
+  // The last export was abandoned before it started (see toggleSongExport()).
+  bool export_failed_;
 };
@@ -2,7 +2,6 @@
 
 #include <cctype>
 #include <cstdio>
-#include <vector>
 
 #include "../help_dialog_frames.h"
 #include "../components/mode_button.h"
@@ -17,7 +16,8 @@ struct SongAreaClipboard {
   bool has_area = false;
   int rows = 0;
   int tracks = 0;
-  std::vector<int> pattern_indices;
+  // Copied cells, starting at row 0 / track 0.
+  Song cells;
 };
 
 enum class UndoActionType {
@@ -27,38 +27,31 @@ enum class UndoActionType {
   Delete,
 };
 
-struct UndoCell {
-  int row;
-  int track;
-  int pattern_index;
-};
-
 struct UndoHistory {
   UndoActionType action_type = UndoActionType::None;
-  std::vector<UndoCell> cells;
-  
+  // The song as it was before the action. It shares chunks with the live
+  // song, so only the chunks the action writes to end up duplicated.
+  Song before;
+  int row = 0;
+  int rows = 0;
+  int track = 0;
+  int tracks = 0;
+
   void clear() {
     action_type = UndoActionType::None;
-    cells.clear();
-  }
-  
-  void saveSingleCell(int row, int track, int pattern_index) {
-    cells.clear();
-    cells.push_back({row, track, pattern_index});
+    before.clear();
+    rows = 0;
+    tracks = 0;
   }
-  
-  void saveArea(int min_row, int max_row, int min_track, int max_track, 
-                const std::vector<int>& pattern_indices) {
-    cells.clear();
-    int idx = 0;
-    for (int r = min_row; r <= max_row; ++r) {
-      for (int t = min_track; t <= max_track; ++t) {
-        if (idx < static_cast<int>(pattern_indices.size())) {
-          cells.push_back({r, t, pattern_indices[idx]});
-        }
-        ++idx;
-      }
-    }
+
+  void save(UndoActionType type, const Song& song, int min_row, int row_count,
+            int min_track, int track_count) {
+    action_type = type;
+    before = song;
+    row = min_row;
+    rows = row_count;
+    track = min_track;
+    tracks = track_count;
   }
 };
 
@@ -301,9 +294,7 @@ bool SongPage::clearPattern() {
   int row = cursorRow();
   
   // Save undo state
-  int current_pattern = mini_acid_.songPatternAt(row, track);
-  g_undo_history.action_type = UndoActionType::Delete;
-  g_undo_history.saveSingleCell(row, cursorTrack(), current_pattern);
+  g_undo_history.save(UndoActionType::Delete, mini_acid_.song(), row, 1, cursorTrack(), 1);
   
   withAudioGuard([&]() {
     mini_acid_.clearSongPattern(row, track);
@@ -386,17 +377,9 @@ bool SongPage::handleEvent(UIEvent& ui_event) {
           int tracks = max_track - min_track + 1;
           g_song_area_clipboard.rows = rows;
           g_song_area_clipboard.tracks = tracks;
-          g_song_area_clipboard.pattern_indices.clear();
-          g_song_area_clipboard.pattern_indices.reserve(rows * tracks);
-          
-          for (int r = min_row; r <= max_row; ++r) {
-            for (int t = min_track; t <= max_track; ++t) {
-              bool valid = false;
-              SongTrack song_track = trackForColumn(t, valid);
-              int pattern = valid ? mini_acid_.songPatternAt(r, song_track) : -1;
-              g_song_area_clipboard.pattern_indices.push_back(pattern);
-            }
-          }
+          g_song_area_clipboard.cells.clear();
+          g_song_area_clipboard.cells.setLength(rows);
+          g_song_area_clipboard.cells.copyRange(mini_acid_.song(), min_row, 0, rows, min_track, 0, tracks);
           g_song_area_clipboard.has_area = true;
           g_song_pattern_clipboard.has_pattern = false; // Clear single-cell clipboard
         } else {
@@ -422,34 +405,18 @@ bool SongPage::handleEvent(UIEvent& ui_event) {
           int tracks = max_track - min_track + 1;
           g_song_area_clipboard.rows = rows;
           g_song_area_clipboard.tracks = tracks;
-          g_song_area_clipboard.pattern_indices.clear();
-          g_song_area_clipboard.pattern_indices.reserve(rows * tracks);
-          
-          // Save undo state and copy/clear
-          std::vector<int> old_patterns;
-          old_patterns.reserve(rows * tracks);
-          
-          withAudioGuard([&]() {
-            for (int r = min_row; r <= max_row; ++r) {
-              for (int t = min_track; t <= max_track; ++t) {
-                bool valid = false;
-                SongTrack song_track = trackForColumn(t, valid);
-                if (valid) {
-                  int pattern = mini_acid_.songPatternAt(r, song_track);
-                  g_song_area_clipboard.pattern_indices.push_back(pattern);
-                  old_patterns.push_back(pattern);
-                  mini_acid_.clearSongPattern(r, song_track);
-                }
-              }
-            }
-          });
-          
+          g_song_area_clipboard.cells.clear();
+          g_song_area_clipboard.cells.setLength(rows);
+          g_song_area_clipboard.cells.copyRange(mini_acid_.song(), min_row, 0, rows, min_track, 0, tracks);
           g_song_area_clipboard.has_area = true;
           g_song_pattern_clipboard.has_pattern = false; // Clear single-cell clipboard
           
-          // Save undo history
-          g_undo_history.action_type = UndoActionType::Cut;
-          g_undo_history.saveArea(min_row, max_row, min_track, max_track, old_patterns);
+          // Save undo history, then clear the area
+          g_undo_history.save(UndoActionType::Cut, mini_acid_.song(), min_row, rows, min_track, tracks);
+          Song empty;
+          withAudioGuard([&]() {
+            mini_acid_.copySongRange(empty, 0, min_row, rows, 0, min_track, tracks);
+          });
         } else {
           // Cut single cell
           int row = cursorRow();
@@ -460,8 +427,7 @@ bool SongPage::handleEvent(UIEvent& ui_event) {
           g_song_area_clipboard.has_area = false; // Clear area clipboard
           
           // Save undo state
-          g_undo_history.action_type = UndoActionType::Cut;
-          g_undo_history.saveSingleCell(row, cursorTrack(), current_pattern);
+          g_undo_history.save(UndoActionType::Cut, mini_acid_.song(), row, 1, cursorTrack(), 1);
           
           withAudioGuard([&]() {
             mini_acid_.clearSongPattern(row, track);
@@ -475,59 +441,19 @@ bool SongPage::handleEvent(UIEvent& ui_event) {
           int start_row = cursorRow();
           int start_track = cursorTrack();
           if (start_track > 2) return false;
+          int rows = g_song_area_clipboard.rows;
+          int tracks = g_song_area_clipboard.tracks;
+          if (start_track + tracks > 3) tracks = 3 - start_track;
           
           // Save old patterns for undo
-          std::vector<int> old_patterns;
-          int min_row = start_row;
-          int max_row = start_row + g_song_area_clipboard.rows - 1;
-          int min_track = start_track;
-          int max_track = start_track + g_song_area_clipboard.tracks - 1;
-          if (max_track > 2) max_track = 2;
-          
-          for (int r = min_row; r <= max_row; ++r) {
-            for (int t = min_track; t <= max_track; ++t) {
-              if (r >= Song::kMaxPositions) {
-                old_patterns.push_back(-1);
-                continue;
-              }
-              bool valid = false;
-              SongTrack song_track = trackForColumn(t, valid);
-              int pattern = valid ? mini_acid_.songPatternAt(r, song_track) : -1;
-              old_patterns.push_back(pattern);
-            }
-          }
+          g_undo_history.save(UndoActionType::Paste, mini_acid_.song(), start_row, rows, start_track, tracks);
           
           withAudioGuard([&]() {
-            int idx = 0;
-            for (int r = 0; r < g_song_area_clipboard.rows; ++r) {
-              for (int t = 0; t < g_song_area_clipboard.tracks; ++t) {
-                int target_row = start_row + r;
-                int target_track = start_track + t;
-                if (target_row >= Song::kMaxPositions || target_track > 2) {
-                  ++idx;
-                  continue;
-                }
-                bool valid = false;
-                SongTrack song_track = trackForColumn(target_track, valid);
-                if (valid && idx < static_cast<int>(g_song_area_clipboard.pattern_indices.size())) {
-                  int pattern = g_song_area_clipboard.pattern_indices[idx];
-                  if (pattern < 0) {
-                    mini_acid_.clearSongPattern(target_row, song_track);
-                  } else {
-                    mini_acid_.setSongPattern(target_row, song_track, pattern);
-                  }
-                }
-                ++idx;
-              }
-            }
+            mini_acid_.copySongRange(g_song_area_clipboard.cells, 0, start_row, rows, 0, start_track, tracks);
             if (mini_acid_.songModeEnabled() && !mini_acid_.isPlaying()) {
               mini_acid_.setSongPosition(start_row);
             }
           });
-          
-          // Save undo history
-          g_undo_history.action_type = UndoActionType::Paste;
-          g_undo_history.saveArea(min_row, max_row, min_track, max_track, old_patterns);
         } else if (g_song_pattern_clipboard.has_pattern) {
           // Paste single cell
           int row = cursorRow();
@@ -535,9 +461,7 @@ bool SongPage::handleEvent(UIEvent& ui_event) {
           int patternIndex = g_song_pattern_clipboard.pattern_index;
           
           // Save old pattern for undo
-          int old_pattern = mini_acid_.songPatternAt(row, track);
-          g_undo_history.action_type = UndoActionType::Paste;
-          g_undo_history.saveSingleCell(row, track_idx, old_pattern);
+          g_undo_history.save(UndoActionType::Paste, mini_acid_.song(), row, 1, track_idx, 1);
           
           withAudioGuard([&]() {
             if (patternIndex < 0) {
@@ -555,27 +479,17 @@ bool SongPage::handleEvent(UIEvent& ui_event) {
         return true;
       }
       case MINIACID_APP_EVENT_UNDO: {
-        if (g_undo_history.action_type == UndoActionType::None || g_undo_history.cells.empty()) {
+        if (g_undo_history.action_type == UndoActionType::None || g_undo_history.rows <= 0) {
           return false;
         }
         
-        // Restore all cells from undo history
+        // Restore the affected cells from the saved song
         withAudioGuard([&]() {
-          for (const auto& cell : g_undo_history.cells) {
-            bool valid = false;
-            SongTrack song_track = trackForColumn(cell.track, valid);
-            if (valid && cell.row >= 0 && cell.row < Song::kMaxPositions) {
-              if (cell.pattern_index < 0) {
-                mini_acid_.clearSongPattern(cell.row, song_track);
-              } else {
-                mini_acid_.setSongPattern(cell.row, song_track, cell.pattern_index);
-              }
-            }
-          }
+          mini_acid_.copySongRange(g_undo_history.before, g_undo_history.row, g_undo_history.row,
+                                   g_undo_history.rows, g_undo_history.track, g_undo_history.track,
+                                   g_undo_history.tracks);
           if (mini_acid_.songModeEnabled() && !mini_acid_.isPlaying()) {
-            if (!g_undo_history.cells.empty()) {
-              mini_acid_.setSongPosition(g_undo_history.cells[0].row);
-            }
+            mini_acid_.setSongPosition(g_undo_history.row);
           }
         });
         
@@ -690,7 +604,8 @@ void SongPage::draw(IGfx& gfx) {
   if (maxStart < 0) maxStart = 0;
   if (scroll_row_ > maxStart) scroll_row_ = maxStart;
 
-  int pos_col_w = 20;
+  int pos_col_w = textWidth(gfx, "0000") + 2;
+  if (pos_col_w < 20) pos_col_w = 20;
   int spacing = 3;
   int modeBtnW = 70;
   int track_col_w = (w - pos_col_w - spacing * 5 - modeBtnW) / 3;
@@ -764,7 +679,7 @@ void SongPage::draw(IGfx& gfx) {
     gfx.drawText(x, row_y + 2, posLabel);
     gfx.setTextColor(COLOR_WHITE);
 
-    for (int t = 0; t < SongPosition::kTrackCount; ++t) {
+    for (int t = 0; t < Song::kTrackCount; ++t) {
       int col_x = x + pos_col_w + spacing + t * (track_col_w + spacing);
       int patternIdx = mini_acid_.songPatternAt(row_idx,
                         t == 0 ? SongTrack::SynthA : (t == 1 ? SongTrack::SynthB : SongTrack::Drums));
@@ -434,6 +434,12 @@ void Synth303ParamsPage::draw(IGfx& gfx) {
   print(cx3 + delta_x_for_controls, center_y_for_knobs + delta_y_for_controls, "D/C");
   print(cx4 + delta_x_for_controls, center_y_for_knobs + delta_y_for_controls, "F/V");
   
+  if (mini_acid_.is303Frozen(voice_index_)) {
+    const char* frozenLabel = "FROZEN";
+    gfx_.setTextColor(IGfxColor::Magenta());
+    gfx_.drawText(dx() + width() - textWidth(gfx_, frozenLabel) - 2, dy() + 2, frozenLabel);
+  }
+
   // finally draw all child components
   Container::draw(gfx_);
 }
@@ -546,6 +552,28 @@ bool Synth303ParamsPage::handleEvent(UIEvent& ui_event)
         mini_acid_.toggleDistortion303(voice_index_);
       });
       break;
+    case 'b':
+      if (mini_acid_.is303Frozen(voice_index_)) {
+        withAudioGuard([&]() {
+          mini_acid_.unfreeze303(voice_index_);
+        });
+      } else {
+        // copy the settings under the guard, render outside it, then swap;
+        // a setting that changes in between means rendering again
+        bool frozen = false;
+        for (int attempt = 0; attempt < 3 && !frozen; ++attempt) {
+          bool captured = false;
+          withAudioGuard([&]() {
+            captured = mini_acid_.capture303Freeze(voice_index_);
+          });
+          if (!captured || !mini_acid_.prepare303Freeze(voice_index_)) break;
+          withAudioGuard([&]() {
+            frozen = mini_acid_.freeze303(voice_index_);
+          });
+        }
+      }
+      event_handled = true;
+      break;
     default:
       break;
   }
@@ -3,24 +3,47 @@
 #include "../help_dialog_frames.h"
 
 namespace {
-constexpr IGfxColor kWaveFadeColors[] = {
-  IGfxColor(0x808080),
-  IGfxColor(0x404040),
-  IGfxColor(0x202020),
+struct ScopeView {
+  const char* label;
+  float beats;         // span in beats at the current tempo, or
+  float milliseconds;  // a fixed span when beats is 0
 };
-constexpr int kWaveFadeColorCount =
-    static_cast<int>(sizeof(kWaveFadeColors) / sizeof(kWaveFadeColors[0]));
+
+// Left/Right steps through these; the first one is the classic close-up.
+constexpr ScopeView kScopeViews[] = {
+  {"10 MS", 0.0f, 10.0f},
+  {"STEP", 0.25f, 0.0f},
+  {"BEAT", 1.0f, 0.0f},
+  {"BAR", 4.0f, 0.0f},
+  {"4 BARS", 16.0f, 0.0f},
+};
+constexpr int kScopeViewCount =
+    static_cast<int>(sizeof(kScopeViews) / sizeof(kScopeViews[0]));
 } // namespace
 
 WaveformPage::WaveformPage(IGfx& gfx, MiniAcid& mini_acid, AudioGuard& audio_guard)
   : gfx_(gfx),
     mini_acid_(mini_acid),
     audio_guard_(audio_guard),
-    wave_color_index_(0)
+    wave_color_index_(0),
+    view_index_(0)
 {
-  for (int i = 0; i < kWaveHistoryLayers; ++i) {
-    wave_lengths_[i] = 0;
+}
+
+uint32_t WaveformPage::viewSpan() const {
+  const ScopeView& view = kScopeViews[view_index_];
+  float seconds = view.milliseconds * 0.001f;
+  if (view.beats > 0.0f) {
+    float bpm = mini_acid_.bpm();
+    if (bpm < 1.0f) bpm = 1.0f;
+    seconds = view.beats * 60.0f / bpm;
+  }
+  float span = seconds * mini_acid_.sampleRate();
+  if (span < 2.0f) span = 2.0f;
+  if (span > static_cast<float>(ScopeBuffer::maxSpan())) {
+    return ScopeBuffer::maxSpan();
   }
+  return static_cast<uint32_t>(span);
 }
 
 void WaveformPage::draw(IGfx& gfx) {
@@ -34,58 +57,36 @@ void WaveformPage::draw(IGfx& gfx) {
   int wave_h = h - 2;
   if (w < 4 || wave_h < 4) return;
 
-  int16_t samples[AUDIO_BUFFER_SAMPLES/2];
-  size_t sampleCount = mini_acid_.copyLastAudio(samples, AUDIO_BUFFER_SAMPLES/2);
   int mid_y = wave_y + wave_h / 2;
-
   gfx_.setTextColor(IGfxColor::Orange());
   gfx_.drawLine(x, mid_y, x + w - 1, mid_y);
 
-  int points = w;
-  if (points > kMaxWavePoints) points = kMaxWavePoints;
-  if (sampleCount > 1 && points > 1) {
-    int16_t new_wave[kMaxWavePoints];
-    for (int px = 0; px < points; ++px) {
-      size_t idx = static_cast<size_t>((uint64_t)px * (sampleCount - 1) / (points - 1));
-      new_wave[px] = samples[idx];
-    }
+  const char* label = kScopeViews[view_index_].label;
+  gfx_.setTextColor(COLOR_LABEL);
+  gfx_.drawText(x + w - textWidth(gfx_, label) - 2, wave_y, label);
 
-    for (int layer = kWaveHistoryLayers - 1; layer > 0; --layer) {
-      wave_lengths_[layer] = wave_lengths_[layer - 1];
-      for (int px = 0; px < wave_lengths_[layer]; ++px) {
-        wave_history_[layer][px] = wave_history_[layer - 1][px];
-      }
-    }
+  // One min/max per pixel column, read without stopping the audio.
+  int columns = w;
+  if (columns > kMaxColumns) columns = kMaxColumns;
+  ScopeBuffer::Peak peaks[kMaxColumns];
+  if (!mini_acid_.scope().read(viewSpan(), peaks, columns)) return;
 
-    wave_lengths_[0] = points;
-    for (int px = 0; px < points; ++px) {
-      wave_history_[0][px] = new_wave[px];
-    }
-  }
-
-  auto drawWave = [&](const int16_t* wave, int count, IGfxColor color) {
-    int drawCount = count;
-    if (drawCount > w) drawCount = w;
-    if (drawCount < 2) return;
-    int amplitude = wave_h / 2 - 2;
-    if (amplitude < 1) amplitude = 1;
-    for (int px = 0; px < drawCount - 1; ++px) {
-      float s0 = wave[px] / 32768.0f;
-      float s1 = wave[px + 1] / 32768.0f;
-      int y0 = mid_y - static_cast<int>(s0 * amplitude);
-      int y1 = mid_y - static_cast<int>(s1 * amplitude);
-      drawLineColored(gfx_, x + px, y0, x + px + 1, y1, color);
-    }
+  int amplitude = wave_h / 2 - 2;
+  if (amplitude < 1) amplitude = 1;
+  auto toY = [&](int value) {
+    return mid_y - value * amplitude / ScopeBuffer::kFullScale;
   };
-
-  for (int layer = kWaveHistoryLayers - 1; layer >= 1; --layer) {
-    int colorIndex = layer - 1;
-    if (colorIndex >= kWaveFadeColorCount) colorIndex = kWaveFadeColorCount - 1;
-    drawWave(wave_history_[layer], wave_lengths_[layer], kWaveFadeColors[colorIndex]);
-  }
-
   IGfxColor waveColor = WAVE_COLORS[wave_color_index_ % NUM_WAVE_COLORS];
-  drawWave(wave_history_[0], wave_lengths_[0], waveColor);
+  for (int px = 0; px < columns; ++px) {
+    int lo = peaks[px].min;
+    int hi = peaks[px].max;
+    // Reach over to the previous column so the trace stays connected.
+    if (px > 0) {
+      if (peaks[px - 1].max < lo) lo = peaks[px - 1].max;
+      if (peaks[px - 1].min > hi) hi = peaks[px - 1].min;
+    }
+    drawLineColored(gfx_, x + px, toY(hi), x + px, toY(lo), waveColor);
+  }
 }
 
 bool WaveformPage::handleEvent(UIEvent& ui_event) {
@@ -95,6 +96,12 @@ bool WaveformPage::handleEvent(UIEvent& ui_event) {
     case MINIACID_DOWN:
       wave_color_index_ = (wave_color_index_ + 1) % NUM_WAVE_COLORS;
       return true;
+    case MINIACID_LEFT:
+      if (view_index_ > 0) --view_index_;
+      return true;
+    case MINIACID_RIGHT:
+      if (view_index_ + 1 < kScopeViewCount) ++view_index_;
+      return true;
     default:
       break;
   }
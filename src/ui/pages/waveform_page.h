@@ -14,12 +14,13 @@ class WaveformPage : public IPage {
   const std::string & getTitle() const override;
 
  private:
+  // Samples the current view spans at the current tempo.
+  uint32_t viewSpan() const;
+
   IGfx& gfx_;
  MiniAcid& mini_acid_;
  AudioGuard& audio_guard_;
  int wave_color_index_;
-  static constexpr int kWaveHistoryLayers = 4;
-  static constexpr int kMaxWavePoints = 256;
-  int16_t wave_history_[kWaveHistoryLayers][kMaxWavePoints];
-  int wave_lengths_[kWaveHistoryLayers];
+ int view_index_;
+  static constexpr int kMaxColumns = 320;
 };
@@ -0,0 +1,128 @@
+// ThreadedAudioRecorder hands its sink fixed-size chunks, which the web
+// build passes on to JavaScript as they come. Records through a sink that
+// keeps every write as a separate part, in each format, and checks that
+// the parts have the chunk size and join into a file that decodes to what
+// went in.
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "src/audio/recording_codec.h"
+#include "src/audio/threaded_audio_recorder.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr int kSampleRate = 22050;
+constexpr size_t kBlockSamples = 256;
+
+class MemorySinkRecorder : public ThreadedAudioRecorder {
+ public:
+  ~MemorySinkRecorder() override { stop(); }
+
+  std::vector<std::vector<uint8_t>> parts;
+
+ protected:
+  bool openSink(int, const char*, const char* extension, std::string& filename) override {
+    parts.clear();
+    filename = std::string("memory.") + extension;
+    return true;
+  }
+  size_t writeSink(int, const uint8_t* data, size_t size) override {
+    parts.emplace_back(data, data + size);
+    return size;
+  }
+  void closeSink(int, const uint8_t* header, size_t headerSize) override {
+    if (headerSize > 0) parts[0].assign(header, header + headerSize);
+  }
+};
+
+// Ten seconds of a detuned saw pair over a little noise, not a multiple
+// of any block or chunk size.
+std::vector<int16_t> makeSignal() {
+  std::vector<int16_t> pcm(static_cast<size_t>(kSampleRate) * 10 + 123);
+  uint32_t seed = 0x13579bdfu;
+  for (size_t i = 0; i < pcm.size(); ++i) {
+    double t = static_cast<double>(i) / kSampleRate;
+    double saw = fmod(t * 110.0, 1.0) + fmod(t * 110.7, 1.0) - 1.0;
+    seed = seed * 1664525u + 1013904223u;
+    double noise = static_cast<int32_t>(seed) / 2147483648.0;
+    pcm[i] = static_cast<int16_t>(12000.0 * saw + 800.0 * noise);
+  }
+  return pcm;
+}
+
+// The same samples encoded in one go, decoded: what the chunked file must
+// decode to as well.
+std::vector<int16_t> referenceDecode(RecordingFormat format, const std::vector<int16_t>& pcm) {
+  RecordingEncoder encoder;
+  encoder.reset(format);
+  size_t headerSize = recordingHeaderBytes(format);
+  std::vector<uint8_t> file(headerSize);
+  std::vector<uint8_t> block(recordingMaxBlockBytes(format));
+  size_t blockSamples = recordingBlockSamples(format);
+  for (size_t done = 0; done < pcm.size(); done += blockSamples) {
+    size_t count = pcm.size() - done;
+    if (count > blockSamples) count = blockSamples;
+    size_t bytes = encoder.encodeBlock(pcm.data() + done, count, block.data());
+    file.insert(file.end(), block.begin(), block.begin() + bytes);
+  }
+  writeRecordingHeader(format, kSampleRate, 1, static_cast<uint32_t>(pcm.size()),
+                       static_cast<uint32_t>(file.size() - headerSize), file.data());
+  std::vector<int16_t> decoded;
+  int rate = 0;
+  if (!decodeRecording(file.data(), file.size(), decoded, rate)) decoded.clear();
+  return decoded;
+}
+
+}  // namespace
+
+int main() {
+  const std::vector<int16_t> pcm = makeSignal();
+  static const RecordingFormat kFormats[] = {RecordingFormat::Pcm16, RecordingFormat::ImaAdpcm,
+                                             RecordingFormat::RiceLossless};
+  static const char* const kNames[] = {"pcm", "adpcm", "lossless"};
+
+  for (int f = 0; f < 3; ++f) {
+    MemorySinkRecorder recorder;
+    CHECK(recorder.setFormat(kFormats[f]));
+    CHECK(recorder.start(kSampleRate, 1));
+    for (size_t done = 0; done < pcm.size(); done += kBlockSamples) {
+      size_t count = pcm.size() - done;
+      if (count > kBlockSamples) count = kBlockSamples;
+      recorder.writeSamples(pcm.data() + done, count);
+      // Well ahead of real time, but slow enough that the ring never fills.
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    recorder.stop();
+
+    // Every part between the header and the last one is a whole chunk.
+    size_t odd = 0;
+    std::vector<uint8_t> file;
+    for (size_t p = 0; p < recorder.parts.size(); ++p) {
+      const std::vector<uint8_t>& part = recorder.parts[p];
+      if (p > 0 && p + 1 < recorder.parts.size() &&
+          part.size() != ThreadedAudioRecorder::kChunkBytes) {
+        ++odd;
+      }
+      file.insert(file.end(), part.begin(), part.end());
+    }
+    std::vector<int16_t> decoded;
+    int rate = 0;
+    bool decodes = decodeRecording(file.data(), file.size(), decoded, rate);
+    printf("%-8s: %zu chunks, %zu of the wrong size, %u dropped\n", kNames[f],
+           recorder.parts.size() - 1, odd, recorder.droppedSamples());
+    CHECK(recorder.parts.size() > 2);
+    CHECK(odd == 0);
+    CHECK(recorder.droppedSamples() == 0);
+    CHECK(decodes && rate == kSampleRate);
+    CHECK(decoded == referenceDecode(kFormats[f], pcm));
+    // ADPCM is lossy; codec_test bounds its error.
+    if (kFormats[f] != RecordingFormat::ImaAdpcm) CHECK(decoded == pcm);
+  }
+
+  return testResult("chunk_test");
+}
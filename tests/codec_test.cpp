@@ -0,0 +1,138 @@
+// Recording formats round trip: encodes test signals block by block the way
+// the recorder does, decodes the file again and compares. PCM and the
+// lossless format must come back sample for sample; IMA-ADPCM within a
+// bounded error.
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "src/audio/recording_codec.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr int kSampleRate = 22050;
+
+// A bit of everything the codecs care about: silence, a sine sweep, a
+// saw with hard edges, noise, and full-scale jumps that stress the
+// predictor. The length is not a multiple of any block size.
+std::vector<int16_t> makeSignal() {
+  std::vector<int16_t> pcm;
+  const size_t part = kSampleRate / 2 + 37;
+  pcm.insert(pcm.end(), part, 0);
+  double phase = 0.0;
+  for (size_t i = 0; i < part; ++i) {
+    double freq = 40.0 + 8000.0 * i / part;
+    phase += 2.0 * 3.14159265358979323846 * freq / kSampleRate;
+    pcm.push_back(static_cast<int16_t>(20000.0 * sin(phase)));
+  }
+  for (size_t i = 0; i < part; ++i) {
+    pcm.push_back(static_cast<int16_t>(static_cast<int>((i * 311) % 60000) - 30000));
+  }
+  uint32_t seed = 0x2468ace1u;
+  for (size_t i = 0; i < part; ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    pcm.push_back(static_cast<int16_t>(seed >> 16));
+  }
+  for (size_t i = 0; i < 4099; ++i) pcm.push_back(i % 2 ? 32767 : -32768);
+  return pcm;
+}
+
+bool encode(RecordingFormat format, const std::vector<int16_t>& pcm, std::vector<uint8_t>& file) {
+  RecordingEncoder encoder;
+  encoder.reset(format);
+  size_t headerSize = recordingHeaderBytes(format);
+  file.assign(headerSize, 0);
+  std::vector<uint8_t> block(recordingMaxBlockBytes(format));
+  size_t blockSamples = recordingBlockSamples(format);
+  for (size_t done = 0; done < pcm.size(); done += blockSamples) {
+    size_t count = pcm.size() - done;
+    if (count > blockSamples) count = blockSamples;
+    size_t bytes = encoder.encodeBlock(pcm.data() + done, count, block.data());
+    if (bytes > block.size()) return false;
+    file.insert(file.end(), block.begin(), block.begin() + bytes);
+  }
+  return writeRecordingHeader(format, kSampleRate, 1, static_cast<uint32_t>(pcm.size()),
+                              static_cast<uint32_t>(file.size() - headerSize),
+                              file.data()) == headerSize;
+}
+
+struct RoundTrip {
+  bool decoded = false;
+  int maxError = 0;
+  double snrDb = 0.0;
+  double ratio = 0.0;
+};
+
+RoundTrip roundTrip(RecordingFormat format, const std::vector<int16_t>& pcm) {
+  RoundTrip result;
+  std::vector<uint8_t> file;
+  if (!encode(format, pcm, file)) return result;
+  std::vector<int16_t> decoded;
+  int rate = 0;
+  result.decoded = decodeRecording(file.data(), file.size(), decoded, rate) &&
+                   rate == kSampleRate && decoded.size() == pcm.size();
+  if (!result.decoded) return result;
+  double signal = 0.0;
+  double noise = 0.0;
+  for (size_t i = 0; i < pcm.size(); ++i) {
+    int error = decoded[i] - pcm[i];
+    if (error < 0) error = -error;
+    if (error > result.maxError) result.maxError = error;
+    signal += static_cast<double>(pcm[i]) * pcm[i];
+    noise += static_cast<double>(error) * error;
+  }
+  result.snrDb = noise > 0.0 ? 10.0 * log10(signal / noise) : 200.0;
+  result.ratio = 2.0 * pcm.size() / (file.size() - recordingHeaderBytes(format));
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  const std::vector<int16_t> pcm = makeSignal();
+
+  RoundTrip pcm16 = roundTrip(RecordingFormat::Pcm16, pcm);
+  printf("pcm     : %.2f:1, max error %d\n", pcm16.ratio, pcm16.maxError);
+  CHECK(pcm16.decoded);
+  CHECK(pcm16.maxError == 0);
+
+  RoundTrip lossless = roundTrip(RecordingFormat::RiceLossless, pcm);
+  printf("lossless: %.2f:1, max error %d\n", lossless.ratio, lossless.maxError);
+  CHECK(lossless.decoded);
+  CHECK(lossless.maxError == 0);
+  // Silence and the sweep shrink; blocks that would grow are stored
+  // verbatim, so the file never gets much bigger than PCM.
+  CHECK(lossless.ratio > 1.0);
+
+  // ADPCM is lossy: its step size lags full-scale jumps, so the worst
+  // sample can be far off. The error is bounded by the signal to noise
+  // ratio instead.
+  RoundTrip adpcm = roundTrip(RecordingFormat::ImaAdpcm, pcm);
+  printf("adpcm   : %.2f:1, max error %d, SNR %.1f dB\n", adpcm.ratio, adpcm.maxError,
+         adpcm.snrDb);
+  CHECK(adpcm.decoded);
+  CHECK(adpcm.ratio > 3.9);
+  CHECK(adpcm.snrDb > 8.0);
+
+  // A bass line at half scale, the kind of material it is meant for.
+  std::vector<int16_t> bass(kSampleRate);
+  for (size_t i = 0; i < bass.size(); ++i) {
+    double phase = 2.0 * 3.14159265358979323846 * 110.0 * i / kSampleRate;
+    bass[i] = static_cast<int16_t>(16384.0 * sin(phase));
+  }
+  RoundTrip adpcmBass = roundTrip(RecordingFormat::ImaAdpcm, bass);
+  printf("adpcm   : 110 Hz max error %d, SNR %.1f dB\n", adpcmBass.maxError, adpcmBass.snrDb);
+  CHECK(adpcmBass.decoded);
+  CHECK(adpcmBass.snrDb > 40.0);
+
+  // Truncated files are refused rather than decoded short.
+  std::vector<uint8_t> file;
+  CHECK(encode(RecordingFormat::RiceLossless, pcm, file));
+  std::vector<int16_t> decoded;
+  int rate = 0;
+  CHECK(!decodeRecording(file.data(), file.size() / 2, decoded, rate));
+
+  return testResult("codec_test");
+}
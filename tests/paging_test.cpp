@@ -0,0 +1,95 @@
+// Bank paging against a reader that is still busy: a slot the reader may
+// hold is unpublished but never refilled until the reader is done, pinned
+// banks are never chosen as victims, and the current banks plus a full song
+// row ahead fit in the resident slots.
+
+#include <stdio.h>
+
+#include "scenes.h"
+#include "test_check.h"
+
+namespace {
+
+// Stands in for the audio thread: 'busy' means a render that started
+// before the slot was unpublished is still running.
+class TestReaders : public SceneBankReaders {
+ public:
+  uint32_t pinned = 0;
+  bool busy = false;
+  uint32_t finished = 0;
+
+  uint32_t pinnedBanks() const override { return pinned; }
+  uint32_t readTicket() const override { return busy ? finished + 1 : finished; }
+  bool readsDone(uint32_t ticket) const override { return finished >= ticket; }
+};
+
+int8_t markerOf(const SceneBank& bank) { return bank.synthA.patterns[0].steps[0].note; }
+
+// Banks whose slots still hold their own data, resident or not.
+bool slotsIntact(const SceneManager& scene) {
+  for (int b = 0; b < kBankCount; ++b) {
+    const SceneBank* bank = scene.residentBank(b);
+    if (bank && markerOf(*bank) != b) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  MemoryBankStore store;
+  SceneBank bank;
+  clearSceneBank(bank);
+  for (int b = 0; b < kBankCount; ++b) {
+    bank.synthA.patterns[0].steps[0].note = static_cast<int8_t>(b);
+    CHECK(store.writeBank(std::string(), b, bank));
+  }
+
+  TestReaders readers;
+  SceneManager scene;
+  scene.setBankStore(&store, "paging");
+  scene.setBankReaders(&readers);
+
+  // Current banks 0, 1, 2 and the next song row on 3, 4, 5.
+  scene.setCurrentBankIndex(0, 0);
+  scene.setCurrentBankIndex(1, 1);
+  scene.setCurrentBankIndex(2, 2);
+  readers.pinned = (1u << 3) | (1u << 4) | (1u << 5);
+  for (int b = 0; b < 6; ++b) CHECK(scene.ensureBankResident(b));
+  CHECK(scene.residentBanksMask() == 0x3Fu);
+  CHECK(slotsIntact(scene));
+
+  // Paging in more banks while a render is running: pinned banks stay,
+  // and once every slot is in use the next bank waits for the reader.
+  readers.busy = true;
+  int loaded = 0;
+  for (int b = 6; b < kBankCount; ++b) {
+    const SceneBank* before[kBankCount];
+    for (int i = 0; i < kBankCount; ++i) before[i] = scene.residentBank(i);
+    if (scene.ensureBankResident(b)) ++loaded;
+    CHECK((scene.residentBanksMask() & 0x3Fu) == 0x3Fu);
+    CHECK(slotsIntact(scene));
+    // No slot the reader could have looked up was refilled.
+    for (int i = 0; i < kBankCount; ++i) {
+      if (before[i]) CHECK(markerOf(*before[i]) == i);
+    }
+  }
+  CHECK(loaded < kBankCount - 6);
+
+  // Once the render is done the retired slot is free again.
+  readers.busy = false;
+  readers.finished += 1;
+  CHECK(scene.ensureBankResident(15));
+  CHECK(scene.isBankResident(15));
+  CHECK((scene.residentBanksMask() & 0x3Fu) == 0x3Fu);
+  CHECK(slotsIntact(scene));
+
+  // Without readers paging swaps banks in place as before.
+  SceneManager copy;
+  copy.setBankStore(&store, "paging");
+  for (int b = 0; b < kBankCount; ++b) CHECK(copy.ensureBankResident(b));
+  CHECK(copy.isBankResident(kBankCount - 1));
+  CHECK(slotsIntact(copy));
+
+  return testResult("paging_test");
+}
@@ -0,0 +1,102 @@
+// ThreadedAudioRecorder against a sink that stalls like an SD card erasing
+// a block: the audio side must never wait on it, and every sample must end
+// up either written or counted as dropped.
+
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+#include "src/audio/threaded_audio_recorder.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr int kSampleRate = 22050;
+constexpr int kBlockSamples = 256;
+
+class SlowSinkRecorder : public ThreadedAudioRecorder {
+ public:
+  explicit SlowSinkRecorder(int stallMs) : stallMs_(stallMs) {}
+  ~SlowSinkRecorder() override { stop(); }
+
+  uint64_t received = 0;
+
+ protected:
+  bool openSink(int, const char*, const char*, std::string& filename) override {
+    filename = "slow sink";
+    return true;
+  }
+  size_t writeSink(int, const uint8_t*, size_t size) override {
+    // The first write is the placeholder header.
+    if (chunks_++ == 0) return size;
+    // Every 16th chunk stalls, the rest take a couple of milliseconds.
+    std::this_thread::sleep_for(std::chrono::milliseconds(chunks_ % 16 == 0 ? stallMs_ : 2));
+    received += size;
+    return size;
+  }
+  void closeSink(int, const uint8_t*, size_t) override {}
+
+ private:
+  int stallMs_;
+  int chunks_ = 0;
+};
+
+struct SessionResult {
+  double worstWriteUs = 0.0;
+  uint64_t pushed = 0;
+  uint64_t written = 0;
+  uint32_t dropped = 0;
+};
+
+// Feeds the recorder in real time for 'seconds', like the audio callback.
+SessionResult recordSession(int stallMs, int seconds) {
+  SessionResult result;
+  SlowSinkRecorder recorder(stallMs);
+  CHECK(recorder.start(kSampleRate, 1));
+  int16_t block[kBlockSamples];
+  for (int i = 0; i < kBlockSamples; ++i) block[i] = static_cast<int16_t>(i);
+  const auto period = std::chrono::microseconds(1000000LL * kBlockSamples / kSampleRate);
+  const int blocks = seconds * kSampleRate / kBlockSamples;
+  auto next = std::chrono::steady_clock::now();
+  for (int b = 0; b < blocks; ++b) {
+    auto start = std::chrono::steady_clock::now();
+    recorder.writeSamples(block, kBlockSamples);
+    double us = std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - start).count();
+    if (us > result.worstWriteUs) result.worstWriteUs = us;
+    next += period;
+    std::this_thread::sleep_until(next);
+  }
+  result.dropped = recorder.droppedSamples();
+  recorder.stop();
+  result.pushed = static_cast<uint64_t>(blocks) * kBlockSamples;
+  result.written = recorder.received / sizeof(int16_t);
+  printf("%d ms stalls: worst writeSamples %.1f us, %llu samples pushed, %llu written, "
+         "%u dropped\n",
+         stallMs, result.worstWriteUs, static_cast<unsigned long long>(result.pushed),
+         static_cast<unsigned long long>(result.written), result.dropped);
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  // Stalls the ring can absorb lose nothing.
+  SessionResult shortStalls = recordSession(200, 4);
+  CHECK(shortStalls.dropped == 0);
+  CHECK(shortStalls.written == shortStalls.pushed);
+
+  // A stall longer than the ring holds drops whole blocks, never a sample
+  // unaccounted for.
+  SessionResult longStalls = recordSession(3500, 5);
+  CHECK(longStalls.dropped > 0);
+  CHECK(longStalls.dropped % kBlockSamples == 0);
+  CHECK(longStalls.written + longStalls.dropped == longStalls.pushed);
+
+  // Either way the audio side only copies into the ring. The bound leaves
+  // room for scheduling noise but is far below any of the stalls.
+  CHECK(shortStalls.worstWriteUs < 20000.0);
+  CHECK(longStalls.worstWriteUs < 20000.0);
+
+  return testResult("recorder_test");
+}
@@ -0,0 +1,147 @@
+// Frequency response of PolyphaseResampler: sweeps sine tones through each
+// quality and checks the passband gain and the worst image or alias left.
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "src/dsp/resampler.h"
+#include "test_check.h"
+
+namespace {
+
+struct ToneFit {
+  // Amplitude of the output at the tone frequency.
+  double amplitude = 0.0;
+  // Amplitude of a sine with the power of everything else.
+  double residual = 0.0;
+};
+
+// Least-squares fit of a sine at 'freq' to the steady part of 'resampler's
+// output for a full-scale input tone.
+ToneFit fitTone(PolyphaseResampler& resampler, double freq) {
+  const size_t kOutputs = 16384;
+  const size_t kBlock = 256;
+  const size_t settle = 4 * static_cast<size_t>(resampler.tapsPerPhase()) + kBlock;
+  resampler.reset();
+  std::vector<float> in;
+  std::vector<float> out(kOutputs);
+  const double inStep = 2.0 * 3.14159265358979323846 * freq / resampler.inputRate();
+  size_t inPos = 0;
+  for (size_t done = 0; done < kOutputs; done += kBlock) {
+    size_t need = resampler.inputNeeded(kBlock);
+    in.resize(need);
+    for (size_t i = 0; i < need; ++i, ++inPos) in[i] = static_cast<float>(sin(inStep * inPos));
+    resampler.process(in.data(), out.data() + done, kBlock);
+  }
+
+  const double outStep = 2.0 * 3.14159265358979323846 * freq / resampler.outputRate();
+  double cc = 0.0, cs = 0.0, ss = 0.0, yc = 0.0, ys = 0.0, yy = 0.0;
+  for (size_t n = settle; n < kOutputs; ++n) {
+    double c = cos(outStep * n);
+    double s = sin(outStep * n);
+    double y = out[n];
+    cc += c * c;
+    cs += c * s;
+    ss += s * s;
+    yc += y * c;
+    ys += y * s;
+    yy += y * y;
+  }
+  ToneFit fit;
+  double det = cc * ss - cs * cs;
+  double a = 0.0, b = 0.0;
+  if (fabs(det) > 1e-9) {
+    a = (yc * ss - ys * cs) / det;
+    b = (ys * cc - yc * cs) / det;
+  }
+  fit.amplitude = sqrt(a * a + b * b);
+  double residualPower = (yy - a * yc - b * ys) / static_cast<double>(kOutputs - settle);
+  fit.residual = sqrt(2.0 * (residualPower > 0.0 ? residualPower : 0.0));
+  return fit;
+}
+
+double toDb(double amplitude) {
+  return 20.0 * log10(amplitude > 1e-12 ? amplitude : 1e-12);
+}
+
+struct Response {
+  // Gain in dB of tones up to 80% of the lower Nyquist frequency.
+  double passbandMinDb = 0.0;
+  double passbandMaxDb = 0.0;
+  // Loudest image or alias, relative to a full-scale tone.
+  double stopbandMaxDb = -200.0;
+};
+
+// Tones in the passband give the gain; whatever else comes out of them
+// (images when upsampling) and tones that would alias into the passband
+// when downsampling give the stopband.
+Response measure(PolyphaseResampler& resampler) {
+  const double inNyquist = 0.5 * resampler.inputRate();
+  const double outNyquist = 0.5 * resampler.outputRate();
+  const double passEdge = 0.8 * (inNyquist < outNyquist ? inNyquist : outNyquist);
+  const int kTones = 48;
+  Response response;
+  bool first = true;
+  for (int t = 1; t < kTones; ++t) {
+    double freq = inNyquist * t / kTones;
+    ToneFit fit = fitTone(resampler, freq);
+    if (freq > resampler.outputRate() - passEdge) {
+      double db = toDb(sqrt(fit.amplitude * fit.amplitude + fit.residual * fit.residual));
+      if (db > response.stopbandMaxDb) response.stopbandMaxDb = db;
+      continue;
+    }
+    if (freq > passEdge) continue;
+    double gain = toDb(fit.amplitude);
+    if (first || gain < response.passbandMinDb) response.passbandMinDb = gain;
+    if (first || gain > response.passbandMaxDb) response.passbandMaxDb = gain;
+    first = false;
+    double images = toDb(fit.residual);
+    if (images > response.stopbandMaxDb) response.stopbandMaxDb = images;
+  }
+  return response;
+}
+
+}  // namespace
+
+int main() {
+  struct Case {
+    uint32_t inputRate;
+    uint32_t outputRate;
+  };
+  // The engine rates against common device rates, both directions.
+  static const Case kCases[] = {
+    {22050, 44100}, {22050, 48000}, {22050, 96000}, {32000, 48000}, {44100, 22050}, {48000, 44100},
+  };
+  static const char* const kQualityNames[] = {"low", "medium", "high"};
+  // Allowed passband ripple and stopband level per quality, in dB.
+  static const double kRippleDb[] = {4.5, 1.5, 0.1};
+  static const double kStopbandDb[] = {-30.0, -55.0, -80.0};
+
+  for (const Case& c : kCases) {
+    for (int q = 0; q < 3; ++q) {
+      PolyphaseResampler resampler;
+      CHECK(resampler.configure(c.inputRate, c.outputRate, static_cast<ResamplerQuality>(q)));
+      Response r = measure(resampler);
+      printf("%u -> %u Hz %-6s: passband %.3f..%.3f dB, stopband %.1f dB\n", c.inputRate,
+             c.outputRate, kQualityNames[q], r.passbandMinDb, r.passbandMaxDb, r.stopbandMaxDb);
+      CHECK(r.passbandMinDb > -kRippleDb[q] && r.passbandMaxDb < kRippleDb[q]);
+      CHECK(r.stopbandMaxDb < kStopbandDb[q]);
+    }
+  }
+
+  // Equal rates pass samples through untouched.
+  PolyphaseResampler same;
+  CHECK(same.configure(22050, 22050));
+  CHECK(same.passthrough());
+  float in[64];
+  float out[64];
+  for (int i = 0; i < 64; ++i) in[i] = static_cast<float>(i) / 64.0f - 0.5f;
+  CHECK(same.inputNeeded(64) == 64);
+  same.process(in, out, 64);
+  bool identical = true;
+  for (int i = 0; i < 64; ++i) identical = identical && out[i] == in[i];
+  CHECK(identical);
+
+  return testResult("resampler_test");
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdio.h>
+
+// Minimal checks for the test programs: a failed CHECK() prints where and
+// what, and testResult() turns the count into main()'s exit status.
+inline int& testFailures() {
+  static int failures = 0;
+  return failures;
+}
+
+#define CHECK(condition)                                                   \
+  do {                                                                     \
+    if (!(condition)) {                                                    \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      ++testFailures();                                                    \
+    }                                                                      \
+  } while (0)
+
+inline int testResult(const char* name) {
+  if (testFailures() == 0) {
+    printf("%s: ok\n", name);
+    return 0;
+  }
+  printf("%s: %d check(s) failed\n", name, testFailures());
+  return 1;
+}